@@ -95,25 +95,6 @@ namespace Element
         return getRootDir().getChildFile(path).getNonexistentSibling();
     }
     
-    void DataPath::findPresetsFor (const String& format, const String& identifier, NodeArray& nodes) const
-    {
-        const auto presetsDir = getRootDir().getChildFile ("Presets");
-        if (! presetsDir.exists() || ! presetsDir.isDirectory())
-            return;
-
-        DirectoryIterator iter (presetsDir, true, EL_PRESET_FILE_EXTENSIONS);
-        while (iter.next())
-        {
-            Node node (Node::parse (iter.getFile()));
-            if (node.isValid() && 
-                node.getFileOrIdentifier() == identifier && 
-                node.getFormat() == format)
-            {
-                nodes.add (node);
-            }
-        }
-    }
-
     void DataPath::findPresetFiles (StringArray& results) const
     {
         const auto presetsDir = getRootDir().getChildFile ("Presets");
@@ -25,7 +25,6 @@
 namespace Element {
 
 class Node;
-class NodeArray;
 
 class DataPath
 {
@@ -69,7 +68,7 @@ public:
 
     const File& getRootDir() const { return root; }
     File createNewPresetFile (const Node& node, const String& name = String()) const;
-    void findPresetsFor (const String& format, const String& identifier, NodeArray& nodes) const;
+
     void findPresetFiles (StringArray& results) const;
     
 private:
@@ -68,6 +68,7 @@ namespace Tags
     const Identifier nodes              = "nodes";
     const Identifier notes              = "notes";
     const Identifier oversamplingFactor = "oversamplingFactor";
+    const Identifier oversamplingQuality = "oversamplingQuality";
     const Identifier persistent         = "persistent";
     const Identifier placeholder        = "placeholder";
     const Identifier port               = "port";
@@ -101,6 +102,7 @@ namespace Tags
     const Identifier globalMidiPrograms = "globalMidiPrograms";
     const Identifier midiProgramsState  = "midiProgramsState";
     const Identifier renderMode         = "renderMode";
+    const Identifier multiCoreRendering = "multiCoreRendering";
 
     const Identifier vertical           = "vertical";
     const Identifier staticPos          = "staticPos";
@@ -132,6 +134,8 @@ namespace Tags
     const Identifier workspace          = "workspace";
 
     const Identifier externalSync       = "externalSync";
+    const Identifier graphPreload       = "graphPreload";
+    const Identifier graphPreloadCount  = "graphPreloadCount";
 
     const Identifier updater            = "updater";
 }
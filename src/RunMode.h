@@ -25,7 +25,9 @@ enum struct RunMode : int {
     /** Running as standalone application */
     Standalone = 0,
     /** Running as an audio plugin */
-    Plugin     = 1
+    Plugin     = 1,
+    /** Rendering to files without an audio device */
+    Offline    = 2
 };
 
 }
@@ -44,6 +44,8 @@ const char* Settings::oscHostEnabledKey         = "oscHostEnabledKey";
 const char* Settings::systrayKey                = "systrayKey";
 const char* Settings::midiOutLatencyKey         = "midiOutLatency";
 const char* Settings::desktopScaleKey           = "desktopScale";
+const char* Settings::binarySessionsKey         = "binarySessions";
+const char* Settings::autosaveIntervalKey       = "autosaveInterval";
 
 //=============================================================================
 enum OptionsMenuItemId
@@ -409,6 +411,38 @@ void Settings::setDesktopScale (double scale)
         p->setValue (desktopScaleKey, scale);
 }
 
+//=============================================================================
+bool Settings::useBinarySessions() const
+{
+    if (auto* p = getProps())
+        return p->getBoolValue (binarySessionsKey, false);
+    return false;
+}
+
+void Settings::setUseBinarySessions (bool useBinary)
+{
+    if (useBinary == useBinarySessions())
+        return;
+    if (auto* p = getProps())
+        p->setValue (binarySessionsKey, useBinary);
+}
+
+int Settings::getAutosaveInterval() const
+{
+    if (auto* p = getProps())
+        return jmax (0, p->getIntValue (autosaveIntervalKey, 30));
+    return 30;
+}
+
+void Settings::setAutosaveInterval (int seconds)
+{
+    seconds = jmax (0, seconds);
+    if (seconds == getAutosaveInterval())
+        return;
+    if (auto* p = getProps())
+        p->setValue (autosaveIntervalKey, seconds);
+}
+
 //=============================================================================
 void Settings::addItemsToMenu (Globals& world, PopupMenu& menu)
 {
@@ -53,6 +53,8 @@ public:
     static const char* systrayKey;
     static const char* midiOutLatencyKey;
     static const char* desktopScaleKey;
+    static const char* binarySessionsKey;
+    static const char* autosaveIntervalKey;
 
     std::unique_ptr<XmlElement> getLastGraph() const;
     void setLastGraph (const ValueTree& data);
@@ -124,6 +126,14 @@ public:
     double getDesktopScale() const;
     void setDesktopScale (double);
 
+    /** True if sessions should be saved as binary archives instead of XML */
+    bool useBinarySessions() const;
+    void setUseBinarySessions (bool);
+
+    /** Seconds between autosaves of the session's journal, 0 if disabled */
+    int getAutosaveInterval() const;
+    void setAutosaveInterval (int seconds);
+
 private:
     PropertiesFile* getProps() const;
 };
@@ -55,9 +55,10 @@ struct RootGraphHolder
 
     /** This will create a root graph processor/controller and load it if not
         done already. Properties are set from the model, so make sure they are
-        correct before calling this 
+        correct before calling this. Pass false to leave loading the nodes
+        for later.
      */
-    bool attach (AudioEnginePtr engine)
+    bool attach (AudioEnginePtr engine, const bool loadGraph = true)
     {
         jassert (engine);
         if (! engine)
@@ -80,18 +81,32 @@ struct RootGraphHolder
             root->setRenderMode (mode);
             root->setMidiChannels (channels);
             root->setMidiProgram (program);
+            root->setMultiCoreRendering ((bool) model.getProperty (Tags::multiCoreRendering, false));
 
             if (engine->addGraph (root))
             {
                 controller = new RootGraphManager (*root, plugins);
                 model.setProperty (Tags::object, node.get());
-                controller->setNodeModel (model);
-                resetIONodePorts();
+                if (loadGraph)
+                    load();
             }
         }
         
         return attached();
     }
+
+    /** Returns true if attached and the graph's nodes are loaded */
+    bool isLoaded() const { return controller != nullptr && controller->isLoaded(); }
+
+    /** Loads the nodes of an attached graph if not done already */
+    void load()
+    {
+        if (controller == nullptr || controller->isLoaded())
+            return;
+        controller->getRootGraph().setPlayConfigFor (devices);
+        controller->setNodeModel (model);
+        resetIONodePorts();
+    }
     
     bool detach (AudioEnginePtr engine)
     {
@@ -134,6 +149,7 @@ struct RootGraphHolder
 private:
     friend class EngineController;
     friend class EngineController::RootGraphs;
+    friend class EngineController::GraphPreloader;
     PluginManager&                      plugins;
     DeviceManager&                      devices;
     ScopedPointer<RootGraphManager>  controller;
@@ -287,6 +303,41 @@ public:
             g->detach (engine);
     }
     
+    /** Returns the next attached graph which the session's preload policy
+        wants loaded but isn't yet, or nullptr if there's nothing to do
+     */
+    RootGraphHolder* findNextToPreload() const
+    {
+        auto session = owner.getWorld().getSession();
+        if (session == nullptr)
+            return nullptr;
+
+        const auto policy = session->getGraphPreload();
+        const int active  = session->getActiveGraphIndex();
+        const int count   = session->getGraphPreloadCount();
+
+        for (int i = 0; i < session->getNumGraphs(); ++i)
+        {
+            const Node graph (session->getGraph (i));
+            bool wanted = false;
+            switch (policy)
+            {
+                case Session::PreloadAll:       wanted = true; break;
+                case Session::PreloadNext:      wanted = i > active && i <= active + count; break;
+                case Session::PreloadPrograms:  wanted = (int) graph.getProperty (Tags::midiProgram, -1) >= 0; break;
+                case Session::PreloadNone:      break;
+            }
+
+            if (! wanted)
+                continue;
+            if (auto* const holder = findFor (graph))
+                if (holder->attached() && ! holder->isLoaded())
+                    return holder;
+        }
+
+        return nullptr;
+    }
+
     // remove the holder, this will also delete it!
     void remove (RootGraphHolder* g)
     {
@@ -302,17 +353,93 @@ private:
     OwnedArray<RootGraphHolder> graphs;
 };
 
+/** Loads inactive root graphs after the active one according to the session's
+    preload policy. The graphs are already attached, so they render silently
+    and switching to one only changes the engine's current index. Graphs load
+    one per tick so the message thread keeps up, and each graph's plugins are
+    created on GraphManager's worker threads where their format allows it.
+ */
+class EngineController::GraphPreloader : private Timer
+{
+public:
+    GraphPreloader (EngineController& o) : owner (o) { }
+    ~GraphPreloader() { stopTimer(); }
+
+    /** Call when the session or its active graph changes */
+    void refresh() { startTimer (intervalMs); }
+
+    /** Stops preloading */
+    void cancel() { stopTimer(); }
+
+private:
+    enum { intervalMs = 50 };
+    EngineController& owner;
+
+    void timerCallback() override
+    {
+        if (auto* const holder = owner.graphs->findNextToPreload())
+        {
+            holder->load();
+            DBG("[EL] preloaded graph: " << holder->model.getName());
+            return;
+        }
+
+        stopTimer();
+
+       #if JUCE_DEBUG
+        for (const auto& usage : owner.getGraphMemoryUsage())
+            DBG("[EL] resident graph: " << usage.graph.getName()
+                << " nodes: " << usage.numNodes
+                << " render: " << File::descriptionOfSizeInBytes ((int64) usage.renderBytes)
+                << " state: " << File::descriptionOfSizeInBytes ((int64) usage.stateBytes));
+       #endif
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (GraphPreloader)
+};
+
 EngineController::EngineController()
     : AppController::Child()
 {
     graphs = std::make_unique<RootGraphs> (*this);
+    preloader = std::make_unique<GraphPreloader> (*this);
 }
 
 EngineController::~EngineController()
 {
+    preloader = nullptr;
     graphs = nullptr;
 }
 
+Array<EngineController::GraphMemoryUsage> EngineController::getGraphMemoryUsage() const
+{
+    Array<GraphMemoryUsage> result;
+    for (const auto* const holder : graphs->getGraphs())
+    {
+        if (! holder->isLoaded())
+            continue;
+
+        GraphMemoryUsage usage;
+        usage.graph = holder->model;
+        usage.numNodes = holder->getRootGraph()->getNumNodes();
+        usage.renderBytes = holder->getRootGraph()->getMemoryUsage();
+        usage.graph.forEach ([&usage] (const ValueTree& tree)
+        {
+            if (! tree.hasType (Tags::node))
+                return;
+            const auto& state = tree.getProperty (Tags::state);
+            if (const auto* const block = state.getBinaryData())
+                usage.stateBytes += block->getSize();
+            else
+                usage.stateBytes += (size_t) state.toString().length() * 3 / 4;
+        });
+
+        result.add (usage);
+    }
+
+    return result;
+}
+
 void EngineController::addConnection (const uint32 s, const uint32 sp, const uint32 d, const uint32 dp)
 {
     if (auto session = getWorld().getSession())
@@ -644,6 +771,7 @@ void EngineController::deactivate()
         gui->closeAllPluginWindows();
     }
     
+    preloader->cancel();
     session->saveGraphState();
     graphs->clear();
     
@@ -654,6 +782,7 @@ void EngineController::deactivate()
 
 void EngineController::clear()
 {
+    preloader->cancel();
     graphs->clear();
 }
 
@@ -680,7 +809,6 @@ void EngineController::setRootNode (const Node& newRootNode)
     
     auto engine   = getWorld().getAudioEngine();
     auto session  = getWorld().getSession();
-    auto& devices = getWorld().getDeviceManager();
     
     if (! holder->attached())
         holder->attach (engine);
@@ -718,14 +846,10 @@ void EngineController::setRootNode (const Node& newRootNode)
         DBG("[EL] couldn't find graph processor for node.");
     }
     
-    if (auto* const r = holder->getController())
+    if (holder->getController() != nullptr)
     {
-        if (! r->isLoaded())
-        {
-            r->getRootGraph().setPlayConfigFor (devices);
-            r->setNodeModel (newRootNode);
-        }
-        
+        // only stalls if the preload policy didn't cover this graph
+        holder->load();
         engine->setCurrentGraph (index);
     }
     else
@@ -734,13 +858,14 @@ void EngineController::setRootNode (const Node& newRootNode)
     }
     
     engine->refreshSession();
+    preloader->refresh();
 }
 
 void EngineController::changeListenerCallback (ChangeBroadcaster* cb)
 {
     using IOP = GraphProcessor::AudioGraphIOProcessor;
 
-    if (getRunMode() == RunMode::Plugin)
+    if (getRunMode() != RunMode::Standalone)
         return;
 
     auto session = getWorld().getSession();
@@ -847,20 +972,22 @@ void EngineController::sessionReloaded()
 
     if (session->getNumGraphs() > 0)
     {
+        const Node active (session->getCurrentGraph());
         for (int i = 0; i < session->getNumGraphs(); ++i)
         {
             Node rootGraph (session->getGraph (i));
+
+            // everything is attached so graphs can switch without touching the
+            // engine. only the active graph and the ones mixed with it in
+            // parallel load now, the preloader takes care of the rest
+            const bool loadNow = getRunMode() == RunMode::Offline || rootGraph == active
+                || rootGraph.getProperty (Tags::renderMode, "single").toString().trim().toLowerCase() != "single";
+
             if (auto* holder = graphs->add (new RootGraphHolder (rootGraph, getWorld())))
-            {
-                holder->attach (engine);
-                if (auto* const controller = holder->getController())
-                {
-                    // noop: saving this logical block
-                }
-            }
+                holder->attach (engine, loadNow);
         }
 
-        setRootNode (session->getCurrentGraph());
+        setRootNode (active);
     }
 }
 
@@ -121,12 +121,26 @@ public:
     
     void changeBusesLayout (const Node& node, const AudioProcessor::BusesLayout& layout);
     
+    /** Memory used by a root graph which is loaded in the engine */
+    struct GraphMemoryUsage
+    {
+        Node graph;
+        int numNodes = 0;
+        size_t renderBytes = 0; ///< buffers and queues the host allocated to render it
+        size_t stateBytes = 0;  ///< decoded size of the plugin states saved in the model
+    };
+
+    /** Returns the memory used by each loaded root graph */
+    Array<GraphMemoryUsage> getGraphMemoryUsage() const;
+
     Signal<void(const Node&)> nodeRemoved;
 
 private:
     friend struct RootGraphHolder;
     class RootGraphs; friend class RootGraphs;
     std::unique_ptr<RootGraphs> graphs;
+    class GraphPreloader; friend class GraphPreloader;
+    std::unique_ptr<GraphPreloader> preloader;
     
     friend class ChangeBroadcaster;
     void changeListenerCallback (ChangeBroadcaster*) override;
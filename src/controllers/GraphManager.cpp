@@ -177,6 +177,138 @@ private:
     }
 };
 
+/** Creates the nodes of a graph model. Nodes which the plugin manager says can
+    be created off the message thread are instantiated, matched to the model's
+    audio ports and have their state restored on the plugin manager's loading
+    pool, while the message thread creates the rest.
+  */
+class NodeLoader
+{
+public:
+    struct Item
+    {
+        ValueTree data;
+        PluginDescription description;
+        uint32 nodeId = 0;
+        int numAudioIns = 0, numAudioOuts = 0;
+        int program = -1;
+        var state, programState;
+        bool background = false;
+        bool stateRestored = false;
+        NodeObjectPtr object;
+    };
+
+    NodeLoader (PluginManager& p) : plugins (p) { }
+
+    void add (const Node& node)
+    {
+        auto* const item = items.add (new Item());
+        item->data          = node.getValueTree();
+        item->description   = plugins.findDescriptionFor (node);
+        item->nodeId        = node.getNodeId();
+        item->program       = node.getProperty (Tags::program, -1);
+        item->state         = node.getProperty (Tags::state);
+        item->programState  = node.getProperty (Tags::programState);
+        item->background    = plugins.canCreateInBackground (item->description);
+
+        PortArray ins, outs;
+        node.getPorts (ins, outs, PortType::Audio);
+        item->numAudioIns = ins.size();
+        item->numAudioOuts = outs.size();
+    }
+
+    /** Creates every node. Returns once all have been created */
+    void load()
+    {
+        Array<Item*> background;
+        bool anyExternal = false;
+        for (auto* const item : items)
+        {
+            if (item->background)
+            {
+                background.add (item);
+                anyExternal |= item->description.pluginFormatName != EL_INTERNAL_FORMAT_NAME;
+            }
+        }
+
+        std::atomic<int> numPending { background.size() };
+        WaitableEvent finished;
+        const bool threaded = background.size() > 1;
+
+        if (threaded)
+        {
+            auto& pool = plugins.getLoadingPool();
+            for (auto* const item : background)
+            {
+                pool.addJob ([this, item, &numPending, &finished]()
+                {
+                    create (*item);
+                    if (--numPending == 0)
+                        finished.signal();
+                });
+            }
+        }
+
+        // the rest are created here while the workers run
+        for (auto* const item : items)
+            if (! threaded || ! item->background)
+                create (*item);
+
+        if (! threaded)
+            return;
+
+        // some third party plugins still post to the message thread while
+        // they're created or restored, so keep it dispatching until done
+        if (anyExternal && MessageManager::existsAndIsCurrentThread())
+        {
+            while (! finished.wait (5))
+                MessageManager::getInstance()->runDispatchLoopUntil (5);
+        }
+        else
+        {
+            finished.wait();
+        }
+    }
+
+    int size() const noexcept { return items.size(); }
+    Item* operator[] (const int index) const noexcept { return items [index]; }
+
+private:
+    PluginManager& plugins;
+    OwnedArray<Item> items;
+
+    void create (Item& item)
+    {
+        String errorMessage;
+        item.object = plugins.createGraphNode (item.description, errorMessage);
+        if (errorMessage.isNotEmpty())
+            DBG("[EL] error creating audio plugin: " << errorMessage);
+
+        if (item.object == nullptr || ! item.background)
+            return;
+
+        // the node isn't in a graph yet, so it's safe to change the layout
+        // and restore state without suspending it
+        if (auto* const proc = item.object->getAudioProcessor())
+        {
+            if (proc->getTotalNumInputChannels() != item.numAudioIns ||
+                proc->getTotalNumOutputChannels() != item.numAudioOuts)
+            {
+                AudioProcessor::BusesLayout layout;
+                layout.inputBuses.add (AudioChannelSet::namedChannelSet (item.numAudioIns));
+                layout.outputBuses.add (AudioChannelSet::namedChannelSet (item.numAudioOuts));
+                if (proc->checkBusesLayoutSupported (layout))
+                    proc->setBusesLayoutWithoutEnabling (layout);
+            }
+        }
+
+        Node::applyPluginState (*item.object, item.program, item.state, item.programState);
+        item.stateRestored = true;
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (NodeLoader)
+};
+
 GraphManager::GraphManager (GraphProcessor& pg, PluginManager& pm)
     : pluginManager (pm), processor (pg), lastUID (0)
 { }
@@ -488,14 +620,20 @@ void GraphManager::setNodeModel (const Node& node)
     arcs    = node.getArcsValueTree();
     nodes   = node.getNodesValueTree();
     
-    Array<ValueTree> failed;
+    NodeLoader loader (pluginManager);
     for (int i = 0; i < nodes.getNumChildren(); ++i)
+        loader.add (Node (nodes.getChild (i), false));
+    loader.load();
+
+    Array<ValueTree> failed;
+    for (int i = 0; i < loader.size(); ++i)
     {
-        Node node (nodes.getChild (i), false);
-        const PluginDescription desc (pluginManager.findDescriptionFor (node));
-        if (NodeObjectPtr obj = createFilter (&desc, 0.0, 0.0, node.getNodeId()))
+        auto* const item = loader[i];
+        Node node (item->data, false);
+        NodeObjectPtr obj = item->object != nullptr ? processor.addNode (item->object.get(), item->nodeId) : nullptr;
+        if (obj != nullptr)
         {
-            setupNode (node.getValueTree(), obj);
+            setupNode (node.getValueTree(), obj, ! item->stateRestored);
             obj->setEnabled (node.isEnabled());
             node.setProperty (Tags::enabled, obj->isEnabled());
         }
@@ -521,29 +659,34 @@ void GraphManager::setNodeModel (const Node& node)
 
     // If you hit this, then failed nodes didn't get handled properly
     jassert (nodes.getNumChildren() == processor.getNumNodes());
-    
-    // Cheap way to refresh engine-side nodes
-    processor.triggerAsyncUpdate();
-    processor.handleUpdateNowIfNeeded();
+
+    // connect everything in one go, the rendering sequence is built once at the end
+    Array<Arc> wanted;
+    wanted.ensureStorageAllocated (arcs.getNumChildren());
+    for (int i = 0; i < arcs.getNumChildren(); ++i)
+    {
+        const ValueTree arc (arcs.getChild (i));
+        wanted.add (Arc ((uint32)(int) arc.getProperty (Tags::sourceNode),
+                         (uint32)(int) arc.getProperty (Tags::sourcePort),
+                         (uint32)(int) arc.getProperty (Tags::destNode),
+                         (uint32)(int) arc.getProperty (Tags::destPort)));
+    }
+
+    const auto connected = processor.addConnections (wanted);
+    const Node graphObject (graph, false);
 
     for (int i = 0; i < arcs.getNumChildren(); ++i)
     {
         ValueTree arc (arcs.getChild (i));
-        const auto sourceNode = (uint32)(int) arc.getProperty (Tags::sourceNode);
-        const auto destNode = (uint32)(int) arc.getProperty (Tags::destNode);
-        bool worked = processor.addConnection (sourceNode, (uint32)(int) arc.getProperty (Tags::sourcePort),
-                                               destNode, (uint32)(int) arc.getProperty (Tags::destPort));
-        if (worked)
+        if (connected [i])
         {
             arc.removeProperty (Tags::missing, 0);
         }
         else
         {
             DBG("[EL] failed creating connection: ");
-            const Node graphObject (graph, false);
-
-            if (graphObject.getNodeById(sourceNode).isValid() &&
-                graphObject.getNodeById(destNode).isValid())
+            if (graphObject.getNodeById (wanted.getReference(i).sourceNode).isValid() &&
+                graphObject.getNodeById (wanted.getReference(i).destNode).isValid())
             {
                 DBG("[EL] set missing connection");
                 // if the nodes are valid then preserve it
@@ -562,6 +705,9 @@ void GraphManager::setNodeModel (const Node& node)
         for (const auto& n : failed)
             arcs.removeChild (n, nullptr);
 
+    // everything was just restored from the model, so there's nothing to autosave
+    for (int i = 0; i < processor.getNumNodes(); ++i)
+        processor.getNode(i)->clearStateChanged();
     
     loaded = true;
     jassert (arcs.getNumChildren() == processor.getNumConnections());
@@ -569,6 +715,7 @@ void GraphManager::setNodeModel (const Node& node)
 
     IONodeEnforcer enforceIONodes (*this);
     processorArcsChanged();
+    processor.handleUpdateNowIfNeeded();
 }
 
 void GraphManager::savePluginStates()
@@ -631,7 +778,7 @@ void GraphManager::processorArcsChanged()
     changed();
 }
 
-void GraphManager::setupNode (const ValueTree& data, NodeObjectPtr obj)
+void GraphManager::setupNode (const ValueTree& data, NodeObjectPtr obj, const bool restoreState)
 {
     jassert (obj && data.hasType (Tags::node));
     Node node (data, false);
@@ -671,7 +818,7 @@ void GraphManager::setupNode (const ValueTree& data, NodeObjectPtr obj)
         resetPorts = true;
     }
 
-    node.restorePluginState();
+    node.restorePluginState (restoreState);
 
     if (resetPorts || node.getNumPorts() != static_cast<int> (obj->getNumPorts()))
         node.resetPorts();
@@ -123,7 +123,7 @@ private:
     NodeObject* createFilter (const PluginDescription* desc, double x = 0.0f, double y = 0.0f,
                              uint32 nodeId = 0);
     NodeObject* createPlaceholder (const Node& node);
-    void setupNode (const ValueTree& data, NodeObjectPtr object);
+    void setupNode (const ValueTree& data, NodeObjectPtr object, bool restoreState = true);
     
     void processorArcsChanged();
 
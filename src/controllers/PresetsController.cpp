@@ -62,15 +62,16 @@ void PresetsController::refresh()
 
 void PresetsController::add (const Node& node, const String& presetName)
 {
-    const DataPath path;
-    if (! node.savePresetTo (path, presetName))
+    const auto file = DataPath().createNewPresetFile (node, presetName);
+    if (! node.savePresetTo (file))
     {
         AlertWindow::showMessageBoxAsync (AlertWindow::WarningIcon, 
             "Preset", "Could not save preset");        
     }
     else
     {
-        getWorld().getPresetCollection().refresh();
+        // it should be in the menu right away, without waiting on a rescan
+        getWorld().getPresetCollection().add (file);
     }
 
     if (auto* gui = findSibling<GuiController>())
@@ -28,6 +28,8 @@
 #include "gui/ContentComponent.h"
 
 #include "session/Node.h"
+#include "session/SessionArchive.h"
+#include "session/SessionJournal.h"
 #include "Globals.h"
 #include "Settings.h"
 
@@ -49,6 +51,112 @@ private:
     SessionController& owner;
 };
 
+/** Journals node state that changed since the session was saved. Only
+    nodes which flagged a change are captured, other edits to the session
+    write a snapshot of the whole tree. Files are written in the background.
+ */
+class SessionController::Autosave : public Timer,
+                                    public ChangeListener
+{
+public:
+    explicit Autosave (SessionController& sc) : owner (sc)
+    {
+        owner.currentSession->addChangeListener (this);
+    }
+
+    ~Autosave()
+    {
+        stopTimer();
+        owner.currentSession->removeChangeListener (this);
+    }
+
+    /** Starts journaling for a session file, discarding the previous journal.
+        Pass true to snapshot on the first tick, e.g. after a recovery */
+    void start (const File& sessionFile, bool snapshotFirst = false)
+    {
+        stop();
+        sessionChanged = snapshotFirst;
+
+        const int interval = owner.getWorld().getSettings().getAutosaveInterval();
+        if (sessionFile == File() || interval <= 0)
+            return;
+
+        // a journal left over from a crash is kept until the snapshot replaces it
+        journal.setFile (SessionJournal::getJournalFile (sessionFile));
+        if (! snapshotFirst)
+            journal.discard();
+        startTimer (interval * 1000);
+    }
+
+    /** Stops journaling and removes the journal */
+    void stop()
+    {
+        stopTimer();
+        journal.discard();
+        journal.setFile (File());
+    }
+
+    /** Nodes are about to be saved in full, so their changes are covered */
+    void clearChanges()     { setChanged (false); }
+
+    /** A save didn't happen after all, so everything needs journaling */
+    void restoreChanges()   { setChanged (true); }
+
+    void changeListenerCallback (ChangeBroadcaster*) override
+    {
+        sessionChanged = true;
+    }
+
+    void timerCallback() override
+    {
+        Array<ValueTree> changed;
+        {
+            // saving plugin state isn't an edit, it mustn't force a snapshot
+            Session::ScopedFrozenLock freeze (*owner.currentSession);
+            owner.currentSession->forEach ([&changed] (const ValueTree& tree)
+            {
+                if (tree.hasType (Tags::node) && Node (tree, false).saveChangedPluginState())
+                    changed.add (tree);
+            });
+        }
+
+        if (sessionChanged || journal.needsCompaction())
+        {
+            sessionChanged = false;
+            journal.writeSnapshot (owner.currentSession->getValueTree());
+        }
+        else
+        {
+            journal.appendNodes (changed);
+        }
+    }
+
+private:
+    SessionController& owner;
+    SessionJournal journal;
+    bool sessionChanged = false;
+
+    void setChanged (bool changed)
+    {
+        owner.currentSession->forEach ([changed] (const ValueTree& tree)
+        {
+            if (! tree.hasType (Tags::node))
+                return;
+            auto* const object = Node (tree, false).getGraphNode();
+            if (object == nullptr)
+                return;
+            if (changed)
+                object->markStateChanged();
+            else
+                object->clearStateChanged();
+        });
+
+        if (changed)
+            sessionChanged = true;
+    }
+};
+
+//=============================================================================
 SessionController::SessionController() { }
 SessionController::~SessionController() { }
 
@@ -58,6 +166,7 @@ void SessionController::activate()
     currentSession = app->getWorld().getSession();
     document.reset (new SessionDocument (currentSession));
     changeResetter.reset (new ChangeResetter (*this));
+    autosave.reset (new Autosave (*this));
 }
 
 void SessionController::deactivate()
@@ -73,6 +182,9 @@ void SessionController::deactivate()
         document = nullptr;
     }
 
+    autosave->stop();
+    autosave.reset (nullptr);
+
     changeResetter->cancelPendingUpdate();
     changeResetter.reset (nullptr);
 
@@ -89,11 +201,13 @@ void SessionController::openDefaultSession()
     refreshOtherControllers();
     findSibling<GuiController>()->stabilizeContent();
     resetChanges (true);
+    autosave->start (File());
 }
 
 void SessionController::openFile (const File& file)
 {
     bool didSomething = true;
+    bool recovered = false;
     
     if (file.hasFileExtension ("elg"))
     {
@@ -115,6 +229,16 @@ void SessionController::openFile (const File& file)
     else if (file.hasFileExtension ("els"))
     {
         document->saveIfNeededAndUserAgrees();
+
+        // a journal newer than the session means it wasn't closed normally
+        const auto journal = SessionJournal::getJournalFile (file);
+        recovered = journal.existsAsFile()
+            && journal.getLastModificationTime() > file.getLastModificationTime()
+            && AlertWindow::showOkCancelBox (AlertWindow::QuestionIcon, "Recover Session?",
+                "This session has autosaved changes which were never saved. Would you like to recover them?",
+                "Recover", "Discard");
+        document->setRecoveryJournal (recovered ? journal : File());
+
         Session::ScopedFrozenLock freeze (*currentSession);
         Result result = document->loadFrom (file, true);
         
@@ -134,7 +258,9 @@ void SessionController::openFile (const File& file)
             resetChanges();
         }
 
-        jassert(!hasSessionChanged());
+        recovered = recovered && result.wasOk();
+        autosave->start (document->getFile(), recovered);
+        jassert (recovered || ! hasSessionChanged());
     }
     else
     {
@@ -145,7 +271,12 @@ void SessionController::openFile (const File& file)
     {
         if (auto* gc = findSibling<GuiController>())
             gc->stabilizeContent();
-        changeResetter->triggerAsyncUpdate();
+
+        // recovered changes still need saving
+        if (recovered)
+            document->changed();
+        else
+            changeResetter->triggerAsyncUpdate();
     }
 }
 
@@ -194,12 +325,19 @@ void SessionController::saveSession (const bool saveAs, const bool askForFile, c
         ui.setProperty ("content", state, nullptr);
     }
 
+    document->setSaveFormat (getWorld().getSettings().useBinarySessions()
+        ? SessionDocument::ArchiveFormat : SessionDocument::XmlFormat);
+    autosave->clearChanges();
+
     if (saveAs) {
         result = document->saveAs (File(), true, askForFile, showError);
     } else {
         result = document->save (askForFile, showError);
     }
 
+    if (result != FileBasedDocument::savedOk)
+        autosave->restoreChanges();
+
     if (result == FileBasedDocument::userCancelledSave)
         return;
     
@@ -209,6 +347,7 @@ void SessionController::saveSession (const bool saveAs, const bool askForFile, c
         currentSession->dispatchPendingMessages();
         document->setChangedFlag (false);
         jassert (! hasSessionChanged());
+        autosave->start (document->getFile());
     }
 }
 
@@ -233,6 +372,7 @@ void SessionController::newSession()
         refreshOtherControllers();
         findSibling<GuiController>()->stabilizeContent();
         resetChanges (true);
+        autosave->start (File());
     }
 }
 
@@ -245,8 +385,7 @@ void SessionController::loadNewSessionData()
     if (file.existsAsFile())
     {
         ValueTree data;
-        if (auto xml = XmlDocument::parse (file))
-            data = ValueTree::fromXml (*xml);
+        SessionArchive::load (file, data);
         if (data.isValid() && data.hasType (Tags::session))
             wasLoaded = currentSession->loadData (data);
     }
@@ -56,6 +56,8 @@ private:
     std::unique_ptr<SessionDocument> document;
     class ChangeResetter;
     std::unique_ptr<ChangeResetter> changeResetter;
+    class Autosave;
+    std::unique_ptr<Autosave> autosave;
     void loadNewSessionData();
     void refreshOtherControllers();
 };
@@ -18,6 +18,8 @@
 */
 
 #include "session/Session.h"
+#include "session/SessionArchive.h"
+#include "session/SessionJournal.h"
 #include "documents/SessionDocument.h"
 
 namespace Element {
@@ -61,18 +63,27 @@ namespace Element {
             return Result::fail ("No session data target");
 
         String error;
-        if (auto e = XmlDocument::parse (file))
-        {
-            ValueTree newData (ValueTree::fromXml (*e));
-            if (! newData.isValid() && newData.hasType ("session"))
-                error = "Not a valid session file";
-            if (error.isEmpty() && !session->loadData (newData))
-                error = "Could not load session data";
-        }
-        else
+        const auto journal = recoveryJournal;
+        recoveryJournal = File();
+
+        auto recover = [&journal, &error] (ValueTree& data)
         {
+            if (error.isNotEmpty() || journal == File())
+                return;
+            const auto result = SessionJournal::replay (journal, data);
+            if (result.failed())
+                error = result.getErrorMessage();
+        };
+
+        ValueTree newData;
+        const auto result = SessionArchive::load (file, newData);
+        if (result.failed())
+            error = result.getErrorMessage();
+        recover (newData);
+        if (error.isEmpty() && ! newData.hasType (Tags::session))
             error = "Not a valid session file";
-        }
+        if (error.isEmpty() && ! session->loadData (newData))
+            error = "Could not load session data";
 
         if (error.isEmpty())
         {
@@ -88,6 +99,9 @@ namespace Element {
             return Result::fail ("Nil session");
         
         session->saveGraphState();
+        if (format == ArchiveFormat)
+            return SessionArchive().write (session->getValueTree(), file);
+
         if (auto e = session->createXml())
         {
             Result res (e->writeToFile (file, String())
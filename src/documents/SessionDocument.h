@@ -27,6 +27,13 @@ namespace Element {
                              public ChangeListener
     {
     public:
+        /** Formats a session can be saved in. Both load regardless */
+        enum Format
+        {
+            XmlFormat = 0,
+            ArchiveFormat
+        };
+
         SessionDocument (SessionPtr);
         ~SessionDocument();
 
@@ -38,9 +45,19 @@ namespace Element {
         
         void changeListenerCallback (ChangeBroadcaster*) override;
 
+        /** Set the format used by saveDocument() */
+        void setSaveFormat (Format newFormat) { format = newFormat; }
+        Format getSaveFormat() const noexcept { return format; }
+
+        /** Replays an autosave journal over the next session loaded. This is
+            cleared once the session loads */
+        void setRecoveryJournal (const File& journal) { recoveryJournal = journal; }
+
     private:
         SessionPtr session;
         File lastSession;
+        Format format = XmlFormat;
+        File recoveryJournal;
         friend class Session;
         void onSessionChanged();
     };
@@ -24,6 +24,7 @@
 #include "engine/MidiChannelMap.h"
 #include "engine/MidiEngine.h"
 #include "engine/MidiTranspose.h"
+#include "engine/RenderThreadPool.h"
 #include "engine/Transport.h"
 #include "Globals.h"
 #include "Settings.h"
@@ -86,15 +87,24 @@ void RootGraph::updateChannelNames (AudioIODevice* device)
             audioOutputNames.add(namesOut[i]);
 }
 
-struct RootGraphRender : public AsyncUpdater
+struct RootGraphRender : public AsyncUpdater,
+                         private RenderThreadPool::Work
 {
     std::function<void()> onActiveGraphChanged;
 
     RootGraphRender()
     {
         graphs.ensureStorageAllocated (32);
+        scratches.ensureStorageAllocated (32);
     }
 
+    /** Set the pool used to render parallel graphs concurrently */
+    void setRenderThreadPool (RenderThreadPool* pool) { renderPool = pool; }
+
+    /** When rendering offline, graphs wait for topology changes instead of
+        rendering silence, so the output doesn't depend on timing */
+    void setOffline (bool isOffline) { offline = isOffline; }
+
     void handleAsyncUpdate() override
     {
         if (onActiveGraphChanged)
@@ -124,6 +134,8 @@ struct RootGraphRender : public AsyncUpdater
         numOutputChans  = numOuts;
         audioTemp.setSize (jmax (numIns, numOuts), numSamples);
         audioOut.setSize (audioTemp.getNumChannels(), audioTemp.getNumSamples());
+        for (auto* const scratch : scratches)
+            scratch->prepare (audioTemp.getNumChannels(), audioTemp.getNumSamples());
     }
 
     void releaseBuffers()
@@ -133,6 +145,8 @@ struct RootGraphRender : public AsyncUpdater
         midiTemp.clear();
         audioTemp.setSize (1, 1);
         audioOut.setSize (1, 1);
+        for (auto* const scratch : scratches)
+            scratch->prepare (1, 1);
     }
     void dumpGraphs() {
         
@@ -188,83 +202,103 @@ struct RootGraphRender : public AsyncUpdater
             for (int i = numChans; --i >= 0;)
                 audioOut.clear (i, 0, numSamples);
             midiOut.clear();
-            
-            for (auto* const graph : graphs)
+
+            // parallel graphs without a pending switch don't fade, so they
+            // can be rendered concurrently and mixed after they all finish
+            const bool renderedConcurrently = ! graphChanged && ! current->isSingle()
+                && renderGraphsConcurrently (buffer, midi);
+
+            if (! renderedConcurrently)
             {
-                // copy inputs, clear outs if more than input count
-                for (int i = 0; i < numInputChans; ++i)
-                    audioTemp.copyFrom (i, 0, buffer, i, 0, numSamples);
-                for (int i = numInputChans; i < numChans; ++i)
-                    audioTemp.clear (i, 0, numSamples);
-                
-                // clear so messages: avoids feedback loop when IO node ins are 
-                // connected to IO node outs
-                midiTemp.clear (0, numSamples);
-                
-                if ((last == graph && graphChanged && last->isSingle())
-                    || (graphChanged && current != nullptr && current->isSingle() && graph != current))
+                for (int g = 0; g < graphs.size(); ++g)
                 {
-                    // send kill messages to the last graph(s) when the graph changes
-                    // see http://nickfever.com/music/midi-cc-list
-                    for (int i = 0; i < 16; ++i)
+                    auto* const graph = graphs.getUnchecked (g);
+                    auto& scratch = *scratches.getUnchecked (g);
+
+                    // inactive single graphs stay resident and prepared, but
+                    // there's no point rendering them until a switch involves
+                    // them, their output is dropped anyway
+                    if (! graphChanged && graph->isSingle() && graph != current)
                     {
-                        // sustain pedal off
-                        midiTemp.addEvent (MidiMessage::controllerEvent (i + 1, 64, 0), 0);
-                        // Sostenuto off
-                        midiTemp.addEvent (MidiMessage::controllerEvent (i + 1, 66, 0), 0);
-                        // Hold off
-                        midiTemp.addEvent (MidiMessage::controllerEvent (i + 1, 69, 0), 0);
-
-                        midiTemp.addEvent (MidiMessage::allNotesOff (i + 1), 0);
+                        if (! scratch.dormant)
+                            graph->setDormant (true);
+                        scratch.dormant = true;
+                        continue;
                     }
-                }
-                else if ((current == graph && graph->isSingle()) 
-                            || (current != nullptr && !current->isSingle() && !graph->isSingle()))
-                {
-                    // current single graph or parallel graphs get MIDI always
-                    midiTemp.addEvents (midi, 0, numSamples, 0);
-                }
 
-                {
-                    const ScopedLock sl (graph->getCallbackLock());
-                    if (graph->isSuspended())
+                    // don't let stale state from before it went quiet through
+                    if (scratch.dormant)
                     {
-                        graph->processBlockBypassed (audioTemp, midiTemp);
+                        graph->setDormant (false);
+                        graph->reset();
+                        scratch.dormant = false;
                     }
-                    else
+
+                    // copy inputs, clear outs if more than input count
+                    for (int i = 0; i < numInputChans; ++i)
+                        audioTemp.copyFrom (i, 0, buffer, i, 0, numSamples);
+                    for (int i = numInputChans; i < numChans; ++i)
+                        audioTemp.clear (i, 0, numSamples);
+                
+                    // clear so messages: avoids feedback loop when IO node ins are 
+                    // connected to IO node outs
+                    midiTemp.clear (0, numSamples);
+                
+                    if ((last == graph && graphChanged && last->isSingle())
+                        || (graphChanged && current != nullptr && current->isSingle() && graph != current))
                     {
-                        graph->processBlock (audioTemp, midiTemp);
+                        // send kill messages to the last graph(s) when the graph changes
+                        // see http://nickfever.com/music/midi-cc-list
+                        for (int i = 0; i < 16; ++i)
+                        {
+                            // sustain pedal off
+                            midiTemp.addEvent (MidiMessage::controllerEvent (i + 1, 64, 0), 0);
+                            // Sostenuto off
+                            midiTemp.addEvent (MidiMessage::controllerEvent (i + 1, 66, 0), 0);
+                            // Hold off
+                            midiTemp.addEvent (MidiMessage::controllerEvent (i + 1, 69, 0), 0);
+
+                            midiTemp.addEvent (MidiMessage::allNotesOff (i + 1), 0);
+                        }
                     }
-                }
+                    else if ((current == graph && graph->isSingle()) 
+                                || (current != nullptr && !current->isSingle() && !graph->isSingle()))
+                    {
+                        // current single graph or parallel graphs get MIDI always
+                        midiTemp.addEvents (midi, 0, numSamples, 0);
+                    }
+
+                    renderGraph (*graph, audioTemp, midiTemp);
                 
-                if (graphChanged && ((current->isSingle() && current != graph) ||
-                                     (modeChanged && !current->isSingle() && graph->isSingle())))
+                    if (graphChanged && ((current->isSingle() && current != graph) ||
+                                         (modeChanged && !current->isSingle() && graph->isSingle())))
                                      
-                {
-                    // DBG("  FADE OUT LAST GRAPH: " << graph->engineIndex);
-                    for (int i = 0; i < numOutputChans; ++i)
-                            audioOut.addFromWithRamp (i, 0, audioTemp.getReadPointer (i), 
-                                                      numSamples, 1.f, 0.f);
-                }
-                else if ((graph == current && graph->isSingle()) ||
-                         (!graph->isSingle() && (current != nullptr) && !current->isSingle()))
-                {
-                    // if it's the current single graph or both are parallel...
-                    if (graphChanged && (graph->isSingle() || 
-                                        (modeChanged && !graph->isSingle() && !current->isSingle())))
                     {
-                        // DBG("  FADE IN NEW GRAPH: " << graph->engineIndex);
+                        // DBG("  FADE OUT LAST GRAPH: " << graph->engineIndex);
                         for (int i = 0; i < numOutputChans; ++i)
-                            audioOut.addFromWithRamp (i, 0, audioTemp.getReadPointer (i), 
-                                                      numSamples, 0.f, 1.f);
+                                audioOut.addFromWithRamp (i, 0, audioTemp.getReadPointer (i), 
+                                                          numSamples, 1.f, 0.f);
                     }
-                    else
+                    else if ((graph == current && graph->isSingle()) ||
+                             (!graph->isSingle() && (current != nullptr) && !current->isSingle()))
                     {
-                        for (int i = 0; i < numOutputChans; ++i)
-                            audioOut.addFrom (i, 0, audioTemp, i, 0, numSamples);
-                    }
+                        // if it's the current single graph or both are parallel...
+                        if (graphChanged && (graph->isSingle() || 
+                                            (modeChanged && !graph->isSingle() && !current->isSingle())))
+                        {
+                            // DBG("  FADE IN NEW GRAPH: " << graph->engineIndex);
+                            for (int i = 0; i < numOutputChans; ++i)
+                                audioOut.addFromWithRamp (i, 0, audioTemp.getReadPointer (i), 
+                                                          numSamples, 0.f, 1.f);
+                        }
+                        else
+                        {
+                            for (int i = 0; i < numOutputChans; ++i)
+                                audioOut.addFrom (i, 0, audioTemp, i, 0, numSamples);
+                        }
                     
-                    midiOut.addEvents (midiTemp, 0, numSamples, 0);
+                        midiOut.addEvents (midiTemp, 0, numSamples, 0);
+                    }
                 }
             }
 
@@ -303,6 +337,8 @@ struct RootGraphRender : public AsyncUpdater
     bool addGraph (RootGraph* graph)
     {
         graph->setLocked (locked);
+        auto* const scratch = scratches.add (new GraphScratch());
+        scratch->prepare (audioTemp.getNumChannels(), audioTemp.getNumSamples());
         graphs.add (graph);
         graph->engineIndex = graphs.size() - 1;
 
@@ -319,6 +355,7 @@ struct RootGraphRender : public AsyncUpdater
     void removeGraph (RootGraph* graph)
     {
         jassert (graphs.contains (graph));
+        scratches.remove (graphs.indexOf (graph));
         graphs.removeFirstMatchingValue (graph);
         graph->engineIndex = -1;
         updateIndexes();
@@ -343,7 +380,24 @@ struct RootGraphRender : public AsyncUpdater
     }
 
 private:
+    /** Per-graph render state. The buffers are used when graphs render concurrently */
+    struct GraphScratch
+    {
+        AudioSampleBuffer audio;
+        MidiBuffer midi;
+        bool dormant = false; // audio thread only
+
+        void prepare (const int numChannels, const int numSamples)
+        {
+            audio.setSize (jmax (1, numChannels), jmax (1, numSamples));
+            midi.ensureSize (2048);
+        }
+    };
+
     Array<RootGraph*> graphs;
+    OwnedArray<GraphScratch> scratches;
+    RenderThreadPool* renderPool = nullptr;
+    bool offline = false;
     bool locked             = false;
     int currentGraph        = -1;
     int lastGraph           = -1;
@@ -367,6 +421,130 @@ private:
 
     MidiBuffer midiOut, midiTemp;
 
+    // concurrent render state for the current block
+    std::atomic<int> nextGraphToRender { 0 };
+    std::atomic<int> numGraphsRendered { 0 };
+    AudioSampleBuffer* blockAudio = nullptr;
+    MidiBuffer* blockMidi = nullptr;
+
+    /** Renders every graph on the thread pool and mixes the parallel ones.
+        Returns false if the graphs should be rendered serially instead.
+     */
+    bool renderGraphsConcurrently (AudioSampleBuffer& buffer, MidiBuffer& midi)
+    {
+        if (renderPool == nullptr || graphs.size() < 2)
+            return false;
+
+        const int numSamples = buffer.getNumSamples();
+        const int numChans   = buffer.getNumChannels();
+
+        for (auto* const scratch : scratches)
+            scratch->audio.setSize (numChans, numSamples, false, false, true);
+
+        blockAudio = &buffer;
+        blockMidi  = &midi;
+        nextGraphToRender.store (0);
+        numGraphsRendered.store (0);
+
+        if (! renderPool->perform (*this))
+            return false;
+
+        // barrier passed, mix in graph order so the result is deterministic
+        for (int g = 0; g < graphs.size(); ++g)
+        {
+            if (graphs.getUnchecked(g)->isSingle())
+                continue;
+
+            auto& scratch = *scratches.getUnchecked (g);
+            for (int i = 0; i < numOutputChans; ++i)
+                audioOut.addFrom (i, 0, scratch.audio, i, 0, numSamples);
+            midiOut.addEvents (scratch.midi, 0, numSamples, 0);
+        }
+
+        return true;
+    }
+
+    bool performNextJob() noexcept override
+    {
+        const int index = nextGraphToRender.fetch_add (1);
+        if (index >= graphs.size())
+            return false;
+
+        auto* const graph = graphs.getUnchecked (index);
+        auto& scratch = *scratches.getUnchecked (index);
+        const int numSamples = blockAudio->getNumSamples();
+
+        // the current graph is parallel, so single graphs are silent
+        if (graph->isSingle())
+        {
+            if (! scratch.dormant)
+                graph->setDormant (true);
+            scratch.dormant = true;
+            ++numGraphsRendered;
+            return true;
+        }
+
+        if (scratch.dormant)
+        {
+            graph->setDormant (false);
+            graph->reset();
+            scratch.dormant = false;
+        }
+
+        for (int i = 0; i < numInputChans; ++i)
+            scratch.audio.copyFrom (i, 0, *blockAudio, i, 0, numSamples);
+        for (int i = numInputChans; i < scratch.audio.getNumChannels(); ++i)
+            scratch.audio.clear (i, 0, numSamples);
+
+        // only parallel graphs receive MIDI when the current graph is parallel
+        scratch.midi.clear();
+        if (! graph->isSingle())
+            scratch.midi.addEvents (*blockMidi, 0, numSamples, 0);
+
+        renderGraph (*graph, scratch.audio, scratch.midi);
+
+        ++numGraphsRendered;
+        return true;
+    }
+
+    bool isFinished() const noexcept override
+    {
+        return numGraphsRendered.load() >= graphs.size();
+    }
+
+    /** Renders one graph without ever blocking. Topology changes don't need
+        the callback lock anymore, so it is only held while the message thread
+        suspends a graph. If it is held, the graph is silent for this block.
+        Offline rendering waits for the lock instead.
+     */
+    void renderGraph (RootGraph& graph, AudioSampleBuffer& audio, MidiBuffer& midi)
+    {
+        if (offline)
+        {
+            const ScopedLock sl (graph.getCallbackLock());
+            renderGraphLocked (graph, audio, midi);
+            return;
+        }
+
+        const ScopedTryLock sl (graph.getCallbackLock());
+        if (! sl.isLocked())
+        {
+            audio.clear();
+            midi.clear();
+            return;
+        }
+
+        renderGraphLocked (graph, audio, midi);
+    }
+
+    static void renderGraphLocked (RootGraph& graph, AudioSampleBuffer& audio, MidiBuffer& midi)
+    {
+        if (graph.isSuspended())
+            graph.processBlockBypassed (audio, midi);
+        else
+            graph.processBlock (audio, midi);
+    }
+
     void updateIndexes()
     {
         for (int i = 0 ; i < graphs.size(); ++i)
@@ -408,6 +586,8 @@ public:
         sessionWantsExternalClock.set (0);
         midiClock.addListener (this);
         graphs.onActiveGraphChanged = std::bind (&AudioEngine::Private::onCurrentGraphChanged, this);
+        graphs.setRenderThreadPool (&renderPool);
+        graphs.setOffline (engine.getRunMode() == RunMode::Offline);
         midiIOMonitor = new MidiIOMonitor();
         startTimerHz (90);
     }
@@ -415,6 +595,9 @@ public:
     ~Private()
     {
         graphs.onActiveGraphChanged = nullptr;
+        graphs.setRenderThreadPool (nullptr);
+        for (int i = 0; i < graphs.size(); ++i)
+            graphs.getGraph(i)->setRenderThreadPool (nullptr);
         midiClock.removeListener (this);
         tempoValue.removeListener (this);
         externalClockValue.removeListener (this);
@@ -591,6 +774,8 @@ public:
     
     bool isTimeMaster() const
     {
+        if (engine.getRunMode() == RunMode::Offline)
+            return true;
         if (engine.getRunMode() == RunMode::Plugin)
             return sessionWantsExternalClock.get() == 0;
         return processMidiClock.get() == 0 && sessionWantsExternalClock.get() == 0;
@@ -622,6 +807,9 @@ public:
         
         graphs.prepareBuffers (numInputChans, numOutputChans, blockSize);
 
+        if (! renderPool.isRunning())
+            renderPool.start();
+
         if (isPrepared)
         {
             isPrepared = false;
@@ -680,6 +868,7 @@ public:
         jassert (graph);
         if (isPrepared)
             prepareGraph (graph, sampleRate, blockSize);
+        graph->setRenderThreadPool (&renderPool);
         ScopedLock sl (lock);
         if (graphs.addGraph (graph))
         {
@@ -696,6 +885,7 @@ public:
         }
         
         graph->renderingSequenceChanged.disconnect_all_slots();
+        graph->setRenderThreadPool (nullptr);
         if (isPrepared)
             graph->releaseResources();
     }
@@ -762,6 +952,8 @@ public:
     
     bool isUsingExternalClock() const
     {
+        if (engine.getRunMode() == RunMode::Offline)
+            return false;
         if (engine.getRunMode() == RunMode::Plugin)
             return sessionWantsExternalClock.get() > 0;
         return sessionWantsExternalClock.get() > 0 && processMidiClock.get() > 0;
@@ -771,6 +963,7 @@ private:
     friend class AudioEngine;
     AudioEngine&        engine;
     Transport           transport;
+    RenderThreadPool    renderPool;
     RootGraphRender     graphs;
     SessionPtr          session;
     
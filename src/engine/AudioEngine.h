@@ -52,8 +52,7 @@ public:
     inline void setLocked (const var&)
     {
         const bool isNowLocked = false;
-        ScopedLock sl (getCallbackLock());
-        locked = isNowLocked;
+        locked.store (isNowLocked);
     }
 
     inline static bool renderModeValid (const int mode) {
@@ -75,25 +74,18 @@ public:
     void setPlayConfigFor (const DeviceManager::AudioDeviceSetup& setup);
     void setPlayConfigFor (DeviceManager&);
     
-    inline RenderMode getRenderMode() const { return renderMode; }
-    inline String getRenderModeSlug() const { return getSlugForRenderMode (renderMode); }
+    inline RenderMode getRenderMode() const { return static_cast<RenderMode> (renderMode.load (std::memory_order_relaxed)); }
+    inline String getRenderModeSlug() const { return getSlugForRenderMode (getRenderMode()); }
     inline bool isSingle() const { return getRenderMode() == SingleGraph; }
     
     inline void setRenderMode (const RenderMode mode)
     {
-        // TODO: don't use a lock
-        if (! locked && renderMode == static_cast<int> (mode))
-            return;
-        ScopedLock sl (getCallbackLock());
-        renderMode = locked ? SingleGraph : mode;
+        renderMode.store (locked.load() ? SingleGraph : mode);
     }
 
     inline void setMidiProgram (const int program)
     {
-        if (program == midiProgram)
-            return;
-        ScopedLock sl (getCallbackLock());
-        midiProgram = program;
+        midiProgram.store (program);
     }
     
     const String getName() const override;
@@ -117,11 +109,11 @@ private:
     StringArray audioInputNames;
     StringArray audioOutputNames;
     int midiChannel = 0;
-    int midiProgram = -1;
+    std::atomic<int> midiProgram { -1 };
     int engineIndex = -1;
-    RenderMode renderMode = Parallel;
+    std::atomic<int> renderMode { Parallel };
     
-    bool locked = true;
+    std::atomic<bool> locked { true };
 
     void updateChannelNames (AudioIODevice* device);
 };
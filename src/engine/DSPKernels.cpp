@@ -0,0 +1,383 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "engine/DSPKernels.h"
+
+namespace Element {
+namespace Kernels {
+
+static double clampFrequency (double sampleRate, double frequency) noexcept
+{
+    return jlimit (1.0, 0.49 * sampleRate, frequency);
+}
+
+//==============================================================================
+void applyGain (AudioBuffer<float>& buffer, float gain) noexcept
+{
+    for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+        FloatVectorOperations::multiply (buffer.getWritePointer (ch), gain, buffer.getNumSamples());
+}
+
+void mix (AudioBuffer<float>& dest, const AudioBuffer<float>& src, float gain) noexcept
+{
+    const int numSamples = jmin (dest.getNumSamples(), src.getNumSamples());
+    for (int ch = jmin (dest.getNumChannels(), src.getNumChannels()); --ch >= 0;)
+        FloatVectorOperations::addWithMultiply (dest.getWritePointer (ch), src.getReadPointer (ch), gain, numSamples);
+}
+
+void multiply (AudioBuffer<float>& dest, const AudioBuffer<float>& src) noexcept
+{
+    if (src.getNumChannels() <= 0)
+        return;
+
+    const int numSamples = jmin (dest.getNumSamples(), src.getNumSamples());
+    for (int ch = 0; ch < dest.getNumChannels(); ++ch)
+        FloatVectorOperations::multiply (dest.getWritePointer (ch),
+            src.getReadPointer (src.getNumChannels() == 1 ? 0 : jmin (ch, src.getNumChannels() - 1)),
+            numSamples);
+}
+
+void pan (AudioBuffer<float>& buffer, float position) noexcept
+{
+    if (buffer.getNumChannels() < 2)
+        return;
+
+    const float angle = (jlimit (-1.f, 1.f, position) + 1.f) * MathConstants<float>::pi * 0.25f;
+    FloatVectorOperations::multiply (buffer.getWritePointer (0), std::cos (angle), buffer.getNumSamples());
+    FloatVectorOperations::multiply (buffer.getWritePointer (1), std::sin (angle), buffer.getNumSamples());
+}
+
+void matrix (AudioBuffer<float>& dest, const AudioBuffer<float>& src,
+             const float* gains, int numOuts, int numIns) noexcept
+{
+    jassert (&dest != &src);
+    const int numSamples = jmin (dest.getNumSamples(), src.getNumSamples());
+    numOuts = jmin (numOuts, dest.getNumChannels());
+    numIns  = jmin (numIns, src.getNumChannels());
+
+    for (int o = 0; o < numOuts; ++o)
+    {
+        auto* const out = dest.getWritePointer (o);
+        FloatVectorOperations::clear (out, numSamples);
+        for (int i = 0; i < numIns; ++i)
+            if (gains [o * numIns + i] != 0.f)
+                FloatVectorOperations::addWithMultiply (out, src.getReadPointer (i), gains [o * numIns + i], numSamples);
+    }
+}
+
+//==============================================================================
+void Biquad::setup (Type type, double sampleRate, double frequency, double q, double gainDb) noexcept
+{
+    const double w0    = MathConstants<double>::twoPi * clampFrequency (sampleRate, frequency) / sampleRate;
+    const double cosw  = std::cos (w0);
+    const double alpha = std::sin (w0) / (2.0 * jmax (0.01, q));
+    const double A     = std::pow (10.0, gainDb / 40.0);
+    const double sqA2a = 2.0 * std::sqrt (A) * alpha;
+
+    double nb0 = 1.0, nb1 = 0.0, nb2 = 0.0, na0 = 1.0, na1 = 0.0, na2 = 0.0;
+
+    switch (type)
+    {
+        case lowPass:
+            nb0 = (1.0 - cosw) * 0.5; nb1 = 1.0 - cosw; nb2 = nb0;
+            na0 = 1.0 + alpha; na1 = -2.0 * cosw; na2 = 1.0 - alpha;
+            break;
+        case highPass:
+            nb0 = (1.0 + cosw) * 0.5; nb1 = -(1.0 + cosw); nb2 = nb0;
+            na0 = 1.0 + alpha; na1 = -2.0 * cosw; na2 = 1.0 - alpha;
+            break;
+        case bandPass:
+            nb0 = alpha; nb1 = 0.0; nb2 = -alpha;
+            na0 = 1.0 + alpha; na1 = -2.0 * cosw; na2 = 1.0 - alpha;
+            break;
+        case notch:
+            nb0 = 1.0; nb1 = -2.0 * cosw; nb2 = 1.0;
+            na0 = 1.0 + alpha; na1 = -2.0 * cosw; na2 = 1.0 - alpha;
+            break;
+        case allPass:
+            nb0 = 1.0 - alpha; nb1 = -2.0 * cosw; nb2 = 1.0 + alpha;
+            na0 = 1.0 + alpha; na1 = -2.0 * cosw; na2 = 1.0 - alpha;
+            break;
+        case peak:
+            nb0 = 1.0 + alpha * A; nb1 = -2.0 * cosw; nb2 = 1.0 - alpha * A;
+            na0 = 1.0 + alpha / A; na1 = -2.0 * cosw; na2 = 1.0 - alpha / A;
+            break;
+        case lowShelf:
+            nb0 = A * ((A + 1.0) - (A - 1.0) * cosw + sqA2a);
+            nb1 = 2.0 * A * ((A - 1.0) - (A + 1.0) * cosw);
+            nb2 = A * ((A + 1.0) - (A - 1.0) * cosw - sqA2a);
+            na0 = (A + 1.0) + (A - 1.0) * cosw + sqA2a;
+            na1 = -2.0 * ((A - 1.0) + (A + 1.0) * cosw);
+            na2 = (A + 1.0) + (A - 1.0) * cosw - sqA2a;
+            break;
+        case highShelf:
+            nb0 = A * ((A + 1.0) + (A - 1.0) * cosw + sqA2a);
+            nb1 = -2.0 * A * ((A - 1.0) + (A + 1.0) * cosw);
+            nb2 = A * ((A + 1.0) + (A - 1.0) * cosw - sqA2a);
+            na0 = (A + 1.0) - (A - 1.0) * cosw + sqA2a;
+            na1 = 2.0 * ((A - 1.0) - (A + 1.0) * cosw);
+            na2 = (A + 1.0) - (A - 1.0) * cosw - sqA2a;
+            break;
+    }
+
+    b0 = nb0 / na0; b1 = nb1 / na0; b2 = nb2 / na0;
+    a1 = na1 / na0; a2 = na2 / na0;
+}
+
+void Biquad::process (AudioBuffer<float>& buffer) noexcept
+{
+    for (int ch = jmin ((int) maxChannels, buffer.getNumChannels()); --ch >= 0;)
+        process (buffer.getWritePointer (ch), buffer.getNumSamples(), ch);
+}
+
+void Biquad::process (float* data, int numSamples, int channel) noexcept
+{
+    if (! isPositiveAndBelow (channel, (int) maxChannels))
+        return;
+
+    double s1 = z1 [channel], s2 = z2 [channel];
+    for (int i = 0; i < numSamples; ++i)
+    {
+        const double x = data[i];
+        const double y = b0 * x + s1;
+        s1 = b1 * x - a1 * y + s2;
+        s2 = b2 * x - a2 * y;
+        data[i] = (float) y;
+    }
+
+    z1 [channel] = s1; z2 [channel] = s2;
+}
+
+void Biquad::reset() noexcept
+{
+    for (int ch = 0; ch < maxChannels; ++ch)
+        z1 [ch] = z2 [ch] = 0.0;
+}
+
+//==============================================================================
+void SVF::setup (Type newType, double sampleRate, double frequency, double q) noexcept
+{
+    type = newType;
+    const double g = std::tan (MathConstants<double>::pi * clampFrequency (sampleRate, frequency) / sampleRate);
+    k  = 1.0 / jmax (0.01, q);
+    a1 = 1.0 / (1.0 + g * (g + k));
+    a2 = g * a1;
+    a3 = g * a2;
+}
+
+void SVF::process (AudioBuffer<float>& buffer) noexcept
+{
+    for (int ch = jmin ((int) maxChannels, buffer.getNumChannels()); --ch >= 0;)
+        process (buffer.getWritePointer (ch), buffer.getNumSamples(), ch);
+}
+
+void SVF::process (float* data, int numSamples, int channel) noexcept
+{
+    if (! isPositiveAndBelow (channel, (int) maxChannels))
+        return;
+
+    double s1 = ic1 [channel], s2 = ic2 [channel];
+    for (int i = 0; i < numSamples; ++i)
+    {
+        const double x  = data[i];
+        const double v3 = x - s2;
+        const double v1 = a1 * s1 + a2 * v3;
+        const double v2 = s2 + a2 * s1 + a3 * v3;
+        s1 = 2.0 * v1 - s1;
+        s2 = 2.0 * v2 - s2;
+
+        switch (type)
+        {
+            case lowPass:   data[i] = (float) v2; break;
+            case highPass:  data[i] = (float) (x - k * v1 - v2); break;
+            case bandPass:  data[i] = (float) v1; break;
+            case notch:     data[i] = (float) (x - k * v1); break;
+        }
+    }
+
+    ic1 [channel] = s1; ic2 [channel] = s2;
+}
+
+void SVF::reset() noexcept
+{
+    for (int ch = 0; ch < maxChannels; ++ch)
+        ic1 [ch] = ic2 [ch] = 0.0;
+}
+
+//==============================================================================
+Delay::Delay (int channels, int maxDelaySamples)
+{
+    numChannels = jlimit (1, (int) maxChannels, channels);
+    size = nextPowerOfTwo (jmax (2, maxDelaySamples + 1));
+    mask = size - 1;
+    line.calloc ((size_t) (numChannels * size));
+}
+
+void Delay::process (AudioBuffer<float>& buffer, int delaySamples, float feedback, float mix) noexcept
+{
+    const int delay = jlimit (1, mask, delaySamples);
+    const int numSamples = buffer.getNumSamples();
+    const float dry = 1.f - mix;
+
+    for (int ch = jmin (numChannels, buffer.getNumChannels()); --ch >= 0;)
+    {
+        auto* const data = buffer.getWritePointer (ch);
+        auto* const ring = line.get() + ch * size;
+        int w = writePos;
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const float delayed = ring [(w - delay) & mask];
+            ring [w] = data[i] + delayed * feedback;
+            data[i] = data[i] * dry + delayed * mix;
+            w = (w + 1) & mask;
+        }
+    }
+
+    writePos = (writePos + numSamples) & mask;
+}
+
+void Delay::reset() noexcept
+{
+    zeromem (line.get(), sizeof (float) * (size_t) (numChannels * size));
+    writePos = 0;
+}
+
+//==============================================================================
+void Follower::setup (double sampleRate, double attackMs, double releaseMs) noexcept
+{
+    attack  = std::exp (-1.0 / (jmax (0.01, attackMs)  * 0.001 * sampleRate));
+    release = std::exp (-1.0 / (jmax (0.01, releaseMs) * 0.001 * sampleRate));
+}
+
+float Follower::process (const AudioBuffer<float>& buffer, float* envelope) noexcept
+{
+    const int numChannels = buffer.getNumChannels();
+    auto* const* const data = buffer.getArrayOfReadPointers();
+    double env = level;
+
+    for (int i = 0; i < buffer.getNumSamples(); ++i)
+    {
+        float peak = 0.f;
+        for (int ch = 0; ch < numChannels; ++ch)
+            peak = jmax (peak, std::abs (data[ch][i]));
+
+        const double coef = peak > env ? attack : release;
+        env = coef * env + (1.0 - coef) * peak;
+        if (envelope != nullptr)
+            envelope[i] = (float) env;
+    }
+
+    level = env;
+    return (float) env;
+}
+
+//==============================================================================
+static inline double polyBlep (double t, double dt) noexcept
+{
+    if (t < dt)
+    {
+        t /= dt;
+        return t + t - t * t - 1.0;
+    }
+
+    if (t > 1.0 - dt)
+    {
+        t = (t - 1.0) / dt;
+        return t * t + t + t + 1.0;
+    }
+
+    return 0.0;
+}
+
+void Oscillator::setup (Shape newShape, double sampleRate, double frequency) noexcept
+{
+    shape = newShape;
+    increment = clampFrequency (sampleRate, frequency) / sampleRate;
+}
+
+void Oscillator::process (AudioBuffer<float>& buffer, float gain) noexcept
+{
+    if (buffer.getNumChannels() <= 0)
+        return;
+
+    auto* const out = buffer.getWritePointer (0);
+    const int numSamples = buffer.getNumSamples();
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        double value = 0.0;
+        switch (shape)
+        {
+            case sine:
+                value = std::sin (MathConstants<double>::twoPi * phase);
+                break;
+            case saw:
+                value = 2.0 * phase - 1.0 - polyBlep (phase, increment);
+                break;
+            case square:
+                value = (phase < 0.5 ? 1.0 : -1.0) + polyBlep (phase, increment)
+                      - polyBlep (std::fmod (phase + 0.5, 1.0), increment);
+                break;
+            case triangle:
+                value = 1.0 - 4.0 * std::abs (phase - 0.5);
+                break;
+        }
+
+        out[i] = (float) value * gain;
+        phase += increment;
+        if (phase >= 1.0)
+            phase -= 1.0;
+    }
+
+    for (int ch = 1; ch < buffer.getNumChannels(); ++ch)
+        FloatVectorOperations::copy (buffer.getWritePointer (ch), out, numSamples);
+}
+
+//==============================================================================
+Spectrum::Spectrum (int order)
+    : fft (jlimit (4, 15, order))
+{
+    const int size = fft.getSize();
+    window.malloc ((size_t) size);
+    data.calloc ((size_t) size * 2);
+    for (int i = 0; i < size; ++i)
+        window[i] = 0.5f - 0.5f * std::cos (MathConstants<float>::twoPi * (float) i / (float) (size - 1));
+}
+
+void Spectrum::process (const AudioBuffer<float>& buffer, int channel) noexcept
+{
+    const int size = fft.getSize();
+    FloatVectorOperations::clear (data.get(), size * 2);
+    if (! isPositiveAndBelow (channel, buffer.getNumChannels()))
+        return;
+
+    const int numSamples = jmin (size, buffer.getNumSamples());
+    const int start = buffer.getNumSamples() - numSamples;
+    FloatVectorOperations::multiply (data.get(), buffer.getReadPointer (channel, start), window.get(), numSamples);
+    fft.performFrequencyOnlyForwardTransform (data.get());
+}
+
+float Spectrum::getMagnitude (int bin) const noexcept
+{
+    return isPositiveAndBelow (bin, fft.getSize() / 2 + 1) ? data[bin] : 0.f;
+}
+
+}
+}
@@ -0,0 +1,182 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+namespace Element {
+
+/** Block processing DSP used by scripts through the el.dsp module.
+
+    Everything here works on whole buffers so a script only makes one call
+    per block. Processing never allocates. Filters and followers keep state
+    for up to maxChannels channels, and extra channels are left untouched.
+ */
+namespace Kernels {
+
+enum { maxChannels = 16 };
+
+//==============================================================================
+/** Multiplies every channel by a gain */
+void applyGain (AudioBuffer<float>& buffer, float gain) noexcept;
+
+/** Adds src multiplied by a gain to dest */
+void mix (AudioBuffer<float>& dest, const AudioBuffer<float>& src, float gain) noexcept;
+
+/** Multiplies dest by src, sample by sample. A mono src is applied to every
+    channel of dest */
+void multiply (AudioBuffer<float>& dest, const AudioBuffer<float>& src) noexcept;
+
+/** Equal power pan of the first two channels, -1 is left and 1 is right */
+void pan (AudioBuffer<float>& buffer, float position) noexcept;
+
+/** Replaces dest with src through a gain matrix. gains holds numOuts rows of
+    numIns gains, so output o is the sum of input i times gains[o * numIns + i].
+    dest and src must be different buffers */
+void matrix (AudioBuffer<float>& dest, const AudioBuffer<float>& src,
+             const float* gains, int numOuts, int numIns) noexcept;
+
+//==============================================================================
+/** An RBJ biquad in transposed direct form II */
+class Biquad final
+{
+public:
+    enum Type { lowPass = 0, highPass, bandPass, notch, allPass, peak, lowShelf, highShelf };
+
+    Biquad() { reset(); }
+
+    /** Sets the response. gainDb is only used by the peak and shelf types */
+    void setup (Type type, double sampleRate, double frequency, double q, double gainDb = 0.0) noexcept;
+
+    void process (AudioBuffer<float>& buffer) noexcept;
+    void process (float* data, int numSamples, int channel) noexcept;
+    void reset() noexcept;
+
+private:
+    double b0 = 1.0, b1 = 0.0, b2 = 0.0, a1 = 0.0, a2 = 0.0;
+    double z1 [maxChannels], z2 [maxChannels];
+};
+
+//==============================================================================
+/** A trapezoidal state variable filter. Unlike the biquad, its frequency can
+    be changed every block without clicks */
+class SVF final
+{
+public:
+    enum Type { lowPass = 0, highPass, bandPass, notch };
+
+    SVF() { reset(); }
+
+    void setup (Type type, double sampleRate, double frequency, double q) noexcept;
+
+    void process (AudioBuffer<float>& buffer) noexcept;
+    void process (float* data, int numSamples, int channel) noexcept;
+    void reset() noexcept;
+
+private:
+    Type type = lowPass;
+    double k = 1.0, a1 = 1.0, a2 = 0.0, a3 = 0.0;
+    double ic1 [maxChannels], ic2 [maxChannels];
+};
+
+//==============================================================================
+/** A feedback delay line with a delay of up to the size it was created with */
+class Delay final
+{
+public:
+    Delay (int numChannels, int maxDelaySamples);
+
+    /** Delays each channel. The output is the input and delayed signal blended
+        by mix, where 0 is only the input */
+    void process (AudioBuffer<float>& buffer, int delaySamples, float feedback, float mix) noexcept;
+
+    int getMaxDelay() const noexcept { return mask; }
+    void reset() noexcept;
+
+private:
+    int numChannels = 0, size = 0, mask = 0, writePos = 0;
+    HeapBlock<float> line;
+};
+
+//==============================================================================
+/** Follows the peak level of all channels */
+class Follower final
+{
+public:
+    Follower() = default;
+
+    void setup (double sampleRate, double attackMs, double releaseMs) noexcept;
+
+    /** Follows a block and returns the level at the end of it. If envelope
+        isn't null, the level at each sample is written to it */
+    float process (const AudioBuffer<float>& buffer, float* envelope = nullptr) noexcept;
+
+    float getLevel() const noexcept { return (float) level; }
+    void reset() noexcept { level = 0.0; }
+
+private:
+    double attack = 0.0, release = 0.0, level = 0.0;
+};
+
+//==============================================================================
+/** An oscillator with PolyBLEP saw and square waves */
+class Oscillator final
+{
+public:
+    enum Shape { sine = 0, saw, square, triangle };
+
+    Oscillator() = default;
+
+    void setup (Shape shape, double sampleRate, double frequency) noexcept;
+
+    /** Writes the waveform times gain to every channel */
+    void process (AudioBuffer<float>& buffer, float gain = 1.f) noexcept;
+
+    void reset() noexcept { phase = 0.0; }
+
+private:
+    Shape shape = sine;
+    double phase = 0.0, increment = 0.0;
+};
+
+//==============================================================================
+/** Windowed magnitude spectrum of one channel */
+class Spectrum final
+{
+public:
+    explicit Spectrum (int order);
+
+    /** Analyses the last getSize() samples of a channel, zero padded if the
+        block is shorter */
+    void process (const AudioBuffer<float>& buffer, int channel) noexcept;
+
+    /** Returns the size of the transform */
+    int getSize() const noexcept { return fft.getSize(); }
+
+    /** Returns a bin's magnitude from the last call to process() */
+    float getMagnitude (int bin) const noexcept;
+
+private:
+    dsp::FFT fft;
+    HeapBlock<float> window, data;
+};
+
+}
+}
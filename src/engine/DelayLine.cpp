@@ -0,0 +1,155 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "engine/DelayLine.h"
+
+namespace Element {
+
+//==============================================================================
+void AudioDelayLine::prepare (const int newMaxDelay, const int maxBlockSize)
+{
+    maxDelay = jmax (0, newMaxDelay);
+    size = nextPowerOfTwo (maxDelay + jmax (1, maxBlockSize));
+    mask = size - 1;
+    buffer.calloc ((size_t) size);
+    writePos = 0;
+    numSilent = size;
+    delay.store (jmin (delay.load(), maxDelay));
+}
+
+bool AudioDelayLine::setDelay (const int numSamples) noexcept
+{
+    if (numSamples < 0 || numSamples > maxDelay)
+        return false;
+    delay.store (numSamples, std::memory_order_relaxed);
+    return true;
+}
+
+void AudioDelayLine::reset() noexcept
+{
+    if (size > 0)
+        FloatVectorOperations::clear (buffer.getData(), size);
+    writePos = 0;
+    numSilent = size;
+}
+
+void AudioDelayLine::write (const float* input, const int numSamples) noexcept
+{
+    const int first = jmin (numSamples, size - writePos);
+    FloatVectorOperations::copy (buffer + writePos, input, first);
+    if (first < numSamples)
+        FloatVectorOperations::copy (buffer.getData(), input + first, numSamples - first);
+    writePos = (writePos + numSamples) & mask;
+}
+
+void AudioDelayLine::read (float* output, const int numSamples, const int delaySamples) const noexcept
+{
+    // reads back from where the block just written started
+    const int start = (writePos - numSamples - delaySamples) & mask;
+    const int first = jmin (numSamples, size - start);
+    FloatVectorOperations::copy (output, buffer + start, first);
+    if (first < numSamples)
+        FloatVectorOperations::copy (output + first, buffer.getData(), numSamples - first);
+}
+
+bool AudioDelayLine::process (const float* input, float* output, const int numSamples,
+                              const bool inputSilent) noexcept
+{
+    // once the whole ring is silent, silence in means silence out
+    if (inputSilent && numSilent >= size)
+    {
+        if (input != output)
+            FloatVectorOperations::clear (output, numSamples);
+        return true;
+    }
+
+    if (size <= 0)
+    {
+        if (input != output)
+            FloatVectorOperations::copy (output, input, numSamples);
+        return inputSilent;
+    }
+
+    // the input is written before reading, so in place works even when the
+    // delay is shorter than the block
+    const int delaySamples = delay.load (std::memory_order_relaxed);
+    const int chunk = size - delaySamples;
+
+    for (int done = 0; done < numSamples;)
+    {
+        const int numThisTime = jmin (chunk, numSamples - done);
+        write (input + done, numThisTime);
+        if (delaySamples > 0 || input != output)
+            read (output + done, numThisTime, delaySamples);
+        done += numThisTime;
+    }
+
+    numSilent = inputSilent ? jmin (numSilent + numSamples, size) : 0;
+    return numSilent >= delaySamples + numSamples;
+}
+
+//==============================================================================
+void MidiDelayLine::prepare (const int numBytes)
+{
+    pending.clear();
+    pending.ensureSize ((size_t) jmax (0, numBytes));
+}
+
+void MidiDelayLine::setDelay (const int numSamples) noexcept
+{
+    delay.store (jmax (0, numSamples), std::memory_order_relaxed);
+}
+
+void MidiDelayLine::process (MidiBuffer& midi, const int numSamples) noexcept
+{
+    const int delaySamples = delay.load (std::memory_order_relaxed);
+    if (delaySamples <= 0 && pending.isEmpty())
+        return;
+
+    if (! midi.isEmpty())
+    {
+        pending.addEvents (midi, 0, -1, delaySamples);
+        midi.clear();
+    }
+
+    if (pending.isEmpty())
+        return;
+
+    midi.addEvents (pending, 0, numSamples, 0);
+    pending.clear (0, numSamples);
+    shiftTimes (pending, -numSamples);
+}
+
+void MidiDelayLine::shiftTimes (MidiBuffer& midi, const int delta) noexcept
+{
+    // stored as an int32 time, a uint16 size, then the message bytes
+    auto* d = midi.data.begin();
+    auto* const end = midi.data.end();
+    while (d < end)
+    {
+        int32 time; uint16 size;
+        std::memcpy (&time, d, sizeof (time));
+        std::memcpy (&size, d + sizeof (time), sizeof (size));
+        time += delta;
+        std::memcpy (d, &time, sizeof (time));
+        d += sizeof (time) + sizeof (size) + size;
+    }
+}
+
+}
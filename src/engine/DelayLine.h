@@ -0,0 +1,112 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+namespace Element {
+
+/** A fixed delay for one channel of audio, used for latency compensation.
+
+    Blocks are copied in and out of a power of two ring with at most two
+    copies each way, so the cost doesn't depend on the delay. The delay can
+    be changed from another thread while rendering, as long as it fits in
+    the size the line was prepared with.
+ */
+class AudioDelayLine final
+{
+public:
+    AudioDelayLine() = default;
+
+    /** Allocates room for delays up to maxDelay. Blocks bigger than
+        maxBlockSize still work, they're just copied in pieces */
+    void prepare (int maxDelay, int maxBlockSize);
+
+    /** Returns the longest delay which fits without reallocating */
+    int getMaxDelay() const noexcept { return maxDelay; }
+
+    /** Sets the delay in samples. Returns false and leaves the delay alone if
+        it doesn't fit. Safe to call while processing */
+    bool setDelay (int numSamples) noexcept;
+
+    /** Returns the delay in samples */
+    int getDelay() const noexcept { return delay.load (std::memory_order_relaxed); }
+
+    /** Writes the delayed input to the output. These can be the same channel.
+        Returns true if the output is silent */
+    bool process (const float* input, float* output, int numSamples, bool inputSilent = false) noexcept;
+
+    /** Clears the line */
+    void reset() noexcept;
+
+private:
+    HeapBlock<float> buffer;
+    int size = 0, mask = 0, maxDelay = 0, writePos = 0;
+    int numSilent = 0;
+    std::atomic<int> delay { 0 };
+
+    void write (const float* input, int numSamples) noexcept;
+    void read (float* output, int numSamples, int delaySamples) const noexcept;
+
+    JUCE_DECLARE_NON_COPYABLE (AudioDelayLine)
+};
+
+//==============================================================================
+/** Delays MIDI by shifting timestamps.
+
+    Events which land beyond the current block wait in a preallocated buffer
+    and are moved back one block at a time. Nothing is copied per sample.
+ */
+class MidiDelayLine final
+{
+public:
+    MidiDelayLine() = default;
+
+    /** Reserves room for pending events */
+    void prepare (int numBytes = 2048);
+
+    /** Sets the delay in samples. Events already waiting keep the delay they
+        were added with. Safe to call while processing */
+    void setDelay (int numSamples) noexcept;
+
+    /** Returns the delay in samples */
+    int getDelay() const noexcept { return delay.load (std::memory_order_relaxed); }
+
+    /** Replaces a block of MIDI with the events due in it */
+    void process (MidiBuffer& midi, int numSamples) noexcept;
+
+    /** Returns true if no events are waiting */
+    bool isEmpty() const noexcept { return pending.isEmpty(); }
+
+    /** Drops every waiting event */
+    void reset() noexcept { pending.clear(); }
+
+    /** Adds delta to the time of every event. The order can't change since
+        every event is moved the same */
+    static void shiftTimes (MidiBuffer& midi, int delta) noexcept;
+
+private:
+    MidiBuffer pending;
+    std::atomic<int> delay { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE (MidiDelayLine)
+};
+
+}
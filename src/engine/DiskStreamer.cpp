@@ -0,0 +1,404 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "engine/DiskStreamer.h"
+
+namespace Element {
+
+// files which decode to less than this are loaded in full
+static constexpr int64 maxPreloadBytes = 8 * 1024 * 1024;
+
+// ring buffer size, and the amount read at once is a quarter of it
+static constexpr double readAheadSeconds = 1.0;
+static constexpr int minReadAhead = 16384;
+
+// workers sleep this long when no stream needs reading, this is also how
+// quickly a seek from a thread that can't wake them is picked up
+static constexpr int workerIdleMs = 5;
+
+static int64 bytesPerFrame (const AudioFormatReader& reader)
+{
+    return (int64) jmax (1, (int) reader.numChannels) * jmax (1, (int) reader.bitsPerSample / 8);
+}
+
+//=============================================================================
+class DiskStreamer::Worker : public Thread
+{
+public:
+    Worker (DiskStreamer& s, int index)
+        : Thread ("Disk Streamer " + String (index)),
+          streamer (s) { }
+
+    void run() override
+    {
+        while (! threadShouldExit())
+            if (! streamer.serviceNextStream())
+                wait (workerIdleMs);
+    }
+
+private:
+    DiskStreamer& streamer;
+};
+
+//=============================================================================
+DiskStreamer::Stream::Stream (DiskStreamer& s, AudioFormatReader* r, bool mapped)
+    : streamer (s),
+      reader (r),
+      length (jmax ((int64) 0, r->lengthInSamples)),
+      numChannels (jmax (1, (int) r->numChannels)),
+      sampleRate (r->sampleRate > 0.0 ? r->sampleRate : 44100.0),
+      memoryMapped (mapped),
+      preload (length * numChannels * (int64) sizeof (float) <= maxPreloadBytes),
+      fifo (preload ? 1 : jmax (minReadAhead, roundToInt (sampleRate * readAheadSeconds)))
+{
+    if (! preload)
+        ring.setSize (numChannels, fifo.getTotalSize());
+}
+
+DiskStreamer::Stream::~Stream()
+{
+    streamer.removeStream (this);
+}
+
+bool DiskStreamer::Stream::isReady() const noexcept
+{
+    if (preload)
+        return loaded.load();
+    return readerEpoch.load() == requestEpoch.load() && fifo.getNumReady() > 0;
+}
+
+void DiskStreamer::Stream::setNextReadPosition (int64 position)
+{
+    requestedPosition.store (jlimit ((int64) 0, length, position));
+    requestEpoch.fetch_add (1, std::memory_order_release);
+}
+
+int64 DiskStreamer::Stream::getNextReadPosition() const
+{
+    auto position = readPosition.load();
+    if (readerEpoch.load() != requestEpoch.load())
+        position = requestedPosition.load();
+    return (looping.load() && length > 0) ? position % length : position;
+}
+
+void DiskStreamer::Stream::setLooping (bool shouldLoop)
+{
+    // the ring holds audio read for the old setting, so refill it
+    if (looping.exchange (shouldLoop) != shouldLoop && ! preload)
+        setNextReadPosition (getNextReadPosition());
+}
+
+void DiskStreamer::Stream::readFrom (const AudioBuffer<float>& source, int sourceStart,
+                                     const AudioSourceChannelInfo& info,
+                                     int offset, int numSamples) const noexcept
+{
+    if (numSamples <= 0)
+        return;
+    for (int c = info.buffer->getNumChannels(); --c >= 0;)
+        info.buffer->copyFrom (c, info.startSample + offset, source,
+                               jmin (c, source.getNumChannels() - 1),
+                               sourceStart, numSamples);
+}
+
+void DiskStreamer::Stream::getNextAudioBlock (const AudioSourceChannelInfo& info)
+{
+    const int numSamples = info.numSamples;
+    if (numSamples > 0)
+        info.clearActiveBufferRegion();
+
+    const auto request = requestEpoch.load (std::memory_order_acquire);
+    if (request != readerEpoch.load (std::memory_order_relaxed))
+    {
+        if (preload)
+        {
+            readPosition.store (requestedPosition.load());
+        }
+        else if (workerEpoch.load (std::memory_order_acquire) == request)
+        {
+            // everything in the ring is from before the seek
+            fifo.finishedRead (fifo.getNumReady());
+            readPosition.store (startPosition.load());
+        }
+        else
+        {
+            return;
+        }
+
+        readerEpoch.store (request, std::memory_order_release);
+    }
+
+    // an empty block still picks up a seek
+    if (numSamples <= 0)
+        return;
+
+    const bool loop = looping.load (std::memory_order_relaxed) && length > 0;
+    auto position = readPosition.load (std::memory_order_relaxed);
+
+    if (preload)
+    {
+        if (! loaded.load (std::memory_order_acquire))
+            return;
+
+        for (int offset = 0; offset < numSamples;)
+        {
+            const auto start = loop ? (position + offset) % length : position + offset;
+            if (start >= length)
+                break;
+            const int n = (int) jmin ((int64) (numSamples - offset), length - start);
+            readFrom (samples, (int) start, info, offset, n);
+            offset += n;
+        }
+
+        position += numSamples;
+    }
+    else
+    {
+        // past the end of a file that doesn't loop there's nothing to read
+        const int wanted = loop ? numSamples
+            : (int) jlimit ((int64) 0, (int64) numSamples, length - position);
+        const int numRead = jmin (wanted, fifo.getNumReady());
+
+        if (numRead < wanted)
+            ++streamer.underruns;
+
+        int start1, size1, start2, size2;
+        fifo.prepareToRead (numRead, start1, size1, start2, size2);
+        readFrom (ring, start1, info, 0, size1);
+        readFrom (ring, start2, info, size1, size2);
+        fifo.finishedRead (size1 + size2);
+
+        // keep in step with the ring, unless the file has ended
+        position += (numRead < wanted || wanted == numSamples) ? numRead : numSamples;
+    }
+
+    readPosition.store (loop ? position % length : position, std::memory_order_relaxed);
+}
+
+bool DiskStreamer::Stream::needsService (double& deadline) const noexcept
+{
+    if (preload)
+    {
+        deadline = 0.0;
+        return ! loaded.load();
+    }
+
+    const auto request = requestEpoch.load (std::memory_order_acquire);
+    if (request != workerEpoch.load())
+    {
+        deadline = 0.0;
+        return true;
+    }
+
+    // wait for the reader to flush what was read before the seek
+    if (readerEpoch.load (std::memory_order_acquire) != request)
+        return false;
+    if (! looping.load() && workerPosition >= length)
+        return false;
+    if (fifo.getFreeSpace() < fifo.getTotalSize() / 4)
+        return false;
+
+    // seconds until the ring runs dry
+    deadline = (double) fifo.getNumReady() / sampleRate;
+    return true;
+}
+
+int64 DiskStreamer::Stream::service()
+{
+    if (preload)
+    {
+        samples.setSize (numChannels, (int) length);
+        if (length > 0)
+            reader->read (&samples, 0, (int) length, 0, true, true);
+        loaded.store (true, std::memory_order_release);
+        return length * bytesPerFrame (*reader);
+    }
+
+    const auto request = requestEpoch.load (std::memory_order_acquire);
+    if (request != workerEpoch.load())
+    {
+        workerPosition = requestedPosition.load();
+        if (looping.load() && length > 0)
+            workerPosition %= length;
+        startPosition.store (workerPosition);
+        workerEpoch.store (request, std::memory_order_release);
+        return 0;
+    }
+
+    if (readerEpoch.load (std::memory_order_acquire) != request)
+        return 0;
+
+    const bool loop = looping.load() && length > 0;
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite (jmin (fifo.getFreeSpace(), fifo.getTotalSize() / 4),
+                         start1, size1, start2, size2);
+
+    for (auto block : { std::make_pair (start1, size1), std::make_pair (start2, size2) })
+    {
+        while (block.second > 0)
+        {
+            if (loop && workerPosition >= length)
+                workerPosition = 0;
+            const int n = loop ? (int) jmin ((int64) block.second, length - workerPosition)
+                               : block.second;
+            // reads past the end are filled with silence
+            reader->read (&ring, block.first, n, workerPosition, true, true);
+            workerPosition += n;
+            block.first += n;
+            block.second -= n;
+        }
+    }
+
+    fifo.finishedWrite (size1 + size2);
+    return (int64) (size1 + size2) * bytesPerFrame (*reader);
+}
+
+//=============================================================================
+DiskStreamer::DiskStreamer()
+{
+    const int numThreads = jlimit (1, 4, SystemStats::getNumCpus() / 2);
+    for (int i = 0; i < numThreads; ++i)
+        workers.add (new Worker (*this, i + 1))->startThread();
+}
+
+DiskStreamer::~DiskStreamer()
+{
+    // streams must be deleted before the streamer
+    jassert (streams.isEmpty());
+
+    for (auto* worker : workers)
+        worker->signalThreadShouldExit();
+    wakeWorkers();
+    for (auto* worker : workers)
+        worker->stopThread (1000);
+    workers.clear();
+}
+
+std::unique_ptr<DiskStreamer::Stream> DiskStreamer::openFile (AudioFormatManager& formats, const File& file)
+{
+    std::unique_ptr<AudioFormatReader> reader;
+    bool mapped = false;
+
+    if (auto* format = formats.findFormatForFileExtension (file.getFileExtension()))
+    {
+        std::unique_ptr<MemoryMappedAudioFormatReader> mappedReader (format->createMemoryMappedReader (file));
+        if (mappedReader != nullptr && mappedReader->mapEntireFile())
+        {
+            reader = std::move (mappedReader);
+            mapped = true;
+        }
+    }
+
+    if (reader == nullptr)
+        reader.reset (formats.createReaderFor (file));
+    if (reader == nullptr)
+        return nullptr;
+
+    std::unique_ptr<Stream> stream (new Stream (*this, reader.release(), mapped));
+    addStream (stream.get());
+    return stream;
+}
+
+DiskStreamer::Stats DiskStreamer::getStats()
+{
+    Stats stats;
+
+    {
+        ScopedLock sl (lock);
+        stats.numStreams = streams.size();
+        for (const auto* stream : streams)
+        {
+            if (stream->isPreloaded())      ++stats.numPreloaded;
+            if (stream->isMemoryMapped())   ++stats.numMemoryMapped;
+        }
+    }
+
+    stats.underruns = underruns.load();
+    stats.bytesRead = bytesRead.load();
+
+    const auto now = Time::getMillisecondCounterHiRes();
+    if (lastStatsTime > 0.0 && now > lastStatsTime)
+        stats.bytesPerSecond = (double) (stats.bytesRead - lastBytesRead) * 1000.0 / (now - lastStatsTime);
+    lastStatsTime = now;
+    lastBytesRead = stats.bytesRead;
+
+    return stats;
+}
+
+void DiskStreamer::addStream (Stream* stream)
+{
+    {
+        ScopedLock sl (lock);
+        streams.add (stream);
+    }
+
+    wakeWorkers();
+}
+
+void DiskStreamer::removeStream (Stream* stream)
+{
+    for (;;)
+    {
+        {
+            ScopedLock sl (lock);
+            if (! stream->busy.load())
+            {
+                streams.removeFirstMatchingValue (stream);
+                return;
+            }
+        }
+
+        Thread::sleep (1);
+    }
+}
+
+bool DiskStreamer::serviceNextStream()
+{
+    Stream* next = nullptr;
+
+    {
+        ScopedLock sl (lock);
+        double earliest = 0.0, deadline = 0.0;
+        for (auto* stream : streams)
+        {
+            if (stream->busy.load() || ! stream->needsService (deadline))
+                continue;
+            if (next == nullptr || deadline < earliest)
+            {
+                next = stream;
+                earliest = deadline;
+            }
+        }
+
+        if (next == nullptr)
+            return false;
+        next->busy = true;
+    }
+
+    bytesRead += next->service();
+    next->busy = false;
+    return true;
+}
+
+void DiskStreamer::wakeWorkers()
+{
+    for (auto* worker : workers)
+        worker->notify();
+}
+
+}
@@ -0,0 +1,158 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+namespace Element {
+
+/** Streams audio files from disk for every file player in the app.
+
+    A small pool of threads services all open streams, always refilling the
+    stream closest to running dry first. Each stream reads from its own
+    lock-free ring buffer, so the audio thread never blocks on disk I/O.
+    Uncompressed files are read through a memory map and short files are
+    loaded into memory in full, after which they never touch the disk.
+
+    Use it through a SharedResourcePointer so the threads only run while
+    something needs them.
+ */
+class DiskStreamer final
+{
+public:
+    /** Totals for all streams */
+    struct Stats
+    {
+        int numStreams = 0;
+        int numPreloaded = 0;
+        int numMemoryMapped = 0;
+
+        /** Blocks where a stream had less audio ready than was asked for */
+        int64 underruns = 0;
+
+        /** Bytes decoded from disk */
+        int64 bytesRead = 0;
+
+        /** Disk throughput since the previous call to getStats() */
+        double bytesPerSecond = 0.0;
+    };
+
+    /** A file being streamed. Plays like an AudioFormatReaderSource and can
+        be given to an AudioTransportSource without a read-ahead thread.
+        getNextAudioBlock() is realtime safe. Everything else should be
+        called from the message thread.
+     */
+    class Stream : public PositionableAudioSource
+    {
+    public:
+        ~Stream();
+
+        /** Returns the sample rate of the file */
+        double getSampleRate() const noexcept       { return sampleRate; }
+
+        /** Returns true if the whole file is held in memory */
+        bool isPreloaded() const noexcept           { return preload; }
+
+        /** Returns true if the file is read through a memory map */
+        bool isMemoryMapped() const noexcept        { return memoryMapped; }
+
+        /** Returns true if audio is ready at the play position */
+        bool isReady() const noexcept;
+
+        void prepareToPlay (int, double) override { }
+        void releaseResources() override { }
+        void getNextAudioBlock (const AudioSourceChannelInfo&) override;
+        void setNextReadPosition (int64) override;
+        int64 getNextReadPosition() const override;
+        int64 getTotalLength() const override       { return length; }
+        bool isLooping() const override             { return looping.load(); }
+        void setLooping (bool) override;
+
+    private:
+        friend class DiskStreamer;
+        Stream (DiskStreamer&, AudioFormatReader*, bool memoryMapped);
+
+        DiskStreamer& streamer;
+        std::unique_ptr<AudioFormatReader> reader;
+        const int64 length;
+        const int numChannels;
+        const double sampleRate;
+        const bool memoryMapped;
+        const bool preload;
+        std::atomic<bool> looping { false };
+
+        // preloaded files
+        AudioBuffer<float> samples;
+        std::atomic<bool> loaded { false };
+
+        // streamed files
+        AbstractFifo fifo;
+        AudioBuffer<float> ring;
+        int64 workerPosition = 0;
+
+        // a seek is requested, picked up by the worker, then flushed by the reader
+        std::atomic<int64> requestedPosition { 0 };
+        std::atomic<int64> startPosition { 0 };
+        std::atomic<uint32> requestEpoch { 0 };
+        std::atomic<uint32> workerEpoch { 0 };
+        std::atomic<uint32> readerEpoch { 0 };
+        std::atomic<int64> readPosition { 0 };
+
+        std::atomic<bool> busy { false };
+
+        bool needsService (double& deadline) const noexcept;
+        int64 service();
+        void readFrom (const AudioBuffer<float>&, int sourceStart, const AudioSourceChannelInfo&, int offset, int numSamples) const noexcept;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Stream)
+    };
+
+    DiskStreamer();
+    ~DiskStreamer();
+
+    /** Opens a file for streaming, or returns nullptr if no format can read it */
+    std::unique_ptr<Stream> openFile (AudioFormatManager& formats, const File& file);
+
+    /** Returns the number of streaming threads */
+    int getNumThreads() const noexcept { return workers.size(); }
+
+    /** Returns totals for all streams */
+    Stats getStats();
+
+private:
+    class Worker;
+    OwnedArray<Worker> workers;
+    CriticalSection lock;
+    Array<Stream*> streams;
+
+    std::atomic<int64> underruns { 0 };
+    std::atomic<int64> bytesRead { 0 };
+    int64 lastBytesRead = 0;
+    double lastStatsTime = 0.0;
+
+    void addStream (Stream*);
+    void removeStream (Stream*);
+    bool serviceNextStream();
+    void wakeWorkers();
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DiskStreamer)
+};
+
+}
@@ -17,11 +17,17 @@
     Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 */
 
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+
 #include "engine/nodes/AudioProcessorNode.h"
 #include "engine/AudioEngine.h"
+#include "engine/DelayLine.h"
 #include "engine/GraphProcessor.h"
 #include "engine/MidiPipe.h"
 #include "engine/MidiTranspose.h"
+#include "engine/RenderThreadPool.h"
 #include "engine/nodes/SubGraphProcessor.h"
 #include "session/Node.h"
 
@@ -32,12 +38,58 @@ const int GraphProcessor::midiChannelIndex = 0x1000;
 namespace GraphRender
 {
 
+class Task;
+
+/** A single step of a compiled RenderProgram. Shared buffers are resolved
+    to raw pointers when the program is compiled, so rendering doesn't need
+    to look anything up. */
+struct Instruction
+{
+    enum Code : uint8
+    {
+        clearAudio = 0,
+        copyAudio,
+        addAudio,
+        mixAudio,       // dest = source + source2
+        delayAudio,     // dest = delayed source
+        clearMidi,
+        copyMidi,
+        addMidi,
+        performTask
+    };
+
+    Code code = performTask;
+    int destChannel = 0, sourceChannel = 0, sourceChannel2 = 0;
+    float* dest = nullptr;
+    const float* source = nullptr;
+    const float* source2 = nullptr;
+    MidiBuffer* midiDest = nullptr;
+    const MidiBuffer* midiSource = nullptr;
+    Task* task = nullptr;
+};
+
 class Task
 {
 public:
     Task() { }
     virtual ~Task()  { }
 
+    /** Called once the shared buffers are allocated. Ops which keep their
+        own state can look up channels here instead of on every block.
+        silentChannels holds a flag per audio buffer which is set while the
+        buffer is known to contain silence. */
+    virtual void resolve (AudioSampleBuffer&, const OwnedArray <MidiBuffer>&, uint8* /*silentChannels*/) { }
+
+    /** Returns the instruction which performs this op. By default it just
+        calls perform() */
+    virtual Instruction compile (AudioSampleBuffer&, const OwnedArray <MidiBuffer>&)
+    {
+        Instruction inst;
+        inst.code = Instruction::performTask;
+        inst.task = this;
+        return inst;
+    }
+
     virtual void perform (AudioSampleBuffer& sharedBufferChans,
                           const OwnedArray <MidiBuffer>& sharedMidiBuffers,
                           const int numSamples) = 0;
@@ -52,7 +104,16 @@ public:
         : channelNum (channelNum_)
     { }
 
-    void perform (AudioSampleBuffer& sharedBufferChans, const OwnedArray <MidiBuffer>&, const int numSamples)
+    Instruction compile (AudioSampleBuffer& sharedBufferChans, const OwnedArray <MidiBuffer>&) override
+    {
+        Instruction inst;
+        inst.code = Instruction::clearAudio;
+        inst.destChannel = channelNum;
+        inst.dest = sharedBufferChans.getWritePointer (channelNum);
+        return inst;
+    }
+
+    void perform (AudioSampleBuffer& sharedBufferChans, const OwnedArray <MidiBuffer>&, const int numSamples) override
     {
         sharedBufferChans.clear (channelNum, 0, numSamples);
     }
@@ -72,7 +133,18 @@ public:
           dstChannelNum (dstChannelNum_)
     { }
 
-    void perform (AudioSampleBuffer& sharedBufferChans, const OwnedArray <MidiBuffer>&, const int numSamples)
+    Instruction compile (AudioSampleBuffer& sharedBufferChans, const OwnedArray <MidiBuffer>&) override
+    {
+        Instruction inst;
+        inst.code = Instruction::copyAudio;
+        inst.destChannel = dstChannelNum;
+        inst.sourceChannel = srcChannelNum;
+        inst.dest = sharedBufferChans.getWritePointer (dstChannelNum);
+        inst.source = sharedBufferChans.getReadPointer (srcChannelNum);
+        return inst;
+    }
+
+    void perform (AudioSampleBuffer& sharedBufferChans, const OwnedArray <MidiBuffer>&, const int numSamples) override
     {
         sharedBufferChans.copyFrom (dstChannelNum, 0, sharedBufferChans, srcChannelNum, 0, numSamples);
     }
@@ -92,7 +164,18 @@ public:
           dstChannelNum (dstChannelNum_)
     { }
 
-    void perform (AudioSampleBuffer& sharedBufferChans, const OwnedArray <MidiBuffer>&, const int numSamples)
+    Instruction compile (AudioSampleBuffer& sharedBufferChans, const OwnedArray <MidiBuffer>&) override
+    {
+        Instruction inst;
+        inst.code = Instruction::addAudio;
+        inst.destChannel = dstChannelNum;
+        inst.sourceChannel = srcChannelNum;
+        inst.dest = sharedBufferChans.getWritePointer (dstChannelNum);
+        inst.source = sharedBufferChans.getReadPointer (srcChannelNum);
+        return inst;
+    }
+
+    void perform (AudioSampleBuffer& sharedBufferChans, const OwnedArray <MidiBuffer>&, const int numSamples) override
     {
         sharedBufferChans.addFrom (dstChannelNum, 0, sharedBufferChans, srcChannelNum, 0, numSamples);
     }
@@ -111,7 +194,15 @@ public:
         : bufferNum (bufferNum_)
     {}
 
-    void perform (AudioSampleBuffer&, const OwnedArray <MidiBuffer>& sharedMidiBuffers, const int)
+    Instruction compile (AudioSampleBuffer&, const OwnedArray <MidiBuffer>& sharedMidiBuffers) override
+    {
+        Instruction inst;
+        inst.code = Instruction::clearMidi;
+        inst.midiDest = sharedMidiBuffers.getUnchecked (bufferNum);
+        return inst;
+    }
+
+    void perform (AudioSampleBuffer&, const OwnedArray <MidiBuffer>& sharedMidiBuffers, const int) override
     {
         sharedMidiBuffers.getUnchecked (bufferNum)->clear();
     }
@@ -131,7 +222,16 @@ public:
           dstBufferNum (dstBufferNum_)
     { }
 
-    void perform (AudioSampleBuffer&, const OwnedArray <MidiBuffer>& sharedMidiBuffers, const int)
+    Instruction compile (AudioSampleBuffer&, const OwnedArray <MidiBuffer>& sharedMidiBuffers) override
+    {
+        Instruction inst;
+        inst.code = Instruction::copyMidi;
+        inst.midiDest = sharedMidiBuffers.getUnchecked (dstBufferNum);
+        inst.midiSource = sharedMidiBuffers.getUnchecked (srcBufferNum);
+        return inst;
+    }
+
+    void perform (AudioSampleBuffer&, const OwnedArray <MidiBuffer>& sharedMidiBuffers, const int) override
     {
         *sharedMidiBuffers.getUnchecked (dstBufferNum) = *sharedMidiBuffers.getUnchecked (srcBufferNum);
     }
@@ -151,7 +251,16 @@ public:
           dstBufferNum (dstBufferNum_)
     { }
 
-    void perform (AudioSampleBuffer&, const OwnedArray <MidiBuffer>& sharedMidiBuffers, const int numSamples)
+    Instruction compile (AudioSampleBuffer&, const OwnedArray <MidiBuffer>& sharedMidiBuffers) override
+    {
+        Instruction inst;
+        inst.code = Instruction::addMidi;
+        inst.midiDest = sharedMidiBuffers.getUnchecked (dstBufferNum);
+        inst.midiSource = sharedMidiBuffers.getUnchecked (srcBufferNum);
+        return inst;
+    }
+
+    void perform (AudioSampleBuffer&, const OwnedArray <MidiBuffer>& sharedMidiBuffers, const int numSamples) override
     {
         sharedMidiBuffers.getUnchecked (dstBufferNum)
             ->addEvents (*sharedMidiBuffers.getUnchecked (srcBufferNum), 0, numSamples, 0);
@@ -163,40 +272,96 @@ private:
     JUCE_DECLARE_NON_COPYABLE (AddMidiBufferOp)
 };
 
-class DelayChannelOp : public Task
+/** An op which delays a buffer to line up with a node's other inputs. The
+    delay can be changed while the sequence is rendering, as long as it fits
+    in what the op was created with. */
+class DelayOp : public Task
+{
+public:
+    /** Returns true if the delay can be set without reallocating */
+    virtual bool canDelay (int numSamples) const noexcept = 0;
+
+    /** Sets the delay. Safe to call while rendering */
+    virtual void setDelay (int numSamples) noexcept = 0;
+
+    /** Room for the delay to grow before a rebuild is needed */
+    static int getMaxDelayFor (const int numSamples) noexcept
+    {
+        return jmax (numSamples * 2, 4096);
+    }
+};
+
+class DelayChannelOp : public DelayOp
 {
 public:
-    DelayChannelOp (const int channel_, const int numSamplesDelay_)
-        : channel (channel_),
-          bufferSize (numSamplesDelay_ + 1),
-          readIndex (0), writeIndex (numSamplesDelay_)
+    DelayChannelOp (const int channel_, const int numSamplesDelay, const int blockSize)
+        : channel (channel_)
     {
-        buffer.calloc ((size_t) bufferSize);
+        line.prepare (getMaxDelayFor (numSamplesDelay), blockSize);
+        line.setDelay (numSamplesDelay);
     }
 
-    void perform (AudioSampleBuffer& sharedBufferChans, const OwnedArray <MidiBuffer>&, const int numSamples)
+    Instruction compile (AudioSampleBuffer& sharedBufferChans, const OwnedArray <MidiBuffer>&) override
     {
-        float* data = sharedBufferChans.getWritePointer (channel, 0);
+        Instruction inst;
+        inst.code = Instruction::delayAudio;
+        inst.destChannel = inst.sourceChannel = channel;
+        inst.dest = sharedBufferChans.getWritePointer (channel);
+        inst.source = inst.dest;
+        inst.task = this;
+        return inst;
+    }
 
-        for (int i = numSamples; --i >= 0;)
-        {
-            buffer [writeIndex] = *data;
-            *data++ = buffer [readIndex];
+    void perform (AudioSampleBuffer& sharedBufferChans, const OwnedArray <MidiBuffer>&, const int numSamples) override
+    {
+        float* data = sharedBufferChans.getWritePointer (channel, 0);
+        process (data, data, numSamples, false);
+    }
 
-            if (++readIndex  >= bufferSize) readIndex = 0;
-            if (++writeIndex >= bufferSize) writeIndex = 0;
-        }
+    /** Writes the delayed input to the output. These can be the same channel.
+        Returns true if the output is silent */
+    bool process (const float* input, float* output, const int numSamples, const bool inputSilent) noexcept
+    {
+        return line.process (input, output, numSamples, inputSilent);
     }
 
+    bool canDelay (const int numSamples) const noexcept override  { return numSamples <= line.getMaxDelay(); }
+    void setDelay (const int numSamples) noexcept override        { line.setDelay (numSamples); }
+
 private:
-    HeapBlock<float> buffer;
-    const int channel, bufferSize;
-    int readIndex, writeIndex;
+    const int channel;
+    AudioDelayLine line;
 
     JUCE_DECLARE_NON_COPYABLE (DelayChannelOp)
 };
 
 
+class DelayMidiBufferOp : public DelayOp
+{
+public:
+    DelayMidiBufferOp (const int bufferNum_, const int numSamplesDelay)
+        : bufferNum (bufferNum_)
+    {
+        line.prepare();
+        line.setDelay (numSamplesDelay);
+    }
+
+    void perform (AudioSampleBuffer&, const OwnedArray <MidiBuffer>& sharedMidiBuffers, const int numSamples) override
+    {
+        line.process (*sharedMidiBuffers.getUnchecked (bufferNum), numSamples);
+    }
+
+    bool canDelay (const int) const noexcept override               { return true; }
+    void setDelay (const int numSamples) noexcept override        { line.setDelay (numSamples); }
+
+private:
+    const int bufferNum;
+    MidiDelayLine line;
+
+    JUCE_DECLARE_NON_COPYABLE (DelayMidiBufferOp)
+};
+
+
 class ProcessBufferOp : public Task
 {
 public:
@@ -231,22 +396,82 @@ public:
         tempMidi.ensureSize (128);
     }
 
-    void perform (AudioSampleBuffer& sharedBufferChans, const OwnedArray <MidiBuffer>& sharedMidiBuffers, const int numSamples)
+    void resolve (AudioSampleBuffer& sharedBufferChans, const OwnedArray <MidiBuffer>& sharedMidiBuffers,
+                  uint8* silentChannels_) override
     {
-        for (int i = totalChans; --i >= 0;) {
+        for (int i = totalChans; --i >= 0;)
             channels[i] = sharedBufferChans.getWritePointer (audioChannelsToUse.getUnchecked (i), 0);
+        pipe.reset (new MidiPipe (sharedMidiBuffers, midiChannelsToUse));
+        silentChannels = silentChannels_;
+
+        // storage for rendering in sub-blocks between parameter events
+        splitBlocks = node->canSplitBlocks();
+        events.calloc ((size_t) node->parameterEvents.getCapacity());
+        // the node's array is rebuilt on the message thread when its ports
+        // change, so events are applied to the parameters resolved here
+        params = node->getParameters();
+        segmentChannels.calloc ((size_t) totalChans);
+        blockMidi.clearQuick (true);
+        segmentMidi.clearQuick (true);
+        if (splitBlocks)
+        {
+            for (int i = 0; i < pipe->getNumBuffers(); ++i)
+            {
+                blockMidi.add (new MidiBuffer())->ensureSize (2048);
+                segmentMidi.add (new MidiBuffer())->ensureSize (2048);
+            }
         }
 
-        AudioSampleBuffer buffer (channels, totalChans, numSamples);
-        MidiPipe midiPipe (sharedMidiBuffers, midiChannelsToUse);
+        // the device input is where silence starts, other nodes only report
+        // silence when they're asleep
+        checkOutputSilence = node->isAudioInputNode();
+
+        // how long the inputs must be silent before the node can sleep
+        samplesBeforeSleep = -1;
+        if (node->canSleep())
+        {
+            const auto* const proc = node->getAudioProcessor();
+            samplesBeforeSleep = proc != nullptr
+                ? roundToInt (proc->getTailLengthSeconds() * proc->getSampleRate())
+                : 0;
+        }
+    }
+
+    void perform (AudioSampleBuffer&, const OwnedArray <MidiBuffer>&, const int numSamples) override
+    {
+        jassert (pipe != nullptr);
+        audio.setDataToReferTo (channels.getData(), totalChans, numSamples);
+        AudioSampleBuffer& buffer = audio;
+        MidiPipe& midiPipe = *pipe;
+
+        node->lastRenderTime.store (Time::getMillisecondCounterHiRes(), std::memory_order_release);
+        collectParameterEvents (numSamples);
 
         if (! node->isEnabled())
         {
+            applyParameterEvents (numEvents);
             for (int ch = numAudioIns; ch < numAudioOuts; ++ch)
+            {
                 buffer.clear (ch, 0, buffer.getNumSamples());
+                silentChannels[audioChannelsToUse.getUnchecked (ch)] = 1;
+            }
             return;
         }
 
+        // a sleeping node is skipped until its input has signal or MIDI
+        const bool inputSilent = isInputSilent();
+        if (sleeping)
+        {
+            if (inputSilent)
+            {
+                applyParameterEvents (numEvents);
+                renderAsleep (buffer);
+                return;
+            }
+
+            sleeping = false;
+        }
+
         const bool muted = node->isMuted();
         const bool muteInput = node->isMutingInputs();
 
@@ -277,8 +502,16 @@ public:
             buffer.applyGain (0, numSamples, node->getInputGain());
         }
 
-        for (int i = numAudioIns; --i >= 0;)
-            node->setInputRMS (i, buffer.getRMSLevel (i, 0, numSamples));
+        // levels are only measured while something is displaying them
+        const bool metering = node->isMetering();
+        if (metering)
+        {
+            auto& meter = node->getInputMeter();
+            for (int i = 0; i < numAudioIns; ++i)
+                meter.write (i, silentChannels[audioChannelsToUse.getUnchecked (i)] != 0
+                                    ? MeterBuffer::Level() : MeterBuffer::measure (buffer.getReadPointer (i), numSamples));
+            meter.commit();
+        }
 
        #ifndef EL_FREE
         // Begin MIDI filters
@@ -335,34 +568,202 @@ public:
         // End MIDI filters
        #endif
         
-        auto pluginProcessBlock = [=, &sharedMidiBuffers] (AudioSampleBuffer& buffer, MidiPipe& midiPipe, bool isSuspended)
+        if (splitBlocks && numEvents > 0 && events[numEvents - 1].frame > 0)
         {
-            if (node->wantsMidiPipe())
+            renderSplit (buffer, midiPipe, numSamples);
+        }
+        else
+        {
+            applyParameterEvents (numEvents);
+            renderSegment (buffer, midiPipe);
+        }
+
+        if (muted && !muteInput)
+        {
+            if (lastMute != muted)
             {
-                if (! node->isSuspended())
-                    node->render (buffer, midiPipe);
-                else
-                    node->renderBypassed (buffer, midiPipe);
+                // just became muted
+                buffer.applyGainRamp (0, numSamples, node->getLastGain(), 0.0);
             }
             else
             {
-                if (! isSuspended)
-                {
-                    processor->processBlock (buffer, *midiPipe.getWriteBuffer (0));
-                    // processor->processBlock (buffer, *sharedMidiBuffers.getUnchecked (midiBufferToUse));
-                }
-                else
-                {
-                    processor->processBlockBypassed (buffer, *midiPipe.getWriteBuffer (0));
-                    // processor->processBlockBypassed (buffer, *sharedMidiBuffers.getUnchecked (midiBufferToUse));
-                }
+                // normal mute processing
+                buffer.applyGain (0, numSamples, 0.0);
             }
-        };
+        }
+        else if (!muted && !muteInput && muted != lastMute)
+        {
+            // just became unmuted
+            buffer.applyGainRamp (0, numSamples, 0.0, node->getGain());
+        }
+        else if (node->getGain() != node->getLastGain())
+        {
+            buffer.applyGainRamp (0, numSamples, node->getLastGain(), node->getGain());
+        }
+        else 
+        {
+            buffer.applyGain (0, numSamples, node->getGain());
+        }
 
-        const auto osFactor = node->getOversamplingFactor();
-        if (osFactor > 1)
+        node->updateGain();
+        lastMute = muted;
+
+        for (int i = 0; i < numAudioOuts; ++i)
+            silentChannels[audioChannelsToUse.getUnchecked (i)] =
+                checkOutputSilence && buffer.getMagnitude (i, 0, numSamples) == 0.f ? 1 : 0;
+
+        const bool mightSleep = samplesBeforeSleep >= 0 && inputSilent
+                                    && numSilentSamples + numSamples > samplesBeforeSleep;
+        float maxOutputPeak = 0.f;
+
+        if (metering || mightSleep)
+        {
+            auto& meter = node->getOutputMeter();
+            for (int i = 0; i < numAudioOuts; ++i)
+            {
+                const auto level = MeterBuffer::measure (buffer.getReadPointer (i), numSamples);
+                maxOutputPeak = jmax (maxOutputPeak, level.peak);
+                if (metering)
+                    meter.write (i, level);
+            }
+
+            if (metering)
+                meter.commit();
+        }
+
+        // sleep once the tail has played out after the input went silent. A
+        // single quiet block can be the gap between two echoes
+        if (samplesBeforeSleep >= 0 && inputSilent)
+        {
+            numSilentSamples += numSamples;
+            numQuietBlocks = mightSleep && maxOutputPeak < silenceThreshold ? numQuietBlocks + 1 : 0;
+            if (numQuietBlocks >= quietBlocksBeforeSleep)
+                sleeping = true;
+        }
+        else
+        {
+            numSilentSamples = 0;
+            numQuietBlocks = 0;
+        }
+    }
+
+    const NodeObjectPtr node;
+    AudioProcessor* const processor;
+
+private:
+    Array <int> audioChannelsToUse;
+    Array <int> midiChannelsToUse;
+    HeapBlock <float*> channels;
+    AudioSampleBuffer audio;
+    std::unique_ptr<MidiPipe> pipe;
+    int totalChans, numAudioIns, numAudioOuts;
+    int midiBufferToUse;
+    bool lastMute = false;
+    MidiTranspose transpose;
+    MidiBuffer tempMidi;
+
+    static constexpr float silenceThreshold = 1.0e-5f;
+    uint8* silentChannels = nullptr;
+    static constexpr int quietBlocksBeforeSleep = 8;
+    int samplesBeforeSleep = -1;
+    int numSilentSamples = 0;
+    int numQuietBlocks = 0;
+    bool sleeping = false;
+    bool checkOutputSilence = false;
+
+    bool isInputSilent() const noexcept
+    {
+        for (int i = 0; i < numAudioIns; ++i)
+            if (silentChannels[audioChannelsToUse.getUnchecked (i)] == 0)
+                return false;
+
+        for (int i = 0; i < pipe->getNumBuffers(); ++i)
+            if (! pipe->getReadBuffer(i)->isEmpty())
+                return false;
+
+        return true;
+    }
+
+    void renderAsleep (AudioSampleBuffer& buffer) noexcept
+    {
+        for (int i = 0; i < numAudioOuts; ++i)
+        {
+            const int channel = audioChannelsToUse.getUnchecked (i);
+            if (silentChannels[channel] == 0)
+            {
+                buffer.clear (i, 0, buffer.getNumSamples());
+                silentChannels[channel] = 1;
+            }
+        }
+
+        if (node->isMetering())
+        {
+            auto& inputMeter = node->getInputMeter();
+            for (int i = 0; i < numAudioIns; ++i)
+                inputMeter.write (i, MeterBuffer::Level());
+            inputMeter.commit();
+
+            auto& outputMeter = node->getOutputMeter();
+            for (int i = 0; i < numAudioOuts; ++i)
+                outputMeter.write (i, MeterBuffer::Level());
+            outputMeter.commit();
+        }
+    }
+
+    void processNode (AudioSampleBuffer& buffer, MidiPipe& midiPipe, bool isSuspended)
+    {
+        if (node->wantsMidiPipe())
+        {
+            if (! node->isSuspended())
+                node->render (buffer, midiPipe);
+            else
+                node->renderBypassed (buffer, midiPipe);
+        }
+        else
+        {
+            if (! isSuspended)
+            {
+                processor->processBlock (buffer, *midiPipe.getWriteBuffer (0));
+            }
+            else
+            {
+                processor->processBlockBypassed (buffer, *midiPipe.getWriteBuffer (0));
+            }
+        }
+    }
+
+    /** Scales event times in place. The order can't change since every
+        event is scaled the same */
+    static void scaleMidiTimes (MidiBuffer& midi, int multiplier, int divisor) noexcept
+    {
+        // stored as an int32 time, a uint16 size, then the message bytes
+        auto* d = midi.data.begin();
+        auto* const end = midi.data.end();
+        while (d < end)
+        {
+            int32 time; uint16 size;
+            std::memcpy (&time, d, sizeof (time));
+            std::memcpy (&size, d + sizeof (time), sizeof (size));
+            time = time * multiplier / divisor;
+            std::memcpy (d, &time, sizeof (time));
+            d += sizeof (time) + sizeof (size) + size;
+        }
+    }
+
+    void renderSegment (AudioSampleBuffer& buffer, MidiPipe& midiPipe)
+    {
+        // the node is being prepared again for new oversampling
+        const ScopedTryLock sl (node->renderLock);
+        if (! sl.isLocked())
+        {
+            buffer.clear();
+            return;
+        }
+
+        // only exists when the node was prepared with a factor above 1
+        if (auto* const osProcessor = node->getOversamplingProcessor())
         {
-            auto osProcessor = node->getOversamplingProcessor();
+            const auto osFactor = static_cast<int> (osProcessor->getOversamplingFactor());
 
             dsp::AudioBlock<float> block (buffer);
             dsp::AudioBlock<float> osBlock = osProcessor->processSamplesUp (block);
@@ -381,98 +782,516 @@ public:
                 buffer.getNumChannels(),
                 static_cast<int> (osBlock.getNumSamples()));
             
-            tempMidi.clear();
             for (int i = 0; i < midiPipe.getNumBuffers(); ++i)
-            {
-                auto& mb = *midiPipe.getWriteBuffer (i);
-                for (const auto& msg : mb) 
-                {
-                    tempMidi.addEvent (
-                        msg.data, 
-                        msg.numBytes, 
-                        msg.samplePosition * osFactor
-                    );
-                }
-                mb.swapWith (tempMidi);
-                tempMidi.clear();
-            }
+                scaleMidiTimes (*midiPipe.getWriteBuffer (i), osFactor, 1);
 
-            pluginProcessBlock (osBuffer, midiPipe, node->isSuspended());
+            processNode (osBuffer, midiPipe, node->isSuspended());
             osProcessor->processSamplesDown (block);
 
-            tempMidi.clear();
             for (int i = 0; i < midiPipe.getNumBuffers(); ++i)
-            {
-                auto& mb = *midiPipe.getWriteBuffer (i);
-                for (const auto& msg : mb)
-                {
-                    tempMidi.addEvent (
-                        msg.data,
-                        msg.numBytes,
-                        msg.samplePosition / osFactor
-                    );
-                }
-                mb.swapWith (tempMidi);
-                tempMidi.clear();
-            }
+                scaleMidiTimes (*midiPipe.getWriteBuffer (i), 1, osFactor);
         }
         else
         {
-            pluginProcessBlock (buffer, midiPipe, node->isSuspended());
+            processNode (buffer, midiPipe, node->isSuspended());
         }
         
-        if (muted && !muteInput)
+    }
+
+    void collectParameterEvents (const int numSamples) noexcept
+    {
+        // sorted by frame, events at the same frame stay in queued order
+        numEvents = nextEvent = 0;
+        const int capacity = node->parameterEvents.getCapacity();
+        ParameterEventQueue::Event event;
+        while (numEvents < capacity && node->parameterEvents.pop (event))
         {
-            if (lastMute != muted)
+            event.frame = jlimit (0, numSamples - 1, event.frame);
+            int i = numEvents++;
+            for (; i > 0 && events[i - 1].frame > event.frame; --i)
+                events[i] = events[i - 1];
+            events[i] = event;
+        }
+    }
+
+    void applyParameterEvents (const int end) noexcept
+    {
+        for (; nextEvent < end; ++nextEvent)
+        {
+            const auto& event = events[nextEvent];
+            if (! isPositiveAndBelow (event.parameter, params.size()))
+                continue;
+
+            // listeners are told on the message thread
+            params.getObjectPointerUnchecked (event.parameter)->setValue (event.value);
+            node->postParameterChange (event);
+        }
+
+        if (nextEvent >= numEvents)
+            numEvents = nextEvent = 0;
+    }
+
+    /** Renders the block in pieces, applying each parameter event right
+        before the sample it was timed for. Pieces are kept at least
+        minSegmentSize long, later events are moved up to the next split. */
+    void renderSplit (AudioSampleBuffer& buffer, MidiPipe& midiPipe, const int numSamples)
+    {
+        const int numBuffers = midiPipe.getNumBuffers();
+        for (int i = 0; i < numBuffers; ++i)
+        {
+            auto* const midi = blockMidi.getUnchecked (i);
+            midi->clear();
+            midi->swapWith (*midiPipe.getWriteBuffer (i));
+        }
+
+        MidiPipe segmentPipe (segmentMidi.getRawDataPointer(), numBuffers);
+        int start = 0;
+
+        while (start < numSamples)
+        {
+            int split = nextEvent;
+            while (split < numEvents && events[split].frame <= start)
+                ++split;
+            applyParameterEvents (split);
+
+            int end = numEvents > 0 ? events[nextEvent].frame : numSamples;
+            end = jmin (numSamples, jmax (end, start + minSegmentSize));
+            const int length = end - start;
+
+            for (int ch = 0; ch < totalChans; ++ch)
+                segmentChannels[ch] = channels[ch] + start;
+            segment.setDataToReferTo (segmentChannels.getData(), totalChans, length);
+
+            for (int i = 0; i < numBuffers; ++i)
             {
-                // just became muted
-                buffer.applyGainRamp (0, numSamples, node->getLastGain(), 0.0);
+                auto* const midi = segmentMidi.getUnchecked (i);
+                midi->clear();
+                midi->addEvents (*blockMidi.getUnchecked (i), start, length, -start);
             }
-            else
+
+            renderSegment (segment, segmentPipe);
+
+            for (int i = 0; i < numBuffers; ++i)
+                midiPipe.getWriteBuffer (i)->addEvents (*segmentMidi.getUnchecked (i), 0, -1, start);
+
+            start = end;
+        }
+
+        applyParameterEvents (numEvents);
+        for (auto* const midi : blockMidi)
+            midi->clear();
+    }
+
+    std::unique_ptr<float*> osChans;
+    int osChanSize = 0;
+
+    static constexpr int minSegmentSize = 16;
+    bool splitBlocks = false;
+    HeapBlock<ParameterEventQueue::Event> events;
+    int numEvents = 0, nextEvent = 0;
+    ParameterArray params;
+    HeapBlock<float*> segmentChannels;
+    AudioSampleBuffer segment;
+    OwnedArray<MidiBuffer> blockMidi, segmentMidi;
+
+    JUCE_DECLARE_NON_COPYABLE (ProcessBufferOp)
+};
+
+
+/** The flat form of a rendering sequence. Ops are compiled to a contiguous
+    array of instructions with their buffers resolved, and common patterns
+    like clear+add or copy+delay are fused into a single pass. */
+class RenderProgram
+{
+public:
+    RenderProgram() { }
+
+    /** Compiles the ops. Nothing is fused across a barrier, which is an op
+        index where a parallel job starts */
+    void compile (const Array<void*>& ops, AudioSampleBuffer& audio,
+                  const OwnedArray<MidiBuffer>& midi, const Array<int>& barriers)
+    {
+        audioBuffers = &audio;
+        midiBuffers  = &midi;
+
+        // buffers start out zeroed
+        silentChannels.calloc ((size_t) jmax (1, audio.getNumChannels()));
+        memset (silentChannels.getData(), 1, (size_t) jmax (1, audio.getNumChannels()));
+
+        instructions.clearQuick();
+        instructions.ensureStorageAllocated (ops.size());
+        opStarts.clearQuick();
+        opStarts.ensureStorageAllocated (ops.size() + 1);
+
+        for (int i = 0; i < ops.size(); ++i)
+        {
+            auto* const task = static_cast<Task*> (ops.getUnchecked (i));
+            task->resolve (audio, midi, silentChannels.getData());
+            const auto next = task->compile (audio, midi);
+
+            opStarts.add (instructions.size());
+            if (instructions.isEmpty() || barriers.contains (i)
+                || ! fuse (instructions.getReference (instructions.size() - 1), next))
             {
-                // normal mute processing
-                buffer.applyGain (0, numSamples, 0.0);
+                instructions.add (next);
             }
         }
-        else if (!muted && !muteInput && muted != lastMute)
+
+        opStarts.add (instructions.size());
+    }
+
+    /** Returns the first instruction compiled from an op. Ops which were
+        fused into the previous instruction share its index. */
+    int getInstructionIndex (const int opIndex) const   { return opStarts [opIndex]; }
+
+    int size() const noexcept                            { return instructions.size(); }
+
+    void render (const int begin, const int end, const int numSamples) const noexcept
+    {
+        const auto* inst = instructions.begin() + begin;
+        const auto* const last = instructions.begin() + end;
+        uint8* const silent = silentChannels.getData();
+
+        // silence flags follow the audio so nodes can tell when their inputs
+        // are silent without scanning them
+        for (; inst != last; ++inst)
         {
-            // just became unmuted
-            buffer.applyGainRamp (0, numSamples, 0.0, node->getGain());
+            switch (inst->code)
+            {
+                case Instruction::clearAudio:
+                    FloatVectorOperations::clear (inst->dest, numSamples);
+                    silent[inst->destChannel] = 1;
+                    break;
+                case Instruction::copyAudio:
+                    if (silent[inst->sourceChannel] && silent[inst->destChannel])
+                        break;
+                    FloatVectorOperations::copy (inst->dest, inst->source, numSamples);
+                    silent[inst->destChannel] = silent[inst->sourceChannel];
+                    break;
+                case Instruction::addAudio:
+                    if (silent[inst->sourceChannel])
+                        break;
+                    FloatVectorOperations::add (inst->dest, inst->source, numSamples);
+                    silent[inst->destChannel] = 0;
+                    break;
+                case Instruction::mixAudio:
+                    FloatVectorOperations::add (inst->dest, inst->source, inst->source2, numSamples);
+                    silent[inst->destChannel] = silent[inst->sourceChannel] & silent[inst->sourceChannel2];
+                    break;
+                case Instruction::delayAudio:
+                    silent[inst->destChannel] = static_cast<DelayChannelOp*> (inst->task)->process (
+                        inst->source, inst->dest, numSamples, silent[inst->sourceChannel] != 0) ? 1 : 0;
+                    break;
+                case Instruction::clearMidi:
+                    inst->midiDest->clear();
+                    break;
+                case Instruction::copyMidi:
+                    *inst->midiDest = *inst->midiSource;
+                    break;
+                case Instruction::addMidi:
+                    inst->midiDest->addEvents (*inst->midiSource, 0, numSamples, 0);
+                    break;
+                case Instruction::performTask:
+                    inst->task->perform (*audioBuffers, *midiBuffers, numSamples);
+                    break;
+            }
         }
-        else if (node->getGain() != node->getLastGain())
+    }
+
+private:
+    Array<Instruction> instructions;
+    Array<int> opStarts;
+    HeapBlock<uint8> silentChannels;
+    AudioSampleBuffer* audioBuffers = nullptr;
+    const OwnedArray<MidiBuffer>* midiBuffers = nullptr;
+
+    static bool fuse (Instruction& last, const Instruction& next) noexcept
+    {
+        if (next.code == Instruction::addAudio && next.dest == last.dest)
         {
-            buffer.applyGainRamp (0, numSamples, node->getLastGain(), node->getGain());
+            if (last.code == Instruction::clearAudio && next.source != last.dest)
+            {
+                last.code = Instruction::copyAudio;
+                last.source = next.source;
+                last.sourceChannel = next.sourceChannel;
+                return true;
+            }
+
+            if (last.code == Instruction::copyAudio && last.source != last.dest && next.source != last.dest)
+            {
+                last.code = Instruction::mixAudio;
+                last.source2 = next.source;
+                last.sourceChannel2 = next.sourceChannel;
+                return true;
+            }
         }
-        else 
+        else if (next.code == Instruction::delayAudio && last.code == Instruction::copyAudio
+                    && next.dest == last.dest)
         {
-            buffer.applyGain (0, numSamples, node->getGain());
+            last.code = Instruction::delayAudio;
+            last.task = next.task;
+            return true;
+        }
+        else if (next.code == Instruction::addMidi && last.code == Instruction::clearMidi
+                    && next.midiDest == last.midiDest)
+        {
+            last.code = Instruction::copyMidi;
+            last.midiSource = next.midiSource;
+            return true;
         }
 
-        node->updateGain();
-        lastMute = muted;
+        return false;
+    }
 
-        for (int i = 0; i < numAudioOuts; ++i)
-            node->setOutputRMS (i, buffer.getRMSLevel (i, 0, numSamples));
+    JUCE_DECLARE_NON_COPYABLE (RenderProgram)
+};
+
+/** A dependency graph of rendering ops which can be performed on several
+    threads at once. Each job is the contiguous range of ops which prepare
+    a node's buffers followed by its ProcessBufferOp. A job becomes ready
+    once every job feeding it has finished. */
+class ParallelPlan : public RenderThreadPool::Work
+{
+public:
+    ParallelPlan() { }
+    ~ParallelPlan() { }
+
+    /** Adds a job. Dependencies are indexes of jobs added before this one */
+    void addJob (const int opsBegin, const int opsEnd, const Array<int>& dependencies)
+    {
+        auto* const job = jobs.add (new Job());
+        job->opsBegin = opsBegin;
+        job->opsEnd = opsEnd;
+
+        for (const auto dep : dependencies)
+        {
+            jassert (isPositiveAndBelow (dep, jobs.size() - 1));
+            if (jobs[dep]->dependents.addIfNotAlreadyThere (jobs.size() - 1))
+                ++job->numDependencies;
+        }
     }
 
-    const NodeObjectPtr node;
-    AudioProcessor* const processor;
+    /** Returns the op indexes where jobs start. Ops must not be fused across these */
+    Array<int> getJobStarts() const
+    {
+        Array<int> starts;
+        for (const auto* const job : jobs)
+            starts.add (job->opsBegin);
+        return starts;
+    }
+
+    /** Call this once all jobs have been added and the ops are compiled.
+        Job ranges are converted from ops to program instructions. */
+    void finalize (const RenderProgram& compiled)
+    {
+        program = &compiled;
+        for (auto* const job : jobs)
+        {
+            job->opsBegin = program->getInstructionIndex (job->opsBegin);
+            job->opsEnd   = program->getInstructionIndex (job->opsEnd);
+        }
+
+        const auto numJobs = static_cast<size_t> (jmax (1, jobs.size()));
+        pending.reset (new std::atomic<int> [numJobs]);
+        readyJobs.reset (new std::atomic<int> [numJobs]);
+    }
+
+    int getNumJobs() const noexcept { return jobs.size(); }
+
+    /** Resets the job counters for a new block. Call before dispatching */
+    void begin (const int nframes) noexcept
+    {
+        numSamples = nframes;
+
+        readyHead.store (0);
+        readyTail.store (0);
+        remaining.store (jobs.size());
+
+        for (int i = 0; i < jobs.size(); ++i)
+        {
+            pending[i].store (jobs.getUnchecked(i)->numDependencies);
+            readyJobs[i].store (-1);
+        }
+
+        for (int i = 0; i < jobs.size(); ++i)
+            if (jobs.getUnchecked(i)->numDependencies == 0)
+                pushReadyJob (i);
+    }
+
+    bool performNextJob() noexcept override
+    {
+        for (;;)
+        {
+            int head = readyHead.load();
+            if (head >= readyTail.load())
+                return false;
+
+            if (readyHead.compare_exchange_weak (head, head + 1))
+            {
+                int index = -1;
+                while ((index = readyJobs[head].load()) < 0)
+                    RenderThreadPool::pause();
+                performJob (index);
+                return true;
+            }
+        }
+    }
+
+    bool isFinished() const noexcept override
+    {
+        return remaining.load() <= 0;
+    }
 
 private:
-    Array <int> audioChannelsToUse;
-    Array <int> midiChannelsToUse;
-    HeapBlock <float*> channels;
-    int totalChans, numAudioIns, numAudioOuts;
-    int midiBufferToUse;
-    bool lastMute = false;
-    MidiTranspose transpose;
-    MidiBuffer tempMidi;
+    struct Job
+    {
+        int opsBegin = 0;
+        int opsEnd = 0;
+        int numDependencies = 0;
+        Array<int> dependents;
+    };
+
+    OwnedArray<Job> jobs;
+    const RenderProgram* program = nullptr;
+    std::unique_ptr<std::atomic<int>[]> pending;
+    std::unique_ptr<std::atomic<int>[]> readyJobs;
+    std::atomic<int> readyHead { 0 };
+    std::atomic<int> readyTail { 0 };
+    std::atomic<int> remaining { 0 };
+
+    int numSamples = 0;
+
+    void pushReadyJob (const int index) noexcept
+    {
+        // every job is pushed exactly once per block, so the slots never wrap
+        readyJobs[readyTail.fetch_add (1)].store (index);
+    }
 
-    std::unique_ptr<float*> osChans;
-    int osChanSize = 0;
-    JUCE_DECLARE_NON_COPYABLE (ProcessBufferOp)
+    void performJob (const int index) noexcept
+    {
+        const auto* const job = jobs.getUnchecked (index);
+        program->render (job->opsBegin, job->opsEnd, numSamples);
+
+        for (const auto dependent : job->dependents)
+            if (--pending[dependent] == 0)
+                pushReadyJob (dependent);
+
+        --remaining;
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (ParallelPlan)
 };
 
+/** A delay op and the connections it compensates. These are kept with the
+    sequence, so delays can follow latency changes without a rebuild. */
+struct DelayPoint
+{
+    DelayOp* op = nullptr;
+    uint32 sourceNode = 0;
+    Array<uint32> destNodes;
+};
+
+/** Works out how much each connection needs delaying so a node's inputs line
+    up with the latest one. Nodes are visited in render order. Sources which
+    haven't rendered yet are feedback loops which read silence, so they're
+    never delayed. */
+class LatencyPlan
+{
+public:
+    LatencyPlan() { }
+
+    void compute (const GraphProcessor& graph, const Array<void*>& orderedNodes)
+    {
+        nodeDelays.clear();
+        connectionDelays.clear();
+        totalLatency = 0;
+
+        std::unordered_map<uint32, Array<const GraphProcessor::Connection*>> inputs;
+        for (int i = 0; i < graph.getNumConnections(); ++i)
+        {
+            const auto* const c = graph.getConnection (i);
+            inputs[c->destNode].add (c);
+        }
+
+        for (auto* const ptr : orderedNodes)
+        {
+            auto* const node = (NodeObject*) ptr;
+            if (! isRendered (node))
+                continue;
+
+            const auto& nodeInputs = inputs[node->nodeId];
+            int inputLatency = 0;
+            for (const auto* const c : nodeInputs)
+                inputLatency = jmax (inputLatency, getNodeDelay (c->sourceNode));
+
+            for (const auto* const c : nodeInputs)
+            {
+                const auto source = nodeDelays.find (c->sourceNode);
+                if (source == nodeDelays.end() || source->second >= inputLatency)
+                    continue;
+
+                const PortType type (node->getPortType (c->destPort));
+                if (type == PortType::Audio || type == PortType::Midi)
+                    connectionDelays[key (c->sourceNode, node->nodeId)] = inputLatency - source->second;
+            }
+
+            nodeDelays[node->nodeId] = inputLatency + node->getLatencySamples();
+
+            if (node->isAudioIONode() && node->getNumPorts (PortType::Audio, false) == 0)
+                totalLatency = inputLatency;
+        }
+    }
+
+    /** Returns the delay needed on connections from source to dest */
+    int getDelay (const uint32 sourceNode, const uint32 destNode) const
+    {
+        const auto iter = connectionDelays.find (key (sourceNode, destNode));
+        return iter != connectionDelays.end() ? iter->second : 0;
+    }
+
+    /** Returns the latency of the graph's audio output */
+    int getTotalLatency() const noexcept { return totalLatency; }
+
+    /** Returns true if every delayed connection has one of the given keys */
+    bool isCoveredBy (const std::unordered_set<uint64>& delayed) const
+    {
+        for (const auto& iter : connectionDelays)
+            if (delayed.find (iter.first) == delayed.end())
+                return false;
+        return true;
+    }
+
+    static uint64 key (const uint32 sourceNode, const uint32 destNode) noexcept
+    {
+        return (static_cast<uint64> (sourceNode) << 32) | static_cast<uint64> (destNode);
+    }
+
+    /** IO nodes without audio to process are left out of the sequence */
+    static bool isRendered (NodeObject* const node)
+    {
+        typedef GraphProcessor::AudioGraphIOProcessor IOProc;
+        if (auto* const ioproc = dynamic_cast<IOProc*> (node->getAudioProcessor()))
+        {
+            if (IOProc::audioInputNode == ioproc->getType() && node->getNumPorts (PortType::Audio, false) <= 0)
+                return false;
+            if (IOProc::audioOutputNode == ioproc->getType() && node->getNumPorts (PortType::Audio, true) <= 0)
+                return false;
+        }
+
+        return true;
+    }
+
+private:
+    std::unordered_map<uint32, int> nodeDelays;
+    std::unordered_map<uint64, int> connectionDelays;
+    int totalLatency = 0;
+
+    int getNodeDelay (const uint32 nodeID) const
+    {
+        const auto iter = nodeDelays.find (nodeID);
+        return iter != nodeDelays.end() ? iter->second : 0;
+    }
+};
 
 /** Used to calculate the correct sequence of rendering ops needed, based on
     the best re-use of shared buffers at each stage. */
@@ -481,10 +1300,14 @@ class ProcessorGraphBuilder
 public:
     ProcessorGraphBuilder (GraphProcessor& graph_, 
                            const Array<void*>& orderedNodes_,
-                           Array<void*>& renderingOps)
+                           Array<void*>& renderingOps,
+                           std::vector<DelayPoint>& delays_,
+                           ParallelPlan* plan_ = nullptr)
         : graph (graph_),
           orderedNodes (orderedNodes_),
-          totalLatency (0)
+          delays (delays_),
+          plan (plan_),
+          blockSize (graph_.getBlockSize() > 0 ? graph_.getBlockSize() : 512)
     {
         for (int i = 0; i < PortType::Unknown; ++i)
         {
@@ -492,14 +1315,29 @@ public:
             allPorts[i].add (KV_INVALID_PORT);
         }
 
+        latency.compute (graph, orderedNodes);
+        buildConnectionTables();
+
         for (int i = 0; i < orderedNodes.size(); ++i)
         {
-            createRenderingOpsForNode ((NodeObject*) orderedNodes.getUnchecked (i),
-                                       renderingOps, i);
-            markUnusedBuffersFree (i);
+            auto* const node = (NodeObject*) orderedNodes.getUnchecked (i);
+            const int opsBegin = renderingOps.size();
+            createRenderingOpsForNode (node, renderingOps, i);
+
+            if (plan != nullptr)
+            {
+                // buffers are never recycled when rendering in parallel, this
+                // way concurrent branches can't write to each others' buffers
+                if (renderingOps.size() > opsBegin)
+                    addJobForNode (node, opsBegin, renderingOps.size());
+            }
+            else
+            {
+                markUnusedBuffersFree (i);
+            }
         }
 
-        graph.setLatencySamples (totalLatency);
+        graph.setLatencySamples (latency.getTotalLatency());
     }
 
     int32 buffersNeeded (PortType type)     { return allNodes[type.id()].size(); }
@@ -508,67 +1346,89 @@ private:
     //==============================================================================
     GraphProcessor& graph;
     const Array<void*>& orderedNodes;
+    std::vector<DelayPoint>& delays;
+    ParallelPlan* const plan;
+    const int blockSize;
+    Array <uint32> jobNodes;
     Array <uint32> allNodes [PortType::Unknown];
     Array <uint32> allPorts [PortType::Unknown];
 
-    enum { freeNodeID = 0xffffffff, zeroNodeID = 0xfffffffe, anonymousNodeID = 0xfffffffd };
+    enum { freeNodeID = 0xffffffff, zeroNodeID = 0xfffffffe, anonymousNodeID = 0xfffffffd,
+           delayTapNodeID = 0xfffffffc };
 
     static bool isNodeBusy (uint32 nodeID) noexcept { return nodeID != freeNodeID && nodeID != zeroNodeID; }
 
-    Array <uint32> nodeDelayIDs;
-    Array <int> nodeDelays;
-    int totalLatency;
+    LatencyPlan latency;
 
-    int getNodeDelay (const uint32 nodeID) const          { return nodeDelays [nodeDelayIDs.indexOf (nodeID)]; }
-
-    void setNodeDelay (const uint32 nodeID, const int latency)
+    /** A source delayed once for every consumer which needs the same delay.
+        Its buffer is marked with delayTapNodeID and the tap's index */
+    struct DelayTap
+    {
+        uint32 sourceNode, sourcePort;
+        int delay;
+        int buffer;
+        int job;            // the job writing it when rendering in parallel
+        size_t delayPoint;
+    };
+
+    std::vector<DelayTap> taps;
+    std::map<std::pair<uint64, int>, int> tapUses;
+    Array<int> tapDependencies;
+
+    /** A rendering step which reads from a node's output port */
+    struct PortUse
     {
-        const int index = nodeDelayIDs.indexOf (nodeID);
+        int step;
+        uint32 port;
+    };
 
-        if (index >= 0)
-        {
-            nodeDelays.set (index, latency);
-        }
-        else
-        {
-            nodeDelayIDs.add (nodeID);
-            nodeDelays.add (latency);
-        }
+    // connections indexed by destination node, and the steps reading each
+    // output port. These keep the builder linear in the number of connections.
+    std::unordered_map<uint32, Array<const GraphProcessor::Connection*>> inputConnections;
+    std::unordered_map<uint64, Array<PortUse>> outputUses;
+    const Array<const GraphProcessor::Connection*> noConnections;
+
+    static uint64 portKey (const uint32 nodeId, const uint32 port) noexcept
+    {
+        return (static_cast<uint64> (nodeId) << 32) | static_cast<uint64> (port);
     }
 
-    int getInputLatency (const uint32 nodeID) const
+    void buildConnectionTables()
     {
-        int maxLatency = 0;
+        std::unordered_map<uint32, int> steps;
+        for (int i = 0; i < orderedNodes.size(); ++i)
+            steps[((const NodeObject*) orderedNodes.getUnchecked (i))->nodeId] = i;
 
-        for (int i = graph.getNumConnections(); --i >= 0;)
+        for (int i = 0; i < graph.getNumConnections(); ++i)
         {
             const auto* const c = graph.getConnection (i);
-            if (c->destNode == nodeID)
-                maxLatency = jmax (maxLatency, getNodeDelay (c->sourceNode));
+            inputConnections[c->destNode].add (c);
+
+            const auto step = steps.find (c->destNode);
+            if (step != steps.end())
+                outputUses[portKey (c->sourceNode, c->sourcePort)].add ({ step->second, c->destPort });
+
+            const int delay = latency.getDelay (c->sourceNode, c->destNode);
+            if (delay > 0)
+                ++tapUses[{ portKey (c->sourceNode, c->sourcePort), delay }];
         }
+    }
 
-        return maxLatency;
+    const Array<const GraphProcessor::Connection*>& getInputConnections (const uint32 nodeID) const
+    {
+        const auto iter = inputConnections.find (nodeID);
+        return iter != inputConnections.end() ? iter->second : noConnections;
     }
 
     void createRenderingOpsForNode (NodeObject* const node, Array<void*>& renderingOps,
                                     const int ourRenderingIndex)
     {
-        AudioProcessor* const proc (node->getAudioProcessor());
-
         // don't add IONodes that cannot process
-        typedef GraphProcessor::AudioGraphIOProcessor IOProc;
-        if (IOProc* ioproc = dynamic_cast<IOProc*> (proc))
-        {
-            const uint32 numOuts = node->getNumPorts (PortType::Audio, false);
-            if (IOProc::audioInputNode == ioproc->getType() && numOuts <= 0)
-                return;
-            const uint32 numIns = node->getNumPorts (PortType::Audio, true);
-            if (IOProc::audioOutputNode == ioproc->getType() && numIns <= 0)
-                return;
-        }
-        
+        if (! LatencyPlan::isRendered (node))
+            return;
+
         Array <int> channelsToUse [PortType::Unknown];
-        int maxLatency = getInputLatency (node->nodeId);
+        tapDependencies.clearQuick();
 
         const uint32 numPorts (node->getNumPorts());
         for (uint32 port = 0; port < numPorts; ++port)
@@ -607,11 +1467,12 @@ private:
             // get a list of all the inputs to this node
             Array <uint32> sourceNodes;
             Array <uint32> sourcePorts;
-            for (int i = graph.getNumConnections(); --i >= 0;)
+            const auto& inputs = getInputConnections (node->nodeId);
+            for (int i = inputs.size(); --i >= 0;)
             {
-                const GraphProcessor::Connection* const c = graph.getConnection (i);
+                const GraphProcessor::Connection* const c = inputs.getUnchecked (i);
 
-                if (c->destNode == node->nodeId && c->destPort == port)
+                if (c->destPort == port)
                 {
                     sourceNodes.add (c->sourceNode);
                     sourcePorts.add (c->sourcePort);
@@ -630,17 +1491,7 @@ private:
                 else
                 {
                     bufIndex = getFreeBuffer (portType);
-                    switch (portType.id())
-                    {
-                        case PortType::Audio:
-                            renderingOps.add (new ClearChannelOp (bufIndex));
-                            break;
-                        case PortType::Midi:
-                            renderingOps.add (new ClearMidiBufferOp (bufIndex));
-                            break;
-                        default:
-                            break;
-                    }
+                    renderingOps.add (createClearOp (portType, bufIndex));
                 }
             }
             else if (sourceNodes.size() == 1)
@@ -650,6 +1501,10 @@ private:
                 const uint32 srcPort = sourcePorts.getUnchecked (0);
 
                 bufIndex = getBufferContaining (portType, srcNode, srcPort);
+                const int delay = bufIndex >= 0 ? latency.getDelay (srcNode, node->nodeId) : 0;
+
+                // the node writes its output over this input
+                const bool writesInPlace = inputChan < (int) numOuts || portType == PortType::Midi;
 
                 if (bufIndex < 0)
                 {
@@ -657,62 +1512,68 @@ private:
                     bufIndex = getReadOnlyEmptyBuffer();
                     jassert (bufIndex >= 0);
                 }
-                
-                const bool bufNeededLater = isBufferNeededLater (ourRenderingIndex, port, srcNode, srcPort);
-                if (bufNeededLater && (inputChan < (int) numOuts || portType == PortType::Midi))
+
+                if (shouldUseTap (srcNode, srcPort, delay))
                 {
-                    // can't mess up this channel because it's needed later by another node, so we
-                    // need to use a copy of it..
-                    const int newFreeBuffer = getFreeBuffer (portType);
+                    // other consumers need the same delay, so read from a shared tap
+                    bufIndex = getDelayTap (renderingOps, portType, srcNode, srcPort, bufIndex,
+                                            node->nodeId, delay);
 
-                    switch (portType.id())
+                    if (writesInPlace)
                     {
-                        case PortType::Audio:
-                            renderingOps.add (new CopyChannelOp (bufIndex, newFreeBuffer));
-                            break;
-                        case PortType::Midi:
-                            renderingOps.add (new CopyMidiBufferOp (bufIndex, newFreeBuffer));
-                            break;
-                        default:
-                            break;
+                        const int newFreeBuffer = getScratchBuffer (portType);
+                        renderingOps.add (createCopyOp (portType, bufIndex, newFreeBuffer));
+                        bufIndex = newFreeBuffer;
                     }
-
-                    bufIndex = newFreeBuffer;
                 }
+                else
+                {
+                    if ((writesInPlace || delay > 0)
+                         && isBufferNeededLater (ourRenderingIndex, port, srcNode, srcPort))
+                    {
+                        // can't mess up this channel because it's needed later by another node, so we
+                        // need to use a copy of it..
+                        const int newFreeBuffer = getScratchBuffer (portType);
+                        renderingOps.add (createCopyOp (portType, bufIndex, newFreeBuffer));
+                        bufIndex = newFreeBuffer;
+                    }
 
-                const int nodeDelay = getNodeDelay (srcNode);
-
-                if (nodeDelay < maxLatency)
-                    renderingOps.add (new DelayChannelOp (bufIndex, maxLatency - nodeDelay));
+                    if (delay > 0)
+                        addDelayOp (renderingOps, portType, bufIndex, srcNode, node->nodeId, delay);
+                }
             }
             else
             {
                 // channel with a mix of several inputs..
-                // try to find a re-usable channel from our inputs..
+                Array<int> sourceBuffers, sourceDelays;
+                for (int i = 0; i < sourceNodes.size(); ++i)
+                {
+                    const int sourceBufIndex = getBufferContaining (portType, sourceNodes.getUnchecked (i),
+                                                                              sourcePorts.getUnchecked (i));
+                    sourceBuffers.add (sourceBufIndex);
+                    sourceDelays.add (sourceBufIndex >= 0 ? latency.getDelay (sourceNodes.getUnchecked (i), node->nodeId) : 0);
+                }
+
+                // try to find a re-usable channel from our inputs. Ones read
+                // through a shared tap are left alone..
                 int reusableInputIndex = -1;
 
                 for (int i = 0; i < sourceNodes.size(); ++i)
                 {
-                    const int sourceBufIndex = getBufferContaining (portType, sourceNodes.getUnchecked(i),
-                                                                              sourcePorts.getUnchecked(i));
-
-                    if (sourceBufIndex >= 0
-                        && ! isBufferNeededLater (ourRenderingIndex,
-                                                  inputChan,
+                    if (sourceBuffers.getUnchecked (i) >= 0
+                        && ! shouldUseTap (sourceNodes.getUnchecked (i), sourcePorts.getUnchecked (i),
+                                           sourceDelays.getUnchecked (i))
+                        && ! isBufferNeededLater (ourRenderingIndex, port,
                                                   sourceNodes.getUnchecked(i),
                                                   sourcePorts.getUnchecked(i)))
                     {
                         // we've found one of our input chans that can be re-used..
                         reusableInputIndex = i;
-                        bufIndex = sourceBufIndex;
-
-                        if (portType == PortType::Audio)
-                        {
-                            const int nodeDelay = getNodeDelay (sourceNodes.getUnchecked (i));
-                            if (nodeDelay < maxLatency)
-                                renderingOps.add (new DelayChannelOp (sourceBufIndex, maxLatency - nodeDelay));
-                        }
+                        bufIndex = sourceBuffers.getUnchecked (i);
 
+                        if (sourceDelays.getUnchecked (i) > 0)
+                            addDelayOp (renderingOps, portType, bufIndex, sourceNodes.getUnchecked (i),
+                                        node->nodeId, sourceDelays.getUnchecked (i));
                         break;
                     }
                 }
@@ -720,76 +1581,64 @@ private:
                 if (reusableInputIndex < 0)
                 {
                     // can't re-use any of our input chans, so get a new one and copy everything into it..
-                    bufIndex = getFreeBuffer (portType);
+                    bufIndex = getScratchBuffer (portType);
                     jassert (bufIndex != 0);
-                    
-                    markBufferAsContaining (bufIndex, portType, anonymousNodeID, 0);
-                    
-                    const int srcIndex = getBufferContaining (portType, sourceNodes.getUnchecked (0),
-                                                                        sourcePorts.getUnchecked (0));
+
+                    const int srcIndex = sourceBuffers.getFirst();
+                    const int delay = sourceDelays.getFirst();
+
                     if (srcIndex < 0)
                     {
                         // if not found, this is probably a feedback loop
-                        if (portType == PortType::Audio)
-                            renderingOps.add (new ClearChannelOp (bufIndex));
-                        else if (portType == PortType::Midi)
-                            renderingOps.add (new ClearMidiBufferOp (bufIndex));
+                        renderingOps.add (createClearOp (portType, bufIndex));
+                    }
+                    else if (shouldUseTap (sourceNodes.getFirst(), sourcePorts.getFirst(), delay))
+                    {
+                        renderingOps.add (createCopyOp (portType,
+                            getDelayTap (renderingOps, portType, sourceNodes.getFirst(), sourcePorts.getFirst(),
+                                         srcIndex, node->nodeId, delay),
+                            bufIndex));
                     }
                     else
                     {
-                        if (portType == PortType::Audio)
-                            renderingOps.add (new CopyChannelOp (srcIndex, bufIndex));
-                        else if (portType == PortType::Midi)
-                            renderingOps.add (new CopyMidiBufferOp (srcIndex, bufIndex));
+                        renderingOps.add (createCopyOp (portType, srcIndex, bufIndex));
+                        if (delay > 0)
+                            addDelayOp (renderingOps, portType, bufIndex, sourceNodes.getFirst(),
+                                        node->nodeId, delay);
                     }
 
                     reusableInputIndex = 0;
-
-                    if (portType == PortType::Audio)
-                    {
-                        const int nodeDelay = getNodeDelay (sourceNodes.getFirst());
-                        if (nodeDelay < maxLatency)
-                            renderingOps.add (new DelayChannelOp (bufIndex, maxLatency - nodeDelay));
-                    }
                 }
 
                 for (int j = 0; j < sourceNodes.size(); ++j)
                 {
-                    if (j != reusableInputIndex)
+                    int srcIndex = sourceBuffers.getUnchecked (j);
+                    if (j == reusableInputIndex || srcIndex < 0)
+                        continue;
+
+                    const uint32 srcNode = sourceNodes.getUnchecked (j);
+                    const uint32 srcPort = sourcePorts.getUnchecked (j);
+                    const int delay = sourceDelays.getUnchecked (j);
+
+                    if (shouldUseTap (srcNode, srcPort, delay))
                     {
-                        int srcIndex = getBufferContaining (portType, sourceNodes.getUnchecked(j),
-                                                                      sourcePorts.getUnchecked(j));
-                        if (srcIndex >= 0)
+                        srcIndex = getDelayTap (renderingOps, portType, srcNode, srcPort, srcIndex,
+                                                node->nodeId, delay);
+                    }
+                    else if (delay > 0)
+                    {
+                        if (isBufferNeededLater (ourRenderingIndex, port, srcNode, srcPort))
                         {
-                            if (portType == PortType::Audio)
-                            {
-                                const int nodeDelay = getNodeDelay (sourceNodes.getUnchecked (j));
-
-                                if (nodeDelay < maxLatency)
-                                {
-                                    if (! isBufferNeededLater (ourRenderingIndex, port,
-                                                               sourceNodes.getUnchecked(j),
-                                                               sourcePorts.getUnchecked(j)))
-                                    {
-                                        renderingOps.add (new DelayChannelOp (srcIndex, maxLatency - nodeDelay));
-                                    }
-                                    else // buffer is reused elsewhere, can't be delayed
-                                    {
-                                        const int bufferToDelay = getFreeBuffer (PortType::Audio);
-                                        renderingOps.add (new CopyChannelOp (srcIndex, bufferToDelay));
-                                        renderingOps.add (new DelayChannelOp (bufferToDelay, maxLatency - nodeDelay));
-                                        srcIndex = bufferToDelay;
-                                    }
-                                }
-
-                                renderingOps.add (new AddChannelOp (srcIndex, bufIndex));
-                            }
-                            else if (portType == PortType::Midi)
-                            {
-                                renderingOps.add (new AddMidiBufferOp (srcIndex, bufIndex));
-                            }
+                            // buffer is reused elsewhere, delay a copy of it
+                            const int bufferToDelay = getScratchBuffer (portType);
+                            renderingOps.add (createCopyOp (portType, srcIndex, bufferToDelay));
+                            srcIndex = bufferToDelay;
                         }
+
+                        addDelayOp (renderingOps, portType, srcIndex, srcNode, node->nodeId, delay);
                     }
+
+                    renderingOps.add (createAddOp (portType, srcIndex, bufIndex));
                 }
             }
 
@@ -803,17 +1652,119 @@ private:
             }
         } /* foreach port */
 
-        setNodeDelay (node->nodeId, maxLatency + node->getLatencySamples());
-        
-        if (node->isAudioIONode() && node->getNumPorts (PortType::Audio, false) == 0)
-            totalLatency = maxLatency;
-
         int totalChans = jmax (node->getNumPorts (PortType::Audio, true),
                                node->getNumPorts (PortType::Audio, false));
         renderingOps.add (new ProcessBufferOp (node, channelsToUse [PortType::Audio],
                                                totalChans, 0, channelsToUse));
     }
 
+    static Task* createClearOp (const PortType type, const int buffer)
+    {
+        if (type == PortType::Midi)
+            return new ClearMidiBufferOp (buffer);
+        return new ClearChannelOp (buffer);
+    }
+
+    static Task* createCopyOp (const PortType type, const int source, const int dest)
+    {
+        if (type == PortType::Midi)
+            return new CopyMidiBufferOp (source, dest);
+        return new CopyChannelOp (source, dest);
+    }
+
+    static Task* createAddOp (const PortType type, const int source, const int dest)
+    {
+        if (type == PortType::Midi)
+            return new AddMidiBufferOp (source, dest);
+        return new AddChannelOp (source, dest);
+    }
+
+    /** Delays a buffer in place by the latency between two nodes */
+    void addDelayOp (Array<void*>& renderingOps, const PortType type, const int buffer,
+                     const uint32 sourceNode, const uint32 destNode, const int delay)
+    {
+        DelayOp* op = nullptr;
+        if (type == PortType::Midi)
+            op = new DelayMidiBufferOp (buffer, delay);
+        else
+            op = new DelayChannelOp (buffer, delay, blockSize);
+        renderingOps.add (op);
+
+        DelayPoint point;
+        point.op = op;
+        point.sourceNode = sourceNode;
+        point.destNodes.add (destNode);
+        delays.push_back (point);
+    }
+
+    /** Returns a free buffer which stays busy until the end of this step */
+    int getScratchBuffer (const PortType type)
+    {
+        const int bufIndex = getFreeBuffer (type);
+        markBufferAsContaining (bufIndex, type, anonymousNodeID, 0);
+        return bufIndex;
+    }
+
+    int findTap (const uint32 sourceNode, const uint32 sourcePort, const int delay) const
+    {
+        for (size_t i = 0; i < taps.size(); ++i)
+        {
+            const auto& tap = taps[i];
+            if (tap.buffer >= 0 && tap.sourceNode == sourceNode
+                && tap.sourcePort == sourcePort && tap.delay == delay)
+                return (int) i;
+        }
+
+        return -1;
+    }
+
+    /** True if the delayed source is read from a tap, either because one
+        exists or because more than one connection needs it */
+    bool shouldUseTap (const uint32 sourceNode, const uint32 sourcePort, const int delay) const
+    {
+        if (delay <= 0)
+            return false;
+        if (findTap (sourceNode, sourcePort, delay) >= 0)
+            return true;
+        const auto uses = tapUses.find ({ portKey (sourceNode, sourcePort), delay });
+        return uses != tapUses.end() && uses->second > 1;
+    }
+
+    /** Returns a buffer holding a source delayed by the given amount. It's
+        shared by every consumer needing the same delay, so nothing may write
+        to it */
+    int getDelayTap (Array<void*>& renderingOps, const PortType type,
+                     const uint32 sourceNode, const uint32 sourcePort, const int sourceBuffer,
+                     const uint32 destNode, const int delay)
+    {
+        const int index = findTap (sourceNode, sourcePort, delay);
+        if (index >= 0)
+        {
+            const auto& tap = taps[(size_t) index];
+            delays[tap.delayPoint].destNodes.addIfNotAlreadyThere (destNode);
+
+            // the job which wrote the tap has to finish first
+            if (isPositiveAndBelow (tap.job, jobNodes.size()))
+                tapDependencies.addIfNotAlreadyThere (tap.job);
+            return tap.buffer;
+        }
+
+        DelayTap tap;
+        tap.sourceNode = sourceNode;
+        tap.sourcePort = sourcePort;
+        tap.delay = delay;
+        tap.buffer = getFreeBuffer (type);
+        tap.job = plan != nullptr ? jobNodes.size() : -1;
+        markBufferAsContaining (tap.buffer, type, delayTapNodeID, (uint32) taps.size());
+
+        renderingOps.add (createCopyOp (type, sourceBuffer, tap.buffer));
+        addDelayOp (renderingOps, type, tap.buffer, sourceNode, destNode, delay);
+        tap.delayPoint = delays.size() - 1;
+
+        taps.push_back (tap);
+        return tap.buffer;
+    }
+
     int getFreeBuffer (PortType type)
     {
         jassert (type.id() < PortType::Unknown);
@@ -854,7 +1805,17 @@ private:
 
             for (int i = 0; i < nodes.size(); ++i)
             {
-                if (isNodeBusy (nodes.getUnchecked (i))
+                if (nodes.getUnchecked (i) == delayTapNodeID)
+                {
+                    // taps live as long as their source does
+                    auto& tap = taps[(size_t) ports.getUnchecked (i)];
+                    if (! isBufferNeededLater (stepIndex, KV_INVALID_PORT, tap.sourceNode, tap.sourcePort))
+                    {
+                        tap.buffer = -1;
+                        nodes.set (i, (uint32) freeNodeID);
+                    }
+                }
+                else if (isNodeBusy (nodes.getUnchecked (i))
                      && ! isBufferNeededLater (stepIndex, KV_INVALID_PORT,
                                                           nodes.getUnchecked(i),
                                                           ports.getUnchecked(i)))
@@ -865,26 +1826,58 @@ private:
         }
     }
 
-    bool isBufferNeededLater (int stepIndexToSearchFrom, uint32 inputChannelOfIndexToIgnore,
-                              const uint32 sourceNode, const uint32 outputPortIndex) const
+    void addJobForNode (NodeObject* const node, const int opsBegin, const int opsEnd)
     {
-        while (stepIndexToSearchFrom < orderedNodes.size())
+        Array<int> dependencies;
+
+        for (const auto* const c : getInputConnections (node->nodeId))
         {
-            const NodeObject* const node = (const NodeObject*) orderedNodes.getUnchecked (stepIndexToSearchFrom);
+            // sources not yet rendered are feedback loops and read silence
+            const int sourceJob = jobNodes.indexOf (c->sourceNode);
+            if (sourceJob >= 0)
+                dependencies.addIfNotAlreadyThere (sourceJob);
+        }
+
+        for (const auto tapJob : tapDependencies)
+            dependencies.addIfNotAlreadyThere (tapJob);
 
+        // IO nodes share the graph's IO buffers, keep them in serial order
+        if (node->isAudioIONode() || node->isMidiIONode())
+        {
+            for (int i = jobNodes.size(); --i >= 0;)
             {
-                for (uint32 port = 0; port < node->getNumPorts(); ++port)
+                if (auto* const other = graph.getNodeForId (jobNodes.getUnchecked (i)))
                 {
-                    if (port != inputChannelOfIndexToIgnore &&
-                          graph.getConnectionBetween (sourceNode, outputPortIndex, node->nodeId, port) != nullptr)
+                    if (other->isAudioIONode() || other->isMidiIONode())
                     {
-                        return true;
+                        dependencies.addIfNotAlreadyThere (i);
+                        break;
                     }
                 }
             }
+        }
+
+        plan->addJob (opsBegin, opsEnd, dependencies);
+        jobNodes.add (node->nodeId);
+    }
+
+    bool isBufferNeededLater (int stepIndexToSearchFrom, uint32 inputChannelOfIndexToIgnore,
+                              const uint32 sourceNode, const uint32 outputPortIndex) const
+    {
+        const auto uses = outputUses.find (portKey (sourceNode, outputPortIndex));
+        if (uses == outputUses.end())
+            return false;
+
+        for (const auto& use : uses->second)
+        {
+            // execution order of branches isn't known when rendering in
+            // parallel, so the buffer is needed by any other consumer
+            if (plan != nullptr && use.step != stepIndexToSearchFrom)
+                return true;
 
-            inputChannelOfIndexToIgnore = KV_INVALID_PORT;
-            ++stepIndexToSearchFrom;
+            if (use.step > stepIndexToSearchFrom
+                || (use.step == stepIndexToSearchFrom && use.port != inputChannelOfIndexToIgnore))
+                return true;
         }
 
         return false;
@@ -903,6 +1896,87 @@ private:
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ProcessorGraphBuilder)
 };
 
+/** A compiled rendering sequence. These are built on the message thread and
+    never modified once published. The audio thread only touches the shared
+    buffers, which belong to the sequence so nothing is resized under it. */
+class RenderSequence
+{
+public:
+    RenderSequence() { }
+
+    ~RenderSequence()
+    {
+        plan.reset();
+        for (int i = ops.size(); --i >= 0;)
+            delete static_cast<Task*> (ops.getUnchecked (i));
+    }
+
+    /** Compiles the ops to a flat program. Call after the buffers are allocated */
+    void compile()
+    {
+        program.compile (ops, audioBuffers, midiBuffers,
+                         plan != nullptr ? plan->getJobStarts() : Array<int>());
+        if (plan != nullptr)
+            plan->finalize (program);
+    }
+
+    void render (const int numSamples) const noexcept
+    {
+        program.render (0, program.size(), numSamples);
+    }
+
+    /** Allocates the shared buffers. Audio channels are contiguous and each
+        one starts on a cache line so the ops can use aligned SIMD loads. */
+    void allocateBuffers (const int numChannels, const int numMidiBuffers, const int blockSize)
+    {
+        enum { alignment = 64, floatsPerLine = alignment / sizeof (float) };
+
+        maxBlockSize = jmax (1, blockSize);
+        const auto stride = (size_t) ((maxBlockSize + floatsPerLine - 1) / floatsPerLine) * floatsPerLine;
+        storage.calloc (stride * (size_t) numChannels + floatsPerLine);
+        channelPointers.calloc ((size_t) numChannels);
+        bufferBytes = (stride * (size_t) numChannels + floatsPerLine) * sizeof (float)
+                    + (size_t) numChannels * sizeof (float*)
+                    + (size_t) numMidiBuffers * 2048;
+
+        auto* const base = reinterpret_cast<float*> (
+            (reinterpret_cast<pointer_sized_int> (storage.getData()) + alignment - 1) & ~(pointer_sized_int) (alignment - 1));
+        for (int ch = 0; ch < numChannels; ++ch)
+            channelPointers[ch] = base + stride * (size_t) ch;
+
+        audioBuffers.setDataToReferTo (channelPointers.getData(), numChannels, maxBlockSize);
+
+        while (midiBuffers.size() < numMidiBuffers)
+            midiBuffers.add (new MidiBuffer())->ensureSize (2048);
+    }
+
+    /** Returns the largest block this sequence can render in one go, or zero
+        if it has no buffers */
+    int getMaxBlockSize() const noexcept { return maxBlockSize; }
+
+    /** Returns roughly how many bytes the shared buffers use */
+    size_t getBufferMemory() const noexcept { return bufferBytes; }
+
+    Array<void*> ops;
+    RenderProgram program;
+    std::unique_ptr<ParallelPlan> plan;
+    ReferenceCountedArray<NodeObject> nodes;
+    std::vector<DelayPoint> delays;     // points into ops
+    AudioSampleBuffer audioBuffers;
+    OwnedArray<MidiBuffer> midiBuffers;
+
+    // link in the graph's list of sequences waiting to be deleted
+    RenderSequence* nextRetired = nullptr;
+
+private:
+    HeapBlock<float> storage;
+    HeapBlock<float*> channelPointers;
+    int maxBlockSize = 0;
+    size_t bufferBytes = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (RenderSequence)
+};
+
 }
 
 GraphProcessor::Connection::Connection (const uint32 sourceNode_, const uint32 sourcePort_,
@@ -918,19 +1992,28 @@ GraphProcessor::Connection::Connection (const uint32 sourceNode_, const uint32 s
 
 GraphProcessor::GraphProcessor()
     : lastNodeId (0),
-      renderingBuffers (1, 1),
       currentAudioInputBuffer (nullptr),
       currentAudioOutputBuffer (1, 1),
       currentMidiInputBuffer (nullptr)
 {
     for (int i = 0; i < AudioGraphIOProcessor::numDeviceTypes; ++i)
         ioNodes[i] = KV_INVALID_PORT;
+    updateMidiChannelMask();
 }
 
 GraphProcessor::~GraphProcessor()
 {
     renderingSequenceChanged.disconnect_all_slots();
-    clearRenderingSequence();
+    stopTimer();
+    latencyUpdater.cancelPendingUpdate();
+
+    // the audio thread is done with this graph, so the active sequence can go too
+    delete pendingSequence.exchange (nullptr);
+    deleteRetiredSequences();
+    delete activeSequence;
+    activeSequence = nullptr;
+    detachRemovedNodes();
+
     clear();
 }
 
@@ -941,6 +2024,7 @@ const String GraphProcessor::getName() const
 
 void GraphProcessor::clear()
 {
+    renderOrder.clearQuick();
     nodes.clear();
     connections.clear();
     //triggerAsyncUpdate();
@@ -1002,6 +2086,7 @@ NodeObject* GraphProcessor::addNode (AudioProcessor* const newProcessor, uint32
         node->resetPorts();
         node->prepare (getSampleRate(), getBlockSize(), this);
         nodes.add (node);
+        renderOrder.add (node);
         triggerAsyncUpdate();
         return node;
     }
@@ -1052,6 +2137,7 @@ NodeObject* GraphProcessor::addNode (NodeObject* newNode, uint32 nodeId)
     newNode->setParentGraph (this);
     newNode->resetPorts();
     newNode->prepare (getSampleRate(), getBlockSize(), this);
+    renderOrder.add (newNode);
     triggerAsyncUpdate();
     return nodes.add (newNode);
 }
@@ -1064,12 +2150,17 @@ bool GraphProcessor::removeNode (const uint32 nodeId)
         NodeObjectPtr n = nodes.getUnchecked (i);
         if (nodes.getUnchecked(i)->nodeId == nodeId)
         {
+            renderOrder.removeFirstMatchingValue (n.get());
             nodes.remove (i);
          
             // triggerAsyncUpdate();
             // do this syncronoously so it wont try processing with a null graph
             handleAsyncUpdate();
-            n->setParentGraph (nullptr);
+
+            // the audio thread can still be rendering a sequence which holds
+            // this node, so it's detached once that sequence is replaced
+            removedNodes.add (n);
+            deleteRetiredSequences();
 
             if (auto* sub = dynamic_cast<SubGraphProcessor*> (n->getAudioProcessor()))
             {
@@ -1165,10 +2256,40 @@ bool GraphProcessor::addConnection (const uint32 sourceNode, const uint32 source
     ArcSorter sorter;
     Connection* c = new Connection (sourceNode, sourcePort, destNode, destPort);
     connections.addSorted (sorter, c);
+    updateRenderOrder (sourceNode, destNode);
     triggerAsyncUpdate();
     return true;
 }
 
+Array<bool> GraphProcessor::addConnections (const Array<Arc>& arcs)
+{
+    Array<bool> results;
+    results.ensureStorageAllocated (arcs.size());
+    ArcSorter sorter;
+    bool anyAdded = false;
+
+    for (const auto& arc : arcs)
+    {
+        const bool added = canConnect (arc.sourceNode, arc.sourcePort, arc.destNode, arc.destPort);
+        if (added)
+        {
+            connections.addSorted (sorter, new Connection (arc.sourceNode, arc.sourcePort,
+                                                           arc.destNode, arc.destPort));
+            anyAdded = true;
+        }
+
+        results.add (added);
+    }
+
+    if (anyAdded)
+    {
+        sortRenderOrder();
+        triggerAsyncUpdate();
+    }
+
+    return results;
+}
+
 bool GraphProcessor::connectChannels (PortType type, uint32 sourceNode, int32 sourceChannel,
                                       uint32 destNode, int32 destChannel)
 {
@@ -1263,142 +2384,389 @@ void GraphProcessor::setMidiChannel (const int channel) noexcept
         midiChannels.setOmni (true);
     else
         midiChannels.setChannel (channel);
+    updateMidiChannelMask();
 }
 
 void GraphProcessor::setMidiChannels (const BigInteger channels) noexcept
 {
-    ScopedLock sl (getCallbackLock());
     midiChannels.setChannels (channels);
+    updateMidiChannelMask();
 }
 
 void GraphProcessor::setMidiChannels (const kv::MidiChannels channels) noexcept
 {
-    ScopedLock sl (getCallbackLock());
     midiChannels = channels;
+    updateMidiChannelMask();
+}
+
+void GraphProcessor::updateMidiChannelMask() noexcept
+{
+    // bit 0 is omni, bits 1 to 16 are the channels
+    uint32 mask = midiChannels.isOmni() ? 1u : 0u;
+    for (int channel = 1; channel <= 16; ++channel)
+        if (midiChannels.isOn (channel))
+            mask |= (1u << channel);
+    midiChannelMask.store (mask, std::memory_order_relaxed);
 }
 
 bool GraphProcessor::acceptsMidiChannel (const int channel) const noexcept
 {
-    ScopedLock sl (getCallbackLock());
-    return midiChannels.isOn (channel);
+    const auto mask = midiChannelMask.load (std::memory_order_relaxed);
+    return (mask & 1u) != 0 || (isPositiveAndBelow (channel, 17) && (mask & (1u << channel)) != 0);
 }
 
 void GraphProcessor::setVelocityCurveMode (const VelocityCurve::Mode mode) noexcept
 {
-    ScopedLock sl (getCallbackLock());
-    velocityCurve.setMode (mode);
+    // picked up by the audio thread at the start of the next block
+    velocityCurveMode.store (static_cast<int> (mode), std::memory_order_relaxed);
 }
 
-static void deleteRenderOpArray (Array<void*>& ops)
+void GraphProcessor::publishRenderingSequence (GraphRender::RenderSequence* const sequence)
 {
-    for (int i = ops.size(); --i >= 0;)
-        delete static_cast<GraphRender::Task*> (ops.getUnchecked (i));
-    ops.clearQuick();
+    // a sequence still pending was never seen by the audio thread
+    latestSequence = sequence;
+    delete pendingSequence.exchange (sequence, std::memory_order_acq_rel);
+    deleteRetiredSequences();
+
+    if (! isTimerRunning())
+        startTimer (50);
 }
 
-void GraphProcessor::clearRenderingSequence()
+void GraphProcessor::deleteRetiredSequences()
 {
-    Array<void*> oldOps;
+    swapSequenceIfStopped();
 
+    auto* sequence = retiredSequences.exchange (nullptr, std::memory_order_acquire);
+    while (sequence != nullptr)
     {
-        const ScopedLock sl (getCallbackLock());
-        renderingOps.swapWith (oldOps);
+        auto* const next = sequence->nextRetired;
+        delete sequence;
+        sequence = next;
     }
 
-    deleteRenderOpArray (oldOps);
+    // once the latest sequence is picked up, nothing older can be rendered
+    if (pendingSequence.load (std::memory_order_acquire) == nullptr)
+        detachRemovedNodes();
 }
 
-bool GraphProcessor::isAnInputTo (const uint32 possibleInputId,
-                                  const uint32 possibleDestinationId,
-                                  const int recursionCheck) const
+void GraphProcessor::swapSequenceIfStopped()
 {
-    if (recursionCheck > 0)
+    // nothing calls processBlock between releaseResources and prepareToPlay,
+    // or while the engine leaves the graph dormant, so the sequence is swapped
+    // here instead. The lock covers the graph being rendered again meanwhile,
+    // which then skips a block.
+    if ((prepared.load() && ! dormant.load()) || sequenceLock.exchange (true, std::memory_order_acquire))
+        return;
+
+    if (auto* const next = pendingSequence.exchange (nullptr, std::memory_order_acq_rel))
     {
-        for (int i = connections.size(); --i >= 0;)
-        {
-            const GraphProcessor::Connection* const c = connections.getUnchecked (i);
+        delete activeSequence;
+        activeSequence = next;
+    }
 
-            if (c->destNode == possibleDestinationId
-                 && (c->sourceNode == possibleInputId
-                      || isAnInputTo (possibleInputId, c->sourceNode, recursionCheck - 1)))
-                return true;
+    sequenceLock.store (false, std::memory_order_release);
+}
+
+void GraphProcessor::detachRemovedNodes()
+{
+    for (auto* const node : removedNodes)
+        if (! nodes.contains (node))
+            node->setParentGraph (nullptr);
+    removedNodes.clear();
+}
+
+void GraphProcessor::timerCallback()
+{
+    deleteRetiredSequences();
+
+    // keep polling until the audio thread has picked up the last sequence
+    if (pendingSequence.load() == nullptr && retiredSequences.load() == nullptr
+        && removedNodes.isEmpty())
+        stopTimer();
+}
+
+void GraphProcessor::clearRenderingSequence()
+{
+    // the audio thread may still be inside the active sequence, so hand it
+    // an empty one and let the old one be retired as usual
+    publishRenderingSequence (new GraphRender::RenderSequence());
+}
+
+void GraphProcessor::nodeLatencyChanged()
+{
+    latencyUpdater.triggerAsyncUpdate();
+}
+
+void GraphProcessor::refreshLatencies()
+{
+    latencyUpdater.cancelPendingUpdate();
+
+    // a rebuild on the way picks up the new latencies anyway
+    if (isUpdatePending())
+        return;
+
+    if (! updateDelays())
+        triggerAsyncUpdate();
+}
+
+bool GraphProcessor::updateDelays()
+{
+    auto* const sequence = latestSequence;
+    if (sequence == nullptr)
+        return false;
+
+    Array<void*> orderedNodes;
+    for (auto* const node : sequence->nodes)
+        orderedNodes.add (node);
+
+    GraphRender::LatencyPlan latency;
+    latency.compute (*this, orderedNodes);
+
+    // every delay has to change in place, otherwise nothing is touched
+    std::unordered_set<uint64> delayed;
+    for (const auto& point : sequence->delays)
+    {
+        const int delay = latency.getDelay (point.sourceNode, point.destNodes.getFirst());
+        if (! point.op->canDelay (delay))
+            return false;
+
+        for (const auto destNode : point.destNodes)
+        {
+            // consumers sharing a tap have to still agree
+            if (latency.getDelay (point.sourceNode, destNode) != delay)
+                return false;
+            delayed.insert (GraphRender::LatencyPlan::key (point.sourceNode, destNode));
         }
     }
 
-    return false;
+    if (! latency.isCoveredBy (delayed))
+        return false;
+
+    for (const auto& point : sequence->delays)
+        point.op->setDelay (latency.getDelay (point.sourceNode, point.destNodes.getFirst()));
+
+    setLatencySamples (latency.getTotalLatency());
+    return true;
 }
 
-void GraphProcessor::buildRenderingSequence()
+void GraphProcessor::setMultiCoreRendering (const bool shouldUseMultipleCores)
 {
-    Array<void*> newRenderingOps;
-    int numRenderingBuffersNeeded = 2;
-    int numMidiBuffersNeeded = 1;
+    if (multiCoreRendering == shouldUseMultipleCores)
+        return;
+    multiCoreRendering = shouldUseMultipleCores;
+    triggerAsyncUpdate();
+}
+
+void GraphProcessor::setRenderThreadPool (RenderThreadPool* const pool)
+{
+    if (renderPool.load() == pool)
+        return;
+    renderPool.store (pool);
+    triggerAsyncUpdate();
+}
 
+void GraphProcessor::updateRenderOrder (const uint32 sourceId, const uint32 destId)
+{
+    // Removing connections never invalidates the order, and a new connection
+    // only affects the nodes placed between its ends. Reorder just that
+    // region (Pearce-Kelly) instead of sorting the whole graph again.
+    int lower = -1, upper = -1;
+    for (int i = renderOrder.size(); --i >= 0;)
     {
-        //XXX:
-        MessageManagerLock mml;
+        const auto nodeId = renderOrder.getUnchecked(i)->nodeId;
+        if (nodeId == destId)   lower = i;
+        if (nodeId == sourceId) upper = i;
+    }
 
-        Array<void*> orderedNodes;
+    if (lower < 0 || upper < 0 || upper < lower)
+        return;
+
+    std::unordered_map<uint32, int> positions;
+    for (int i = lower; i <= upper; ++i)
+        positions[renderOrder.getUnchecked(i)->nodeId] = i;
 
+    std::unordered_map<uint32, Array<uint32>> outputs, inputs;
+    for (const auto* const c : connections)
+    {
+        if (positions.find (c->sourceNode) != positions.end()
+            && positions.find (c->destNode) != positions.end())
         {
-            const LookupTable table (connections);
+            outputs[c->sourceNode].addIfNotAlreadyThere (c->destNode);
+            inputs[c->destNode].addIfNotAlreadyThere (c->sourceNode);
+        }
+    }
 
-            for (int i = 0; i < nodes.size(); ++i)
+    auto collect = [&positions] (uint32 start, std::unordered_map<uint32, Array<uint32>>& edges,
+                                 Array<int>& result, uint32 stopAt) -> bool
+    {
+        std::unordered_set<uint32> visited { start };
+        Array<uint32> stack { start };
+        while (! stack.isEmpty())
+        {
+            const auto nodeId = stack.removeAndReturn (stack.size() - 1);
+            result.add (positions [nodeId]);
+            for (const auto next : edges [nodeId])
             {
-                NodeObject* const node = nodes.getUnchecked(i);
-                node->prepare (getSampleRate(), getBlockSize(), this);
+                if (next == stopAt)
+                    return false;
+                if (visited.insert (next).second)
+                    stack.add (next);
+            }
+        }
+
+        return true;
+    };
+
+    Array<int> forward, backward;
+    if (! collect (destId, outputs, forward, sourceId))
+        return; // feedback loop, order stays as is and the loop reads silence
+    collect (sourceId, inputs, backward, KV_INVALID_NODE);
+
+    forward.sort();
+    backward.sort();
+
+    // nodes feeding the source go first, nodes fed by the dest go after
+    Array<NodeObject*> moved;
+    for (const auto index : backward)   moved.add (renderOrder.getUnchecked (index));
+    for (const auto index : forward)    moved.add (renderOrder.getUnchecked (index));
 
-                int j = 0;
-                for (; j < orderedNodes.size(); ++j)
-                    if (table.isAnInputTo (node->nodeId, ((NodeObject*) orderedNodes.getUnchecked(j))->nodeId))
-                      break;
+    Array<int> slots;
+    slots.addArray (backward);
+    slots.addArray (forward);
+    slots.sort();
 
-                orderedNodes.insert (j, node);
+    for (int i = 0; i < slots.size(); ++i)
+        renderOrder.set (slots.getUnchecked (i), moved.getUnchecked (i));
+}
+
+void GraphProcessor::sortRenderOrder()
+{
+    // depth first over each node's inputs, placing a node once everything
+    // feeding it is placed. Visiting in the current order keeps unrelated
+    // nodes where they were, and an input which is still being visited is a
+    // feedback loop which gets skipped, so the loop reads silence as it does
+    // when connecting one at a time.
+    const int numNodes = renderOrder.size();
+    std::unordered_map<uint32, int> positions;
+    for (int i = 0; i < numNodes; ++i)
+        positions[renderOrder.getUnchecked(i)->nodeId] = i;
+
+    std::vector<Array<int>> inputs ((size_t) numNodes);
+    for (const auto* const c : connections)
+    {
+        const auto source = positions.find (c->sourceNode);
+        const auto dest = positions.find (c->destNode);
+        if (source != positions.end() && dest != positions.end())
+            inputs[(size_t) dest->second].addIfNotAlreadyThere (source->second);
+    }
+
+    enum { unvisited = 0, visiting, placed };
+    std::vector<int> states ((size_t) numNodes, unvisited);
+    std::vector<std::pair<int, int>> stack;
+    Array<NodeObject*> sorted;
+    sorted.ensureStorageAllocated (numNodes);
+
+    for (int root = 0; root < numNodes; ++root)
+    {
+        if (states[(size_t) root] != unvisited)
+            continue;
+
+        states[(size_t) root] = visiting;
+        stack.push_back ({ root, 0 });
+
+        while (! stack.empty())
+        {
+            const int index = stack.back().first;
+            const int next = stack.back().second++;
+            const auto& nodeInputs = inputs[(size_t) index];
+
+            if (next < nodeInputs.size())
+            {
+                const int input = nodeInputs.getUnchecked (next);
+                if (states[(size_t) input] == unvisited)
+                {
+                    states[(size_t) input] = visiting;
+                    stack.push_back ({ input, 0 });
+                }
+            }
+            else
+            {
+                states[(size_t) index] = placed;
+                sorted.add (renderOrder.getUnchecked (index));
+                stack.pop_back();
             }
         }
+    }
 
-        GraphRender::ProcessorGraphBuilder calculator (*this, orderedNodes, newRenderingOps);
+    renderOrder.swapWith (sorted);
+}
 
-        numRenderingBuffersNeeded = calculator.buffersNeeded (PortType::Audio);
-        numMidiBuffersNeeded      = calculator.buffersNeeded (PortType::Midi);
-    }
+void GraphProcessor::buildRenderingSequence()
+{
+    std::unique_ptr<GraphRender::RenderSequence> sequence (new GraphRender::RenderSequence());
+    int numRenderingBuffersNeeded = 2;
+    int numMidiBuffersNeeded = 1;
+
+    // nodes, connections and the render order only change on the message
+    // thread, so sequences are built there, or with it locked when a device
+    // prepares the graph from its own thread
+    JUCE_ASSERT_MESSAGE_MANAGER_IS_LOCKED
 
     {
-        // swap over to the new rendering sequence..
-        const ScopedLock sl (getCallbackLock());
+        Array<void*> orderedNodes;
+        orderedNodes.ensureStorageAllocated (renderOrder.size());
+
+        // the render order is kept up to date as nodes and connections change
+        for (auto* const node : renderOrder)
+        {
+            node->prepare (getSampleRate(), getBlockSize(), this);
+            orderedNodes.add (node);
+            sequence->nodes.add (node);
+        }
 
-        renderingBuffers.setSize (numRenderingBuffersNeeded, 4096);
-        renderingBuffers.clear();
+        if (multiCoreRendering && renderPool.load() != nullptr)
+            sequence->plan.reset (new GraphRender::ParallelPlan());
 
-        for (int i = midiBuffers.size(); --i >= 0;)
-            midiBuffers.getUnchecked(i)->clear();
+        GraphRender::ProcessorGraphBuilder calculator (*this, orderedNodes, sequence->ops,
+                                                        sequence->delays, sequence->plan.get());
 
-        while (midiBuffers.size() < numMidiBuffersNeeded)
-            midiBuffers.add (new MidiBuffer());
+        // not worth dispatching if nothing can run concurrently
+        if (sequence->plan != nullptr && sequence->plan->getNumJobs() < 2)
+            sequence->plan.reset();
 
-        renderingOps.swapWith (newRenderingOps);
+        numRenderingBuffersNeeded = calculator.buffersNeeded (PortType::Audio);
+        numMidiBuffersNeeded      = calculator.buffersNeeded (PortType::Midi);
     }
 
-    // delete the old ones..
-    deleteRenderOpArray (newRenderingOps);
+    // sized for the prepared block, bigger callbacks get split in processBlock
+    sequence->allocateBuffers (numRenderingBuffersNeeded, numMidiBuffersNeeded,
+                               getBlockSize() > 0 ? getBlockSize() : 512);
+    sequence->compile();
+    sequenceMemory = sequence->getBufferMemory();
+
+    // the audio thread swaps to it at the start of its next block
+    publishRenderingSequence (sequence.release());
 
     renderingSequenceChanged();
 }
 
+bool GraphProcessor::hasParallelPlan() const noexcept
+{
+    return latestSequence != nullptr && latestSequence->plan != nullptr;
+}
+
+size_t GraphProcessor::getMemoryUsage() const
+{
+    size_t bytes = sequenceMemory;
+    for (const auto* const node : nodes)
+        bytes += node->getMemoryUsage();
+    return bytes;
+}
+
 void GraphProcessor::getOrderedNodes (ReferenceCountedArray<NodeObject>& orderedNodes)
 {
-    const LookupTable table (connections);
-    for (int i = 0; i < nodes.size(); ++i)
-    {
-        NodeObject* const node = nodes.getUnchecked(i);
-        
-        int j = 0;
-        for (; j < orderedNodes.size(); ++j)
-            if (table.isAnInputTo (node->nodeId, ((NodeObject*) orderedNodes.getUnchecked(j))->nodeId))
-                break;
-        
-        orderedNodes.insert (j, node);
-    }
+    for (auto* const node : renderOrder)
+        orderedNodes.add (node);
 }
 
 void GraphProcessor::handleAsyncUpdate()
@@ -1408,10 +2776,15 @@ void GraphProcessor::handleAsyncUpdate()
 
 void GraphProcessor::prepareToPlay (double sampleRate, int estimatedSamplesPerBlock)
 {
+    // does nothing on the message thread, see buildRenderingSequence()
+    const MessageManagerLock mml;
+
     currentAudioInputBuffer = nullptr;
     currentAudioOutputBuffer.setSize (jmax (1, getTotalNumOutputChannels()), estimatedSamplesPerBlock);
     currentMidiInputBuffer = nullptr;
     currentMidiOutputBuffer.clear();
+    splitMidiInput.ensureSize (2048);
+    splitMidiOutput.ensureSize (2048);
     clearRenderingSequence();
 
     if (getSampleRate() != sampleRate || getBlockSize() != estimatedSamplesPerBlock)
@@ -1424,15 +2797,18 @@ void GraphProcessor::prepareToPlay (double sampleRate, int estimatedSamplesPerBl
         nodes.getUnchecked(i)->prepare (sampleRate, estimatedSamplesPerBlock, this);
 
     buildRenderingSequence();
+    prepared.store (true);
 }
 
 void GraphProcessor::releaseResources()
 {
+    // the empty sequence below is swapped in right away, freeing the old one
+    prepared.store (false);
+
     for (int i = 0; i < nodes.size(); ++i)
         nodes.getUnchecked(i)->unprepare();
 
-    renderingBuffers.setSize (1, 1);
-    midiBuffers.clear();
+    clearRenderingSequence();
 
     currentAudioInputBuffer = nullptr;
     currentAudioOutputBuffer.setSize (1, 1);
@@ -1442,10 +2818,8 @@ void GraphProcessor::releaseResources()
 
 void GraphProcessor::reset()
 {
-    const ScopedLock sl (getCallbackLock());
-    for (auto node : nodes)
-        if (auto* const proc = node->getAudioProcessor())
-            proc->reset();
+    // nodes are reset on the audio thread before rendering the next block
+    resetRequested.store (true);
 }
 
 // MARK: Process Graph
@@ -1454,11 +2828,90 @@ void GraphProcessor::processBlock (AudioSampleBuffer& buffer, MidiBuffer& midiMe
 {
     const int32 numSamples = buffer.getNumSamples();
 
+    // held by the message thread while it swaps sequences for a stopped graph
+    if (sequenceLock.exchange (true, std::memory_order_acquire))
+    {
+        buffer.clear();
+        midiMessages.clear();
+        return;
+    }
+
+    struct SequenceUnlocker
+    {
+        ~SequenceUnlocker() { lock.store (false, std::memory_order_release); }
+        std::atomic<bool>& lock;
+    } unlocker { sequenceLock };
+
+    if (auto* const next = pendingSequence.exchange (nullptr, std::memory_order_acq_rel))
+    {
+        // hand the old sequence back to the message thread for deletion
+        if (auto* const old = activeSequence)
+        {
+            old->nextRetired = retiredSequences.load (std::memory_order_relaxed);
+            while (! retiredSequences.compare_exchange_weak (old->nextRetired, old,
+                                                             std::memory_order_release,
+                                                             std::memory_order_relaxed))
+            { }
+        }
+
+        activeSequence = next;
+    }
+
+    if (resetRequested.exchange (false) && activeSequence != nullptr)
+        for (auto* const node : activeSequence->nodes)
+            if (auto* const proc = node->getAudioProcessor())
+                proc->reset();
+
+    const auto curveMode = velocityCurveMode.load (std::memory_order_relaxed);
+    if (velocityCurve.getMode() != curveMode)
+        velocityCurve.setMode (static_cast<VelocityCurve::Mode> (curveMode));
+
+    const auto channelMask = midiChannelMask.load (std::memory_order_relaxed);
+    // the output buffer is sized in prepareToPlay, never on this thread
+    const int maxBlockSize = activeSequence != nullptr
+        ? jmin (activeSequence->getMaxBlockSize(), currentAudioOutputBuffer.getNumSamples()) : 0;
+
+    if (maxBlockSize <= 0 || numSamples <= maxBlockSize)
+    {
+        renderBlock (buffer, midiMessages, channelMask);
+        return;
+    }
+
+    // the callback is bigger than the graph was prepared for, render it in pieces
+    splitMidiOutput.clear();
+    for (int start = 0; start < numSamples; start += maxBlockSize)
+    {
+        const int numThisTime = jmin (maxBlockSize, numSamples - start);
+        AudioSampleBuffer chunk (buffer.getArrayOfWritePointers(), buffer.getNumChannels(),
+                                 start, numThisTime);
+        splitMidiInput.clear();
+        splitMidiInput.addEvents (midiMessages, start, numThisTime, -start);
+        renderBlock (chunk, splitMidiInput, channelMask);
+        splitMidiOutput.addEvents (splitMidiInput, 0, numThisTime, start);
+    }
+
+    midiMessages.swapWith (splitMidiOutput);
+}
+
+void GraphProcessor::renderBlock (AudioSampleBuffer& buffer, MidiBuffer& midiMessages, const uint32 channelMask)
+{
+    const int32 numSamples = buffer.getNumSamples();
+    const bool omni = (channelMask & 1u) != 0;
+
+    // nothing to render, and the block may not fit the output buffer
+    if (activeSequence == nullptr)
+    {
+        buffer.clear();
+        midiMessages.clear();
+        return;
+    }
+
+    // bigger blocks were split in processBlock
+    jassert (numSamples <= currentAudioOutputBuffer.getNumSamples());
     currentAudioInputBuffer = &buffer;
-    currentAudioOutputBuffer.setSize (jmax (1, buffer.getNumChannels()), numSamples);
-    currentAudioOutputBuffer.clear();
+    currentAudioOutputBuffer.clear (0, numSamples);
     
-    if (midiChannels.isOmni() && velocityCurve.getMode() == VelocityCurve::Linear)
+    if (omni && velocityCurve.getMode() == VelocityCurve::Linear)
     {
         currentMidiInputBuffer = &midiMessages;
     }
@@ -1471,7 +2924,7 @@ void GraphProcessor::processBlock (AudioSampleBuffer& buffer, MidiBuffer& midiMe
         while (iter.getNextEvent (msg, frame))
         {
             chan = msg.getChannel();
-            if (chan > 0 && midiChannels.isOff (chan))
+            if (chan > 0 && ! omni && (channelMask & (1u << chan)) == 0)
                 continue;
 
             if (msg.isNoteOn())
@@ -1489,14 +2942,25 @@ void GraphProcessor::processBlock (AudioSampleBuffer& buffer, MidiBuffer& midiMe
     
     currentMidiOutputBuffer.clear();
 
-    for (int i = 0; i < renderingOps.size(); ++i)
+    auto* const sequence = activeSequence;
+    bool renderedInParallel = false;
+    auto* const pool = renderPool.load();
+
+    if (sequence->plan != nullptr && pool != nullptr)
     {
-        GraphRender::Task* const op = static_cast<GraphRender::Task*> (renderingOps.getUnchecked (i));
-        op->perform (renderingBuffers, midiBuffers, numSamples);
+        sequence->plan->begin (numSamples);
+        renderedInParallel = pool->perform (*sequence->plan);
     }
 
-    for (int i = 0; i < buffer.getNumChannels(); ++i)
+    // serial fallback when the pool isn't available or is busy
+    if (! renderedInParallel)
+        sequence->render (numSamples);
+
+    const int numOutputChans = jmin (buffer.getNumChannels(), currentAudioOutputBuffer.getNumChannels());
+    for (int i = 0; i < numOutputChans; ++i)
         buffer.copyFrom (i, 0, currentAudioOutputBuffer, i, 0, numSamples);
+    for (int i = numOutputChans; i < buffer.getNumChannels(); ++i)
+        buffer.clear (i, 0, numSamples);
     
     midiMessages.clear();
     midiMessages.addEvents (currentMidiOutputBuffer, 0, numSamples, 0);
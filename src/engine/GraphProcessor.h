@@ -26,6 +26,13 @@
 
 namespace Element {
 
+class RenderThreadPool;
+
+namespace GraphRender {
+class ParallelPlan;
+class RenderSequence;
+}
+
 /**
     A type of AudioProcessor which plays back a graph of other AudioProcessors.
 
@@ -40,7 +47,8 @@ namespace Element {
     AudioProcessorPlayer object.
 */
 class JUCE_API GraphProcessor : public Processor,
-                                public AsyncUpdater
+                                public AsyncUpdater,
+                                private Timer
 {
 public:
     Signal<void()> renderingSequenceChanged;
@@ -112,6 +120,11 @@ public:
 
     /** Builds an array of ordered nodes */
     void getOrderedNodes (ReferenceCountedArray<NodeObject>& res);
+
+    /** Returns an estimate of the bytes allocated to render this graph,
+        including its render buffers and every node's host side memory
+     */
+    size_t getMemoryUsage() const;
     
     /** Returns the number of connections in the graph. */
     int getNumConnections() const                                       { return connections.size(); }
@@ -142,6 +155,12 @@ public:
     bool addConnection (uint32 sourceNode, uint32 sourcePort,
                         uint32 destNode, uint32 destPort);
 
+    /** Adds several connections at once. The render order is sorted a single
+        time after all of them are added, instead of after every connection.
+        @returns a flag for each arc telling whether it was connected
+    */
+    Array<bool> addConnections (const Array<Arc>& arcs);
+
     /** Connect two ports by channel number */
     bool connectChannels (PortType type, uint32 sourceNode, int32 sourceChannel,
                           uint32 destNode, int32 destChannel);
@@ -187,6 +206,42 @@ public:
     /** Set the MIDI curve of this graph */
     void setVelocityCurveMode (const VelocityCurve::Mode) noexcept;
 
+    /** Render independent branches of this graph on multiple cores. This only
+        has an effect if a render thread pool has been set. When the pool is
+        unavailable the graph falls back to rendering serially.
+     */
+    void setMultiCoreRendering (const bool shouldUseMultipleCores);
+
+    /** Returns true if multi-core rendering was requested */
+    bool isMultiCoreRendering() const noexcept                      { return multiCoreRendering; }
+
+    /** Returns true if the last sequence built has a plan for rendering
+        on multiple cores. Message thread only */
+    bool hasParallelPlan() const noexcept;
+
+    /** Set the thread pool used for multi-core rendering. The pool must
+        outlive this graph or be unset before it is deleted.
+     */
+    void setRenderThreadPool (RenderThreadPool* pool);
+
+    /** The engine calls this from the audio thread when it stops or resumes
+        rendering a prepared graph. While dormant, the message thread adopts
+        new sequences itself, like it does when the graph isn't prepared.
+     */
+    void setDormant (bool isDormant) noexcept   { dormant.store (isDormant); }
+
+    /** Call this when a node's latency changes. It's safe from any thread,
+        the delays are updated later on the message thread.
+     */
+    void nodeLatencyChanged();
+
+    /** Updates latency compensation to match the nodes' current latencies.
+        Delays change in place in the running sequence. If that isn't
+        possible, like when a connection which wasn't delayed now needs to
+        be, the sequence is rebuilt instead.
+     */
+    void refreshLatencies();
+
     /** A special number that represents the midi channel of a node.
 
         This is used as a channel index value if you want to refer to the midi input
@@ -341,9 +396,42 @@ private:
     uint32 ioNodes [AudioGraphIOProcessor::numDeviceTypes];
     
     uint32 lastNodeId;
-    AudioSampleBuffer renderingBuffers;
-    OwnedArray <MidiBuffer> midiBuffers;
-    Array<void*> renderingOps;
+
+    // Sequences are published to the audio thread through pendingSequence.
+    // Only the audio thread touches activeSequence, and it hands replaced
+    // ones back through retiredSequences to be deleted on the message thread.
+    std::atomic<GraphRender::RenderSequence*> pendingSequence { nullptr };
+    std::atomic<GraphRender::RenderSequence*> retiredSequences { nullptr };
+    GraphRender::RenderSequence* activeSequence = nullptr;
+    std::atomic<bool> resetRequested { false };
+
+    // the last sequence published, which stays alive until a newer one
+    // replaces it. Message thread only.
+    GraphRender::RenderSequence* latestSequence = nullptr;
+
+    // set between prepareToPlay and releaseResources. While it's clear, or the
+    // graph is dormant, the message thread swaps sequences itself, holding
+    // sequenceLock
+    std::atomic<bool> prepared { false };
+    std::atomic<bool> dormant { false };
+    std::atomic<bool> sequenceLock { false };
+
+    // removed nodes waiting for the audio thread to drop the sequence
+    // holding them before they're detached. Message thread only.
+    ReferenceCountedArray<NodeObject> removedNodes;
+
+    struct LatencyUpdater : public AsyncUpdater
+    {
+        LatencyUpdater (GraphProcessor& g) : graph (g) { }
+        ~LatencyUpdater() { cancelPendingUpdate(); }
+        void handleAsyncUpdate() override { graph.refreshLatencies(); }
+        GraphProcessor& graph;
+    } latencyUpdater { *this };
+
+    Array<NodeObject*> renderOrder;
+    size_t sequenceMemory = 0;
+    std::atomic<RenderThreadPool*> renderPool { nullptr };
+    bool multiCoreRendering = false;
 
     friend class AudioGraphIOProcessor;
     friend class GraphPort;
@@ -354,13 +442,25 @@ private:
     MidiBuffer currentMidiOutputBuffer;
     
     kv::MidiChannels midiChannels;
-    VelocityCurve velocityCurve;
+    std::atomic<uint32> midiChannelMask { 1 };
+    std::atomic<int> velocityCurveMode { VelocityCurve::Linear };
+    VelocityCurve velocityCurve; // audio thread only
     MidiBuffer filteredMidi;
+    MidiBuffer splitMidiInput, splitMidiOutput;
     
     void handleAsyncUpdate() override;
+    void timerCallback() override;
+    void renderBlock (AudioSampleBuffer&, MidiBuffer&, uint32 channelMask);
     void clearRenderingSequence();
     void buildRenderingSequence();
-    bool isAnInputTo (uint32 possibleInputId, uint32 possibleDestinationId, int recursionCheck) const;
+    void publishRenderingSequence (GraphRender::RenderSequence*);
+    void deleteRetiredSequences();
+    void swapSequenceIfStopped();
+    void detachRemovedNodes();
+    bool updateDelays();
+    void updateMidiChannelMask() noexcept;
+    void updateRenderOrder (uint32 sourceId, uint32 destId);
+    void sortRenderOrder();
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GraphProcessor)
 };
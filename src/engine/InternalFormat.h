@@ -119,6 +119,10 @@ public:
     StringArray searchPathsForPlugins (const FileSearchPath&, bool /*recursive*/, bool /*allowAsync*/) override;
     bool isTrivialToScan() const override { return true; }
     
+    /** Creates one of Element's processors directly. Unlike the format manager
+        this doesn't bounce through the message thread when called from another one */
+    AudioPluginInstance* instantiatePlugin (const PluginDescription& desc, double rate, int block);
+
 protected:
     void createPluginInstance (const PluginDescription&,
                                double initialSampleRate,
@@ -131,7 +135,6 @@ private:
     PluginDescription reverbDesc;
     PluginDescription combFilterDesc;
     PluginDescription allPassFilterDesc;
-    AudioPluginInstance* instantiatePlugin (const PluginDescription& desc, double rate, int block);
 };
 
 }
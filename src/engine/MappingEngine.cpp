@@ -19,6 +19,7 @@
 
 #include "engine/NodeObject.h"
 #include "engine/MappingEngine.h"
+#include "engine/MidiDispatchTable.h"
 #include "engine/MidiEngine.h"
 #include "session/ControllerDevice.h"
 #include "session/Node.h"
@@ -31,8 +32,19 @@ public:
     ControllerMapHandler() { }
     virtual ~ControllerMapHandler() { }
 
+    /** The message this handler is indexed by in the dispatch table */
+    virtual bool isControllerMap() const =0;
+    virtual int getMidiNumber() const =0;
+    virtual int getMidiChannel() const =0;
+
     virtual bool wants (const MidiMessage& message) const =0;
-    virtual void perform (const MidiMessage& message) =0;
+
+    /** Handles a message. The time is on the Time::getMillisecondCounterHiRes()
+        clock, for handlers which queue sample accurate parameter changes */
+    virtual void perform (const MidiMessage& message, double timeMs) =0;
+
+    /** Called on the message thread when the channel listened on changes */
+    std::function<void()> channelChanged;
 };
 
 struct MidiNoteControllerMap : public ControllerMapHandler,
@@ -82,6 +94,10 @@ struct MidiNoteControllerMap : public ControllerMapHandler,
             (channel.get() == 0 || (channel.get() > 0 && message.getChannel() == channel.get()));
     }
 
+    bool isControllerMap() const override   { return false; }
+    int getMidiNumber() const override      { return noteNumber; }
+    int getMidiChannel() const override     { return channel.get(); }
+
     bool wants (const MidiMessage& message) const override
     {
         bool wants = momentary.get() == 0
@@ -90,7 +106,7 @@ struct MidiNoteControllerMap : public ControllerMapHandler,
         return wants;
     }
 
-    void perform (const MidiMessage& message) override
+    void perform (const MidiMessage& message, double) override
     {
         const bool isInverse = inverse.get() == 1;
 
@@ -199,6 +215,8 @@ private:
         if (channelObject.refersToSameSourceAs (value))
         {
             channel.set (jlimit (0, 16, (int) channelObject.getValue()));
+            if (channelChanged)
+                channelChanged();
         }
         else if (momentaryObject.refersToSameSourceAs (value))
         {
@@ -262,6 +280,10 @@ struct MidiCCControllerMapHandler : public ControllerMapHandler,
         channelObject.removeListener (this);
     }
 
+    bool isControllerMap() const override   { return true; }
+    int getMidiNumber() const override      { return controllerNumber; }
+    int getMidiChannel() const override     { return channel.get(); }
+
     bool wants (const MidiMessage& message) const override
     {
         return message.isController() && 
@@ -269,14 +291,16 @@ struct MidiCCControllerMapHandler : public ControllerMapHandler,
             (channel.get() == 0 || (channel.get() > 0 && message.getChannel() == channel.get()));
     }
 
-    void perform (const MidiMessage& message) override
+    void perform (const MidiMessage& message, double timeMs) override
     {
         const auto ccValue = message.getControllerValue();
 
         if (nullptr != parameter)
         {
+            const auto value = static_cast<float> (ccValue) / 127.f;
             parameter->beginChangeGesture();
-            parameter->setValueNotifyingHost (static_cast<float> (ccValue) / 127.f);
+            if (! node->postParameterEvent (parameterIndex, value, timeMs))
+                parameter->setValueNotifyingHost (value);
             parameter->endChangeGesture();
         }
         else if (parameterIndex == NodeObject::EnabledParameter ||
@@ -410,6 +434,8 @@ private:
         else if (channelObject.refersToSameSourceAs (value))
         {
             channel.set (jlimit (0, 16, (int) channelObject.getValue()));
+            if (channelChanged)
+                channelChanged();
         }
     }
 };
@@ -426,9 +452,10 @@ public:
     ~ControllerMapInput()
     {
         close();
+        delete table.exchange (nullptr);
     }
 
-    void handleIncomingMidiMessage (MidiInput*, const MidiMessage& message)
+    void handleIncomingMidiMessage (MidiInput* source, const MidiMessage& message)
     {
         if ((! message.isController() || !controllerNumbers [message.getControllerNumber()]) &&
             (!message.isNoteOnOrOff() || !noteNumbers [message.getNoteNumber()]))
@@ -441,9 +468,17 @@ public:
         else if (message.isController())
             mapping.captureNextEvent (*this, controls[message.getControllerNumber()], message);
 
-        for (auto* handler : handlers)
-            if (handler->wants (message))
-                handler->perform (message);
+        // devices stamp messages in seconds, while MIDI coming from the
+        // engine's own callback has no source and is stamped in milliseconds
+        const double timeMs = source != nullptr ? message.getTimeStamp() * 1000.0
+                                                : message.getTimeStamp();
+
+        ++numDispatching;
+        if (auto* const current = table.load())
+            for (auto* handler : current->lookup (message))
+                if (handler->wants (message))
+                    handler->perform (message, timeMs);
+        --numDispatching;
     }
 
     bool close()
@@ -501,9 +536,25 @@ public:
 
     void addHandler (ControllerMapHandler* handler)
     {
-        stop();
+        handler->channelChanged = [this]() { rebuildTable(); };
         handlers.add (handler);
-        start();
+        rebuildTable();
+    }
+
+    /** Indexes the handlers and swaps the new table in for the MIDI thread */
+    void rebuildTable()
+    {
+        std::unique_ptr<DispatchTable> newTable (new DispatchTable());
+        for (auto* handler : handlers)
+            newTable->add (handler, handler->isControllerMap(),
+                           handler->getMidiChannel(), handler->getMidiNumber());
+        newTable->build();
+
+        std::unique_ptr<DispatchTable> oldTable (table.exchange (newTable.release()));
+
+        // the MIDI thread might still be reading the old table
+        while (numDispatching.load() > 0)
+            Thread::yield();
     }
 
 private:
@@ -512,6 +563,9 @@ private:
     ControllerDevice controllerDevice;
     std::unique_ptr<MidiInput> midiInput;
     OwnedArray<ControllerMapHandler> handlers;
+    using DispatchTable = MidiDispatchTable<ControllerMapHandler>;
+    std::atomic<DispatchTable*> table { nullptr };
+    std::atomic<int> numDispatching { 0 };
     BigInteger controllerNumbers, noteNumbers;
     HashMap<int, ControllerDevice::Control> controls, notes;
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ControllerMapInput)
@@ -0,0 +1,151 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "engine/MeterBuffer.h"
+
+#if JUCE_USE_SSE_INTRINSICS
+ #include <xmmintrin.h>
+#elif JUCE_USE_ARM_NEON
+ #include <arm_neon.h>
+#endif
+
+namespace Element {
+
+MeterBuffer::Level MeterBuffer::measure (const float* samples, const int numSamples) noexcept
+{
+    float peak = 0.f, sum = 0.f;
+    int i = 0;
+
+   #if JUCE_USE_SSE_INTRINSICS
+    const __m128 signMask = _mm_set1_ps (-0.f);
+    __m128 vpeak = _mm_setzero_ps();
+    __m128 vsum  = _mm_setzero_ps();
+
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        const __m128 s = _mm_loadu_ps (samples + i);
+        vpeak = _mm_max_ps (vpeak, _mm_andnot_ps (signMask, s));
+        vsum  = _mm_add_ps (vsum, _mm_mul_ps (s, s));
+    }
+
+    alignas (16) float peaks[4], sums[4];
+    _mm_store_ps (peaks, vpeak);
+    _mm_store_ps (sums, vsum);
+    peak = jmax (jmax (peaks[0], peaks[1]), jmax (peaks[2], peaks[3]));
+    sum  = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+   #elif JUCE_USE_ARM_NEON
+    float32x4_t vpeak = vdupq_n_f32 (0.f);
+    float32x4_t vsum  = vdupq_n_f32 (0.f);
+
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        const float32x4_t s = vld1q_f32 (samples + i);
+        vpeak = vmaxq_f32 (vpeak, vabsq_f32 (s));
+        vsum  = vmlaq_f32 (vsum, s, s);
+    }
+
+    float peaks[4], sums[4];
+    vst1q_f32 (peaks, vpeak);
+    vst1q_f32 (sums, vsum);
+    peak = jmax (jmax (peaks[0], peaks[1]), jmax (peaks[2], peaks[3]));
+    sum  = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+   #endif
+
+    for (; i < numSamples; ++i)
+    {
+        const float s = samples[i];
+        peak = jmax (peak, std::abs (s));
+        sum += s * s;
+    }
+
+    Level level;
+    level.peak = peak;
+    level.rms  = numSamples > 0 ? std::sqrt (sum / (float) numSamples) : 0.f;
+    return level;
+}
+
+void MeterBuffer::prepare (const int newNumChannels, const int newNumFrames)
+{
+    numChannels = jmax (0, newNumChannels);
+    numFrames   = nextPowerOfTwo (jmax (2, newNumFrames));
+    frames.calloc ((size_t) (numChannels * numFrames));
+    levels.calloc ((size_t) jmax (1, numChannels));
+    writeIndex.store (0);
+    readIndex.store (0);
+}
+
+void MeterBuffer::release()
+{
+    numChannels = numFrames = 0;
+    frames.free();
+    levels.free();
+}
+
+void MeterBuffer::write (const int channel, const Level level) noexcept
+{
+    if (! isPositiveAndBelow (channel, numChannels))
+        return;
+    const auto frame = writeIndex.load (std::memory_order_relaxed) % (uint32) numFrames;
+    frames[frame * (uint32) numChannels + (uint32) channel] = level;
+}
+
+void MeterBuffer::commit() noexcept
+{
+    if (numChannels <= 0)
+        return;
+
+    const auto write = writeIndex.load (std::memory_order_relaxed);
+    // keep one free slot so the frame being written is never being read
+    if (write - readIndex.load (std::memory_order_acquire) >= (uint32) numFrames - 1)
+        return;
+    writeIndex.store (write + 1, std::memory_order_release);
+}
+
+bool MeterBuffer::update()
+{
+    const auto write = writeIndex.load (std::memory_order_acquire);
+    auto read = readIndex.load (std::memory_order_relaxed);
+    if (read == write || numChannels <= 0)
+        return false;
+
+    const auto numNew = write - read;
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        float peak = 0.f, sumSquares = 0.f;
+        for (auto i = read; i != write; ++i)
+        {
+            const auto& level = frames[(i % (uint32) numFrames) * (uint32) numChannels + (uint32) ch];
+            peak = jmax (peak, level.peak);
+            sumSquares += level.rms * level.rms;
+        }
+
+        levels[ch].peak = peak;
+        levels[ch].rms  = std::sqrt (sumSquares / (float) numNew);
+    }
+
+    readIndex.store (write, std::memory_order_release);
+    return true;
+}
+
+MeterBuffer::Level MeterBuffer::getLevel (const int channel) const noexcept
+{
+    return isPositiveAndBelow (channel, numChannels) ? levels[channel] : Level();
+}
+
+}
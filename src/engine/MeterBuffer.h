@@ -0,0 +1,81 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+namespace Element {
+
+/** Levels of a node's ports, measured on the audio thread and read by the UI.
+
+    The audio thread writes one frame of levels per block. Frames go through
+    a small lock-free ring, and the message thread folds every frame written
+    since its last update into the levels it displays. If the ring is full,
+    the newest frame is dropped.
+ */
+class MeterBuffer final
+{
+public:
+    struct Level
+    {
+        float peak = 0.f;
+        float rms  = 0.f;
+    };
+
+    MeterBuffer() { }
+    ~MeterBuffer() { }
+
+    /** Measures peak and RMS of a block in one pass */
+    static Level measure (const float* samples, int numSamples) noexcept;
+
+    /** Allocates the ring. Call on the message thread while not rendering */
+    void prepare (int numChannels, int numFrames = 16);
+
+    /** Frees the ring */
+    void release();
+
+    /** Returns the number of channels being metered */
+    int getNumChannels() const noexcept { return numChannels; }
+
+    /** Sets the level of a channel in the frame being written. Audio thread only */
+    void write (int channel, Level level) noexcept;
+
+    /** Publishes the frame being written. Audio thread only */
+    void commit() noexcept;
+
+    /** Folds frames written since the last update into the current levels.
+        Returns true if there was anything new. Message thread only */
+    bool update();
+
+    /** Returns the level of a channel as of the last update */
+    Level getLevel (int channel) const noexcept;
+
+private:
+    int numChannels = 0;
+    int numFrames = 0;
+    HeapBlock<Level> frames;
+    HeapBlock<Level> levels;
+    std::atomic<uint32> writeIndex { 0 };
+    std::atomic<uint32> readIndex { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MeterBuffer)
+};
+
+}
@@ -0,0 +1,136 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+namespace Element {
+
+/** Finds the handlers listening for a MIDI controller or note in constant
+    time.
+
+    Handlers are added with the controller or note number and the channel
+    they listen on, then build() indexes them by message type, channel and
+    number. A handler on channel 0 listens on every channel. Once built,
+    the table is read only, so it can be swapped in atomically and read on
+    the MIDI thread without locking.
+ */
+template <class Handler>
+class MidiDispatchTable final
+{
+public:
+    MidiDispatchTable() = default;
+    ~MidiDispatchTable() = default;
+
+    /** A range of handlers, in the order they were added */
+    struct Range
+    {
+        Handler* const* first = nullptr;
+        Handler* const* last = nullptr;
+
+        Handler* const* begin() const noexcept  { return first; }
+        Handler* const* end() const noexcept    { return last; }
+        int size() const noexcept               { return (int) (last - first); }
+    };
+
+    /** Adds a handler for a controller or note number. Call before build() */
+    void add (Handler* handler, bool isController, int channel, int number)
+    {
+        jassert (isPositiveAndBelow (number, numNumbers));
+        jassert (channel >= 0 && channel <= numChannels);
+        entries.add ({ handler, isController, channel, number });
+    }
+
+    /** Indexes the handlers added so far */
+    void build()
+    {
+        starts.calloc ((size_t) numSlots + 1);
+
+        for (const auto& entry : entries)
+            forEachSlot (entry, [this] (int slot, Handler*) { ++starts[slot + 1]; });
+        for (int i = 0; i < numSlots; ++i)
+            starts[i + 1] += starts[i];
+
+        slots.calloc ((size_t) jmax (1, starts[numSlots]));
+        HeapBlock<int> fill (numSlots);
+        for (int i = 0; i < numSlots; ++i)
+            fill[i] = starts[i];
+        for (const auto& entry : entries)
+            forEachSlot (entry, [this, &fill] (int slot, Handler* handler) { slots[fill[slot]++] = handler; });
+
+        entries.clear();
+    }
+
+    /** Returns the handlers for a controller or note message */
+    Range lookup (const MidiMessage& message) const noexcept
+    {
+        if (starts == nullptr || message.getChannel() <= 0)
+            return {};
+
+        int slot = -1;
+        if (message.isController())
+            slot = getSlot (true, message.getChannel(), message.getControllerNumber());
+        else if (message.isNoteOnOrOff())
+            slot = getSlot (false, message.getChannel(), message.getNoteNumber());
+
+        if (slot < 0)
+            return {};
+
+        return { slots + starts[slot], slots + starts[slot + 1] };
+    }
+
+private:
+    enum { numChannels = 16, numNumbers = 128, numSlots = 2 * numChannels * numNumbers };
+
+    struct Entry
+    {
+        Handler* handler;
+        bool isController;
+        int channel;
+        int number;
+    };
+
+    Array<Entry> entries;
+    HeapBlock<int> starts;
+    HeapBlock<Handler*> slots;
+
+    static int getSlot (bool isController, int channel, int number) noexcept
+    {
+        return ((isController ? numChannels : 0) + channel - 1) * numNumbers + number;
+    }
+
+    template <class Callback>
+    static void forEachSlot (const Entry& entry, Callback&& callback)
+    {
+        if (entry.channel == 0)
+        {
+            for (int ch = 1; ch <= numChannels; ++ch)
+                callback (getSlot (entry.isController, ch, entry.number), entry.handler);
+        }
+        else
+        {
+            callback (getSlot (entry.isController, entry.channel, entry.number), entry.handler);
+        }
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (MidiDispatchTable)
+};
+
+}
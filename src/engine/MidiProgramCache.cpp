@@ -0,0 +1,276 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <iomanip>
+#include "engine/MidiProgramCache.h"
+#include "session/Node.h"
+
+#define EL_MIDI_PROGRAM_CACHE_POLL_MS   2000
+
+namespace Element {
+
+class MidiProgramCache::Loader : public TimeSliceThread,
+                                 private TimeSliceClient
+{
+public:
+    Loader() : TimeSliceThread ("MIDI Program Loader")
+    {
+        addTimeSliceClient (this);
+        startThread (3);
+    }
+
+    ~Loader()
+    {
+        removeTimeSliceClient (this);
+        stopThread (5000);
+    }
+
+    void add (MidiProgramCache* cache)
+    {
+        ScopedLock sl (cachesLock);
+        caches.addIfNotAlreadyThere (cache);
+    }
+
+    /** Waits if the cache is being scanned */
+    void remove (MidiProgramCache* cache)
+    {
+        ScopedLock ssl (scanLock);
+        ScopedLock sl (cachesLock);
+        caches.removeFirstMatchingValue (cache);
+    }
+
+    /** Scans every cache soon */
+    void refresh()
+    {
+        moveToFrontOfQueue (this);
+    }
+
+private:
+    CriticalSection scanLock, cachesLock;
+    Array<MidiProgramCache*> caches;
+
+    int useTimeSlice() override
+    {
+        ScopedLock ssl (scanLock);
+        Array<MidiProgramCache*> toScan;
+
+        {
+            ScopedLock sl (cachesLock);
+            toScan = caches;
+        }
+
+        // nodes of the same plugin share a folder, so list each one once
+        std::map<String, Listing> listings;
+        for (auto* const cache : toScan)
+        {
+            File dir;
+
+            {
+                ScopedLock sl (cache->lock);
+                if (cache->identifier.isEmpty())
+                    continue;
+                dir = cache->directory;
+            }
+
+            auto listing = listings.find (dir.getFullPathName());
+            if (listing == listings.end())
+                listing = listings.emplace (dir.getFullPathName(), listDirectory (dir)).first;
+            cache->scan (dir, listing->second);
+        }
+
+        return EL_MIDI_PROGRAM_CACHE_POLL_MS;
+    }
+};
+
+static std::shared_ptr<const MemoryBlock> decodeProgramFile (const File& file)
+{
+    const auto data = Node::parse (file).getProperty (Tags::state).toString().trim();
+    if (data.isEmpty())
+        return nullptr;
+
+    auto state = std::make_shared<MemoryBlock>();
+    if (! state->fromBase64Encoding (data) || state->getSize() <= 0)
+        return nullptr;
+    return state;
+}
+
+//=============================================================================
+MidiProgramCache::MidiProgramCache()
+{
+    loader->add (this);
+}
+
+MidiProgramCache::~MidiProgramCache()
+{
+    loader->remove (this);
+}
+
+File MidiProgramCache::getProgramFile (const File& directory, const String& identifier, int program)
+{
+    std::stringstream stream;
+    stream << identifier.toStdString() << "_" << std::setfill('0') << std::setw(3) << program << ".eln";
+    return directory.getChildFile (String (stream.str()));
+}
+
+void MidiProgramCache::setSource (const File& newDirectory, const String& newIdentifier)
+{
+    {
+        ScopedLock sl (lock);
+        if (directory == newDirectory && identifier == newIdentifier)
+            return;
+
+        directory = newDirectory;
+        identifier = newIdentifier;
+        for (auto& slot : slots)
+            slot = Slot();
+    }
+
+    refresh();
+}
+
+std::shared_ptr<const MemoryBlock> MidiProgramCache::getState (int program)
+{
+    if (! isPositiveAndBelow (program, 128))
+        return nullptr;
+
+    ScopedLock sl (lock);
+    auto state = slots[program].state;
+    if (state != nullptr)
+        ++stats.hits;
+    else
+        ++stats.misses;
+    return state;
+}
+
+void MidiProgramCache::refresh()
+{
+    loader->refresh();
+}
+
+void MidiProgramCache::refreshNow()
+{
+    File dir;
+
+    {
+        ScopedLock sl (lock);
+        dir = directory;
+    }
+
+    scan (dir, listDirectory (dir));
+}
+
+void MidiProgramCache::addLatency (double milliseconds)
+{
+    ScopedLock sl (lock);
+    ++stats.numChanges;
+    stats.averageLatencyMs += (milliseconds - stats.averageLatencyMs) / (double) stats.numChanges;
+    stats.maxLatencyMs = jmax (stats.maxLatencyMs, milliseconds);
+}
+
+MidiProgramCache::Stats MidiProgramCache::getStats() const
+{
+    ScopedLock sl (lock);
+    auto result = stats;
+    result.numCached = 0;
+    for (const auto& slot : slots)
+        if (slot.state != nullptr)
+            ++result.numCached;
+    return result;
+}
+
+size_t MidiProgramCache::getMemoryUsage() const
+{
+    ScopedLock sl (lock);
+    size_t bytes = 0;
+    for (const auto& slot : slots)
+        if (slot.state != nullptr)
+            bytes += slot.state->getSize();
+    return bytes;
+}
+
+MidiProgramCache::Listing MidiProgramCache::listDirectory (const File& dir)
+{
+    Listing listing;
+    if (! dir.isDirectory())
+        return listing;
+
+    DirectoryIterator iter (dir, false, "*.eln", File::findFiles);
+    int64 fileSize = 0;
+    Time modified;
+    while (iter.next (nullptr, nullptr, &fileSize, &modified, nullptr, nullptr))
+    {
+        auto& info = listing[iter.getFile().getFileName()];
+        info.modified = modified.toMilliseconds();
+        info.size = fileSize;
+    }
+
+    return listing;
+}
+
+void MidiProgramCache::scan (const File& listedDirectory, const Listing& listing)
+{
+    ScopedLock ssl (scanLock);
+
+    File dir;
+    String id;
+
+    {
+        ScopedLock sl (lock);
+        dir = directory;
+        id = identifier;
+    }
+
+    // the source changed since the listing, it'll be scanned again
+    if (id.isEmpty() || dir != listedDirectory)
+        return;
+
+    for (int program = 0; program < 128; ++program)
+    {
+        const auto file = getProgramFile (dir, id, program);
+        const auto info = listing.find (file.getFileName());
+        Slot slot;
+        slot.exists = info != listing.end();
+        if (slot.exists)
+        {
+            slot.modified = info->second.modified;
+            slot.size = info->second.size;
+        }
+
+        {
+            ScopedLock sl (lock);
+            if (id != identifier)
+                return; // source changed, it'll be scanned again
+            const auto& current = slots[program];
+            if (current.exists == slot.exists && current.modified == slot.modified
+                && current.size == slot.size)
+                continue;
+        }
+
+        // decode outside the lock so program changes aren't held up
+        if (slot.exists)
+            slot.state = decodeProgramFile (file);
+
+        ScopedLock sl (lock);
+        if (id != identifier)
+            return;
+        slots[program] = slot;
+    }
+}
+
+}
@@ -0,0 +1,116 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+namespace Element {
+
+/** Holds the decoded states of a node's global MIDI programs.
+
+    All 128 program files are read and decoded ahead of time on a background
+    thread shared by every cache, so a program change can be applied from
+    memory. Every couple of seconds, or straight away after a call to
+    refresh(), that thread lists each programs folder once for all the caches
+    using it, and a program is decoded again when its modification time or
+    size changes.
+ */
+class MidiProgramCache final
+{
+public:
+    struct Stats
+    {
+        /** Programs with a decoded state in memory */
+        int numCached = 0;
+
+        /** Requests served from memory and requests which weren't */
+        int64 hits = 0;
+        int64 misses = 0;
+
+        /** Program changes applied and the time from the change being
+            received to the state being set */
+        int64 numChanges = 0;
+        double averageLatencyMs = 0.0;
+        double maxLatencyMs = 0.0;
+    };
+
+    MidiProgramCache();
+    ~MidiProgramCache();
+
+    /** Returns the file a global program is saved to */
+    static File getProgramFile (const File& directory, const String& identifier, int program);
+
+    /** Sets where program files are found. Changing it forgets all programs
+        and loads the new ones in the background */
+    void setSource (const File& directory, const String& identifier);
+
+    /** Returns the decoded state of a program, or nullptr if it hasn't been
+        loaded or has no file */
+    std::shared_ptr<const MemoryBlock> getState (int program);
+
+    /** Checks the program files for changes in the background */
+    void refresh();
+
+    /** Checks the program files for changes on the calling thread */
+    void refreshNow();
+
+    /** Records how long a program change took to apply */
+    void addLatency (double milliseconds);
+
+    /** Returns counts and latencies since the cache was created */
+    Stats getStats() const;
+
+    /** Returns the number of bytes held by decoded states */
+    size_t getMemoryUsage() const;
+
+private:
+    class Loader;
+    SharedResourcePointer<Loader> loader;
+
+    struct Slot
+    {
+        bool exists = false;
+        int64 modified = 0;
+        int64 size = 0;
+        std::shared_ptr<const MemoryBlock> state;
+    };
+
+    struct FileInfo
+    {
+        int64 modified = 0;
+        int64 size = 0;
+    };
+
+    /** Program files found in a folder, by file name */
+    using Listing = std::map<String, FileInfo>;
+
+    CriticalSection lock, scanLock;
+    File directory;
+    String identifier;
+    Slot slots [128];
+    Stats stats;
+
+    static Listing listDirectory (const File& directory);
+    void scan (const File& listedDirectory, const Listing& listing);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidiProgramCache)
+};
+
+}
@@ -17,7 +17,6 @@
     Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 */
 
-#include <iomanip>
 #include "ElementApp.h"
 
 #include "engine/nodes/AudioProcessorNode.h"
@@ -40,7 +39,9 @@ NodeObject::NodeObject (const uint32 nodeId_) noexcept
       isPrepared (false),
       enablement (*this),
       midiProgramLoader (*this),
-      portResetter (*this)
+      portResetter (*this),
+      parameterNotifier (*this),
+      stateChangeListener (*this)
 {
     parent = nullptr;
     gain.set(1.0f); lastGain.set (1.0f);
@@ -63,6 +64,8 @@ void NodeObject::clearParameters()
     for (const auto* param : parameters)
         jassert(param->getReferenceCount() == 1);
    #endif
+    for (auto* param : parameters)
+        param->removeListener (&stateChangeListener);
     parameters.clear();
 }
 
@@ -188,19 +191,73 @@ bool NodeObject::isMidiDeviceNode() const
     return nullptr != dynamic_cast<MidiDeviceProcessor*> (getAudioProcessor());
 }
 
-int NodeObject::getNumAudioInputs()      const { return ports.size (PortType::Audio, true); }
-int NodeObject::getNumAudioOutputs()     const { return ports.size (PortType::Audio, false); }
+bool NodeObject::canSleep() const
+{
+    if (isAudioIONode() || isMidiIONode() || isMidiDeviceNode() || getNumAudioInputs() <= 0)
+        return false;
+
+    auto* const proc = getAudioProcessor();
+    // graphs can contain generators
+    if (proc == nullptr || dynamic_cast<GraphProcessor*> (proc) != nullptr)
+        return false;
+
+    // instruments may play on their own, e.g. arpeggiators
+    PluginDescription desc;
+    getPluginDescription (desc);
+    if (desc.isInstrument)
+        return false;
+
+    const auto tail = proc->getTailLengthSeconds();
+    // a zero tail is what most plugins report when they don't say, delays
+    // and reverbs included, so those keep running
+    return std::isfinite (tail) && tail > 0.0 && tail < 60.0;
+}
+
+bool NodeObject::postParameterEvent (const int parameter, const float value, const double timeMs) noexcept
+{
+    // events for a node which isn't rendering would be applied late, if ever
+    static constexpr double maxRenderGapMillis = 250.0;
+    const double renderTime = lastRenderTime.load (std::memory_order_acquire);
+    if (! isPrepared || sampleRate <= 0.0 || parameter < 0 ||
+        Time::getMillisecondCounterHiRes() - renderTime > maxRenderGapMillis)
+        return false;
 
-void NodeObject::setInputRMS (int chan, float val)
+    // parameters can be rebuilt on the message thread meanwhile, so the index
+    // is checked on the audio thread when the event is applied
+
+    // like MidiMessageCollector, events are delayed by one block so they
+    // keep their spacing. The graph clamps the offset to the block it renders.
+    ParameterEventQueue::Event event;
+    event.parameter = parameter;
+    event.value     = value;
+    event.frame     = jmax (0, roundToInt ((timeMs - renderTime) * 0.001 * sampleRate));
+    return parameterEvents.push (event);
+}
+
+void NodeObject::postParameterChange (const ParameterEventQueue::Event& event) noexcept
 {
-    if (chan < inRMS.size())
-        inRMS.getUnchecked(chan)->set(val);
+    // if the queue is full the value is still applied, only the
+    // notification is dropped
+    if (parameterChanges.push (event))
+        parameterNotifier.triggerAsyncUpdate();
 }
 
-void NodeObject::setOutputRMS (int chan, float val)
+void NodeObject::ParameterNotifier::handleAsyncUpdate()
 {
-    if (chan < outRMS.size())
-        outRMS.getUnchecked(chan)->set(val);
+    ParameterEventQueue::Event event;
+    while (node.parameterChanges.pop (event))
+        if (isPositiveAndBelow (event.parameter, node.parameters.size()))
+            node.parameters.getObjectPointerUnchecked (event.parameter)
+                ->sendValueChangedMessageToListeners (event.value);
+}
+
+int NodeObject::getNumAudioInputs()      const { return ports.size (PortType::Audio, true); }
+int NodeObject::getNumAudioOutputs()     const { return ports.size (PortType::Audio, false); }
+
+void NodeObject::updateMeters()
+{
+    inputMeter.update();
+    outputMeter.update();
 }
 
 bool NodeObject::isSuspended() const
@@ -296,23 +353,19 @@ int NodeObject::getNthPort (const PortType type, const int index, bool isInput,
 uint32 NodeObject::getMidiInputPort()  const { return getPortForChannel (PortType::Midi, 0, true); }
 uint32 NodeObject::getMidiOutputPort() const { return getPortForChannel (PortType::Midi, 0, false); }
 
-void NodeObject::prepare (const double newSampleRate, const int blockSize,
+void NodeObject::prepare (const double newSampleRate, const int newBlockSize,
                          GraphProcessor* const parentGraph,
                          bool willBeEnabled)
 {
     sampleRate = newSampleRate;
+    blockSize = newBlockSize;
     parent = parentGraph;
 
     if ((willBeEnabled || enabled.get() == 1) && !isPrepared)
     {
         isPrepared = true;
         setParentGraph (parentGraph); //<< ensures io nodes get setup
-
-        oversampler->prepare (jmax (getNumPorts (PortType::Audio, true), 
-                                    getNumPorts (PortType::Audio, false)), 
-                                    blockSize);
-        const int osFactor = jmax (1, getOversamplingFactor());
-        prepareToRender (sampleRate * osFactor, blockSize * osFactor);
+        prepareOversampling();
 
         // TODO: move model code out of engine code
         // VERIFY: this portion is actually needed. This was here to ensure
@@ -324,21 +377,8 @@ void NodeObject::prepare (const double newSampleRate, const int blockSize,
         if (metadata.getProperty (Tags::bypass, false))
             suspendProcessing (true);
 
-        inRMS.clearQuick (true);
-        for (int i = 0; i < getNumAudioInputs(); ++i)
-        {
-            AtomicValue<float>* avf = new AtomicValue<float>();
-            avf->set(0);
-            inRMS.add (avf);
-        }
-
-        outRMS.clearQuick (true);
-        for (int i = 0; i < getNumAudioOutputs(); ++i)
-        {
-            AtomicValue<float>* avf = new AtomicValue<float>();
-            avf->set(0);
-            outRMS.add(avf);
-        }
+        inputMeter.prepare (getNumAudioInputs());
+        outputMeter.prepare (getNumAudioOutputs());
     }
 }
 
@@ -349,8 +389,8 @@ void NodeObject::unprepare()
         isPrepared = false;
         releaseResources();
         oversampler->reset();
-        inRMS.clear (true);
-        outRMS.clear (true);
+        inputMeter.release();
+        outputMeter.release();
     }
 }
 
@@ -396,9 +436,55 @@ void NodeObject::EnablementUpdater::handleAsyncUpdate()
 
 void NodeObject::reloadMidiProgram()
 {
+    // keep the oldest request when changes arrive faster than they're applied
+    int64 noRequest = 0;
+    midiProgramRequestTicks.compare_exchange_strong (noRequest, Time::getHighResolutionTicks());
     midiProgramLoader.triggerAsyncUpdate();
 }
 
+void NodeObject::setUseGlobalMidiPrograms (bool use)
+{
+    globalMidiPrograms.set (use ? 1 : 0);
+    updateMidiProgramCache();
+}
+
+void NodeObject::setMidiProgramsEnabled (bool enabled)
+{
+    midiProgramsEnabled.set (enabled ? 1 : 0);
+    updateMidiProgramCache();
+}
+
+void NodeObject::updateMidiProgramCache()
+{
+    if (! areMidiProgramsEnabled() || ! useGlobalMidiPrograms())
+    {
+        midiProgramCache.reset();
+        return;
+    }
+
+    PluginDescription desc;
+    getPluginDescription (desc);
+    const auto uids = desc.createIdentifierString();
+    if (uids.isEmpty())
+        return;
+
+    if (midiProgramCache == nullptr)
+        midiProgramCache.reset (new MidiProgramCache());
+    midiProgramCache->setSource (DataPath::applicationDataDir().getChildFile ("NodeMidiPrograms"), uids);
+}
+
+void NodeObject::refreshMidiPrograms()
+{
+    if (midiProgramCache != nullptr)
+        midiProgramCache->refresh();
+}
+
+MidiProgramCache::Stats NodeObject::getMidiProgramStats() const
+{
+    return midiProgramCache != nullptr ? midiProgramCache->getStats()
+                                       : MidiProgramCache::Stats();
+}
+
 File NodeObject::getMidiProgramFile (int program) const
 {
     PluginDescription desc;
@@ -419,10 +505,8 @@ File NodeObject::getMidiProgramFile (int program) const
         return File();
     }
 
-    std::stringstream stream;
-    stream << uids.toStdString() << "_" << std::setfill('0') << std::setw(3) << program << ".eln";
-    String fileName = stream.str();
-    const File file (DataPath::applicationDataDir().getChildFile("NodeMidiPrograms").getChildFile(fileName));
+    const File file (MidiProgramCache::getProgramFile (
+        DataPath::applicationDataDir().getChildFile ("NodeMidiPrograms"), uids, program));
     if (! file.getParentDirectory().exists())
         file.getParentDirectory().createDirectory();
     return file;
@@ -453,6 +537,7 @@ void NodeObject::removeMidiProgram (int program, bool global)
         const auto file = getMidiProgramFile (program);
         if (file.existsAsFile())
             file.deleteFile();
+        refreshMidiPrograms();
     }
     else
     {
@@ -465,6 +550,19 @@ void NodeObject::removeMidiProgram (int program, bool global)
     }
 }
 
+size_t NodeObject::getMemoryUsage() const
+{
+    size_t bytes = sizeof (*this)
+        + (size_t) (parameterEvents.getCapacity() + parameterChanges.getCapacity())
+            * sizeof (ParameterEventQueue::Event);
+    for (const auto* const program : midiPrograms)
+        bytes += sizeof (MidiProgram) + program->state.getSize();
+    if (midiProgramCache != nullptr)
+        bytes += sizeof (MidiProgramCache) + midiProgramCache->getMemoryUsage();
+    bytes += oversampler->getMemoryUsage();
+    return bytes;
+}
+
 NodeObject::MidiProgram* NodeObject::getMidiProgram (int program) const
 {
     if (! isPositiveAndBelow (program, 128))
@@ -479,9 +577,9 @@ NodeObject::MidiProgram* NodeObject::getMidiProgram (int program) const
 
 void NodeObject::MidiProgramLoader::handleAsyncUpdate()
 {
-    const File programFile = node.getMidiProgramFile();
     const bool globalPrograms = node.useGlobalMidiPrograms();
     const auto requestedProgram = node.getMidiProgram();
+    const auto requestTicks = node.midiProgramRequestTicks.exchange (0);
    #if 0
     if (node.lastMidiProgram.get() == requestedProgram)
     {
@@ -492,25 +590,38 @@ void NodeObject::MidiProgramLoader::handleAsyncUpdate()
 
     if (globalPrograms)
     {
-        if (programFile.existsAsFile())
+        std::shared_ptr<const MemoryBlock> state;
+        if (node.midiProgramCache != nullptr)
+            state = node.midiProgramCache->getState (requestedProgram);
+
+        // not decoded yet, read it here
+        const File programFile = state == nullptr ? node.getMidiProgramFile() : File();
+        if (state == nullptr && programFile.existsAsFile())
         {
             const auto programData = Node::parse (programFile);
             auto data = programData.getProperty(Tags::state).toString().trim();
             if (data.isNotEmpty())
             {
-                MemoryBlock state;
-                state.fromBase64Encoding (data);
-                if (state.getSize() > 0)
-                {
-                    node.lastMidiProgram.set (requestedProgram);
-                    node.setState (state.getData(), (int) state.getSize());
-                    DBG("[EL] loaded program: " << requestedProgram);
-                }
+                auto decoded = std::make_shared<MemoryBlock>();
+                decoded->fromBase64Encoding (data);
+                state = decoded;
             }
         }
-        else
+
+        if (state != nullptr && state->getSize() > 0)
+        {
+            node.lastMidiProgram.set (requestedProgram);
+            node.setState (state->getData(), (int) state->getSize());
+            node.markStateChanged();
+            DBG("[EL] loaded program: " << requestedProgram);
+
+            if (requestTicks > 0 && node.midiProgramCache != nullptr)
+                node.midiProgramCache->addLatency (1000.0 * Time::highResolutionTicksToSeconds (
+                    Time::getHighResolutionTicks() - requestTicks));
+        }
+        else if (state == nullptr)
         {
-            DBG("[EL] Program file doesn't exist: " << node.getMidiProgramFile().getFileName());
+            DBG("[EL] Program file doesn't exist: " << programFile.getFileName());
         }
     }
     else
@@ -519,6 +630,7 @@ void NodeObject::MidiProgramLoader::handleAsyncUpdate()
         {
             node.setState (program->state.getData(), 
                            static_cast<int> (program->state.getSize()));
+            node.markStateChanged();
         }
         else
         {
@@ -666,6 +778,8 @@ void NodeObject::resetPorts()
     metadata.addChild (portList, 1, nullptr);
     jassert (metadata.getChildWithName(Tags::ports).getNumChildren() == ports.size());
     
+    for (auto* param : parameters)
+        param->removeListener (&stateChangeListener);
     parameters.clear();
     for (int i = 0; i < ports.size(); ++i)
     {
@@ -673,6 +787,9 @@ void NodeObject::resetPorts()
         if (port.input && port.type == PortType::Control)
             parameters.add (getOrCreateParameter (port));
     }
+
+    for (auto* param : parameters)
+        param->addListener (&stateChangeListener);
     
     struct ParamSorter
     {
@@ -712,44 +829,71 @@ void NodeObject::setMuted (bool muted)
 
 dsp::Oversampling<float>* NodeObject::getOversamplingProcessor()
 {
-    return oversampler->getProcessor (osPow - 1);
+    return oversampler->getProcessor();
 }
 
-void NodeObject::setOversamplingFactor (int osFactor)
+void NodeObject::prepareOversampling()
 {
-    const auto newOsPow = (int) log2f ((float) osFactor);
+    oversampler->prepare (jmax (getNumPorts (PortType::Audio, true), 
+                                getNumPorts (PortType::Audio, false)), 
+                                blockSize);
+    osLatency = oversampler->getLatencySamples();
+    auto* const osProc = getOversamplingProcessor();
+    const int osFactor = osProc != nullptr ? (int) osProc->getOversamplingFactor() : 1;
+    prepareToRender (sampleRate * osFactor, blockSize * osFactor);
+}
 
+void NodeObject::setOversamplingFactor (int osFactor)
+{
     {
         ScopedLock sl (getPropertyLock());
-        if (newOsPow == osPow)
+        const auto oldFactor = oversampler->getFactor();
+        oversampler->setFactor (osFactor);
+        if (oldFactor == oversampler->getFactor())
             return;
+    }
 
-        if (osFactor > 1)
-        {
-            osPow = (int) log2f ((float) osFactor);
-            if (auto* const osProc = getOversamplingProcessor())
-                osLatency = osProc->getLatencyInSamples();
-        }
-        else
-        {
-            osPow = 0;
-            osLatency = 0.0;
-        }
+    oversamplingChanged();
+}
+
+void NodeObject::oversamplingChanged()
+{
+    if (! isPrepared)
+        return;
+
+    {
+        // the processor runs at the oversampled rate, so it's prepared again too
+        ScopedLock sl (renderLock);
+        releaseResources();
+        prepareOversampling();
     }
 
     if (auto* g = getParentGraph())
-        g->triggerAsyncUpdate();
+        g->nodeLatencyChanged();
 }
 
 int NodeObject::getOversamplingFactor()
 {
-    if (osPow > 0)
+    return oversampler->getFactor();
+}
+
+void NodeObject::setOversamplingQuality (int quality)
+{
     {
-        if (auto* osProc = getOversamplingProcessor())
-            return static_cast<int> (osProc->getOversamplingFactor());
+        ScopedLock sl (getPropertyLock());
+        const auto newQuality = quality == Oversampler<float>::linearPhaseFIR
+            ? Oversampler<float>::linearPhaseFIR : Oversampler<float>::lowLatencyIIR;
+        if (newQuality == oversampler->getQuality())
+            return;
+        oversampler->setQuality (newQuality);
     }
-    
-    return 1;
+
+    oversamplingChanged();
+}
+
+int NodeObject::getOversamplingQuality()
+{
+    return static_cast<int> (oversampler->getQuality());
 }
 
 //=========================================================================
@@ -760,6 +904,8 @@ void NodeObject::setDelayCompensation (double delayMs)
     delayCompMillis = delayMs;
     jassert (sampleRate > 0.0);
     delayCompSamples = roundToInt (delayCompMillis * 0.001 * sampleRate);
+    if (parent != nullptr)
+        parent->nodeLatencyChanged();
 }
 
 double NodeObject::getDelayCompensation()        const { return delayCompMillis; }
@@ -832,14 +978,15 @@ void NodeObject::triggerPortReset()
 //=========================================================================
 int NodeObject::getLatencySamples() const
 {
-    return latencySamples + delayCompSamples + roundFloatToInt (osLatency);
+    return latencySamples.load() + delayCompSamples + roundFloatToInt (osLatency);
 }
 
 void NodeObject::setLatencySamples (int latency)
 {
-    if (latency == latencySamples)
+    if (latencySamples.exchange (latency) == latency)
         return;
-    latencySamples = latency;
+    if (parent != nullptr)
+        parent->nodeLatencyChanged();
 }
 
 //=========================================================================
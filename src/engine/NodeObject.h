@@ -20,9 +20,12 @@
 #pragma once
 
 #include "ElementApp.h"
+#include "engine/MeterBuffer.h"
 #include "engine/MidiPipe.h"
+#include "engine/MidiProgramCache.h"
 #include "engine/Oversampler.h"
 #include "engine/Parameter.h"
+#include "engine/ParameterEventQueue.h"
 
 namespace Element {
 
@@ -196,15 +199,59 @@ public:
     bool isMidiIONode() const;
     bool isMidiDeviceNode() const;
 
+    /** Returns true if the graph may skip rendering this node while its
+        inputs are silent and its tail has played out. Nodes which make
+        sound on their own should return false. By default only effects
+        with audio inputs and a finite, non-zero tail can sleep.
+     */
+    virtual bool canSleep() const;
+
     /* Returns the parent graph.
        If one has not been set, then this will return nullptr.
      */
     GraphProcessor* getParentGraph() const;
 
-    void setInputRMS (int chan, float val);
-    float getInputRMS(int chan) const { return (chan < inRMS.size()) ? inRMS.getUnchecked(chan)->get() : 0.0f; }
-    void setOutputRMS (int chan, float val);
-    float getOutputRMS (int chan) const { return (chan < outRMS.size()) ? outRMS.getUnchecked(chan)->get() : 0.0f; }
+    //=========================================================================
+    /** Levels are only measured while at least one subscriber wants them.
+        Call these from the message thread, e.g. when a meter is shown.
+     */
+    void addMeterSubscriber() noexcept          { ++meterSubscribers; }
+    void removeMeterSubscriber() noexcept       { jassert (meterSubscribers.load() > 0); --meterSubscribers; }
+
+    /** Returns true if anything is subscribed to this node's levels */
+    bool isMetering() const noexcept            { return meterSubscribers.load (std::memory_order_relaxed) > 0; }
+
+    /** Meters written by the graph while rendering */
+    MeterBuffer& getInputMeter() noexcept       { return inputMeter; }
+    MeterBuffer& getOutputMeter() noexcept      { return outputMeter; }
+
+    /** Picks up levels written since the last call. Message thread only */
+    void updateMeters();
+
+    float getInputRMS (int chan) const          { return inputMeter.getLevel (chan).rms; }
+    float getOutputRMS (int chan) const         { return outputMeter.getLevel (chan).rms; }
+
+    //=========================================================================
+    /** Queues a parameter change to be applied on the audio thread.
+
+        The time is on the Time::getMillisecondCounterHiRes() clock and is
+        mapped to a sample offset in the next block this node renders. Returns
+        false if nothing was queued, because the node isn't being rendered or
+        the queue is full. Callers should then set the parameter directly.
+        Indexes past the node's parameters are dropped when applied.
+     */
+    bool postParameterEvent (int parameter, float value, double timeMs = 0.0) noexcept;
+
+    /** Return true if render() can be called with parts of a block, so that
+        queued parameter events take effect on the exact sample they were
+        timed for. Otherwise they are applied at the start of the block.
+     */
+    virtual bool canSplitBlocks() const { return false; }
+
+    /** Returns an estimate of the memory in bytes the host allocated to
+        render this node. Memory a plugin allocates itself isn't included.
+     */
+    virtual size_t getMemoryUsage() const;
 
     //=========================================================================
     /** Connect this node's output audio to another node's input audio */
@@ -249,14 +296,14 @@ public:
     inline bool useGlobalMidiPrograms() const          { return globalMidiPrograms.get() == 1; }
 
     /** Change usage of global midi programs to on or off */
-    inline void setUseGlobalMidiPrograms (bool use)    { globalMidiPrograms.set (use ? 1 : 0); }
+    void setUseGlobalMidiPrograms (bool use);
 
     /** True if MIDI programs should be loaded when Program change messages
         are received */
     inline bool areMidiProgramsEnabled() const         { return midiProgramsEnabled.get() == 1; }
 
     /** Enable or disable changing midi programs */
-    inline void setMidiProgramsEnabled (bool enabled)  { midiProgramsEnabled.set (enabled ? 1 : 0); }
+    void setMidiProgramsEnabled (bool enabled);
 
     /** Returns the active midi program */
     inline int getMidiProgram() const                  { return midiProgram.get(); }
@@ -279,6 +326,13 @@ public:
     /** Removes a MIDI Program */
     void removeMidiProgram (int program, bool global);
 
+    /** Checks global MIDI program files for changes in the background. Call
+        this after writing a program file */
+    void refreshMidiPrograms();
+
+    /** Returns cache and latency stats for global MIDI programs */
+    MidiProgramCache::Stats getMidiProgramStats() const;
+
     /** Get all MIDI program states stored directly on the node */
     void getMidiProgramsState (String& state) const;
 
@@ -336,10 +390,32 @@ public:
     virtual void getState (MemoryBlock&) = 0;
     virtual void setState (const void*, int sizeInBytes) = 0;
 
+    /** Flags the state as changed since the session last captured it. Parameter
+        changes and MIDI program loads do this automatically. Safe to call from
+        any thread.
+     */
+    void markStateChanged() noexcept            { stateChanged.store (true, std::memory_order_relaxed); }
+
+    /** Returns true if the state changed since clearStateChanged() was called */
+    bool hasStateChanged() const noexcept       { return stateChanged.load (std::memory_order_relaxed); }
+
+    /** Clears the changed flag. Returns true if it was set */
+    bool clearStateChanged() noexcept           { return stateChanged.exchange (false); }
+
     //=========================================================================
+    /** Sets the oversampling factor, a power of two from 1 to 8. Stages are
+        only allocated above 1. A prepared node is prepared again right away */
     void setOversamplingFactor (int osFactor);
+
+    /** Returns the oversampling factor set */
     int getOversamplingFactor();
 
+    /** Sets the oversampling filters, a value of Oversampler::Quality */
+    void setOversamplingQuality (int quality);
+
+    /** Returns the oversampling filters set */
+    int getOversamplingQuality();
+
     //=========================================================================
     void setDelayCompensation (double delayMs);
     double getDelayCompensation() const;
@@ -387,7 +463,8 @@ protected:
     }
 
     //==========================================================================
-    /** Set latency samples */
+    /** Set latency samples. The parent graph is told when it changes, so
+        this can be called from any thread */
     void setLatencySamples (int latency);
 
     //==========================================================================
@@ -415,13 +492,39 @@ private:
     Atomic<int> muteInput { 0 };
 
     double sampleRate = 0.0;
-    int latencySamples = 0;
+    int blockSize = 0;
+    std::atomic<int> latencySamples { 0 };
     String name;
 
     ParameterArray parameters;
 
     Atomic<float> gain, lastGain, inputGain, lastInputGain;
-    OwnedArray<AtomicValue<float> > inRMS, outRMS;
+    MeterBuffer inputMeter, outputMeter;
+    std::atomic<int> meterSubscribers { 0 };
+
+    ParameterEventQueue parameterEvents;
+
+    // values the audio thread applied from parameterEvents, so listeners
+    // can be told about them on the message thread
+    ParameterEventQueue parameterChanges;
+    void postParameterChange (const ParameterEventQueue::Event&) noexcept;
+    struct ParameterNotifier : public AsyncUpdater
+    {
+        ParameterNotifier (NodeObject& n) : node (n) { }
+        ~ParameterNotifier() { cancelPendingUpdate(); }
+        void handleAsyncUpdate() override;
+        NodeObject& node;
+    } parameterNotifier;
+
+    std::atomic<bool> stateChanged { true };
+    struct StateChangeListener : public Parameter::Listener
+    {
+        StateChangeListener (NodeObject& n) : node (n) { }
+        void controlValueChanged (int, float) override  { node.markStateChanged(); }
+        void controlTouched (int, bool) override        { }
+        NodeObject& node;
+    } stateChangeListener;
+    std::atomic<double> lastRenderTime { 0.0 };
     
     Atomic<int> keyRangeLow { 0 };
     Atomic<int> keyRangeHigh { 127 };
@@ -450,6 +553,10 @@ private:
         NodeObject& node;    
     } midiProgramLoader;
 
+    std::unique_ptr<MidiProgramCache> midiProgramCache;
+    std::atomic<int64> midiProgramRequestTicks { 0 };
+    void updateMidiProgramCache();
+
     friend struct PortResetter;
     struct PortResetter : public AsyncUpdater
     {
@@ -474,9 +581,14 @@ private:
     void resetPorts();
 
     std::unique_ptr<Oversampler<float>> oversampler;
-    int osPow = 0;
     float osLatency = 0.0f;
     dsp::Oversampling<float>* getOversamplingProcessor();
+    void prepareOversampling();
+    void oversamplingChanged();
+
+    // held while the oversampler and processor are prepared again, the audio
+    // thread skips the node for blocks where it can't get it
+    CriticalSection renderLock;
 
     Parameter::Ptr getOrCreateParameter (const PortDescription&);
 
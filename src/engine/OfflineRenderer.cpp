@@ -0,0 +1,212 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "engine/GraphProcessor.h"
+#include "engine/OfflineRenderer.h"
+
+namespace Element {
+
+OfflineRenderer::OfflineRenderer (AudioEngine& e)
+    : engine (e)
+{
+    jassert (engine.getRunMode() == RunMode::Offline);
+}
+
+OfflineRenderer::~OfflineRenderer() { }
+
+void OfflineRenderer::setNonRealtime (const bool isNonRealtime)
+{
+    for (int i = 0;; ++i)
+    {
+        auto* const graph = engine.getGraph (i);
+        if (graph == nullptr)
+            break;
+
+        graph->setNonRealtime (isNonRealtime);
+        for (int j = 0; j < graph->getNumNodes(); ++j)
+            if (auto* const proc = graph->getNode (j)->getAudioProcessor())
+                proc->setNonRealtime (isNonRealtime);
+    }
+}
+
+Result OfflineRenderer::render (const Options& options)
+{
+    renderedSeconds = realtimeFactor = 0.0;
+
+    static constexpr int maxChannels = 64;
+    if (options.sampleRate <= 0.0 || options.blockSize <= 0 ||
+        ! isPositiveAndNotGreaterThan (options.numOutputs, maxChannels) ||
+        ! isPositiveAndNotGreaterThan (options.numInputs, maxChannels))
+        return Result::fail ("Invalid sample rate, block size or channel count");
+
+    AudioFormatManager formats;
+    formats.registerBasicFormats();
+
+    // inputs
+    OwnedArray<AudioFormatReader> readers;
+    OwnedArray<AudioSampleBuffer> readBuffers;
+    int64 totalFrames = 0;
+    int numInputChannels = 0;
+    for (const auto& file : options.inputFiles)
+    {
+        std::unique_ptr<AudioFormatReader> reader (formats.createReaderFor (file));
+        if (reader == nullptr)
+            return Result::fail ("Could not read input file: " + file.getFullPathName());
+        if (reader->sampleRate != options.sampleRate)
+            return Result::fail ("Sample rate of " + file.getFileName() + " doesn't match the render");
+
+        numInputChannels += (int) reader->numChannels;
+        totalFrames = jmax (totalFrames, reader->lengthInSamples);
+        readBuffers.add (new AudioSampleBuffer ((int) reader->numChannels, options.blockSize));
+        readers.add (reader.release());
+    }
+
+    if (numInputChannels > options.numInputs)
+        return Result::fail ("Input files have more channels than the engine has inputs");
+
+    MidiMessageSequence midiSequence;
+    if (options.midiFile != File())
+    {
+        FileInputStream stream (options.midiFile);
+        MidiFile midiFile;
+        if (! stream.openedOk() || ! midiFile.readFrom (stream))
+            return Result::fail ("Could not read MIDI file: " + options.midiFile.getFullPathName());
+
+        midiFile.convertTimestampTicksToSeconds();
+        for (int i = 0; i < midiFile.getNumTracks(); ++i)
+            midiSequence.addSequence (*midiFile.getTrack (i), 0.0);
+        midiSequence.updateMatchedPairs();
+        totalFrames = jmax (totalFrames, (int64) std::ceil (midiSequence.getEndTime() * options.sampleRate));
+    }
+
+    if (options.lengthSeconds > 0.0)
+        totalFrames = (int64) std::ceil (options.lengthSeconds * options.sampleRate);
+    else
+        totalFrames += (int64) std::ceil (jmax (0.0, options.tailSeconds) * options.sampleRate);
+
+    if (totalFrames <= 0)
+        return Result::fail ("Nothing to render, give a length or some inputs");
+
+    // output
+    auto* const format = formats.findFormatForFileExtension (options.outputFile.getFileExtension());
+    if (format == nullptr)
+        return Result::fail ("Unsupported output format: " + options.outputFile.getFileName());
+    if (! format->getPossibleBitDepths().contains (options.bitDepth))
+        return Result::fail (format->getFormatName() + " can't be written with " + String (options.bitDepth) + " bits");
+
+    options.outputFile.deleteFile();
+    std::unique_ptr<FileOutputStream> stream (options.outputFile.createOutputStream());
+    if (stream == nullptr || ! stream->openedOk())
+        return Result::fail ("Could not write to " + options.outputFile.getFullPathName());
+
+    std::unique_ptr<AudioFormatWriter> writer (format->createWriterFor (stream.get(), options.sampleRate,
+        (unsigned int) options.numOutputs, options.bitDepth, {}, 0));
+    if (writer == nullptr)
+        return Result::fail ("Could not create a " + format->getFormatName() + " writer");
+    stream.release(); // the writer owns it now
+
+    // engine
+    engine.prepareExternalPlayback (options.sampleRate, options.blockSize,
+                                    options.numInputs, options.numOutputs);
+    engine.updateExternalLatencySamples();
+    for (int i = 0;; ++i)
+    {
+        auto* const graph = engine.getGraph (i);
+        if (graph == nullptr)
+            break;
+        graph->handleUpdateNowIfNeeded();
+    }
+
+    setNonRealtime (true);
+    engine.seekToAudioFrame (0);
+    engine.setPlaying (true);
+
+    const int latency = options.compensateLatency ? engine.getExternalLatencySamples() : 0;
+    const int numChannels = jmax (options.numInputs, options.numOutputs);
+    AudioSampleBuffer buffer (numChannels, options.blockSize);
+    MidiBuffer midi;
+    midi.ensureSize (4096);
+
+    int nextMidiEvent = 0;
+    int64 inputFrame = 0, written = 0;
+    const int64 framesToProcess = totalFrames + latency;
+    const auto startTime = Time::getMillisecondCounterHiRes();
+
+    while (inputFrame < framesToProcess)
+    {
+        const int numSamples = (int) jmin ((int64) options.blockSize, framesToProcess - inputFrame);
+        buffer.setSize (numChannels, numSamples, false, false, true);
+        buffer.clear();
+
+        int channel = 0;
+        for (int i = 0; i < readers.size(); ++i)
+        {
+            auto& input = *readBuffers.getUnchecked (i);
+            input.setSize (input.getNumChannels(), numSamples, false, false, true);
+            readers.getUnchecked (i)->read (&input, 0, numSamples, inputFrame, true, true);
+            for (int ch = 0; ch < input.getNumChannels(); ++ch)
+                buffer.copyFrom (channel++, 0, input, ch, 0, numSamples);
+        }
+
+        midi.clear();
+        for (; nextMidiEvent < midiSequence.getNumEvents(); ++nextMidiEvent)
+        {
+            const auto& message = midiSequence.getEventPointer (nextMidiEvent)->message;
+            const auto frame = roundToInt (message.getTimeStamp() * options.sampleRate) - inputFrame;
+            if (frame >= numSamples)
+                break;
+            if (! message.isMetaEvent())
+                midi.addEvent (message, (int) jmax ((int64) 0, frame));
+        }
+
+        engine.processExternalBuffers (buffer, midi);
+
+        // skip the engine's latency at the start
+        const int skip = (int) jlimit ((int64) 0, (int64) numSamples, latency - inputFrame);
+        if (skip < numSamples)
+        {
+            const float* outputs[maxChannels] = {};
+            for (int i = 0; i < options.numOutputs; ++i)
+                outputs[i] = buffer.getReadPointer (i, skip);
+            if (! writer->writeFromFloatArrays (outputs, options.numOutputs, numSamples - skip))
+                break;
+            written += numSamples - skip;
+        }
+
+        inputFrame += numSamples;
+        if (onProgress)
+            onProgress ((double) inputFrame / (double) framesToProcess);
+    }
+
+    const auto elapsed = (Time::getMillisecondCounterHiRes() - startTime) * 0.001;
+
+    engine.setPlaying (false);
+    setNonRealtime (false);
+    engine.releaseExternalResources();
+    writer.reset();
+
+    renderedSeconds = (double) written / options.sampleRate;
+    realtimeFactor = elapsed > 0.0 ? renderedSeconds / elapsed : 0.0;
+
+    if (written < totalFrames)
+        return Result::fail ("Could not write all audio to " + options.outputFile.getFullPathName());
+    return Result::ok();
+}
+
+}
@@ -0,0 +1,87 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "engine/AudioEngine.h"
+
+namespace Element {
+
+/** Renders an engine's session to a file as fast as the CPU allows.
+
+    Audio files are fed to the engine's inputs and a MIDI file to its MIDI
+    input, block by block through AudioEngine::processExternalBuffers().
+    The transport starts playing from zero on the first block, so the same
+    session and inputs always produce the same output. Use it with an
+    engine created with RunMode::Offline.
+ */
+class OfflineRenderer final
+{
+public:
+    struct Options
+    {
+        double sampleRate   = 48000.0;
+        int blockSize       = 512;
+        int numInputs       = 2;
+        int numOutputs      = 2;
+
+        /** Files played into the engine's inputs, their channels in order */
+        Array<File> inputFiles;
+
+        /** A standard MIDI file played into the engine's MIDI input */
+        File midiFile;
+
+        /** The file to write. The format is picked from its extension */
+        File outputFile;
+        int bitDepth        = 24;
+
+        /** Length of the render. If zero, the longest input plus the tail */
+        double lengthSeconds = 0.0;
+        double tailSeconds   = 2.0;
+
+        /** Trims the engine's latency from the start of the output */
+        bool compensateLatency = true;
+    };
+
+    explicit OfflineRenderer (AudioEngine& engine);
+    ~OfflineRenderer();
+
+    /** Renders the session with the given options. Call on the message thread */
+    Result render (const Options& options);
+
+    /** Number of seconds of audio written by the last render */
+    double getRenderedSeconds() const noexcept  { return renderedSeconds; }
+
+    /** How many times faster than realtime the last render ran */
+    double getRealtimeFactor() const noexcept   { return realtimeFactor; }
+
+    /** Progress of the current render from 0 to 1 */
+    std::function<void (double)> onProgress;
+
+private:
+    AudioEngine& engine;
+    double renderedSeconds = 0.0;
+    double realtimeFactor = 0.0;
+
+    void setNonRealtime (bool isNonRealtime);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (OfflineRenderer)
+};
+
+}
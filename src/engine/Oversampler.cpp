@@ -5,56 +5,86 @@ namespace Element {
 template <typename T>
 Oversampler<T>::~Oversampler()
 {
-    reset();
-    processors.clear (true);
+    processor.reset();
 }
 
 template <typename T>
-float Oversampler<T>::getLatencySamples (int index) const
+int Oversampler<T>::getNumStages (int f) noexcept
 {
-    if (auto* const proc = getProcessor (index))
-        return proc->getLatencyInSamples();
-    return 0.f;
+    int stages = 0;
+    for (; f > 1; f >>= 1)
+        ++stages;
+    return stages;
 }
 
 template <typename T>
-int Oversampler<T>::getFactor (int index) const
+void Oversampler<T>::setFactor (int newFactor)
 {
-    if (auto* const proc = getProcessor (index))
-        return static_cast<int> (proc->getOversamplingFactor());
-    return 1;
+    factor = jlimit (1, (int) maxFactor, nextPowerOfTwo (jmax (1, newFactor)));
 }
 
 template <typename T>
-void Oversampler<T>::prepare (int numChannels, int blockSize)
+float Oversampler<T>::getLatencySamples() const
 {
-    reset();
+    if (processor != nullptr)
+        return processor->getLatencyInSamples();
+    return 0.f;
+}
 
+template <typename T>
+void Oversampler<T>::prepare (int numChannels, int blockSize)
+{
     numChannels = jmax (1, numChannels);
-    
-    if (processors.size() <= 0 || channels != numChannels || buffer != blockSize)
+
+    if (factor <= 1)
     {
-        buffer      = blockSize;
-        channels    = numChannels;
-        processors.clear();
-        for (int f = 0; f < maxProc; ++f)
-            processors.add (new ProcessorType (channels, f + 1,
-                ProcessorType::FilterType::filterHalfBandPolyphaseIIR));
-       
+        processor.reset();
+        channels = buffer = 0;
+        preparedFactor = 1;
+        return;
     }
 
-    for (auto* proc : processors)
-        proc->initProcessing (buffer);
+    if (processor == nullptr || channels != numChannels || buffer != blockSize
+        || preparedFactor != factor || preparedQuality != quality)
+    {
+        buffer          = blockSize;
+        channels        = numChannels;
+        preparedFactor  = factor;
+        preparedQuality = quality;
+
+        const auto filterType = quality == linearPhaseFIR
+            ? ProcessorType::FilterType::filterHalfBandFIREquiripple
+            : ProcessorType::FilterType::filterHalfBandPolyphaseIIR;
+        processor.reset (new ProcessorType ((size_t) channels, (size_t) getNumStages (factor), filterType));
+        processor->initProcessing ((size_t) buffer);
+    }
+    else
+    {
+        processor->reset();
+    }
 }
 
 template <typename T>
 void Oversampler<T>::reset()
 {
-    for (auto* const proc : processors)
-        proc->reset();
+    if (processor != nullptr)
+        processor->reset();
+}
+
+template <typename T>
+size_t Oversampler<T>::getMemoryUsage() const
+{
+    if (processor == nullptr)
+        return 0;
+
+    // each stage buffers its output at that stage's rate
+    size_t bytes = sizeof (ProcessorType);
+    for (int stage = 1; stage <= getNumStages (preparedFactor); ++stage)
+        bytes += (size_t) channels * (size_t) (buffer << stage) * sizeof (T);
+    return bytes;
 }
 
 template class Oversampler<float>;
-template class Oversampler<double>; 
+template class Oversampler<double>;
 
 }
@@ -23,28 +23,73 @@
 
 namespace Element {
 
+/** Oversamples a node's audio.
+
+    Nothing is allocated while the factor is 1, which is nearly every node.
+    Otherwise one dsp::Oversampling is built for the chosen factor and filter
+    quality when prepared. Changing either only takes effect on the next call
+    to prepare().
+ */
 template <typename SampleType>
 class Oversampler final
 {
 public:
     using ProcessorType = juce::dsp::Oversampling<SampleType>;
-    
+
+    enum Quality
+    {
+        /** Polyphase IIR half band filters, low latency but not linear phase */
+        lowLatencyIIR = 0,
+
+        /** Equiripple FIR half band filters, linear phase with more latency */
+        linearPhaseFIR
+    };
+
+    enum { maxFactor = 8 };
+
     Oversampler() = default;
     ~Oversampler();
 
-    int getNumProcessors()                      const { return processors.size(); }
-    ProcessorType* getProcessor (int index)     const { return processors [index]; }
-    
-    float getLatencySamples (int index) const;
-    int getFactor (int index) const;
+    /** Sets the factor to use. Rounded up to a power of two from 1 to 8 */
+    void setFactor (int newFactor);
+
+    /** Returns the factor set, which may not be prepared yet */
+    int getFactor() const noexcept                  { return factor; }
+
+    /** Sets the filters to use */
+    void setQuality (Quality newQuality)            { quality = newQuality; }
+
+    /** Returns the filters set, which may not be prepared yet */
+    Quality getQuality() const noexcept             { return quality; }
+
+    /** Returns the processor built when last prepared, or nullptr if the
+        factor was 1 */
+    ProcessorType* getProcessor() const noexcept    { return processor.get(); }
+
+    /** Returns the latency of the prepared processor */
+    float getLatencySamples() const;
+
+    /** Builds the processor if the factor is above 1, or frees it if not */
     void prepare (int numChannels, int blockSize);
+
+    /** Clears the filter state */
     void reset();
 
+    /** Returns roughly how many bytes the processor holds. This is its
+        stage buffers, which are nearly all of it */
+    size_t getMemoryUsage() const;
+
 private:
-    enum { maxProc = 3 };
+    int factor = 1;
+    Quality quality = lowLatencyIIR;
+
     int channels = 0,
-        buffer = 0;
-    OwnedArray<ProcessorType> processors;
+        buffer = 0,
+        preparedFactor = 1;
+    Quality preparedQuality = lowLatencyIIR;
+    std::unique_ptr<ProcessorType> processor;
+
+    static int getNumStages (int factor) noexcept;
 };
 
 }
@@ -0,0 +1,85 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "engine/ParameterEventQueue.h"
+
+namespace Element {
+
+ParameterEventQueue::ParameterEventQueue (const int capacity)
+{
+    const auto size = (uint32) nextPowerOfTwo (jmax (2, capacity));
+    mask = size - 1;
+    cells.calloc (size);
+    for (uint32 i = 0; i < size; ++i)
+        cells[i].sequence.store (i, std::memory_order_relaxed);
+}
+
+bool ParameterEventQueue::push (const Event& event) noexcept
+{
+    // each cell's sequence tells whether it is free for the write at its
+    // position, so producers only contend on the write index.
+    auto pos = writeIndex.load (std::memory_order_relaxed);
+    Cell* cell = nullptr;
+
+    for (;;)
+    {
+        cell = &cells[pos & mask];
+        const auto diff = (int32) (cell->sequence.load (std::memory_order_acquire) - pos);
+
+        if (diff == 0)
+        {
+            if (writeIndex.compare_exchange_weak (pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            return false;
+        }
+        else
+        {
+            pos = writeIndex.load (std::memory_order_relaxed);
+        }
+    }
+
+    cell->event = event;
+    cell->sequence.store (pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool ParameterEventQueue::pop (Event& event) noexcept
+{
+    const auto pos = readIndex.load (std::memory_order_relaxed);
+    auto& cell = cells[pos & mask];
+
+    if ((int32) (cell.sequence.load (std::memory_order_acquire) - (pos + 1)) < 0)
+        return false;
+
+    event = cell.event;
+    cell.sequence.store (pos + mask + 1, std::memory_order_release);
+    readIndex.store (pos + 1, std::memory_order_relaxed);
+    return true;
+}
+
+void ParameterEventQueue::clear() noexcept
+{
+    Event event;
+    while (pop (event)) { }
+}
+
+}
@@ -0,0 +1,74 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+namespace Element {
+
+/** A bounded, lock-free queue of parameter changes for a single node.
+
+    Any thread may push events. Only the audio thread rendering the node
+    pops them. Each event carries the sample offset in the next rendered
+    block at which it should take effect. Storage is allocated up front,
+    so pushing and popping never allocate or lock.
+ */
+class ParameterEventQueue final
+{
+public:
+    struct Event
+    {
+        int parameter = -1;
+        float value = 0.f;
+        int frame = 0;
+    };
+
+    /** Creates a queue. The capacity is rounded up to a power of two */
+    explicit ParameterEventQueue (int capacity = 256);
+    ~ParameterEventQueue() { }
+
+    /** Returns the max number of events the queue can hold */
+    int getCapacity() const noexcept { return (int) mask + 1; }
+
+    /** Adds an event. Returns false if the queue is full. Any thread */
+    bool push (const Event& event) noexcept;
+
+    /** Takes the oldest event. Returns false if empty. Audio thread only */
+    bool pop (Event& event) noexcept;
+
+    /** Discards all queued events. Audio thread only */
+    void clear() noexcept;
+
+private:
+    struct Cell
+    {
+        std::atomic<uint32> sequence;
+        Event event;
+    };
+
+    HeapBlock<Cell> cells;
+    uint32 mask = 0;
+    alignas (64) std::atomic<uint32> writeIndex { 0 };
+    alignas (64) std::atomic<uint32> readIndex { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ParameterEventQueue)
+};
+
+}
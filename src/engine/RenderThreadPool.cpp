@@ -0,0 +1,222 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "engine/RenderThreadPool.h"
+
+#if JUCE_LINUX
+ #include <linux/futex.h>
+ #include <sys/syscall.h>
+ #include <unistd.h>
+ #include <climits>
+#endif
+
+#if JUCE_INTEL
+ #include <immintrin.h>
+#endif
+
+namespace Element {
+
+static thread_local bool renderPoolWorkerThread = false;
+
+// number of spins a worker makes before going to sleep
+static constexpr int numSpinsBeforeSleep = 4096;
+
+// max number of helper threads, more than this doesn't pay off
+static constexpr int maxWorkerThreads = 16;
+
+class RenderThreadPool::Worker : public Thread
+{
+public:
+    Worker (RenderThreadPool& p, int index)
+        : Thread ("Element Render " + String (index + 1)),
+          pool (p)
+    { }
+
+    ~Worker()
+    {
+        stopThread (500);
+    }
+
+    void run() override
+    {
+        renderPoolWorkerThread = true;
+        uint32 seen = pool.generation.load();
+
+        while (! threadShouldExit())
+        {
+            if (! waitForWork (seen))
+                continue;
+
+            seen = pool.generation.load();
+            if (threadShouldExit())
+                break;
+
+            ++pool.numActive;
+
+            if (auto* const work = pool.current.load())
+            {
+                while (! work->isFinished())
+                {
+                    if (work->performNextJob())
+                        numJobs.store (numJobs.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                    else
+                        RenderThreadPool::pause();
+                }
+            }
+
+            --pool.numActive;
+        }
+
+        renderPoolWorkerThread = false;
+    }
+
+    int64 getNumJobs() const noexcept { return numJobs.load (std::memory_order_relaxed); }
+
+    void wake() noexcept
+    {
+       #if ! JUCE_LINUX
+        event.signal();
+       #endif
+    }
+
+private:
+    RenderThreadPool& pool;
+    std::atomic<int64> numJobs { 0 }; // only written by this worker
+   #if ! JUCE_LINUX
+    WaitableEvent event;
+   #endif
+
+    bool waitForWork (const uint32 seen)
+    {
+        for (int i = 0; i < numSpinsBeforeSleep; ++i)
+        {
+            if (pool.generation.load (std::memory_order_acquire) != seen)
+                return true;
+            RenderThreadPool::pause();
+        }
+
+       #if JUCE_LINUX
+        struct timespec timeout = { 0, 100 * 1000 * 1000 };
+        syscall (SYS_futex, reinterpret_cast<uint32*> (&pool.generation), FUTEX_WAIT_PRIVATE,
+                 seen, &timeout, nullptr, 0);
+       #else
+        event.wait (100);
+       #endif
+
+        return pool.generation.load (std::memory_order_acquire) != seen;
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (Worker)
+};
+
+RenderThreadPool::RenderThreadPool() { }
+
+RenderThreadPool::~RenderThreadPool()
+{
+    stop();
+}
+
+void RenderThreadPool::start (int numThreads)
+{
+    stop();
+
+    if (numThreads < 0)
+        numThreads = SystemStats::getNumCpus() - 1;
+    numThreads = jlimit (0, maxWorkerThreads, numThreads);
+
+    for (int i = 0; i < numThreads; ++i)
+    {
+        auto* const worker = workers.add (new Worker (*this, i));
+        worker->startThread (Thread::realtimeAudioPriority);
+    }
+}
+
+void RenderThreadPool::stop()
+{
+    jassert (! busy.load());
+
+    for (auto* const worker : workers)
+        worker->signalThreadShouldExit();
+    wakeWorkers();
+
+    workers.clear();
+}
+
+bool RenderThreadPool::perform (Work& work) noexcept
+{
+    if (workers.isEmpty() || isWorkerThread())
+        return false;
+
+    bool expected = false;
+    if (! busy.compare_exchange_strong (expected, true))
+        return false;
+
+    current.store (&work);
+    wakeWorkers();
+
+    while (! work.isFinished())
+        if (! work.performNextJob())
+            pause();
+
+    // workers register as active before they look at the current work,
+    // so once none are active nobody can still be referencing it.
+    current.store (nullptr);
+    while (numActive.load() > 0)
+        pause();
+
+    busy.store (false);
+    return true;
+}
+
+void RenderThreadPool::wakeWorkers() noexcept
+{
+    generation.fetch_add (1, std::memory_order_release);
+
+   #if JUCE_LINUX
+    syscall (SYS_futex, reinterpret_cast<uint32*> (&generation), FUTEX_WAKE_PRIVATE,
+             INT_MAX, nullptr, nullptr, 0);
+   #else
+    for (auto* const worker : workers)
+        worker->wake();
+   #endif
+}
+
+int64 RenderThreadPool::getNumWorkerJobs() const noexcept
+{
+    int64 total = 0;
+    for (const auto* const worker : workers)
+        total += worker->getNumJobs();
+    return total;
+}
+
+bool RenderThreadPool::isWorkerThread() noexcept
+{
+    return renderPoolWorkerThread;
+}
+
+void RenderThreadPool::pause() noexcept
+{
+   #if JUCE_INTEL
+    _mm_pause();
+   #else
+    std::this_thread::yield();
+   #endif
+}
+
+}
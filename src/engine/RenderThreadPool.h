@@ -0,0 +1,104 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+namespace Element {
+
+/** A pool of pre-spawned realtime threads which help the audio thread
+    render independent work in parallel.
+
+    Workers spin for a short while waiting for work and then sleep on a
+    futex (or a WaitableEvent on non-linux platforms). Dispatching work
+    never allocates or locks, so perform() is safe to call from the
+    audio callback.
+
+    Only one Work object can be dispatched at a time. If the pool is
+    already busy, perform() returns false immediately and the caller is
+    expected to render the work serially.
+ */
+class RenderThreadPool final
+{
+public:
+    /** A unit of parallel work. Implementations hand out jobs to any thread
+        that calls performNextJob() until isFinished() returns true.
+     */
+    class Work
+    {
+    public:
+        virtual ~Work() { }
+
+        /** Perform a single ready job. Return false if no job was ready */
+        virtual bool performNextJob() noexcept = 0;
+
+        /** Return true once every job in this work has completed */
+        virtual bool isFinished() const noexcept = 0;
+    };
+
+    RenderThreadPool();
+    ~RenderThreadPool();
+
+    /** Start the worker threads. Stops existing workers first if needed.
+        @param numThreads   The number of helper threads. If less than zero
+                            the number of CPUs minus one is used
+     */
+    void start (int numThreads = -1);
+
+    /** Stops all worker threads */
+    void stop();
+
+    /** Returns the number of helper threads currently running */
+    int getNumThreads() const noexcept { return workers.size(); }
+
+    /** Returns true if there are worker threads available */
+    bool isRunning() const noexcept { return workers.size() > 0; }
+
+    /** Renders the work using the calling thread plus all workers. This
+        returns once the work is finished. Returns false without doing
+        anything if the pool is not running or already busy.
+     */
+    bool perform (Work& work) noexcept;
+
+    /** Returns how many jobs the worker threads have performed, not
+        counting those done by the thread calling perform() */
+    int64 getNumWorkerJobs() const noexcept;
+
+    /** Returns true if called from one of this pool's worker threads */
+    static bool isWorkerThread() noexcept;
+
+    /** Hints the CPU that the calling thread is spinning */
+    static void pause() noexcept;
+
+private:
+    class Worker;
+    OwnedArray<Worker> workers;
+
+    std::atomic<bool> busy { false };
+    std::atomic<Work*> current { nullptr };
+    std::atomic<uint32> generation { 0 };
+    std::atomic<int> numActive { 0 };
+
+    void wakeWorkers() noexcept;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RenderThreadPool)
+};
+
+}
@@ -344,6 +344,7 @@ AudioFilePlayerNode::AudioFilePlayerNode()
 
     for (auto* const param : getParameters())
         param->addListener (this);
+    formats.registerBasicFormats();
 }
 
 AudioFilePlayerNode::~AudioFilePlayerNode()
@@ -384,8 +385,7 @@ void AudioFilePlayerNode::fillInPluginDescription (PluginDescription& desc) cons
 void AudioFilePlayerNode::clearPlayer()
 {
     player.setSource (nullptr);
-    if (reader)
-        reader = nullptr;
+    stream = nullptr;
     *playing = player.isPlaying();
 }
 
@@ -393,35 +393,26 @@ void AudioFilePlayerNode::openFile (const File& file)
 {
     if (file == audioFile)
         return;
-    if (auto* newReader = formats.createReaderFor (file))
+    if (auto newStream = streamer->openFile (formats, file))
     {
         clearPlayer();
-        reader.reset (new AudioFormatReaderSource (newReader, true));
+        stream = std::move (newStream);
         audioFile = file;
-        player.setSource (reader.get(), 1024 * 8, &thread, 
-                          newReader->sampleRate, 2);
-
-        ScopedLock sl (getCallbackLock());
-        reader->setLooping (*looping);
+        stream->setLooping (*looping);
         player.setLooping (*looping);
+        player.setSource (stream.get(), 0, nullptr, stream->getSampleRate(), 2);
     }
 }
 
 void AudioFilePlayerNode::prepareToPlay (double sampleRate, int maximumExpectedSamplesPerBlock)
 {
-    thread.startThread();
-    formats.registerBasicFormats();
     player.prepareToPlay (maximumExpectedSamplesPerBlock, sampleRate);
 
-    if (reader)
+    if (stream)
     {
-        double readerSampleRate = sampleRate;
-        if (auto* fmtReader = reader->getAudioFormatReader())
-            readerSampleRate = fmtReader->sampleRate;
-
-        reader->setLooping (*looping);
+        stream->setLooping (*looping);
         player.setLooping (*looping);
-        player.setSource (reader.get(), 1024 * 8, &thread, readerSampleRate, 2);
+        player.setSource (stream.get(), 0, nullptr, stream->getSampleRate(), 2);
         player.setPosition (jmax (0.0, lastTransportPos));
         if (wasPlaying)
             player.start();
@@ -440,8 +431,6 @@ void AudioFilePlayerNode::releaseResources()
     player.stop();
     player.releaseResources();
     player.setSource (nullptr);
-    formats.clearFormats();
-    thread.stopThread (14);
 }
 
 void AudioFilePlayerNode::processBlock (AudioBuffer<float>& buffer, MidiBuffer& midi)
@@ -464,7 +453,7 @@ void AudioFilePlayerNode::processBlock (AudioBuffer<float>& buffer, MidiBuffer&
     AudioSourceChannelInfo info;
     info.buffer = &buffer;
 
-    ScopedLock sl (getCallbackLock());
+    // the transport guards source changes itself, and the stream never blocks
     if (midiStartStopContinue.get() == 1)
     {
         while (iter.getNextEvent (msg, frame))
@@ -609,10 +598,10 @@ void AudioFilePlayerNode::parameterValueChanged (int parameter, float newValue)
 
         case Looping:
         {
-            if (reader != nullptr)
+            if (stream != nullptr)
             {
                 player.setLooping (*looping);
-                reader->setLooping (*looping);
+                stream->setLooping (*looping);
             }
         } break;
     }
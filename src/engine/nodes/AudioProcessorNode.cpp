@@ -18,8 +18,10 @@
 */
 
 #include "engine/nodes/AudioProcessorNode.h"
+#include "engine/nodes/AudioFilePlayerNode.h"
 #include "engine/nodes/BaseProcessor.h"
 #include "engine/GraphProcessor.h"
+#include "engine/nodes/MediaPlayerProcessor.h"
 #include "engine/nodes/MidiDeviceProcessor.h"
 #include "ScopedFlag.h"
 
@@ -113,6 +115,28 @@ private:
 
 //=============================================================================
 
+bool AudioProcessorNode::canSplitBlocks() const
+{
+    // third party plugins may not cope with small blocks
+    return dynamic_cast<BaseProcessor*> (proc.get()) != nullptr;
+}
+
+bool AudioProcessorNode::canSleep() const
+{
+    if (dynamic_cast<AudioFilePlayerNode*> (proc.get()) != nullptr ||
+        dynamic_cast<MediaPlayerProcessor*> (proc.get()) != nullptr)
+        return false;
+    return NodeObject::canSleep();
+}
+
+size_t AudioProcessorNode::getMemoryUsage() const
+{
+    size_t bytes = NodeObject::getMemoryUsage() + pluginState.getSize();
+    if (auto* const graph = dynamic_cast<GraphProcessor*> (proc.get()))
+        bytes += graph->getMemoryUsage();
+    return bytes;
+}
+
 void AudioProcessorNode::prepareToRender (double sampleRate, int maxBufferSize) 
 { 
     if (! proc)
@@ -141,12 +165,21 @@ void AudioProcessorNode::EnablementUpdater::handleAsyncUpdate()
     node.setEnabled (! node.isEnabled());
 }
 
+void AudioProcessorNode::ProcessorChangeListener::audioProcessorChanged (AudioProcessor* processor)
+{
+    // this can come from the audio thread, the graph re-plans its delays later
+    node.setLatencySamples (processor->getLatencySamples());
+    node.markStateChanged();
+}
+
 AudioProcessorNode::AudioProcessorNode (uint32 nodeId, AudioProcessor* processor)
     : NodeObject (nodeId),
-      enablement (*this)
+      enablement (*this),
+      processorChanges (*this)
 {
     proc.reset (processor);
     jassert (proc != nullptr);
+    proc->addListener (&processorChanges);
     setLatencySamples (proc->getLatencySamples());
     setName (proc->getName());
     proc->refreshParameterList();
@@ -170,6 +203,8 @@ AudioProcessorNode::~AudioProcessorNode()
     NodeObject::clearParameters();
     enablement.cancelPendingUpdate();
     pluginState.reset();
+    if (proc != nullptr)
+        proc->removeListener (&processorChanges);
     proc = nullptr;
 }
 
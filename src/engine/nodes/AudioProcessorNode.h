@@ -41,6 +41,15 @@ public:
     void prepareToRender (double sampleRate, int maxBufferSize) override;
     void releaseResources() override;
 
+    /** Element's own processors can render in sub-blocks */
+    bool canSplitBlocks() const override;
+
+    /** Players make sound without any input, so they never sleep */
+    bool canSleep() const override;
+
+    /** Includes the buffers of nested graphs */
+    size_t getMemoryUsage() const override;
+
 protected:
     void createPorts() override;
     Parameter::Ptr getParameter (const PortDescription& port) override;
@@ -59,6 +68,16 @@ private:
         AudioProcessorNode& node;
     } enablement;
 
+    /** Catches plugins changing state without touching a parameter, and
+        picks up latency changes */
+    struct ProcessorChangeListener : public AudioProcessorListener
+    {
+        ProcessorChangeListener (AudioProcessorNode& n) : node (n) { }
+        void audioProcessorChanged (AudioProcessor*) override;
+        void audioProcessorParameterChanged (AudioProcessor*, int, float) override { }
+        AudioProcessorNode& node;
+    } processorChanges;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AudioProcessorNode);
 };
 
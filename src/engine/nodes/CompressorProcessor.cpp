@@ -87,41 +87,91 @@ void CompressorProcessor::prepareToPlay (double sampleRate, int maximumExpectedS
     detector.reset ((float) sampleRate);
     sideDetector.reset ((float) sampleRate);
     gainComputer.reset();
+    scratch.setSize (3, jmax (1, maximumExpectedSamplesPerBlock), false, false, true);
 
     setBusesLayout (getBusesLayout());
     setRateAndBufferSizeDetails (sampleRate, maximumExpectedSamplesPerBlock);
 }
 
-void CompressorProcessor::releaseResources() {}
-
-void CompressorProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer&)
+void CompressorProcessor::releaseResources()
 {
-    auto mainBuffer = getBusBuffer (buffer, true, 0);
-    auto sideBuffer = getBusBuffer (buffer, true, 1);
+    scratch.setSize (0, 0);
+}
 
-    auto numBuffChannels = mainBuffer.getNumChannels();
+void CompressorProcessor::sumToRectifiedMono (const float* const* channels, int numChans,
+                                              int startSample, float* dest, int numSamples) noexcept
+{
+    FloatVectorOperations::copy (dest, channels[0] + startSample, numSamples);
+    for (int ch = 1; ch < numChans; ++ch)
+        FloatVectorOperations::add (dest, channels[ch] + startSample, numSamples);
+    if (numChans > 1)
+        FloatVectorOperations::multiply (dest, 1.0f / (float) numChans, numSamples);
+    FloatVectorOperations::abs (dest, dest, numSamples);
+}
 
-    updateParams();
+void CompressorProcessor::processChunk (float* const* main, const float* const* side, int numChans,
+                                        int startSample, int numSamples, float sideAmount)
+{
+    auto* const levels = scratch.getWritePointer (0);
+    auto* const sideLevels = scratch.getWritePointer (1);
+    auto* const gains = scratch.getWritePointer (2);
+
+    // detector pre-pass. Both detectors always run, even when one isn't
+    // heard, so moving the sidechain amount doesn't start from a stale envelope
+    sumToRectifiedMono (main, numChans, startSample, levels, numSamples);
+    detector.process (levels, levels, numSamples);
+    sumToRectifiedMono (side, numChans, startSample, sideLevels, numSamples);
+    sideDetector.process (sideLevels, sideLevels, numSamples);
+
+    if (sideAmount > 0.0f)
+    {
+        if (sideAmount >= 1.0f)
+        {
+            FloatVectorOperations::copy (levels, sideLevels, numSamples);
+        }
+        else
+        {
+            FloatVectorOperations::multiply (levels, 1.0f - sideAmount, numSamples);
+            FloatVectorOperations::addWithMultiply (levels, sideLevels, sideAmount, numSamples);
+        }
+    }
 
-    float level = 0.0f;
-    for (int n = 0; n < buffer.getNumSamples(); ++n)
+    // gain curve, then makeup
+    gainComputer.process (levels, gains, numSamples);
+    if (makeupGain.isSmoothing())
+    {
+        for (int i = 0; i < numSamples; ++i)
+            gains[i] *= makeupGain.getNextValue();
+    }
+    else
     {
-        // Get Main mono input
-        float mainInput = getSummedMonoSample (mainBuffer, n, numBuffChannels);
+        FloatVectorOperations::multiply (gains, makeupGain.getTargetValue(), numSamples);
+    }
 
-        // Get sidechain mono input
-        float sideInput = getSummedMonoSample (sideBuffer, n, numBuffChannels);
+    for (int ch = 0; ch < numChans; ++ch)
+        FloatVectorOperations::multiply (main[ch] + startSample, gains, numSamples);
 
-        // Get level estimate, and compute gain
-        level = detector.process (mainInput) * (1.0f - *sideChain)
-              + sideDetector.process (sideInput) * *sideChain;
-        float gain = gainComputer.process (level);
+    inputLevelDB.store (Decibels::gainToDecibels (levels[numSamples - 1]), std::memory_order_relaxed);
+}
 
-        // Apply gain
-        mainBuffer.applyGain (n, 1, gain * makeupGain.getNextValue());
-    }
+void CompressorProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer&)
+{
+    auto mainBuffer = getBusBuffer (buffer, true, 0);
+    auto sideBuffer = getBusBuffer (buffer, true, 1);
+    const int numChans = jmin (mainBuffer.getNumChannels(), sideBuffer.getNumChannels());
+    const int numSamples = buffer.getNumSamples();
+    if (numChans <= 0 || numSamples <= 0 || scratch.getNumSamples() <= 0)
+        return;
 
-    listeners.call (&Listener::updateInGainDB, Decibels::gainToDecibels (level));
+    updateParams();
+    const float sideAmount = jlimit (0.0f, 1.0f, sideChain->get());
+
+    auto* const* main = mainBuffer.getArrayOfWritePointers();
+    auto* const* side = sideBuffer.getArrayOfReadPointers();
+    for (int start = 0; start < numSamples; start += scratch.getNumSamples())
+        processChunk (main, side, numChans, start,
+                      jmin (scratch.getNumSamples(), numSamples - start),
+                      sideAmount);
 }
 
 float CompressorProcessor::calcGainDB (float db)
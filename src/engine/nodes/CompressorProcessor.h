@@ -74,6 +74,20 @@ public:
         return levelEstimate;
     }
 
+    /* Process a block of rectified samples. The envelope is recursive so this
+       stays scalar, but it keeps the estimate in a register for the block */
+    void process (const float* rectified, float* levels, int numSamples) noexcept
+    {
+        auto estimate = levelEstimate;
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const auto x = rectified[i];
+            estimate += (x > estimate ? b0_a : b0_r) * (x - estimate);
+            levels[i] = estimate;
+        }
+        levelEstimate = estimate;
+    }
+
     void setLevelEstimate (float levelEst) { levelEstimate = levelEst; }
     float getLevelEstimate() { return levelEstimate; }
 
@@ -159,6 +173,29 @@ public:
         return calcGain (x, thresh.getNextValue(), ratio.getNextValue());
     }
 
+    /* Compute gains for a block of level estimates */
+    void process (const float* levels, float* gains, int numSamples)
+    {
+        if (thresh.isSmoothing() || ratio.isSmoothing())
+        {
+            for (int i = 0; i < numSamples; ++i)
+                gains[i] = process (levels[i]);
+            return;
+        }
+
+        // nothing to do while the whole block is under the knee
+        if (FloatVectorOperations::findMaximum (levels, numSamples) <= kneeLower)
+        {
+            FloatVectorOperations::fill (gains, 1.0f, numSamples);
+            return;
+        }
+
+        const auto curThresh = thresh.getTargetValue();
+        const auto curRatio  = ratio.getTargetValue();
+        for (int i = 0; i < numSamples; ++i)
+            gains[i] = calcGain (levels[i], curThresh, curRatio);
+    }
+
 private:
     // recalculate knee values for a new threshold or knee width
     void recalcKnees()
@@ -223,15 +260,9 @@ public:
     void setStateInformation (const void* data, int sizeInBytes) override;
     void numChannelsChanged() override;
 
-    class Listener
-    {
-    public:
-        virtual ~Listener() {}
-        virtual void updateInGainDB (float /*inDB*/) {}
-    };
-
-    void addListener (Listener* l) { listeners.add (l); }
-    void removeListener (Listener* l) { listeners.remove (l); }
+    /** Returns the detector level at the end of the last block, in decibels.
+        Safe to poll from the UI */
+    float getInputLevelDB() const noexcept { return inputLevelDB.load (std::memory_order_relaxed); }
 
 protected:
     inline bool isBusesLayoutSupported (const BusesLayout& layout) const override 
@@ -260,13 +291,10 @@ protected:
     }
 
 private:
-    inline float getSummedMonoSample (AudioBuffer<float>& buffer, int idx, int numChans)
-    {
-        float sum = 0.0f;
-        for (int ch = 0; ch < numChans; ++ch)
-            sum += buffer.getSample (ch, idx);
-        return sum / (float) numChans;
-    };
+    void processChunk (float* const* main, const float* const* side, int numChans,
+                       int startSample, int numSamples, float sideAmount);
+    static void sumToRectifiedMono (const float* const* channels, int numChans,
+                                    int startSample, float* dest, int numSamples) noexcept;
 
     int numChannels = 0;
     AudioParameterFloat* threshDB  = nullptr;
@@ -284,7 +312,9 @@ private:
     LevelDetector sideDetector;
     GainComputer gainComputer;
 
-    ListenerList<Listener> listeners;
+    // detector, sidechain detector and gain scratch, sized in prepareToPlay
+    AudioBuffer<float> scratch;
+    std::atomic<float> inputLevelDB { -100.0f };
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CompressorProcessor)
 };
@@ -26,11 +26,16 @@
 #include "engine/nodes/LuaNode.h"
 #include "engine/MidiPipe.h"
 #include "engine/Parameter.h"
+#include "scripting/LuaAllocator.h"
 #include "scripting/LuaBindings.h"
 
 #define EL_LUA_DBG(x)
 // #define EL_LUA_DBG(x) DBG(x)
 
+#ifndef EL_LUA_CROSSFADE_MS
+ #define EL_LUA_CROSSFADE_MS 20
+#endif
+
 static const String initScript = 
 R"(
 require ('kv.AudioBuffer')
@@ -133,17 +138,15 @@ end
 namespace Element {
 
 //=============================================================================
-class LuaParameter : public ControlPortParameter,
-                     public Parameter::Listener
+class LuaParameter : public ControlPortParameter
 {
 public:
     LuaParameter (LuaNode::Context* c, const PortDescription& port)
-        : ControlPortParameter (port),
-          ctx (c)
+        : ControlPortParameter (port)
     {
         const auto sp = getPort();
         set (sp.defaultValue);
-        addListener (this);
+        ctx = c;
     }
 
     ~LuaParameter()
@@ -155,12 +158,12 @@ public:
 
     void unlink()
     {
-        removeListener (this);
         ctx = nullptr;
     }
 
-    void controlValueChanged (int parameterIndex, float newValue) override;
-    void controlTouched (int parameterIndex, bool gestureIsStarting) override;
+    // the graph applies queued events without notifying listeners, so the
+    // value is passed to the script here rather than from a listener
+    void setValue (float newValue) override;
     
 private:
     LuaNode::Context* ctx { nullptr };
@@ -170,8 +173,10 @@ private:
 struct LuaNode::Context
 {
     explicit Context ()
+        : state (sol::default_at_panic, LuaAllocator::allocate, &allocator)
     {
         L = state.lua_state();
+        LuaAllocator::attach (L);
     }
 
     ~Context()
@@ -374,9 +379,19 @@ struct LuaNode::Context
             (*midiPipe)->setSize (nmidi);
         }
 
+        fadeBuffer.setSize (jmax (1, nchans), block, false, false, true);
+        preparedRate  = rate;
+        preparedBlock = block;
         state.collect_garbage();
     }
 
+    bool isPrepared() const noexcept { return preparedBlock > 0; }
+
+    bool isPreparedFor (double rate, int block) const noexcept
+    {
+        return preparedBlock == block && preparedRate == rate;
+    }
+
     void release()
     {
         if (! ready())
@@ -395,6 +410,9 @@ struct LuaNode::Context
             (*midiPipe)->setSize (0);
         }
 
+        fadeBuffer.setSize (1, 1);
+        preparedRate  = 0.0;
+        preparedBlock = 0;
         state.collect_garbage();
     }
 
@@ -424,7 +442,30 @@ struct LuaNode::Context
         {
             DBG("didn't get render fucntion in callback");
         }
+
+        // automatic collection is off, so collect a little every block
+        allocator.stepGarbage (L);
+    }
+
+    LuaAllocator::Stats getAllocatorStats() const { return allocator.getStats(); }
+
+    /** Scratch space for the context being faded out, sized when prepared */
+    AudioSampleBuffer& getFadeBuffer() noexcept { return fadeBuffer; }
+
+    /** True if the other context has the same audio and MIDI ports, so one
+        can be crossfaded into the other */
+    bool hasSameLayout (const Context& other) const
+    {
+        using PT = kv::PortType;
+        for (const bool isInput : { true, false })
+            for (const auto type : { PT::Audio, PT::Midi })
+                if (ports.size (type, isInput) != other.ports.size (type, isInput))
+                    return false;
+        return true;
     }
+
+    /** Increases with each context a node installs */
+    int serial = 0;
     
     const OwnedArray<PortDescription>& getPortArray() const noexcept
     {
@@ -543,6 +584,7 @@ struct LuaNode::Context
     }
 
 private:
+    LuaAllocator allocator;
     sol::state state;
     lua_State* L { nullptr };
     sol::function renderf;
@@ -559,6 +601,10 @@ private:
     PortList ports;
     ParameterArray inParams, outParams;
 
+    AudioSampleBuffer fadeBuffer;
+    double preparedRate = 0.0;
+    int preparedBlock = 0;
+
     int numParams = 0;
     enum { maxParams = 512 };
     float paramData [maxParams];
@@ -704,18 +750,65 @@ private:
     }
 };
 
-void LuaParameter::controlValueChanged (int index, float value)
+void LuaParameter::setValue (float newValue)
 {
+    ControlPortParameter::setValue (newValue);
     if (ctx != nullptr) // index may not be set so use port channel.
-        ctx->setParameter (getPortChannel(), convertFrom0to1 (value));
+        ctx->setParameter (getPortChannel(), get());
 }
 
-void LuaParameter::controlTouched (int, bool) {}
+//=============================================================================
+/** One thread shared by every Lua node, so scripts compile in the order they
+    were asked for */
+struct LuaNode::Compiler : public ThreadPool
+{
+    Compiler() : ThreadPool (1) { }
+};
+
+/** Builds a context ready to be installed. This runs the script and its
+    node_prepare, but touches nothing the node or the audio thread uses */
+static Result compileContext (const String& script, const ValueTree& state,
+                              double rate, int block, bool prepare,
+                              std::unique_ptr<LuaNode::Context>& output)
+{
+    auto result = LuaNode::Context::validate (script);
+    if (result.failed())
+        return result;
+
+    auto ctx = std::make_unique<LuaNode::Context>();
+    result = ctx->load (script);
+    if (result.failed())
+        return result;
+
+    if (prepare)
+        ctx->prepare (rate, block);
+
+    if (state.hasProperty ("params"))
+    {
+        const var& params = state.getProperty ("params");
+        if (params.isBinaryData())
+            if (auto* data = params.getBinaryData())
+                ctx->setParameterData (*data);
+    }
+
+    if (state.hasProperty ("data"))
+    {
+        const var& data = state.getProperty ("data");
+        if (data.isBinaryData())
+            if (auto* saved = data.getBinaryData())
+                ctx->setState (saved->getData(), saved->getSize());
+    }
 
+    output = std::move (ctx);
+    return result;
+}
+
+//=============================================================================
 LuaNode::LuaNode() noexcept
     : NodeObject (0)
 {
     context = std::make_unique<Context>();
+    rendering = context.get();
     jassert (metadata.hasType (Tags::node));
     metadata.setProperty (Tags::format, EL_INTERNAL_FORMAT_NAME, nullptr);
     metadata.setProperty (Tags::identifier, EL_INTERNAL_ID_LUA, nullptr);
@@ -724,6 +817,9 @@ LuaNode::LuaNode() noexcept
 
 LuaNode::~LuaNode()
 {
+    stopTimer();
+    resetRendering();
+    retired.clear();
     context.reset();
 }
 
@@ -742,32 +838,123 @@ Parameter::Ptr LuaNode::getParameter (const PortDescription& port)
 
 Result LuaNode::loadScript (const String& newScript)
 {
-    auto result = Context::validate (newScript);
-    if (result.failed())
-        return result;
-    
-    auto newContext = std::make_unique<Context>();
-    result = newContext->load (newScript);
+    ++latestRequest; // anything compiling in the background is now stale
 
+    std::unique_ptr<Context> newContext;
+    auto result = compileContext (newScript, {}, sampleRate, blockSize, prepared, newContext);
     if (result.wasOk())
+        install (std::move (newContext), newScript, true);
+
+    return result;
+}
+
+void LuaNode::loadScriptAsync (const String& newScript, std::function<void (Result)> callback)
+{
+    JUCE_ASSERT_MESSAGE_THREAD
+    const int request = ++latestRequest;
+    const double rate = sampleRate;
+    const int block = blockSize;
+    const bool prepare = prepared;
+    ++numCompiling;
+
+    compiler->addJob ([self = Ptr (this), newScript, request, rate, block, prepare, callback]() mutable
+    {
+        std::unique_ptr<Context> newContext;
+        auto result = self->latestRequest.load() == request
+            ? compileContext (newScript, {}, rate, block, prepare, newContext)
+            : Result::ok();
+
+        // installed on the message thread, which also owns the node's last
+        // reference if it was removed in the meantime
+        auto* const ctx = newContext.release();
+        const bool posted = MessageManager::callAsync (
+            [self, newScript, request, result, ctx, callback]()
+        {
+            std::unique_ptr<Context> compiled (ctx);
+            --self->numCompiling;
+            if (self->latestRequest.load() != request)
+            {
+                if (compiled != nullptr)
+                    compiled->release();
+                return;
+            }
+
+            if (result.wasOk())
+                self->install (std::move (compiled), newScript, true);
+            if (callback)
+                callback (result);
+        });
+
+        if (! posted)
+            delete ctx;
+    });
+}
+
+void LuaNode::install (std::unique_ptr<Context> newContext, const String& newScript, bool keepParameters)
+{
+    script = draftScript = newScript;
+    if (keepParameters && context != nullptr)
+        newContext->copyParameterValues (*context);
+
+    // the node may have been prepared or released while this was compiling
+    if (prepared && ! newContext->isPreparedFor (sampleRate, blockSize))
+        newContext->prepare (sampleRate, blockSize);
+    else if (! prepared && newContext->isPrepared())
+        newContext->release();
+
+    newContext->serial = ++lastSerial;
+    std::unique_ptr<Context> oldContext (context.release());
+    context = std::move (newContext);
+
+    if (prepared)
     {
-        script = draftScript = newScript;
-        if (prepared)
-            newContext->prepare (sampleRate, blockSize);
-        triggerPortReset();
-        ScopedLock sl (lock);
-        if (context != nullptr)
-            newContext->copyParameterValues (*context);
-        context.swap (newContext);
+        // the audio thread picks it up at the start of its next block, the
+        // old one is deleted by the timer when nothing renders it anymore
+        if (oldContext != nullptr)
+            retired.add (oldContext.release());
+        pending.store (context.get(), std::memory_order_release);
+        startTimer (50);
     }
+    else
+    {
+        resetRendering();
+        if (oldContext != nullptr)
+            oldContext->release();
+    }
+
+    triggerPortReset();
+}
+
+void LuaNode::resetRendering() noexcept
+{
+    pending.store (nullptr);
+    rendering = context.get();
+    fadingOut = nullptr;
+    fadePosition = 0;
+    renderSerial.store (context != nullptr ? context->serial : 0);
+}
 
-    if (newContext != nullptr)
+void LuaNode::collectRetired (bool all)
+{
+    const int inUse = all ? std::numeric_limits<int>::max()
+                          : renderSerial.load (std::memory_order_acquire);
+
+    for (int i = retired.size(); --i >= 0;)
     {
-        newContext->release();
-        newContext.reset();
+        if (retired.getUnchecked (i)->serial < inUse)
+        {
+            retired.getUnchecked (i)->release();
+            retired.remove (i);
+        }
     }
 
-    return result;
+    if (retired.isEmpty())
+        stopTimer();
+}
+
+void LuaNode::timerCallback()
+{
+    collectRetired (false);
 }
 
 void LuaNode::getPluginDescription (PluginDescription& desc) const
@@ -791,7 +978,14 @@ void LuaNode::prepareToRender (double rate, int block)
         return;
     sampleRate = rate;
     blockSize = block;
+    fadeLength = jmax (1, roundToInt (rate * EL_LUA_CROSSFADE_MS * 0.001));
+    for (auto& buffer : fadeMidi)
+        buffer.ensureSize (1024);
+
+    // nothing renders while unprepared, so old contexts can all go
+    collectRetired (true);
     context->prepare (sampleRate, blockSize);
+    resetRendering();
     prepared = true;
 }
 
@@ -800,13 +994,88 @@ void LuaNode::releaseResources()
     if (! prepared)
         return;
     prepared = false;
+    resetRendering();
+    collectRetired (true);
     context->release();
 }
 
 void LuaNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
 {
-    ScopedLock sl (lock);
-    context->render (audio, midi);
+    if (auto* const next = pending.exchange (nullptr, std::memory_order_acq_rel))
+    {
+        if (fadingOut == nullptr && rendering != nullptr && rendering->ready()
+            && next->hasSameLayout (*rendering))
+        {
+            fadingOut = rendering;
+            fadePosition = 0;
+        }
+
+        rendering = next;
+        if (fadingOut == nullptr)
+            renderSerial.store (rendering->serial, std::memory_order_release);
+    }
+
+    if (rendering == nullptr)
+        return;
+
+    const int numChannels = audio.getNumChannels();
+    const int numSamples  = audio.getNumSamples();
+    auto& scratch = rendering->getFadeBuffer();
+
+    if (fadingOut != nullptr && (numChannels > scratch.getNumChannels() || numSamples > scratch.getNumSamples()))
+        finishFade(); // can't fade this block, so cut over
+
+    if (fadingOut == nullptr)
+    {
+        rendering->render (audio, midi);
+        return;
+    }
+
+    // the old script renders a copy of the input with no MIDI
+    AudioSampleBuffer old (scratch.getArrayOfWritePointers(), numChannels, numSamples);
+    for (int ch = 0; ch < numChannels; ++ch)
+        old.copyFrom (ch, 0, audio, ch, 0, numSamples);
+
+    MidiBuffer* silentBuffers [maxFadeMidi];
+    const int numMidi = jmin ((int) maxFadeMidi, midi.getNumBuffers());
+    for (int i = 0; i < numMidi; ++i)
+    {
+        fadeMidi[i].clear();
+        silentBuffers[i] = &fadeMidi[i];
+    }
+
+    MidiPipe silent (silentBuffers, numMidi);
+    fadingOut->render (old, silent);
+    rendering->render (audio, midi);
+
+    const float startGain = (float) fadePosition / (float) fadeLength;
+    fadePosition = jmin (fadeLength, fadePosition + numSamples);
+    const float endGain = (float) fadePosition / (float) fadeLength;
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        audio.applyGainRamp (ch, 0, numSamples, startGain, endGain);
+        audio.addFromWithRamp (ch, 0, old.getReadPointer (ch), numSamples, 1.f - startGain, 1.f - endGain);
+    }
+
+    if (fadePosition >= fadeLength)
+        finishFade();
+}
+
+void LuaNode::finishFade() noexcept
+{
+    fadingOut = nullptr;
+    renderSerial.store (rendering->serial, std::memory_order_release);
+}
+
+LuaAllocator::Stats LuaNode::getLuaStats() const
+{
+    return context != nullptr ? context->getAllocatorStats() : LuaAllocator::Stats();
+}
+
+size_t LuaNode::getMemoryUsage() const
+{
+    return NodeObject::getMemoryUsage() + getLuaStats().arenaBytes;
 }
 
 void LuaNode::setState (const void* data, int size)
@@ -814,27 +1083,15 @@ void LuaNode::setState (const void* data, int size)
     const auto state = ValueTree::readFromGZIPData (data, size);
     if (state.isValid())
     {
-        // May want to do this procedure async with a Message::post()
-        auto result = loadScript (state["script"].toString());
+        // Compiled here instead of in the background so the ports are right
+        // when a session restores connections straight after. Nothing is
+        // locked, the audio thread renders the old script until the swap.
+        ++latestRequest;
+        const String newScript = state["script"].toString();
+        std::unique_ptr<Context> newContext;
+        if (compileContext (newScript, state, sampleRate, blockSize, prepared, newContext).wasOk())
+            install (std::move (newContext), newScript, false);
 
-        if (result.wasOk())
-        {
-            if (state.hasProperty ("params"))
-            {
-                const var& params = state.getProperty ("params");
-                if (params.isBinaryData())
-                    if (auto* block = params.getBinaryData())
-                        context->setParameterData (*block);
-            }
-
-            if (state.hasProperty ("data"))
-            {
-                const var& data = state.getProperty ("data");
-                if (data.isBinaryData())
-                    if (auto* block = data.getBinaryData())
-                        context->setState (block->getData(), block->getSize());
-            }
-        }
         sendChangeMessage();
     }
 }
@@ -864,7 +1121,6 @@ void LuaNode::getState (MemoryBlock& block)
 
 void LuaNode::setParameter (int index, float value)
 {
-    ScopedLock sl (lock);
     context->setParameter (index, value);
 }
 
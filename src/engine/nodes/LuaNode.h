@@ -21,11 +21,13 @@
 
 #include "engine/nodes/BaseProcessor.h"
 #include "engine/NodeObject.h"
+#include "scripting/LuaAllocator.h"
 
 namespace Element {
 
 class LuaNode : public NodeObject,
-                public ChangeBroadcaster
+                public ChangeBroadcaster,
+                private Timer
 {
 public:
     using Ptr = ReferenceCountedObjectPtr<LuaNode>;
@@ -39,11 +41,28 @@ public:
     void prepareToRender (double sampleRate, int maxBufferSize) override;
     void releaseResources() override;
     void render (AudioSampleBuffer& audio, MidiPipe& midi) override;
+    bool canSplitBlocks() const override { return true; }
+    /** Scripts can make sound without any input */
+    bool canSleep() const override { return false; }
     void setState (const void* data, int size) override;
     void getState (MemoryBlock& block) override;
+    size_t getMemoryUsage() const override;
     
+    /** Compiles a script and swaps it in. This blocks the calling thread for
+        the compile, but never the audio thread */
     Result loadScript (const String&);
 
+    /** Compiles a script on a background thread, then installs it on the
+        message thread and crossfades to it on the audio thread. The callback
+        is called on the message thread unless a newer load replaced this one */
+    void loadScriptAsync (const String&, std::function<void (Result)> callback = nullptr);
+
+    /** Returns true while loadScriptAsync is compiling */
+    bool isCompiling() const noexcept { return numCompiling > 0; }
+
+    /** Returns memory and garbage collection counters for the running script */
+    LuaAllocator::Stats getLuaStats() const;
+
     const String& getScript() const { return script; }
     const String& getDraftScript() const { return draftScript; }
     void setDraftScript (const String& draft) { draftScript = draft; }
@@ -62,13 +81,38 @@ protected:
     Parameter::Ptr getParameter (const PortDescription& port) override;
 
 private:
+    struct Compiler;
+    SharedResourcePointer<Compiler> compiler;
+
     String script, draftScript;
     int blockSize = 512;
     double sampleRate = 44100.0;
     bool prepared = false;
-    CriticalSection lock;
-    std::unique_ptr<Context> context;
     ParameterArray inParams, outParams;
+
+    // owned by the message thread: the newest context, and older ones the
+    // audio thread may still be rendering
+    std::unique_ptr<Context> context;
+    OwnedArray<Context> retired;
+    int lastSerial = 0, numCompiling = 0;
+    std::atomic<int> latestRequest { 0 };
+
+    // handed to the audio thread, which reports the oldest serial it renders
+    std::atomic<Context*> pending { nullptr };
+    std::atomic<int> renderSerial { 0 };
+
+    // audio thread
+    enum { maxFadeMidi = 4 };
+    Context* rendering = nullptr;
+    Context* fadingOut = nullptr;
+    int fadePosition = 0, fadeLength = 1;
+    MidiBuffer fadeMidi [maxFadeMidi];
+
+    void install (std::unique_ptr<Context>, const String& newScript, bool keepParameters);
+    void resetRendering() noexcept;
+    void finishFade() noexcept;
+    void collectRetired (bool all);
+    void timerCallback() override;
 };
 
 }
@@ -184,6 +184,7 @@ MediaPlayerProcessor::MediaPlayerProcessor()
     addParameter (volume = new AudioParameterFloat ("volume", "Volume", -60.f, 12.f, 0.f));
     for (auto* const param : getParameters())
         param->addListener (this);
+    formats.registerBasicFormats();
 }
 
 MediaPlayerProcessor::~MediaPlayerProcessor()
@@ -213,8 +214,7 @@ void MediaPlayerProcessor::fillInPluginDescription (PluginDescription& desc) con
 void MediaPlayerProcessor::clearPlayer()
 {
     player.setSource (nullptr);
-    if (reader)
-        reader = nullptr;
+    stream = nullptr;
     *playing = player.isPlaying();
 }
 
@@ -222,34 +222,29 @@ void MediaPlayerProcessor::openFile (const File& file)
 {
     if (file == audioFile)
         return;
-    if (auto* newReader = formats.createReaderFor (file))
+    if (auto newStream = streamer->openFile (formats, file))
     {
         clearPlayer();
-        reader.reset (new AudioFormatReaderSource (newReader, true));
+        stream = std::move (newStream);
         audioFile = file;
-        player.setSource (reader.get(), 1024 * 8, &thread, getSampleRate(), 2);
-        ScopedLock sl (getCallbackLock());        
+        stream->setLooping (true);
         player.setLooping (true);
-        reader->setLooping (true);
+        player.setSource (stream.get(), 0, nullptr, stream->getSampleRate(), 2);
     }
 }
 
 void MediaPlayerProcessor::prepareToPlay (double sampleRate, int maximumExpectedSamplesPerBlock)
 {
-    thread.startThread();
-    formats.registerBasicFormats();
     player.prepareToPlay (maximumExpectedSamplesPerBlock, sampleRate);
     player.setLooping (true);
-    if (reader)
-        reader->setLooping (true);
+    if (stream)
+        stream->setLooping (true);
 }
 
 void MediaPlayerProcessor::releaseResources()
 {
     player.stop();
     player.releaseResources();
-    formats.clearFormats();
-    thread.stopThread (14);
 }
 
 void MediaPlayerProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer& midi)
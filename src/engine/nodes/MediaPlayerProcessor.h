@@ -20,6 +20,7 @@
 #pragma once
 
 #include "engine/nodes/BaseProcessor.h"
+#include "engine/DiskStreamer.h"
 
 namespace Element {
 
@@ -104,8 +105,8 @@ protected:
 #endif
 
 private:
-    TimeSliceThread thread { "MediaPlayer" };
-    std::unique_ptr<AudioFormatReaderSource> reader;
+    SharedResourcePointer<DiskStreamer> streamer;
+    std::unique_ptr<DiskStreamer::Stream> stream;
     AudioFormatManager formats;
     AudioTransportSource player;
 
@@ -48,8 +48,10 @@ namespace Element {
 
 //=============================================================================
 ScriptNode::ScriptNode() noexcept
-    : NodeObject (0)
+    : NodeObject (0),
+      lua (sol::default_at_panic, LuaAllocator::allocate, &allocator)
 {
+    LuaAllocator::attach (lua);
     Lua::initializeState (lua);
     script.reset (new DSPScript (lua.create_table()));
     jassert (metadata.hasType (Tags::node));
@@ -111,9 +113,21 @@ Result ScriptNode::loadScript (const String& newCode)
         newScript.reset();
     }
 
+    collectGarbage();
     return Result::ok();
 }
 
+void ScriptNode::collectGarbage()
+{
+    // the audio thread only collects while rendering, so garbage made on the
+    // message thread would otherwise pile up in the arena while idle
+    ScopedLock sl (lock);
+    if (prepared)
+        allocator.stepGarbage (lua);
+    else
+        lua.collect_garbage();
+}
+
 void ScriptNode::getPluginDescription (PluginDescription& desc) const
 {
     desc.name               = "Script";
@@ -136,6 +150,7 @@ void ScriptNode::prepareToRender (double rate, int block)
     sampleRate = rate;
     blockSize = block;
     script->prepare (sampleRate, blockSize);
+    collectGarbage();
     prepared = true;
 }
 
@@ -145,12 +160,21 @@ void ScriptNode::releaseResources()
         return;
     prepared = false;
     script->release();
+    collectGarbage();
 }
 
 void ScriptNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
 {
     ScopedLock sl (lock);
     script->process (audio, midi);
+
+    // automatic collection is off, so collect a little every block
+    allocator.stepGarbage (lua);
+}
+
+size_t ScriptNode::getMemoryUsage() const
+{
+    return NodeObject::getMemoryUsage() + allocator.getStats().arenaBytes;
 }
 
 void ScriptNode::setState (const void* data, int size)
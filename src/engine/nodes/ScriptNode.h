@@ -21,6 +21,7 @@
 
 #include "engine/nodes/BaseProcessor.h"
 #include "engine/NodeObject.h"
+#include "scripting/LuaAllocator.h"
 #include "sol/sol.hpp"
 
 namespace Element {
@@ -42,11 +43,18 @@ public:
     void prepareToRender (double sampleRate, int maxBufferSize) override;
     void releaseResources() override;
     void render (AudioSampleBuffer& audio, MidiPipe& midi) override;
+    bool canSplitBlocks() const override { return true; }
+    /** Scripts can make sound without any input */
+    bool canSleep() const override { return false; }
     void setState (const void* data, int size) override;
     void getState (MemoryBlock& block) override;
+    size_t getMemoryUsage() const override;
 
     Result loadScript (const String&);
 
+    /** Returns memory and garbage collection counters for the script's state */
+    LuaAllocator::Stats getLuaStats() const { return allocator.getStats(); }
+
     CodeDocument& getCodeDocument (bool forEditor = false) { return forEditor ? edCode : dspCode; }
 
     /** Set a parameter value by index
@@ -63,6 +71,7 @@ protected:
 
 private:
     CriticalSection lock;
+    LuaAllocator allocator;
     sol::state lua;
     CodeDocument dspCode, edCode;
     std::unique_ptr<DSPScript> script;
@@ -71,6 +80,8 @@ private:
     int blockSize = 512;
     double sampleRate = 44100.0;
     bool prepared = false;
+
+    void collectGarbage();
 };
 
 }
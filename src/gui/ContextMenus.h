@@ -222,6 +222,9 @@ public:
         osMenu.addItem (index++, "2x", true, ptr->getOversamplingFactor() == 2);
         osMenu.addItem (index++, "4x", true, ptr->getOversamplingFactor() == 4);
         osMenu.addItem (index++, "8x", true, ptr->getOversamplingFactor() == 8);
+        osMenu.addSeparator();
+        osMenu.addItem (linearPhaseItemId, "Linear phase", true,
+            ptr->getOversamplingQuality() == Oversampler<float>::linearPhaseFIR);
                                                       
         menuToAddTo.addSubMenu ("Oversample", osMenu);
     }
@@ -366,7 +369,12 @@ public:
                 bool wasSuspended = graph->isSuspended();
                 graph->suspendProcessing (true);
                 graph->releaseResources();
-                gNode->setOversamplingFactor (osFactor);
+                if (result == linearPhaseItemId)
+                    gNode->setOversamplingQuality (
+                        gNode->getOversamplingQuality() == Oversampler<float>::linearPhaseFIR
+                            ? Oversampler<float>::lowLatencyIIR : Oversampler<float>::linearPhaseFIR);
+                else
+                    gNode->setOversamplingFactor (osFactor);
                 graph->prepareToPlay (gNode->getParentGraph()->getSampleRate(), gNode->getParentGraph()->getBlockSize());
                 graph->suspendProcessing (wasSuspended);
             }
@@ -403,6 +411,7 @@ private:
     Port port;
     const int firstResultOpId = 1024;
     int currentResultOpId = 1024;
+    const int linearPhaseItemId = 40100;
     
     struct ResultOp
     {
@@ -60,6 +60,7 @@ public:
 
     ~NodeChannelStripComponent()
     {
+        setMeteredNode (nullptr);
         unbindSignals();
     }
 
@@ -126,6 +127,10 @@ public:
         auto& meter = channelStrip.getDigitalMeter();
         if (NodeObjectPtr ptr = node.getGraphNode())
         {
+            if (ptr != meteredNode)
+                setMeteredNode (ptr);
+            ptr->updateMeters();
+
             const int startChannel = jmax (0, channelBox.getSelectedId() - 1);
             if (ptr->getNumAudioOutputs() == 1)
             {
@@ -157,6 +162,7 @@ public:
         }
         else
         {
+            setMeteredNode (nullptr);
             meter.resetPeaks();
             stopTimer();
         }
@@ -198,6 +204,7 @@ public:
     {
         stopTimer();
         node = newNode;
+        setMeteredNode (node.getGraphNode());
         isAudioOutNode = node.isAudioOutputNode();
         isAudioInNode  = node.isAudioInputNode();
         audioIns.clearQuick(); audioOuts.clearQuick();
@@ -249,6 +256,19 @@ protected:
 
 private:
     friend class NodeChannelStripView;
+
+    /** The engine only measures levels of nodes with a visible meter */
+    void setMeteredNode (NodeObject* const newNode)
+    {
+        if (meteredNode == newNode)
+            return;
+        if (meteredNode != nullptr)
+            meteredNode->removeMeterSubscriber();
+        meteredNode = newNode;
+        if (meteredNode != nullptr)
+            meteredNode->addMeterSubscriber();
+    }
+
     GuiController& gui;
     Label nodeName;
     Node node;
@@ -266,6 +286,7 @@ private:
     bool monoMeter      = false;
 
     Value displayName;
+    NodeObjectPtr meteredNode;
 
     SignalConnection nodeSelectedConnection;
     SignalConnection volumeChangedConnection;
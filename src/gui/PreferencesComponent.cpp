@@ -437,6 +437,16 @@ namespace Element {
             askToSaveSession.setToggleState (settings.askToSaveSession(), dontSendNotification);
             askToSaveSession.getToggleStateValue().addListener (this);
 
+           #ifdef EL_PRO
+            addAndMakeVisible (binarySessionsLabel);
+            binarySessionsLabel.setText ("Save sessions as binary archives", dontSendNotification);
+            binarySessionsLabel.setFont (Font (12.0, Font::bold));
+            addAndMakeVisible (binarySessions);
+            binarySessions.setClickingTogglesState (true);
+            binarySessions.setToggleState (settings.useBinarySessions(), dontSendNotification);
+            binarySessions.getToggleStateValue().addListener (this);
+           #endif
+
             addAndMakeVisible (systrayLabel);
             systrayLabel.setText ("Show system tray", dontSendNotification);
             systrayLabel.setFont (Font (12.0, Font::bold));
@@ -544,6 +554,9 @@ namespace Element {
             layoutSetting (r, hidePluginWindowsLabel, hidePluginWindows);
             layoutSetting (r, openLastSessionLabel, openLastSession);
             layoutSetting (r, askToSaveSessionLabel, askToSaveSession);
+           #ifdef EL_PRO
+            layoutSetting (r, binarySessionsLabel, binarySessions);
+           #endif
             layoutSetting (r, systrayLabel, systray);
             layoutSetting (r, desktopScaleLabel, desktopScale, getWidth() / 4);
            #ifdef EL_PRO
@@ -597,6 +610,10 @@ namespace Element {
             {
                 settings.setAskToSaveSession (askToSaveSession.getToggleState());
             }
+            else if (value.refersToSameSourceAs (binarySessions.getToggleStateValue()))
+            {
+                settings.setUseBinarySessions (binarySessions.getToggleState());
+            }
             else if (value.refersToSameSourceAs (hidePluginWindows.getToggleStateValue()))
             {
                 settings.setHidePluginWindowsWhenFocusLost (hidePluginWindows.getToggleState());
@@ -640,6 +657,9 @@ namespace Element {
         Label askToSaveSessionLabel;
         SettingButton askToSaveSession;
 
+        Label binarySessionsLabel;
+        SettingButton binarySessions;
+
         Label defaultSessionFileLabel;
         FilenameComponent defaultSessionFile;
         TextButton defaultSessionClearButton;
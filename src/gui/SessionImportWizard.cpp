@@ -19,6 +19,7 @@
 
 #include "gui/SessionImportWizard.h"
 #include "gui/GuiCommon.h"
+#include "session/SessionArchive.h"
 #include "Globals.h"
 
 namespace Element {
@@ -165,14 +166,11 @@ void SessionImportWizard::loadSession (const File& file)
 {
     SessionPtr newSession;
     bool loaded = false;
-    if (auto e = XmlDocument::parse (file))
+    ValueTree newData;
+    if (SessionArchive::load (file, newData).wasOk() && newData.hasType ("session"))
     {
-        ValueTree newData (ValueTree::fromXml (*e));
-        if (newData.isValid() && newData.hasType ("session"))
-        {
-            newSession = new Session();
-            loaded = newSession->loadData (newData);
-        }
+        newSession = new Session();
+        loaded = newSession->loadData (newData);
     }
 
     if (newSession != nullptr && loaded)
@@ -30,13 +30,10 @@ CompressorNodeEditor::CompViz::CompViz (CompressorProcessor& proc) :
     startTimer (40);
 
     updateCurve();
-
-    proc.addListener (this);
 }
 
 CompressorNodeEditor::CompViz::~CompViz()
 {
-    proc.removeListener (this);
 }
 
 float CompressorNodeEditor::CompViz::getDBForX (float x)
@@ -86,6 +83,7 @@ void CompressorNodeEditor::CompViz::updateInGainDB (float inDB)
 
 void CompressorNodeEditor::CompViz::timerCallback()
 {
+    updateInGainDB (proc.getInputLevelDB());
     repaint();
 }
 
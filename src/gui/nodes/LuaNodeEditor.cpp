@@ -154,13 +154,15 @@ LuaNodeEditor::LuaNodeEditor (const Node& node)
     {
         if (auto* const lua = getNodeObjectOfType<LuaNode>())
         {
-            const auto script = document.getAllContent();
-            auto result = lua->loadScript (script);
-            if (! result.wasOk())
+            // compiles in the background so audio keeps running meanwhile
+            lua->loadScriptAsync (document.getAllContent(), [] (Result result)
             {
-                AlertWindow::showMessageBoxAsync (AlertWindow::WarningIcon,
-                    "Script Error", result.getErrorMessage());
-            }
+                if (! result.wasOk())
+                {
+                    AlertWindow::showMessageBoxAsync (AlertWindow::WarningIcon,
+                        "Script Error", result.getErrorMessage());
+                }
+            });
         }
     };
 
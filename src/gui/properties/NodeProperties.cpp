@@ -92,6 +92,7 @@ public:
                     {
                         node.savePluginState();
                         node.writeToFile (ptr->getMidiProgramFile());
+                        ptr->refreshMidiPrograms();
                     }
                 }
                 else
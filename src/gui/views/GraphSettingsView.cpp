@@ -105,6 +105,34 @@ namespace Element {
         bool locked = false;
     };
 
+    class MultiCoreRenderingPropertyComponent : public BooleanPropertyComponent
+    {
+    public:
+        MultiCoreRenderingPropertyComponent (const Node& g)
+            : BooleanPropertyComponent ("Multi-core", "Enabled", "Disabled"),
+              graph (g)
+        {
+            jassert (graph.isRootGraph());
+        }
+
+        bool getState() const override
+        {
+            return graph.getProperty (Tags::multiCoreRendering, false);
+        }
+
+        void setState (const bool newState) override
+        {
+            graph.setProperty (Tags::multiCoreRendering, newState);
+            if (auto* obj = graph.getGraphNode())
+                if (auto* root = dynamic_cast<RootGraph*> (obj->getAudioProcessor()))
+                    root->setMultiCoreRendering (newState);
+            refresh();
+        }
+
+    private:
+        Node graph;
+    };
+
     class VelocityCurvePropertyComponent : public ChoicePropertyComponent
     {
     public:
@@ -318,6 +346,8 @@ namespace Element {
             props.add (new MidiProgramPropertyComponent (g));
            #endif
 
+            props.add (new MultiCoreRenderingPropertyComponent (g));
+
             for (auto* const p : props)
                 maybeLockObject (p, locked);
             
@@ -0,0 +1,463 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/** The el.dsp module.
+
+    Block processing for scripts. Each call processes a whole kv.AudioBuffer
+    in C++, so a render function only decides what to call and with which
+    parameters. Channel numbers are 0-based like el.MidiPipe.
+
+    local dsp = require ('el.dsp')
+    local lpf = dsp.Biquad()
+
+    function node_render (audio, midi)
+        lpf:setup ('lowpass', rate, 1200, 0.707)
+        lpf:process (audio)
+        dsp.gain (audio, 0.5)
+    end
+ */
+
+#include "lua.hpp"
+#include "lua-kv.h"
+#include "engine/DSPKernels.h"
+
+namespace Element {
+namespace DSPModule {
+
+using namespace Kernels;
+
+/** name is the metatable, onHeap is set for kernels which own heap memory */
+template<class K> struct Meta;
+template<> struct Meta<Biquad>      { static constexpr const char* name = "el.dsp.Biquad";     static constexpr bool onHeap = false; };
+template<> struct Meta<SVF>         { static constexpr const char* name = "el.dsp.SVF";        static constexpr bool onHeap = false; };
+template<> struct Meta<Delay>       { static constexpr const char* name = "el.dsp.Delay";      static constexpr bool onHeap = true; };
+template<> struct Meta<Follower>    { static constexpr const char* name = "el.dsp.Follower";   static constexpr bool onHeap = false; };
+template<> struct Meta<Oscillator>  { static constexpr const char* name = "el.dsp.Oscillator"; static constexpr bool onHeap = false; };
+template<> struct Meta<Spectrum>    { static constexpr const char* name = "el.dsp.Spectrum";   static constexpr bool onHeap = true; };
+
+static const char* const biquadTypes[] = { "lowpass", "highpass", "bandpass", "notch",
+                                           "allpass", "peak", "lowshelf", "highshelf", nullptr };
+static const char* const svfTypes[]    = { "lowpass", "highpass", "bandpass", "notch", nullptr };
+static const char* const shapes[]      = { "sine", "saw", "square", "triangle", nullptr };
+
+//==============================================================================
+/** A kernel which owns heap memory, like a delay line or an FFT */
+struct HeapKernel
+{
+    virtual ~HeapKernel() = default;
+    HeapKernel* next = nullptr;
+};
+
+template<class K>
+struct Heap final : public HeapKernel
+{
+    template<class... Args>
+    explicit Heap (Args&&... args) : kernel (std::forward<Args> (args)...) { }
+    K kernel;
+};
+
+/** Scripts on the audio thread collect garbage after each block, so __gc can
+    run there. Heap kernels which die go on a lock-free list instead and are
+    deleted on the message thread. */
+class Disposal final : private AsyncUpdater
+{
+public:
+    ~Disposal() override
+    {
+        cancelPendingUpdate();
+        deleteRetired();
+    }
+
+    static Disposal& getInstance()
+    {
+        static Disposal disposal;
+        return disposal;
+    }
+
+    void retire (HeapKernel* kernel) noexcept
+    {
+        kernel->next = retired.load (std::memory_order_relaxed);
+        while (! retired.compare_exchange_weak (kernel->next, kernel,
+                                                std::memory_order_release,
+                                                std::memory_order_relaxed)) { }
+        triggerAsyncUpdate();
+    }
+
+    void deleteRetired()
+    {
+        for (auto* kernel = retired.exchange (nullptr, std::memory_order_acquire); kernel != nullptr;)
+        {
+            auto* const next = kernel->next;
+            delete kernel;
+            kernel = next;
+        }
+    }
+
+private:
+    std::atomic<HeapKernel*> retired { nullptr };
+    void handleAsyncUpdate() override { deleteRetired(); }
+};
+
+/** Small kernels live inside the userdata, so there's no extra allocation and
+    __gc only has to run the destructor. Heap kernels are referenced from it
+    and handed to the Disposal when collected. */
+template<class K, class... Args>
+static K* create (lua_State* L, Args&&... args)
+{
+    if constexpr (Meta<K>::onHeap)
+    {
+        auto** block = static_cast<Heap<K>**> (lua_newuserdatauv (L, sizeof (Heap<K>*), 0));
+        *block = nullptr;
+        luaL_setmetatable (L, Meta<K>::name);
+        *block = new Heap<K> (std::forward<Args> (args)...);
+        return &(*block)->kernel;
+    }
+    else
+    {
+        auto* block = lua_newuserdatauv (L, sizeof (K), 0);
+        auto* kernel = new (block) K (std::forward<Args> (args)...);
+        luaL_setmetatable (L, Meta<K>::name);
+        return kernel;
+    }
+}
+
+template<class K>
+static K* check (lua_State* L, int index = 1)
+{
+    if constexpr (Meta<K>::onHeap)
+    {
+        auto** block = static_cast<Heap<K>**> (luaL_checkudata (L, index, Meta<K>::name));
+        luaL_argcheck (L, *block != nullptr, index, "invalid kernel");
+        return &(*block)->kernel;
+    }
+    else
+    {
+        return static_cast<K*> (luaL_checkudata (L, index, Meta<K>::name));
+    }
+}
+
+template<class K>
+static int destroy (lua_State* L)
+{
+    if constexpr (Meta<K>::onHeap)
+    {
+        auto** block = static_cast<Heap<K>**> (luaL_checkudata (L, 1, Meta<K>::name));
+        if (*block != nullptr)
+            Disposal::getInstance().retire (*block);
+        *block = nullptr;
+    }
+    else
+    {
+        check<K> (L)->~K();
+    }
+    return 0;
+}
+
+template<class K>
+static int reset (lua_State* L)
+{
+    check<K> (L)->reset();
+    return 0;
+}
+
+static AudioBuffer<float>& checkBuffer (lua_State* L, int index)
+{
+    auto** buffer = (AudioBuffer<float>**) luaL_checkudata (L, index, LKV_MT_AUDIO_BUFFER_32);
+    luaL_argcheck (L, *buffer != nullptr, index, "invalid audio buffer");
+    return **buffer;
+}
+
+static float checkFloat (lua_State* L, int index)              { return static_cast<float> (luaL_checknumber (L, index)); }
+static float optFloat (lua_State* L, int index, float value)   { return static_cast<float> (luaL_optnumber (L, index, value)); }
+
+//==============================================================================
+static int biquad_new (lua_State* L)    { create<Biquad> (L); return 1; }
+
+static int biquad_setup (lua_State* L)
+{
+    check<Biquad> (L)->setup (static_cast<Biquad::Type> (luaL_checkoption (L, 2, nullptr, biquadTypes)),
+        luaL_checknumber (L, 3), luaL_checknumber (L, 4),
+        luaL_optnumber (L, 5, MathConstants<double>::sqrt2 * 0.5),
+        luaL_optnumber (L, 6, 0.0));
+    return 0;
+}
+
+static int biquad_process (lua_State* L)
+{
+    check<Biquad> (L)->process (checkBuffer (L, 2));
+    return 0;
+}
+
+static const luaL_Reg biquad_methods[] = {
+    { "__gc",       destroy<Biquad> },
+    { "setup",      biquad_setup },
+    { "process",    biquad_process },
+    { "reset",      reset<Biquad> },
+    { nullptr, nullptr }
+};
+
+//==============================================================================
+static int svf_new (lua_State* L)   { create<SVF> (L); return 1; }
+
+static int svf_setup (lua_State* L)
+{
+    check<SVF> (L)->setup (static_cast<SVF::Type> (luaL_checkoption (L, 2, nullptr, svfTypes)),
+        luaL_checknumber (L, 3), luaL_checknumber (L, 4),
+        luaL_optnumber (L, 5, MathConstants<double>::sqrt2 * 0.5));
+    return 0;
+}
+
+static int svf_process (lua_State* L)
+{
+    check<SVF> (L)->process (checkBuffer (L, 2));
+    return 0;
+}
+
+static const luaL_Reg svf_methods[] = {
+    { "__gc",       destroy<SVF> },
+    { "setup",      svf_setup },
+    { "process",    svf_process },
+    { "reset",      reset<SVF> },
+    { nullptr, nullptr }
+};
+
+//==============================================================================
+static int delay_new (lua_State* L)
+{
+    const auto numChannels = luaL_checkinteger (L, 1);
+    const auto maxDelay    = luaL_checkinteger (L, 2);
+    luaL_argcheck (L, numChannels > 0 && numChannels <= maxChannels, 1, "channel count out of range");
+    luaL_argcheck (L, maxDelay > 0 && maxDelay <= (1 << 22), 2, "delay length out of range");
+    create<Delay> (L, static_cast<int> (numChannels), static_cast<int> (maxDelay));
+    return 1;
+}
+
+static int delay_process (lua_State* L)
+{
+    check<Delay> (L)->process (checkBuffer (L, 2),
+        static_cast<int> (luaL_checkinteger (L, 3)),
+        optFloat (L, 4, 0.f), optFloat (L, 5, 1.f));
+    return 0;
+}
+
+static int delay_max (lua_State* L)
+{
+    lua_pushinteger (L, check<Delay> (L)->getMaxDelay());
+    return 1;
+}
+
+static const luaL_Reg delay_methods[] = {
+    { "__gc",       destroy<Delay> },
+    { "process",    delay_process },
+    { "maxdelay",   delay_max },
+    { "reset",      reset<Delay> },
+    { nullptr, nullptr }
+};
+
+//==============================================================================
+static int follower_new (lua_State* L)  { create<Follower> (L); return 1; }
+
+static int follower_setup (lua_State* L)
+{
+    check<Follower> (L)->setup (luaL_checknumber (L, 2), luaL_checknumber (L, 3), luaL_checknumber (L, 4));
+    return 0;
+}
+
+static int follower_process (lua_State* L)
+{
+    lua_pushnumber (L, check<Follower> (L)->process (checkBuffer (L, 2)));
+    return 1;
+}
+
+static int follower_level (lua_State* L)
+{
+    lua_pushnumber (L, check<Follower> (L)->getLevel());
+    return 1;
+}
+
+static const luaL_Reg follower_methods[] = {
+    { "__gc",       destroy<Follower> },
+    { "setup",      follower_setup },
+    { "process",    follower_process },
+    { "level",      follower_level },
+    { "reset",      reset<Follower> },
+    { nullptr, nullptr }
+};
+
+//==============================================================================
+static int oscillator_new (lua_State* L)    { create<Oscillator> (L); return 1; }
+
+static int oscillator_setup (lua_State* L)
+{
+    check<Oscillator> (L)->setup (static_cast<Oscillator::Shape> (luaL_checkoption (L, 2, nullptr, shapes)),
+        luaL_checknumber (L, 3), luaL_checknumber (L, 4));
+    return 0;
+}
+
+static int oscillator_process (lua_State* L)
+{
+    check<Oscillator> (L)->process (checkBuffer (L, 2), optFloat (L, 3, 1.f));
+    return 0;
+}
+
+static const luaL_Reg oscillator_methods[] = {
+    { "__gc",       destroy<Oscillator> },
+    { "setup",      oscillator_setup },
+    { "process",    oscillator_process },
+    { "reset",      reset<Oscillator> },
+    { nullptr, nullptr }
+};
+
+//==============================================================================
+static int spectrum_new (lua_State* L)
+{
+    const auto order = luaL_optinteger (L, 1, 10);
+    luaL_argcheck (L, order >= 4 && order <= 15, 1, "order out of range");
+    create<Spectrum> (L, static_cast<int> (order));
+    return 1;
+}
+
+static int spectrum_process (lua_State* L)
+{
+    check<Spectrum> (L)->process (checkBuffer (L, 2), static_cast<int> (luaL_optinteger (L, 3, 0)));
+    return 0;
+}
+
+static int spectrum_magnitude (lua_State* L)
+{
+    lua_pushnumber (L, check<Spectrum> (L)->getMagnitude (static_cast<int> (luaL_checkinteger (L, 2))));
+    return 1;
+}
+
+static int spectrum_size (lua_State* L)
+{
+    lua_pushinteger (L, check<Spectrum> (L)->getSize());
+    return 1;
+}
+
+static const luaL_Reg spectrum_methods[] = {
+    { "__gc",       destroy<Spectrum> },
+    { "process",    spectrum_process },
+    { "magnitude",  spectrum_magnitude },
+    { "size",       spectrum_size },
+    { nullptr, nullptr }
+};
+
+//==============================================================================
+static int dsp_gain (lua_State* L)
+{
+    applyGain (checkBuffer (L, 1), checkFloat (L, 2));
+    return 0;
+}
+
+static int dsp_mix (lua_State* L)
+{
+    mix (checkBuffer (L, 1), checkBuffer (L, 2), optFloat (L, 3, 1.f));
+    return 0;
+}
+
+static int dsp_multiply (lua_State* L)
+{
+    multiply (checkBuffer (L, 1), checkBuffer (L, 2));
+    return 0;
+}
+
+static int dsp_pan (lua_State* L)
+{
+    pan (checkBuffer (L, 1), checkFloat (L, 2));
+    return 0;
+}
+
+/** dsp.matrix (dest, src, gains), where gains is a table of rows, one per
+    output, each holding a gain per input */
+static int dsp_matrix (lua_State* L)
+{
+    auto& dest = checkBuffer (L, 1);
+    auto& src  = checkBuffer (L, 2);
+    luaL_checktype (L, 3, LUA_TTABLE);
+    luaL_argcheck (L, &dest != &src, 2, "source and destination must differ");
+
+    float gains [maxChannels * maxChannels];
+    const int numOuts = jmin ((int) maxChannels, (int) lua_rawlen (L, 3));
+    int numIns = 0;
+
+    for (int o = 0; o < numOuts; ++o)
+    {
+        lua_rawgeti (L, 3, o + 1);
+        luaL_argcheck (L, lua_istable (L, -1), 3, "gains must be a table of rows");
+        if (o == 0)
+            numIns = jmin ((int) maxChannels, (int) lua_rawlen (L, -1));
+
+        for (int i = 0; i < numIns; ++i)
+        {
+            lua_rawgeti (L, -1, i + 1);
+            gains [o * numIns + i] = static_cast<float> (lua_tonumber (L, -1));
+            lua_pop (L, 1);
+        }
+
+        lua_pop (L, 1);
+    }
+
+    matrix (dest, src, gains, numOuts, numIns);
+    return 0;
+}
+
+static const luaL_Reg functions[] = {
+    { "Biquad",     biquad_new },
+    { "SVF",        svf_new },
+    { "Delay",      delay_new },
+    { "Follower",   follower_new },
+    { "Oscillator", oscillator_new },
+    { "Spectrum",   spectrum_new },
+    { "gain",       dsp_gain },
+    { "mix",        dsp_mix },
+    { "multiply",   dsp_multiply },
+    { "pan",        dsp_pan },
+    { "matrix",     dsp_matrix },
+    { nullptr, nullptr }
+};
+
+template<class K>
+static void registerMetatable (lua_State* L, const luaL_Reg* methods)
+{
+    if (luaL_newmetatable (L, Meta<K>::name)) {
+        lua_pushvalue (L, -1);               /* duplicate the metatable */
+        lua_setfield (L, -2, "__index");     /* mt.__index = mt */
+        luaL_setfuncs (L, methods, 0);
+    }
+    lua_pop (L, 1);
+}
+
+}
+}
+
+int luaopen_el_dsp (lua_State* L)
+{
+    using namespace Element::DSPModule;
+    Disposal::getInstance(); // created here so it isn't on the audio thread
+    registerMetatable<Biquad>     (L, biquad_methods);
+    registerMetatable<SVF>        (L, svf_methods);
+    registerMetatable<Delay>      (L, delay_methods);
+    registerMetatable<Follower>   (L, follower_methods);
+    registerMetatable<Oscillator> (L, oscillator_methods);
+    registerMetatable<Spectrum>   (L, spectrum_methods);
+
+    luaL_newlib (L, functions);
+    return 1;
+}
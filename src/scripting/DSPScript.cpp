@@ -40,17 +40,15 @@ namespace SymbolHelpers
 }
 
 //==============================================================================
-class DSPScript::Parameter : public ControlPortParameter,
-                             public Element::Parameter::Listener
+class DSPScript::Parameter : public ControlPortParameter
 {
 public:
     Parameter (DSPScript* c, const PortDescription& port)
-        : ControlPortParameter (port),
-          ctx (c)
+        : ControlPortParameter (port)
     {
         const auto sp = getPort();
         set (sp.defaultValue);
-        addListener (this);
+        ctx = c;
     }
 
     ~Parameter() override
@@ -62,23 +60,22 @@ public:
 
     void unlink()
     {
-        removeListener (this);
         ctx = nullptr;
     }
 
-    void controlValueChanged (int index, float value) override
+    // the graph applies queued events without notifying listeners, so the
+    // value is passed to the script here rather than from a listener
+    void setValue (float newValue) override
     {
+        ControlPortParameter::setValue (newValue);
         if (ctx != nullptr) // index may not be set so use port channel.
-            ctx->setParameter (getPortChannel(), convertFrom0to1 (value));
+            ctx->setParameter (getPortChannel(), get());
     }
 
-    void controlTouched (int parameterIndex, bool gestureIsStarting) override {}
-
     void update (float value)
     {
-        removeListener (this);
+        const ScopedValueSetter<DSPScript*> noForward (ctx, nullptr);
         set (value);
-        addListener (this);
     }
 
 private:
@@ -0,0 +1,241 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "sol/sol.hpp"
+#include "scripting/LuaAllocator.h"
+
+namespace Element {
+
+LuaAllocator::LuaAllocator (size_t maxArenaBytes)
+{
+    // chunks are whole blocks of the largest class
+    const auto largest = getClassSize (numClasses - 1);
+    chunkSize = jmax (largest, ((size_t) EL_LUA_ARENA_CHUNK_SIZE / largest) * largest);
+    if (maxArenaBytes < chunkSize)
+        chunkSize = jmax (largest, (maxArenaBytes / largest) * largest);
+    maxNumChunks = jlimit (1, (int) maxChunks, (int) (maxArenaBytes / chunkSize));
+
+    for (auto& list : freeLists)
+        list = nullptr;
+
+    addChunk();
+}
+
+LuaAllocator::~LuaAllocator()
+{
+    cancelPendingUpdate();
+}
+
+void* LuaAllocator::allocate (void* userdata, void* ptr, size_t oldSize, size_t newSize) noexcept
+{
+    auto& self = *static_cast<LuaAllocator*> (userdata);
+
+    if (newSize == 0)
+    {
+        if (ptr != nullptr)
+            self.freeBlock (ptr, oldSize);
+        return nullptr;
+    }
+
+    // with no pointer, Lua passes the object type as the old size
+    if (ptr == nullptr)
+        return self.allocateBlock (newSize);
+
+    return self.reallocate (ptr, oldSize, newSize);
+}
+
+void LuaAllocator::attach (lua_State* state)
+{
+    lua_gc (state, LUA_GCINC, 0, 0, 0);
+    lua_gc (state, LUA_GCSTOP);
+}
+
+void LuaAllocator::stepGarbage (lua_State* state, int stepKB) noexcept
+{
+    const auto start = Time::getHighResolutionTicks();
+    lua_gc (state, LUA_GCSTEP, stepKB);
+    const auto ms = 1000.0 * Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start);
+
+    gcSteps.fetch_add (1, std::memory_order_relaxed);
+    gcMilliseconds.store (gcMilliseconds.load (std::memory_order_relaxed) + ms, std::memory_order_relaxed);
+    if (ms > maxGcStepMilliseconds.load (std::memory_order_relaxed))
+        maxGcStepMilliseconds.store (ms, std::memory_order_relaxed);
+}
+
+void LuaAllocator::reserve()
+{
+    if (chunkWanted.exchange (false))
+        addChunk();
+}
+
+LuaAllocator::Stats LuaAllocator::getStats() const
+{
+    Stats stats;
+    stats.arenaBytes            = chunkSize * (size_t) numChunks.load (std::memory_order_relaxed);
+    stats.usedBytes             = used.load (std::memory_order_relaxed);
+    stats.highWaterBytes        = highWater.load (std::memory_order_relaxed);
+    stats.allocations           = allocations.load (std::memory_order_relaxed);
+    stats.fallbacks             = fallbacks.load (std::memory_order_relaxed);
+    stats.gcSteps               = gcSteps.load (std::memory_order_relaxed);
+    stats.gcMilliseconds        = gcMilliseconds.load (std::memory_order_relaxed);
+    stats.maxGcStepMilliseconds = maxGcStepMilliseconds.load (std::memory_order_relaxed);
+    return stats;
+}
+
+//==============================================================================
+int LuaAllocator::getClass (size_t size) noexcept
+{
+    int sizeClass = 0;
+    for (size_t classSize = getClassSize (0); classSize < size; classSize <<= 1)
+        ++sizeClass;
+    return sizeClass;
+}
+
+bool LuaAllocator::owns (const void* ptr) const noexcept
+{
+    auto* const p = static_cast<const char*> (ptr);
+    for (int i = numChunks.load (std::memory_order_acquire); --i >= 0;)
+        if (p >= chunks[i].get() && p < chunks[i].get() + chunkSize)
+            return true;
+    return false;
+}
+
+bool LuaAllocator::addChunk()
+{
+    const int index = numChunks.load (std::memory_order_relaxed);
+    if (index >= maxNumChunks)
+        return false;
+
+    // touched so the pages are resident before the audio thread uses them
+    chunks[index].malloc (chunkSize);
+    zeromem (chunks[index].get(), chunkSize);
+    numChunks.store (index + 1, std::memory_order_release);
+    return true;
+}
+
+void LuaAllocator::nextChunk() noexcept
+{
+    // what's left of the current chunk is kept as free blocks
+    auto* const base = chunks[current].get();
+    for (int sizeClass = numClasses; --sizeClass >= 0;)
+    {
+        const auto blockSize = getClassSize (sizeClass);
+        for (; top + blockSize <= chunkSize; top += blockSize)
+            pushFree (base + top, sizeClass);
+    }
+
+    ++current;
+    top = 0;
+}
+
+void LuaAllocator::pushFree (void* block, int sizeClass) noexcept
+{
+    *static_cast<void**> (block) = freeLists [sizeClass];
+    freeLists [sizeClass] = block;
+}
+
+void* LuaAllocator::allocateBlock (size_t size) noexcept
+{
+    allocations.fetch_add (1, std::memory_order_relaxed);
+
+    const int sizeClass = getClass (size);
+    if (sizeClass < numClasses)
+    {
+        const auto blockSize = getClassSize (sizeClass);
+        void* block = freeLists [sizeClass];
+
+        if (block != nullptr)
+        {
+            freeLists [sizeClass] = *static_cast<void**> (block);
+        }
+        else
+        {
+            const int available = numChunks.load (std::memory_order_acquire);
+            if (top + blockSize > chunkSize && current + 1 < available)
+                nextChunk();
+
+            if (top + blockSize <= chunkSize)
+            {
+                block = chunks[current].get() + top;
+                top += blockSize;
+
+                // ask for the next chunk early, so it's there before this one runs out
+                if (current + 1 == available && available < maxNumChunks
+                    && top > chunkSize / 2 && ! chunkWanted.exchange (true))
+                    triggerAsyncUpdate();
+            }
+        }
+
+        if (block != nullptr)
+        {
+            const auto nowUsed = used.fetch_add (blockSize, std::memory_order_relaxed) + blockSize;
+            if (nowUsed > highWater.load (std::memory_order_relaxed))
+                highWater.store (nowUsed, std::memory_order_relaxed);
+            return block;
+        }
+    }
+
+    fallbacks.fetch_add (1, std::memory_order_relaxed);
+    return std::malloc (size);
+}
+
+void LuaAllocator::freeBlock (void* ptr, size_t size) noexcept
+{
+    if (! owns (ptr))
+    {
+        std::free (ptr);
+        return;
+    }
+
+    const int sizeClass = getClass (size);
+    jassert (sizeClass < numClasses);
+    pushFree (ptr, sizeClass);
+    used.fetch_sub (getClassSize (sizeClass), std::memory_order_relaxed);
+}
+
+void* LuaAllocator::reallocate (void* ptr, size_t oldSize, size_t newSize) noexcept
+{
+    if (owns (ptr))
+    {
+        const int oldClass = getClass (oldSize);
+        const int newClass = getClass (newSize);
+        if (newClass == oldClass)
+            return ptr;
+
+        if (newClass < oldClass)
+        {
+            // shrinking can't fail, so keep the front of the block and free
+            // what's after it as one piece of each smaller class
+            for (int sizeClass = newClass; sizeClass < oldClass; ++sizeClass)
+                pushFree (static_cast<char*> (ptr) + getClassSize (sizeClass), sizeClass);
+            used.fetch_sub (getClassSize (oldClass) - getClassSize (newClass), std::memory_order_relaxed);
+            return ptr;
+        }
+    }
+
+    void* const newPtr = allocateBlock (newSize);
+    if (newPtr == nullptr)
+        return newSize <= oldSize ? ptr : nullptr;
+
+    std::memcpy (newPtr, ptr, jmin (oldSize, newSize));
+    freeBlock (ptr, oldSize);
+    return newPtr;
+}
+
+}
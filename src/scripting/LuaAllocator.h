@@ -0,0 +1,132 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+#ifndef EL_LUA_ARENA_SIZE
+ #define EL_LUA_ARENA_SIZE (4 * 1024 * 1024)
+#endif
+
+#ifndef EL_LUA_ARENA_CHUNK_SIZE
+ #define EL_LUA_ARENA_CHUNK_SIZE (256 * 1024)
+#endif
+
+#ifndef EL_LUA_GC_STEP_KB
+ #define EL_LUA_GC_STEP_KB 8
+#endif
+
+struct lua_State;
+
+namespace Element {
+
+/** A lua_Alloc for Lua states which run on the audio thread.
+
+    Memory comes from an arena, in power of two size classes from 16 bytes
+    to 64 KB with a free list for each. The arena starts as one chunk and
+    grows a chunk at a time up to a maximum size. Chunks are added on the
+    message thread, once the last one is half used, so the audio thread
+    never allocates them. Nothing is locked and no system call is made
+    unless the arena runs out or a block is bigger than 64 KB, in which
+    case malloc is used and counted as a fallback.
+
+    Pass allocate() and the allocator to the state's constructor, then call
+    attach() so collection only happens in stepGarbage(), which should be
+    called after rendering each block. The allocator must outlive the state.
+ */
+class LuaAllocator final : private AsyncUpdater
+{
+public:
+    struct Stats
+    {
+        /** Size of the arena's chunks so far */
+        size_t arenaBytes = 0;
+
+        /** Bytes in use, rounded up to size classes */
+        size_t usedBytes = 0;
+
+        /** The most bytes that have been in use at once */
+        size_t highWaterBytes = 0;
+
+        /** Allocations and reallocations which needed a new block */
+        int64 allocations = 0;
+
+        /** Allocations which went to malloc */
+        int64 fallbacks = 0;
+
+        /** Garbage collection steps and the time spent in them */
+        int64 gcSteps = 0;
+        double gcMilliseconds = 0.0;
+        double maxGcStepMilliseconds = 0.0;
+    };
+
+    /** Creates an allocator with the first chunk of its arena.
+        @param maxArenaBytes    the size the arena can grow to
+     */
+    explicit LuaAllocator (size_t maxArenaBytes = EL_LUA_ARENA_SIZE);
+    ~LuaAllocator() override;
+
+    /** The lua_Alloc function, userdata is the allocator */
+    static void* allocate (void* userdata, void* ptr, size_t oldSize, size_t newSize) noexcept;
+
+    /** Switches a state to incremental collection and stops automatic
+        collection. Full collections still run when asked for */
+    static void attach (lua_State* state);
+
+    /** Runs one bounded step of incremental collection */
+    void stepGarbage (lua_State* state, int stepKB = EL_LUA_GC_STEP_KB) noexcept;
+
+    /** Adds a chunk if the allocator asked for one. This is called
+        asynchronously, but can be called directly off the audio thread */
+    void reserve();
+
+    /** Returns counters since the allocator was created */
+    Stats getStats() const;
+
+private:
+    enum { minClassBits = 4, maxClassBits = 16, numClasses = maxClassBits - minClassBits + 1 };
+    enum { maxChunks = 64 };
+
+    HeapBlock<char> chunks [maxChunks];
+    size_t chunkSize = 0, top = 0;
+    int maxNumChunks = 1, current = 0;
+    std::atomic<int> numChunks { 0 };
+    std::atomic<bool> chunkWanted { false };
+    void* freeLists [numClasses];
+
+    std::atomic<size_t> used { 0 }, highWater { 0 };
+    std::atomic<int64> allocations { 0 }, fallbacks { 0 }, gcSteps { 0 };
+    std::atomic<double> gcMilliseconds { 0.0 }, maxGcStepMilliseconds { 0.0 };
+
+    static int getClass (size_t size) noexcept;
+    static size_t getClassSize (int sizeClass) noexcept { return (size_t) 1 << (sizeClass + minClassBits); }
+    bool owns (const void* ptr) const noexcept;
+    bool addChunk();
+    void nextChunk() noexcept;
+    void handleAsyncUpdate() override { reserve(); }
+    void* allocateBlock (size_t size) noexcept;
+    void freeBlock (void* ptr, size_t size) noexcept;
+    void pushFree (void* block, int sizeClass) noexcept;
+    void* reallocate (void* ptr, size_t oldSize, size_t newSize) noexcept;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LuaAllocator)
+};
+
+}
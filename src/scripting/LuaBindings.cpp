@@ -80,6 +80,7 @@ extern int luaopen_kv_Point (lua_State*);
 extern int luaopen_kv_Rectangle (lua_State*);
 extern int luaopen_kv_Slider (lua_State*);
 extern int luaopen_el_MidiPipe (lua_State*);
+extern int luaopen_el_dsp (lua_State*);
 
 using namespace sol;
 
@@ -299,6 +300,10 @@ static int searchInternalModules (lua_State* L)
     {
         sol::stack::push (L, luaopen_el_Session);
     }
+    else if (mod == "el.dsp")
+    {
+        sol::stack::push (L, luaopen_el_dsp);
+    }
     
     
 #define EL_LUA_INTERNAL_MOD_KV      1
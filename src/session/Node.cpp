@@ -20,6 +20,7 @@
 #include "engine/nodes/BaseProcessor.h" // for internal id macros
 #include "session/Node.h"
 #include "session/Session.h"
+#include "session/SessionArchive.h"
 #include "controllers/GraphManager.h"
 #include "ScopedFlag.h"
 
@@ -271,6 +272,8 @@ ValueTree Node::resetIds (const ValueTree& data)
 ValueTree Node::parse (const File& file)
 {
     ValueTree sessionData = Session::readFromFile (file);
+    if (! sessionData.isValid() && SessionArchive::isArchive (file))
+        SessionArchive::load (file, sessionData);
     if (sessionData.isValid())
     {
         const auto graphs = sessionData.getChildWithName (Tags::graphs);
@@ -362,6 +365,11 @@ bool Node::writeToFile (const File& targetFile) const
 }
 
 bool Node::savePresetTo (const DataPath& path, const String& name) const
+{
+    return savePresetTo (path.createNewPresetFile (*this, name));
+}
+
+bool Node::savePresetTo (const File& targetFile) const
 {
     {
         // hack: ensure the plugin's state info is up-to-date
@@ -373,7 +381,6 @@ bool Node::savePresetTo (const DataPath& path, const String& name) const
     sanitizeProperties (data, true);
     preset.addChild (data, -1, 0);
     
-    const auto targetFile = path.createNewPresetFile (*this, name);
     data.setProperty (Tags::name, targetFile.getFileNameWithoutExtension(), 0);
     data.setProperty (Tags::type, Tags::node.toString(), 0);
     
@@ -754,59 +761,76 @@ kv::MidiChannels Node::getMidiChannels() const
     return chans;
 }
 
-void Node::restorePluginState()
+/** Passes the bytes of a state property to fn. Binary properties, as read
+    from session archives, are used as is and strings are base64 decoded */
+template<class Fn>
+static void withStateData (const var& property, Fn&& fn)
+{
+    if (const auto* const block = property.getBinaryData())
+    {
+        if (block->getSize() > 0)
+            fn (block->getData(), (int) block->getSize());
+        return;
+    }
+
+    const auto data = property.toString().trim();
+    if (data.isEmpty())
+        return;
+
+    MemoryBlock state;
+    state.fromBase64Encoding (data);
+    if (state.getSize() > 0)
+        fn (state.getData(), (int) state.getSize());
+}
+
+void Node::applyPluginState (NodeObject& obj, const int wantedProgram,
+                             const var& stateData, const var& programStateData)
+{
+    if (auto* const proc = obj.getAudioProcessor())
+    {
+        const bool shouldSetProgram = proc->getNumPrograms() > 0 && 
+            isPositiveAndBelow (wantedProgram, proc->getNumPrograms());
+        if (shouldSetProgram)
+            proc->setCurrentProgram (wantedProgram);
+
+        withStateData (stateData, [proc] (const void* data, int size) {
+            proc->setStateInformation (data, size);
+        });
+
+        if (shouldSetProgram)
+        {
+            withStateData (programStateData, [proc] (const void* data, int size) {
+                proc->setCurrentProgramStateInformation (data, size);
+            });
+        }
+    }
+    else
+    {
+        const bool shouldSetProgram = obj.getNumPrograms() > 0 && 
+            isPositiveAndBelow (wantedProgram, obj.getNumPrograms());
+        if (shouldSetProgram)
+            obj.setCurrentProgram (wantedProgram);
+
+        withStateData (stateData, [&obj] (const void* data, int size) {
+            obj.setState (data, size);
+        });
+    }
+
+    obj.markStateChanged();
+}
+
+void Node::restorePluginState (const bool includeProgramAndState)
 {
     if (! isValid())
         return;
     
     if (NodeObjectPtr obj = getGraphNode())
     {
-        if (auto* const proc = obj->getAudioProcessor())
-        {
-            const int wantedProgram = objectData.getProperty (Tags::program, -1);
-            const bool shouldSetProgram = proc->getNumPrograms() > 0 && 
-                isPositiveAndBelow (wantedProgram, proc->getNumPrograms());
-            if (shouldSetProgram)
-                proc->setCurrentProgram (wantedProgram);
-
-            auto data = getProperty(Tags::state).toString().trim();
-            if (data.isNotEmpty())
-            {
-                MemoryBlock state;
-                state.fromBase64Encoding (data);
-                if (state.getSize() > 0)
-                {
-                    proc->setStateInformation (state.getData(), (int) state.getSize());
-                }
-            }
-            
-            data = getProperty(Tags::programState).toString().trim();
-            if (shouldSetProgram && data.isNotEmpty())
-            {
-                MemoryBlock state; state.fromBase64Encoding (data);
-                if (state.getSize() > 0)
-                {
-                    proc->setCurrentProgramStateInformation (state.getData(),
-                        (int) state.getSize());
-                }
-            }
-        }
-        else
+        if (includeProgramAndState)
         {
-            const int wantedProgram = objectData.getProperty (Tags::program, -1);
-            const bool shouldSetProgram = obj->getNumPrograms() > 0 && 
-                isPositiveAndBelow (wantedProgram, obj->getNumPrograms());
-            if (shouldSetProgram)
-                obj->setCurrentProgram (wantedProgram);
-
-            auto data = getProperty(Tags::state).toString().trim();
-            if (data.isNotEmpty())
-            {
-                MemoryBlock state;
-                state.fromBase64Encoding (data);
-                if (state.getSize() > 0)
-                    obj->setState (state.getData(), (int) state.getSize());
-            }
+            applyPluginState (*obj, objectData.getProperty (Tags::program, -1),
+                              getProperty (Tags::state),
+                              getProperty (Tags::programState));
         }
 
         if (hasProperty (Tags::bypass))
@@ -854,6 +878,7 @@ void Node::restorePluginState()
         if (hasProperty (Tags::transpose))
             obj->setTransposeOffset (getProperty (Tags::transpose));
         
+        obj->setOversamplingQuality ((int) getProperty (Tags::oversamplingQuality, 0));
         obj->setOversamplingFactor (jmax (1, (int) getProperty (Tags::oversamplingFactor, 1)));
         obj->setDelayCompensation (getProperty (Tags::delayCompensation, 0.0));
     }
@@ -876,53 +901,70 @@ void Node::savePluginState()
     
     NodeObjectPtr obj = getGraphNode();
     if (obj && obj->isPrepared)
-    {
-        MemoryBlock state;
-        
-        if (auto* proc = obj->getAudioProcessor())
-        {
-            proc->getStateInformation (state);
-            if (state.getSize() > 0)
-            {
-                objectData.setProperty (Tags::state, state.toBase64Encoding(), nullptr);
-            }
-            else
-            {
-                const bool clearStateProperty = false;
-                if (clearStateProperty)
-                    objectData.removeProperty (Tags::state, 0);
-            }
+        saveObjectState (obj.get());
 
-            state.reset();
-            proc->getCurrentProgramStateInformation (state);
-            if (state.getSize() > 0)
-            {
-                objectData.setProperty (Tags::programState, state.toBase64Encoding(), 0);
-            }
+    for (int i = 0; i < getNumNodes(); ++i)
+        getNode(i).savePluginState();
+}
+
+bool Node::saveChangedPluginState()
+{
+    if (! isValid())
+        return false;
 
-            setProperty (Tags::bypass, proc->isSuspended());
-            setProperty (Tags::program, proc->getCurrentProgram());
+    NodeObjectPtr obj = getGraphNode();
+    if (obj == nullptr || ! obj->isPrepared || ! obj->clearStateChanged())
+        return false;
+
+    saveObjectState (obj.get());
+    return true;
+}
+
+void Node::saveObjectState (NodeObject* obj)
+{
+    MemoryBlock state;
+    
+    if (auto* proc = obj->getAudioProcessor())
+    {
+        proc->getStateInformation (state);
+        if (state.getSize() > 0)
+        {
+            objectData.setProperty (Tags::state, state.toBase64Encoding(), nullptr);
         }
         else
         {
-            obj->getState (state);
-            if (state.getSize() > 0)
-                objectData.setProperty (Tags::state, state.toBase64Encoding(), nullptr);
+            const bool clearStateProperty = false;
+            if (clearStateProperty)
+                objectData.removeProperty (Tags::state, 0);
         }
 
-        setProperty (Tags::midiProgram, obj->getMidiProgram());
-        setProperty (Tags::globalMidiPrograms, obj->useGlobalMidiPrograms());
-        setProperty (Tags::midiProgramsEnabled, obj->areMidiProgramsEnabled());
-        setProperty (Tags::mute, obj->isMuted());
-        setProperty ("muteInput", obj->isMutingInputs());
-        String mps; obj->getMidiProgramsState (mps);
-        setProperty (Tags::midiProgramsState, mps);
-        setProperty (Tags::oversamplingFactor, obj->getOversamplingFactor());
-        setProperty (Tags::delayCompensation, obj->getDelayCompensation());
+        state.reset();
+        proc->getCurrentProgramStateInformation (state);
+        if (state.getSize() > 0)
+        {
+            objectData.setProperty (Tags::programState, state.toBase64Encoding(), 0);
+        }
+
+        setProperty (Tags::bypass, proc->isSuspended());
+        setProperty (Tags::program, proc->getCurrentProgram());
+    }
+    else
+    {
+        obj->getState (state);
+        if (state.getSize() > 0)
+            objectData.setProperty (Tags::state, state.toBase64Encoding(), nullptr);
     }
 
-    for (int i = 0; i < getNumNodes(); ++i)
-        getNode(i).savePluginState();
+    setProperty (Tags::midiProgram, obj->getMidiProgram());
+    setProperty (Tags::globalMidiPrograms, obj->useGlobalMidiPrograms());
+    setProperty (Tags::midiProgramsEnabled, obj->areMidiProgramsEnabled());
+    setProperty (Tags::mute, obj->isMuted());
+    setProperty ("muteInput", obj->isMutingInputs());
+    String mps; obj->getMidiProgramsState (mps);
+    setProperty (Tags::midiProgramsState, mps);
+    setProperty (Tags::oversamplingFactor, obj->getOversamplingFactor());
+    setProperty (Tags::oversamplingQuality, obj->getOversamplingQuality());
+    setProperty (Tags::delayCompensation, obj->getDelayCompensation());
 }
 
 void Node::setMuted (bool shouldBeMuted)
@@ -1156,12 +1198,8 @@ void NodeObjectSync::valueTreePropertyChanged (ValueTree& tree, const Identifier
     }
     else if (property == Tags::delayCompensation)
     {
+        // the graph re-plans its delays when the latency changes
         obj->setDelayCompensation (tree.getProperty (property, obj->getDelayCompensation()));
-        if (auto* const g = obj->getParentGraph())
-        {
-            g->cancelPendingUpdate();
-            g->triggerAsyncUpdate();
-        }
     }
 }
 
@@ -411,6 +411,9 @@ public:
 
     /** Save this node as a preset to file */
     bool savePresetTo (const DataPath& path, const String& name) const;
+
+    /** Save this node as a preset to a specific file */
+    bool savePresetTo (const File& targetFile) const;
     
     /** Get an array of possible sources that can connect to this Node */
     void getPossibleSources (NodeArray& nodes) const;
@@ -438,9 +441,21 @@ public:
     //=========================================================================
     /** Saves the node state from NodeObject to state property */
     void savePluginState();
+
+    /** Saves the state of this node only, and only if its NodeObject flagged
+        a change since the last call. Returns true if the state was saved */
+    bool saveChangedPluginState();
     
-    /** Reads state property and applies to NodeObject */
-    void restorePluginState();
+    /** Reads state property and applies to NodeObject. Pass false to restore
+        everything except the program and plugin state, for when they were
+        already applied with applyPluginState() */
+    void restorePluginState (bool includeProgramAndState = true);
+
+    /** Applies a saved program and state to a node object. State can be base64
+        text or binary data. This doesn't touch the model, so loaders can call
+        it on a background thread for nodes that aren't in a graph yet */
+    static void applyPluginState (NodeObject& object, int program,
+                                  const var& state, const var& programState);
     
     //=========================================================================
     /** Get the number of factory presets */
@@ -494,6 +509,7 @@ public:
 
 private:
     void setMissingProperties();
+    void saveObjectState (NodeObject*);
     void forEach (const ValueTree tree, std::function<void(const ValueTree& tree)>) const;
 };
 
@@ -21,6 +21,7 @@
 #include "session/Node.h"
 #include "engine/nodes/NodeTypes.h"
 #include "engine/nodes/SubGraphProcessor.h"
+#include "engine/InternalFormat.h"
 #include "engine/NodeFactory.h"
 #include "DataPath.h"
 #include "Settings.h"
@@ -36,6 +37,7 @@
 #define EL_PLUGIN_SCANNER_FINISHED_ID           "finished"
 
 #define EL_PLUGIN_SCANNER_DEFAULT_TIMEOUT       20000  // 20 Seconds
+#define EL_PLUGIN_SCANNER_FILE_TIMEOUT          120000 // 2 Minutes
 
 namespace Element {
 
@@ -43,188 +45,70 @@ static const char* pluginListKey() { return Settings::pluginListKey; }
 /* noop. prevent OS error dialogs from child process */ 
 static void pluginScannerSlaveCrashHandler (void*) { }
 
-class PluginScannerMaster : public kv::ChildProcessMaster,
-                            public AsyncUpdater
+/** One scanner process. Scans a single file at a time, as handed out by the
+    PluginScanner. Messages arrive on the connection thread and are queued
+    for the scanner to handle on the message thread */
+class PluginScannerMaster : public kv::ChildProcessMaster
 {
 public:
-    explicit PluginScannerMaster (PluginScanner& o) : owner(o) { }
+    explicit PluginScannerMaster (PluginScanner& o) : owner (o) { }
     ~PluginScannerMaster() { }
-    
-    bool startScanning (const StringArray& names = StringArray())
+
+    bool launch()
     {
-        if (isRunning())
-            return true;
-        
-        {
-            ScopedLock sl (lock);
-            slaveState  = "waiting";
-            running     = false;
-            formatNames = names;
-        }
-        
-        const bool res = launchScanner();
-        
-        {
-            ScopedLock sl (lock);
-            running = res;
-        }
-        
-        return res;
+        return launchSlaveProcess (File::getSpecialLocation (File::invokedExecutableFile),
+                                   EL_PLUGIN_SCANNER_PROCESS_ID, EL_PLUGIN_SCANNER_DEFAULT_TIMEOUT, 0);
     }
-    
+
     void handleMessageFromSlave (const MemoryBlock& mb) override
     {
-        const auto data (mb.toString());
-        const auto type (data.upToFirstOccurrenceOf (":", false, false));
-        const auto message (data.fromFirstOccurrenceOf (":", false, false));
-        
-        if (type == "state")
         {
             ScopedLock sl (lock);
-            const String lastState = slaveState;
-            slaveState = message;
-            if (lastState != slaveState)
-            {
-                ScopedUnlock sul (lock);
-                triggerAsyncUpdate();
-            }
-        }
-        else if (type == "name")
-        {
-            owner.listeners.call (&PluginScanner::Listener::audioPluginScanStarted, message.trim());
-            ScopedLock sl (lock);
-            pluginBeingScanned = message.trim();
-        }
-        else if (type == "progress")
-        {
-            float newProgress = (float) var (message);
-            owner.listeners.call (&PluginScanner::Listener::audioPluginScanProgress, newProgress);
-            ScopedLock sl (lock);
-            progress = newProgress;
+            messages.add (mb.toString());
         }
+
+        owner.triggerAsyncUpdate();
     }
-    
+
     void handleConnectionLost() override
     {
         // this probably will happen when a plugin crashes.
-        {
-            ScopedLock sl (lock);
-            running = false;
-        }
-        
-        triggerAsyncUpdate();
-    }
-    
-    void handleAsyncUpdate() override
-    {
-        const auto state = getSlaveState();
-        if (state == "ready" && isRunning())
-        {
-            String msg = "scan:"; msg << formatNames.joinIntoString(",");
-            MemoryBlock mb (msg.toRawUTF8(), msg.length());
-            sendMessageToSlave (mb);
-        }
-        else if (state == "scanning")
-        {
-            if (! isRunning())
-            {
-                DBG("[EL] a plugin crashed or timed out during scan");
-                updateListAndLaunchSlave();
-            }
-            else
-            {
-                DBG("[EL] scanning... and running....");
-            }
-        }
-		else if (state == "finished")
-		{
-			DBG("[EL] slave finished scanning");
-			{
-				ScopedLock sl(lock);
-				running = false;
-				slaveState = "idle";
-			}
-            owner.listeners.call (&PluginScanner::Listener::audioPluginScanFinished);
-			
-        }
-        else if (state == "waiting")
-        {
-            if (! isRunning())
-            {
-                DBG("[EL] waiting for plugin scanner");
-                updateListAndLaunchSlave();
-            }
-        }
-		else if (slaveState == "quitting")
-		{
-			return;
-		}
-        else
-        {
-            DBG("[EL] invalid slave state: " << state);
-        }
+        connectionLost = true;
+        owner.triggerAsyncUpdate();
     }
-    
-    const String getSlaveState() const
-    {
-        ScopedLock sl (lock);
-        return slaveState;
-    }
-    
-    float getProgress() const
+
+    void takeMessages (StringArray& dest)
     {
         ScopedLock sl (lock);
-        return progress;
+        dest.swapWith (messages);
+        messages.clearQuick();
     }
-    
-    bool isRunning() const
+
+    bool hasLostConnection() const      { return connectionLost.load(); }
+    void abandon()                      { connectionLost = true; }
+
+    bool sendString (const String& type, const String& message)
     {
-        ScopedLock sl (lock);
-        return running;
+        String data = type; data << ":" << message;
+        return sendMessageToSlave (MemoryBlock (data.toRawUTF8(), data.getNumBytesAsUTF8()));
     }
-    
+
     bool sendQuitMessage()
     {
-        if (isRunning())
-            return sendMessageToSlave (MemoryBlock ("quit", 4));
-        return false;
+        return sendMessageToSlave (MemoryBlock ("quit", 4));
     }
-    
+
+    // message thread only
+    PluginScanner::Job job;
+    bool hasJob = false;
+    uint32 jobStarted = 0;
+    int crashesWithoutJob = 0;
+
 private:
     PluginScanner& owner;
-
     CriticalSection lock;
-    bool running    = false;
-    float progress  = 0.f;
-    String slaveState;
-    StringArray formatNames;
-    StringArray faileFiles;
-    
-    String pluginBeingScanned;
-
-    void updateListAndLaunchSlave()
-    {
-        if (auto xml = XmlDocument::parse (PluginScanner::getSlavePluginListFile()))
-            owner.list.recreateFromXml (*xml);
-        
-        const bool res = launchScanner();
-        ScopedLock sl (lock);
-        running = res;
-    }
-    
-    void resetScannerVariables()
-    {
-        ScopedLock sl (lock);
-        pluginBeingScanned = String();
-        progress = -1.f;
-    }
-    
-    bool launchScanner (const int timeout = EL_PLUGIN_SCANNER_DEFAULT_TIMEOUT, const int flags = 0)
-    {
-        resetScannerVariables();
-        return launchSlaveProcess (File::getSpecialLocation (File::invokedExecutableFile),
-                                   EL_PLUGIN_SCANNER_PROCESS_ID, timeout, flags);
-    }
+    StringArray messages;
+    std::atomic<bool> connectionLost { false };
 };
 
 class PluginScannerSlave : public kv::ChildProcessSlave, public AsyncUpdater
@@ -232,7 +116,6 @@ class PluginScannerSlave : public kv::ChildProcessSlave, public AsyncUpdater
 public:
     PluginScannerSlave()
     {
-        scanFile = PluginScanner::getSlavePluginListFile();
         SystemStats::setApplicationCrashHandler (pluginScannerSlaveCrashHandler);
     }
     
@@ -252,106 +135,46 @@ public:
         
         if (type == "scan")
         {
-            const auto formats (StringArray::fromTokens (message.trim(), ",", "'"));
-            formatsToScan = formats;
+            {
+                ScopedLock sl (lock);
+                jobs.add (message);
+            }
+
             triggerAsyncUpdate();
         }
     }
     
     void handleAsyncUpdate() override
     {
-        if (! scanFile.existsAsFile())
+        StringArray toScan;
+
         {
-            sendState ("scanning");
-            sendState ("finished");
-            return;
+            ScopedLock sl (lock);
+            toScan.swapWith (jobs);
         }
-        
-        updateScanFileWithSettings();
-        
-        sendState ("scanning");
-        
-        for (const auto& format : formatsToScan)
-            scanFor (format);
-        
-        settings->saveIfNeeded();
-        sendState ("finished");
 
-       #if JUCE_LINUX
-        // workaround to get the background process to quit
-        handleConnectionLost();
-       #endif
-    }
-    
-    void updateScanFileWithSettings()
-    {
-        if (! plugins)
-            return;
-        
-        auto& list = plugins->getKnownPlugins();
-        const auto types = list.getTypes();
-        for (const auto& type : types)
-            pluginList.addType (type);
-        
-        for (const auto& file : list.getBlacklistedFiles())
-            pluginList.addToBlacklist (file);
-        
-        writePluginListNow();
+        for (const auto& job : toScan)
+            scan (job.upToFirstOccurrenceOf ("\n", false, false),
+                  job.fromFirstOccurrenceOf ("\n", false, false));
     }
     
     void handleConnectionMade() override
     {
-        settings    = new Settings();
-        plugins     = new PluginManager();
-        
-        if (! scanFile.existsAsFile())
-            scanFile.create();
-        
-        if (auto xml = XmlDocument::parse (scanFile))
-            pluginList.recreateFromXml (*xml);
-        
-        // This must happen before user settings, PluginManager will delete the deadman file
-        // when restoring user plugins
-        PluginDirectoryScanner::applyBlacklistingsFromDeadMansPedal (
-            pluginList, plugins->getDeadAudioPluginsFile());
-        
+        plugins = new PluginManager();
         plugins->addDefaultFormats();
-        plugins->restoreUserPlugins (*settings);
-        
         sendState (EL_PLUGIN_SCANNER_READY_ID);
     }
     
     void handleConnectionLost() override
     {
-        settings    = nullptr;
-        plugins     = nullptr;
-        scanner     = nullptr;
+        plugins = nullptr;
         exit (0);
     }
 
 private:
-    ScopedPointer<Settings> settings;
     ScopedPointer<PluginManager> plugins;
-    ScopedPointer<PluginDirectoryScanner> scanner;
-    String fileOrIdentifier;
-    KnownPluginList pluginList;
-    StringArray filesToSkip;
-    File scanFile;
-    StringArray formatsToScan;
-    
-    void applyDeadPlugins()
-    {
-        PluginDirectoryScanner::applyBlacklistingsFromDeadMansPedal (
-            pluginList, plugins->getDeadAudioPluginsFile());
-    }
-    
-    bool writePluginListNow()
-    {
-        applyDeadPlugins();
-        if (auto xml = pluginList.createXml())
-            return xml->writeToFile (scanFile, String());
-        return false;
-    }
+    CriticalSection lock;
+    StringArray jobs;
     
     bool sendState (const String& state)
     {
@@ -365,90 +188,272 @@ private:
         return sendMessageToMaster (mb);
     }
     
-    bool doNextScan()
+    void scan (const String& formatName, const String& file)
     {
-        const auto nextFile = scanner->getNextPluginFileThatWillBeScanned();
-        sendString ("name", nextFile);
-        for (const auto& file : scanner->getFailedFiles())
-            pluginList.addToBlacklist (file);
+        XmlElement result ("SCANRESULT");
+        result.setAttribute ("format", formatName);
+        result.setAttribute ("file", file);
 
-        if (scanner->scanNextFile (true, fileOrIdentifier))
+        if (auto* format = plugins != nullptr ? plugins->getAudioPluginFormat (formatName) : nullptr)
         {
-            writePluginListNow();
-            return true;
+            OwnedArray<PluginDescription> found;
+            format->findAllTypesForFile (found, file);
+            for (const auto* type : found)
+                if (auto e = std::unique_ptr<XmlElement> (type->createXml()))
+                    result.addChildElement (e.release());
         }
-        
-        return false;
-    }
-    
-    void scanFor (const String& formatName)
-    {
-        if (plugins == nullptr || settings == nullptr)
-            return;
-        if (auto* format = plugins->getAudioPluginFormat (formatName))
-            scanFor (*format);
-    }
-    
-    void scanFor (AudioPluginFormat& format)
-    {
-        if (plugins == nullptr || settings == nullptr)
-            return;
-        
-        const auto key = String(settings->lastPluginScanPathPrefix) + format.getName();
-        FileSearchPath path (settings->getUserSettings()->getValue (key));
-        scanner = new PluginDirectoryScanner (pluginList, format, path, true,
-                                              plugins->getDeadAudioPluginsFile(),
-                                              false);
-        
-        while (doNextScan())
-            sendString ("progress", String (scanner->getProgress()));
-        
-        writePluginListNow();
-        #if JUCE_LINUX
-        Thread::sleep (1000);
-        #endif
+
+        sendString ("found", result.createDocument (String(), true, false));
     }
 };
 
 // MARK: Plugin Scanner
 
-PluginScanner::PluginScanner (KnownPluginList& listToManage) : list(listToManage) { }
+PluginScanner::PluginScanner (PluginManager& m, KnownPluginList& listToManage)
+    : manager (m), list (listToManage) { }
+
 PluginScanner::~PluginScanner()
 {
     listeners.clear();
-    master.reset();
+    cancel();
+}
+
+int PluginScanner::getNumProcesses()
+{
+    return jlimit (1, 8, SystemStats::getNumCpus());
 }
 
 void PluginScanner::cancel()
 {
-    if (master)
-    {
-        master->cancelPendingUpdate();
+    cancelPendingUpdate();
+    stopTimer();
+
+    for (auto* master : masters)
         master->sendQuitMessage();
-		master.reset();
-    }
+    masters.clear();
+
+    jobs.clearQuick();
+    nextJob = numFinished = 0;
+    scanning = false;
 }
 
-bool PluginScanner::isScanning() const { return master && master->isRunning(); }
+bool PluginScanner::isScanning() const { return scanning; }
 
 void PluginScanner::scanForAudioPlugins (const juce::String &formatName)
 {
     scanForAudioPlugins (StringArray ({ formatName }));
 }
 
+FileSearchPath PluginScanner::getSearchPath (AudioPluginFormat& format) const
+{
+    if (auto* props = manager.props)
+        return FileSearchPath (props->getValue (String (Settings::lastPluginScanPathPrefix) + format.getName()));
+    return format.getDefaultLocationsToSearch();
+}
+
 void PluginScanner::scanForAudioPlugins (const StringArray& formats)
 {
     cancel();
+    failedIdentifiers.clearQuick();
     getSlavePluginListFile().deleteFile();
-	if (master == nullptr)
-		master.reset (new PluginScannerMaster (*this));
-	if (master->isRunning())
-		return;
-    master->startScanning (formats);
+
+    if (! cacheLoaded)
+    {
+        cache.load (PluginScanCache::getDefaultFile());
+        cacheLoaded = true;
+    }
+
+    for (const auto& formatName : formats)
+    {
+        auto* format = manager.getAudioPluginFormat (formatName);
+        if (format == nullptr || ! format->canScanForPlugins())
+            continue;
+
+        const auto blacklist = list.getBlacklistedFiles();
+        for (const auto& file : format->searchPathsForPlugins (getSearchPath (*format), true, false))
+        {
+            if (blacklist.contains (file))
+                continue;
+
+            OwnedArray<PluginDescription> types;
+            if (cache.restore (format->getName(), file, types))
+            {
+                for (const auto* type : types)
+                    list.addType (*type);
+                continue;
+            }
+
+            if (list.getTypeForFile (file) != nullptr && list.isListingUpToDate (file, *format))
+                continue;
+
+            jobs.add (Job { format->getName(), file });
+        }
+    }
+
+    scanning = true;
+    for (int i = jmin (jobs.size(), getNumProcesses()); --i >= 0;)
+    {
+        std::unique_ptr<PluginScannerMaster> master (new PluginScannerMaster (*this));
+        if (master->launch())
+            masters.add (master.release());
+    }
+
+    startTimer (1000);
+    // finishes right away if everything was cached
+    triggerAsyncUpdate();
+}
+
+void PluginScanner::startNextJob (PluginScannerMaster& master)
+{
+    master.hasJob = false;
+    if (nextJob >= jobs.size())
+        return;
+
+    master.job = jobs.getReference (nextJob++);
+    master.hasJob = true;
+    master.jobStarted = Time::getMillisecondCounter();
+    listeners.call (&PluginScanner::Listener::audioPluginScanStarted, master.job.file);
+    master.sendString ("scan", master.job.format + "\n" + master.job.file);
+}
+
+void PluginScanner::fileScanned (const Job& job, const XmlElement* result)
+{
+    if (result != nullptr)
+    {
+        OwnedArray<PluginDescription> types;
+        forEachXmlChildElement (*result, e)
+        {
+            std::unique_ptr<PluginDescription> type (new PluginDescription());
+            if (type->loadFromXml (*e))
+                types.add (type.release());
+        }
+
+        for (const auto* type : types)
+            list.addType (*type);
+        if (types.isEmpty())
+            failedIdentifiers.addIfNotAlreadyThere (job.file);
+
+        cache.store (job.format, job.file, types);
+    }
+    else
+    {
+        // crashed or timed out
+        list.addToBlacklist (job.file);
+        failedIdentifiers.addIfNotAlreadyThere (job.file);
+        cache.remove (job.format, job.file);
+    }
+
+    ++numFinished;
+    listeners.call (&PluginScanner::Listener::audioPluginScanProgress,
+                    (float) numFinished / (float) jmax (1, jobs.size()));
+}
+
+void PluginScanner::handleMessage (PluginScannerMaster& master, const String& data)
+{
+    const auto type (data.upToFirstOccurrenceOf (":", false, false));
+    const auto message (data.fromFirstOccurrenceOf (":", false, false));
+
+    if (type == "state" && message == EL_PLUGIN_SCANNER_READY_ID)
+    {
+        master.crashesWithoutJob = 0;
+        startNextJob (master);
+    }
+    else if (type == "found" && master.hasJob)
+    {
+        auto result = std::unique_ptr<XmlElement> (XmlDocument::parse (message));
+        // a garbled or mismatched answer fails this file, the process would
+        // otherwise sit idle until the job times out
+        if (result == nullptr || result->getStringAttribute ("file") != master.job.file)
+            result.reset();
+
+        fileScanned (master.job, result.get());
+        startNextJob (master);
+    }
+}
+
+void PluginScanner::handleAsyncUpdate()
+{
+    if (! scanning)
+        return;
+
+    for (int i = 0; i < masters.size(); ++i)
+    {
+        auto* master = masters.getUnchecked (i);
+        StringArray messages;
+        master->takeMessages (messages);
+        for (const auto& message : messages)
+            handleMessage (*master, message);
+
+        if (! master->hasLostConnection())
+            continue;
+
+        // the file being scanned is to blame, anything else is the process
+        int crashesWithoutJob = 0;
+        if (master->hasJob)
+            fileScanned (master->job, nullptr);
+        else
+            crashesWithoutJob = master->crashesWithoutJob + 1;
+
+        std::unique_ptr<PluginScannerMaster> replacement;
+        if (nextJob < jobs.size() && crashesWithoutJob < 3)
+        {
+            replacement.reset (new PluginScannerMaster (*this));
+            replacement->crashesWithoutJob = crashesWithoutJob;
+            if (! replacement->launch())
+                replacement.reset();
+        }
+
+        if (replacement != nullptr)
+        {
+            masters.set (i, replacement.release(), true);
+        }
+        else
+        {
+            masters.remove (i--);
+        }
+    }
+
+    bool busy = false;
+    for (const auto* master : masters)
+        busy |= master->hasJob;
+
+    if (! busy && (nextJob >= jobs.size() || masters.isEmpty()))
+        finishScan();
+}
+
+void PluginScanner::finishScan()
+{
+    DBG("[EL] plugin scan finished: " << numFinished << " of " << jobs.size() << " files scanned");
+
+    // files never handed out when every process failed to start
+    while (nextJob < jobs.size())
+        failedIdentifiers.addIfNotAlreadyThere (jobs.getReference (nextJob++).file);
+
+    cache.save (PluginScanCache::getDefaultFile());
+    if (auto xml = std::unique_ptr<XmlElement> (list.createXml()))
+        xml->writeToFile (getSlavePluginListFile(), String());
+
+    cancel();
+    listeners.call (&PluginScanner::Listener::audioPluginScanFinished);
 }
 
 void PluginScanner::timerCallback()
 {
+    // a plugin stuck loading keeps answering pings, so time out the file too
+    const auto now = Time::getMillisecondCounter();
+    bool timedOut = false;
+    for (auto* master : masters)
+    {
+        if (master->hasJob && now - master->jobStarted > EL_PLUGIN_SCANNER_FILE_TIMEOUT)
+        {
+            DBG("[EL] timed out scanning " << master->job.file);
+            master->abandon();
+            timedOut = true;
+        }
+    }
+
+    if (timedOut)
+        triggerAsyncUpdate();
 }
 
 // MARK: Unverified Plugins
@@ -589,6 +594,7 @@ private:
 	double sampleRate = 44100.0;
 	int    blockSize = 512;
 	std::unique_ptr<PluginScanner> scanner;
+    std::unique_ptr<ThreadPool> loadingPool;
 
 	void scanAudioPlugins (const StringArray& names)
 	{
@@ -605,7 +611,7 @@ private:
 				if (formats.getFormat(i)->getName() != "Element" && formats.getFormat(i)->canScanForPlugins())
 					formatsToScan.add(formats.getFormat(i)->getName());
 
-		scanner = std::make_unique<PluginScanner> (allPlugins);
+		scanner = std::make_unique<PluginScanner> (owner, allPlugins);
 		scanner->addListener (this);
 		scanner->scanForAudioPlugins (formatsToScan);
 	}
@@ -719,7 +725,7 @@ kv::ChildProcessSlave* PluginManager::createAudioPluginScannerSlave()
 
 PluginScanner* PluginManager::createAudioPluginScanner()
 {
-    auto* scanner = new PluginScanner (getKnownPlugins());
+    auto* scanner = new PluginScanner (*this, getKnownPlugins());
     return scanner;
 }
 
@@ -745,10 +751,38 @@ bool PluginManager::isScanningAudioPlugins()
 
 AudioPluginInstance* PluginManager::createAudioPlugin (const PluginDescription& desc, String& errorMsg)
 {
+    if (desc.pluginFormatName == EL_INTERNAL_FORMAT_NAME)
+        if (auto* const fmt = format<ElementAudioPluginFormat>())
+            return fmt->instantiatePlugin (desc, priv->sampleRate, priv->blockSize);
+
     return getAudioPluginFormats().createPluginInstance (
         desc, priv->sampleRate, priv->blockSize, errorMsg).release();
 }
 
+bool PluginManager::canCreateInBackground (const PluginDescription& desc) const
+{
+    if (desc.pluginFormatName != EL_INTERNAL_FORMAT_NAME)
+    {
+        auto* const fmt = getAudioPluginFormat (desc.pluginFormatName);
+        return fmt != nullptr && ! fmt->requiresUnblockedMessageThreadDuringCreation (desc);
+    }
+
+    // these create sub controllers, files or network listeners which
+    // expect the message thread
+    static const StringArray messageThreadOnly (
+        EL_INTERNAL_ID_GRAPH, EL_INTERNAL_ID_AUDIO_FILE_PLAYER, EL_INTERNAL_ID_MEDIA_PLAYER,
+        EL_INTERNAL_ID_PLACEHOLDER, EL_INTERNAL_ID_MIDI_MONITOR,
+        EL_INTERNAL_ID_OSC_SENDER, EL_INTERNAL_ID_OSC_RECEIVER);
+    return ! messageThreadOnly.contains (desc.fileOrIdentifier);
+}
+
+ThreadPool& PluginManager::getLoadingPool()
+{
+    if (priv->loadingPool == nullptr)
+        priv->loadingPool.reset (new ThreadPool (jlimit (1, 8, SystemStats::getNumCpus())));
+    return *priv->loadingPool;
+}
+
 NodeObject* PluginManager::createGraphNode (const PluginDescription& desc, String& errorMsg)
 {
     errorMsg.clear();
@@ -20,6 +20,7 @@
 #pragma once
 
 #include "ElementApp.h"
+#include "session/PluginScanCache.h"
 
 #define EL_PLUGIN_SCANNER_PROCESS_ID    "pspelbg"
 
@@ -108,6 +109,14 @@ public:
     AudioPluginInstance* createAudioPlugin (const PluginDescription& desc, String& errorMsg);
     NodeObject* createGraphNode (const PluginDescription& desc, String& errorMsg);
 
+    /** Returns true if a node for this description can be created and have its
+        state restored on a background thread. Third party plugins can be if
+        their format doesn't need the message thread free while creating them */
+    bool canCreateInBackground (const PluginDescription& desc) const;
+
+    /** Returns the pool which creates nodes in the background when graphs load */
+    ThreadPool& getLoadingPool();
+
     /** Set the play config used when instantiating plugins */
     void setPlayConfig (double sampleRate, int blockSize);
 
@@ -131,16 +140,25 @@ private:
     class Private;
     std::unique_ptr<Private> priv;
     
-    friend class PluginScannerMaster;
+    friend class PluginScanner;
     void scanFinished();
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PluginManager);
 };
 
-class PluginScanner : private Timer
+/** Scans plugins in a pool of child processes.
+
+    Files to scan are queued and handed out one at a time to whichever
+    process is free, so a plugin which crashes or hangs only takes down the
+    file being scanned. That file is blacklisted and its process restarted.
+    Results are merged into the list as each file reports, and kept in a
+    PluginScanCache so unchanged files are skipped next time.
+ */
+class PluginScanner : private Timer,
+                      private AsyncUpdater
 {
 public:
-    PluginScanner (KnownPluginList&);
+    PluginScanner (PluginManager&, KnownPluginList&);
     ~PluginScanner();
     
     class Listener
@@ -177,13 +195,37 @@ public:
     /** Returns a list of plugins that failed to load */
     const StringArray& getFailedFiles() const { return failedIdentifiers; }
 
+    /** Returns the number of scanner processes to run at once */
+    static int getNumProcesses();
+
 private:
     friend class PluginScannerMaster;
     friend class Timer;
-    std::unique_ptr<PluginScannerMaster> master;
+    PluginManager& manager;
+    KnownPluginList& list;
+    OwnedArray<PluginScannerMaster> masters;
     ListenerList<Listener> listeners;
     StringArray failedIdentifiers;
-    KnownPluginList& list;
+    PluginScanCache cache;
+    bool cacheLoaded = false;
+
+    struct Job
+    {
+        String format;
+        String file;
+    };
+
+    Array<Job> jobs;
+    int nextJob = 0;
+    int numFinished = 0;
+    bool scanning = false;
+
+    FileSearchPath getSearchPath (AudioPluginFormat&) const;
+    void startNextJob (PluginScannerMaster&);
+    void handleMessage (PluginScannerMaster&, const String&);
+    void fileScanned (const Job&, const XmlElement* result);
+    void finishScan();
+    void handleAsyncUpdate() override;
     void timerCallback() override;
 };
 
@@ -0,0 +1,149 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "session/PluginScanCache.h"
+#include "DataPath.h"
+
+#define EL_PLUGIN_SCAN_CACHE_FILENAME   "PluginScanCache.xml"
+#define EL_PLUGIN_SCAN_CACHE_VERSION    1
+
+namespace Element {
+
+File PluginScanCache::getDefaultFile()
+{
+    return DataPath::applicationDataDir().getChildFile (EL_PLUGIN_SCAN_CACHE_FILENAME);
+}
+
+String PluginScanCache::makeKey (const String& formatName, const String& fileOrIdentifier)
+{
+    return formatName + ":" + fileOrIdentifier;
+}
+
+bool PluginScanCache::getStamp (const String& fileOrIdentifier, Stamp& stamp)
+{
+    if (! File::isAbsolutePath (fileOrIdentifier))
+        return false;
+
+    const File file (fileOrIdentifier);
+    if (file.existsAsFile())
+    {
+        stamp.modified = file.getLastModificationTime().toMilliseconds();
+        stamp.size = file.getSize();
+        return true;
+    }
+
+    if (! file.isDirectory())
+        return false;
+
+    // bundles, the binary inside can change without touching the folder
+    stamp.modified = file.getLastModificationTime().toMilliseconds();
+    stamp.size = 0;
+    for (DirectoryIterator iter (file, true, "*", File::findFiles); iter.next();)
+    {
+        const auto child = iter.getFile();
+        stamp.modified = jmax (stamp.modified, child.getLastModificationTime().toMilliseconds());
+        stamp.size += child.getSize();
+    }
+
+    return true;
+}
+
+bool PluginScanCache::load (const File& file)
+{
+    entries.clear();
+
+    auto xml = std::unique_ptr<XmlElement> (XmlDocument::parse (file));
+    if (xml == nullptr || ! xml->hasTagName ("PLUGINSCANCACHE")
+        || xml->getIntAttribute ("version") != EL_PLUGIN_SCAN_CACHE_VERSION)
+        return false;
+
+    forEachXmlChildElementWithTagName (*xml, e, "FILE")
+    {
+        Entry entry;
+        entry.stamp.modified = e->getStringAttribute ("modified").getLargeIntValue();
+        entry.stamp.size     = e->getStringAttribute ("size").getLargeIntValue();
+
+        forEachXmlChildElement (*e, p)
+        {
+            PluginDescription type;
+            if (type.loadFromXml (*p))
+                entry.types.add (type);
+        }
+
+        entries[makeKey (e->getStringAttribute ("format"), e->getStringAttribute ("path"))] = entry;
+    }
+
+    return true;
+}
+
+bool PluginScanCache::save (const File& file) const
+{
+    XmlElement xml ("PLUGINSCANCACHE");
+    xml.setAttribute ("version", EL_PLUGIN_SCAN_CACHE_VERSION);
+
+    for (const auto& item : entries)
+    {
+        auto* e = xml.createNewChildElement ("FILE");
+        e->setAttribute ("format", item.first.upToFirstOccurrenceOf (":", false, false));
+        e->setAttribute ("path", item.first.fromFirstOccurrenceOf (":", false, false));
+        e->setAttribute ("modified", String (item.second.stamp.modified));
+        e->setAttribute ("size", String (item.second.stamp.size));
+        for (const auto& type : item.second.types)
+            if (auto p = std::unique_ptr<XmlElement> (type.createXml()))
+                e->addChildElement (p.release());
+    }
+
+    file.getParentDirectory().createDirectory();
+    return xml.writeToFile (file, String());
+}
+
+bool PluginScanCache::restore (const String& formatName, const String& fileOrIdentifier,
+                               OwnedArray<PluginDescription>& types) const
+{
+    const auto iter = entries.find (makeKey (formatName, fileOrIdentifier));
+    if (iter == entries.end())
+        return false;
+
+    Stamp stamp;
+    if (! getStamp (fileOrIdentifier, stamp) || ! (stamp == iter->second.stamp))
+        return false;
+
+    for (const auto& type : iter->second.types)
+        types.add (new PluginDescription (type));
+    return true;
+}
+
+void PluginScanCache::store (const String& formatName, const String& fileOrIdentifier,
+                             const OwnedArray<PluginDescription>& types)
+{
+    Entry entry;
+    if (! getStamp (fileOrIdentifier, entry.stamp))
+        return;
+
+    for (const auto* type : types)
+        entry.types.add (*type);
+    entries[makeKey (formatName, fileOrIdentifier)] = entry;
+}
+
+void PluginScanCache::remove (const String& formatName, const String& fileOrIdentifier)
+{
+    entries.erase (makeKey (formatName, fileOrIdentifier));
+}
+
+}
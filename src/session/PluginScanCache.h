@@ -0,0 +1,91 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+namespace Element {
+
+/** Remembers what scanning each plugin file found, so unchanged files can be
+    skipped on the next scan.
+
+    Entries are keyed by format and path, and are only used while the file's
+    modification time and size still match. For bundles these are the newest
+    time and total size of the files inside. Identifiers which aren't files,
+    such as LV2 URIs, are never cached.
+ */
+class PluginScanCache final
+{
+public:
+    PluginScanCache() { }
+    ~PluginScanCache() { }
+
+    /** Returns the cache file in the user's application data */
+    static File getDefaultFile();
+
+    /** Replaces the cache with the contents of a file. Returns false if the
+        file couldn't be read, in which case the cache is empty */
+    bool load (const File& file);
+
+    /** Writes the cache to a file */
+    bool save (const File& file) const;
+
+    /** Fills types with what was found the last time a file was scanned.
+        Returns false if there's no entry or the file changed since */
+    bool restore (const String& formatName, const String& fileOrIdentifier,
+                  OwnedArray<PluginDescription>& types) const;
+
+    /** Records what scanning a file found. An empty list records a file that
+        isn't a plugin */
+    void store (const String& formatName, const String& fileOrIdentifier,
+                const OwnedArray<PluginDescription>& types);
+
+    /** Forgets a file */
+    void remove (const String& formatName, const String& fileOrIdentifier);
+
+    /** Returns the number of files in the cache */
+    int size() const noexcept { return static_cast<int> (entries.size()); }
+
+    /** Forgets everything */
+    void clear() { entries.clear(); }
+
+private:
+    struct Stamp
+    {
+        int64 modified = 0;
+        int64 size = 0;
+        bool operator== (const Stamp& o) const noexcept { return modified == o.modified && size == o.size; }
+    };
+
+    struct Entry
+    {
+        Stamp stamp;
+        Array<PluginDescription> types;
+    };
+
+    std::map<String, Entry> entries;
+
+    static String makeKey (const String& formatName, const String& fileOrIdentifier);
+    static bool getStamp (const String& fileOrIdentifier, Stamp& stamp);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PluginScanCache)
+};
+
+}
@@ -0,0 +1,364 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "session/Presets.h"
+#include "DataPath.h"
+
+#define EL_PRESET_INDEX_FILENAME    "PresetIndex.xml"
+#define EL_PRESET_INDEX_VERSION     1
+
+namespace Element {
+
+class PresetCollection::Indexer : public Thread
+{
+public:
+    explicit Indexer (PresetCollection& c)
+        : Thread ("Preset Indexer"), collection (c) { }
+
+    ~Indexer()
+    {
+        signalThreadShouldExit();
+        notify();
+        stopThread (5000);
+    }
+
+    void refresh()
+    {
+        pending = true;
+        if (isThreadRunning())
+            notify();
+        else
+            startThread (3);
+    }
+
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            if (pending.exchange (false))
+                collection.update();
+            else
+                wait (-1);
+        }
+    }
+
+private:
+    PresetCollection& collection;
+    std::atomic<bool> pending { false };
+};
+
+//=============================================================================
+PresetCollection::PresetCollection()
+    : PresetCollection (DataPath().getRootDir().getChildFile ("Presets"), getDefaultIndexFile()) { }
+
+PresetCollection::PresetCollection (const File& dir, const File& index)
+    : presetsDir (dir), indexFile (index)
+{
+    indexer.reset (new Indexer (*this));
+}
+
+PresetCollection::~PresetCollection()
+{
+    indexer.reset();
+}
+
+File PresetCollection::getDefaultIndexFile()
+{
+    return DataPath::applicationDataDir().getChildFile (EL_PRESET_INDEX_FILENAME);
+}
+
+String PresetCollection::makeKey (const String& format, const String& identifier)
+{
+    return format + ":" + identifier;
+}
+
+void PresetCollection::clear()
+{
+    {
+        ScopedLock sl (updateLock);
+        entries.clear();
+        indexLoaded = false;
+    }
+
+    ScopedLock sl (lookupLock);
+    lookup.reset();
+    added.clear();
+}
+
+void PresetCollection::getPresetsFor (const Node& node, OwnedArray<PresetDescription>& results) const
+{
+    getPresetsFor (node.getFormat().toString(), node.getIdentifier().toString(), results);
+}
+
+void PresetCollection::getPresetsFor (const String& format, const String& identifier,
+                                      OwnedArray<PresetDescription>& results) const
+{
+    std::shared_ptr<const Lookup> current;
+
+    {
+        ScopedLock sl (lookupLock);
+        current = lookup;
+    }
+
+    if (current == nullptr)
+        return;
+
+    // already sorted when published
+    const auto iter = current->presets.find (makeKey (format, identifier));
+    if (iter != current->presets.end())
+        for (const auto& preset : iter->second)
+            results.add (new PresetDescription (preset));
+}
+
+void PresetCollection::findPresetsFor (const String& format, const String& identifier,
+                                       NodeArray& nodes) const
+{
+    OwnedArray<PresetDescription> found;
+    getPresetsFor (format, identifier, found);
+    for (const auto* preset : found)
+    {
+        Node node (Node::parse (preset->file));
+        if (node.isValid())
+            nodes.add (node);
+    }
+}
+
+int PresetCollection::size() const
+{
+    ScopedLock sl (lookupLock);
+    return lookup != nullptr ? lookup->numPresets : 0;
+}
+
+void PresetCollection::add (const File& file)
+{
+    const auto entry = createEntry (file, file.getLastModificationTime().toMilliseconds(), file.getSize());
+    const auto path = file.getFullPathName();
+
+    ScopedLock sl (lookupLock);
+    added[path] = entry;
+
+    // nothing published yet, the first update will include it
+    if (lookup == nullptr)
+        return;
+
+    // copy the published lookup with this file swapped in, keeping each
+    // list sorted by name
+    std::shared_ptr<Lookup> newLookup (new Lookup (*lookup));
+    for (auto& item : newLookup->presets)
+    {
+        auto& list = item.second;
+        for (int i = list.size(); --i >= 0;)
+        {
+            if (list.getReference(i).file == file)
+            {
+                list.remove (i);
+                --newLookup->numPresets;
+            }
+        }
+    }
+
+    const auto& preset = entry.preset;
+    if (preset.format.isNotEmpty() && preset.identifier.isNotEmpty())
+    {
+        auto& list = newLookup->presets[makeKey (preset.format, preset.identifier)];
+        int index = 0;
+        while (index < list.size() && ! (preset.name < list.getReference(index).name))
+            ++index;
+        list.insert (index, preset);
+        ++newLookup->numPresets;
+    }
+
+    lookup = newLookup;
+}
+
+void PresetCollection::refresh()
+{
+    indexer->refresh();
+}
+
+void PresetCollection::refreshNow()
+{
+    update();
+}
+
+void PresetCollection::update()
+{
+    ScopedLock sl (updateLock);
+
+    if (! indexLoaded)
+    {
+        loadIndex();
+        indexLoaded = true;
+    }
+
+    std::map<String, Entry> found;
+    bool changed = false;
+
+    if (presetsDir.isDirectory())
+    {
+        DirectoryIterator iter (presetsDir, true, EL_PRESET_FILE_EXTENSIONS);
+        bool isDirectory = false;
+        int64 fileSize = 0;
+        Time modified;
+
+        while (iter.next (&isDirectory, nullptr, &fileSize, &modified, nullptr, nullptr))
+        {
+            if (isDirectory)
+                continue;
+
+            const auto file = iter.getFile();
+            const auto path = file.getFullPathName();
+            const auto existing = entries.find (path);
+            if (existing != entries.end() && existing->second.modified == modified.toMilliseconds()
+                && existing->second.size == fileSize)
+            {
+                found[path] = existing->second;
+                continue;
+            }
+
+            // new or changed
+            found[path] = createEntry (file, modified.toMilliseconds(), fileSize);
+            changed = true;
+        }
+    }
+
+    // anything left over was removed
+    changed |= found.size() != entries.size();
+
+    {
+        // presets added while scanning are merged and published under the
+        // same lock add() uses, so none are dropped
+        ScopedLock lsl (lookupLock);
+        for (const auto& item : added)
+        {
+            const auto existing = found.find (item.first);
+            if (item.second.preset.file.existsAsFile() && (existing == found.end()
+                || existing->second.modified != item.second.modified
+                || existing->second.size != item.second.size))
+            {
+                found[item.first] = item.second;
+                changed = true;
+            }
+        }
+
+        added.clear();
+        entries.swap (found);
+
+        if (changed || lookup == nullptr)
+            publish();
+    }
+
+    if (changed)
+        saveIndex();
+}
+
+PresetCollection::Entry PresetCollection::createEntry (const File& file, int64 modified, int64 size)
+{
+    // files which aren't presets are kept with no format so they aren't
+    // parsed again
+    Entry entry;
+    entry.modified = modified;
+    entry.size = size;
+    entry.preset.file = file;
+
+    const Node node (Node::parse (file), false);
+    if (node.isValid())
+    {
+        entry.preset.name = node.getName();
+        if (entry.preset.name.isEmpty())
+            entry.preset.name = file.getFileNameWithoutExtension();
+        entry.preset.format = node.getFormat().toString();
+        entry.preset.identifier = node.getIdentifier().toString();
+    }
+
+    return entry;
+}
+
+void PresetCollection::publish()
+{
+    Array<const PresetDescription*> sorted;
+    for (const auto& item : entries)
+        if (item.second.preset.format.isNotEmpty() && item.second.preset.identifier.isNotEmpty())
+            sorted.add (&item.second.preset);
+
+    std::stable_sort (sorted.begin(), sorted.end(),
+        [] (const PresetDescription* a, const PresetDescription* b) { return a->name < b->name; });
+
+    // added in name order, so each list is sorted
+    std::shared_ptr<Lookup> newLookup (new Lookup());
+    for (const auto* preset : sorted)
+        newLookup->presets[makeKey (preset->format, preset->identifier)].add (*preset);
+
+    newLookup->numPresets = sorted.size();
+
+    ScopedLock sl (lookupLock);
+    lookup = newLookup;
+}
+
+void PresetCollection::loadIndex()
+{
+    entries.clear();
+
+    auto xml = std::unique_ptr<XmlElement> (XmlDocument::parse (indexFile));
+    if (xml == nullptr || ! xml->hasTagName ("PRESETINDEX")
+        || xml->getIntAttribute ("version") != EL_PRESET_INDEX_VERSION
+        || File (xml->getStringAttribute ("dir")) != presetsDir)
+        return;
+
+    forEachXmlChildElementWithTagName (*xml, e, "PRESET")
+    {
+        Entry entry;
+        entry.modified          = e->getStringAttribute ("modified").getLargeIntValue();
+        entry.size              = e->getStringAttribute ("size").getLargeIntValue();
+        entry.preset.file       = File (e->getStringAttribute ("path"));
+        entry.preset.name       = e->getStringAttribute ("name");
+        entry.preset.format     = e->getStringAttribute ("format");
+        entry.preset.identifier = e->getStringAttribute ("identifier");
+        entries[entry.preset.file.getFullPathName()] = entry;
+    }
+}
+
+bool PresetCollection::saveIndex() const
+{
+    if (indexFile == File())
+        return false;
+
+    XmlElement xml ("PRESETINDEX");
+    xml.setAttribute ("version", EL_PRESET_INDEX_VERSION);
+    xml.setAttribute ("dir", presetsDir.getFullPathName());
+
+    for (const auto& item : entries)
+    {
+        auto* e = xml.createNewChildElement ("PRESET");
+        e->setAttribute ("path",        item.first);
+        e->setAttribute ("modified",    String (item.second.modified));
+        e->setAttribute ("size",        String (item.second.size));
+        e->setAttribute ("name",        item.second.preset.name);
+        e->setAttribute ("format",      item.second.preset.format);
+        e->setAttribute ("identifier",  item.second.preset.identifier);
+    }
+
+    // another instance may be reading it
+    indexFile.getParentDirectory().createDirectory();
+    TemporaryFile tempFile (indexFile);
+    return xml.writeToFile (tempFile.getFile(), String())
+        && tempFile.overwriteTargetFileWithTemporary();
+}
+
+}
@@ -32,6 +32,13 @@ struct PresetDescription
     File file;
 };
 
+/** An index of the user's presets, looked up by node format and identifier.
+
+    The index is kept on disk with each file's modification time and size.
+    Refreshing walks the presets folder and only parses files which are new
+    or changed since they were last indexed, on a background thread. Lookups
+    never touch the disk.
+ */
 class PresetCollection
 {
 public:
@@ -49,59 +56,87 @@ public:
         }
     };
 
-    PresetCollection() { }
-    ~PresetCollection() { }
+    /** Indexes the user's Presets folder */
+    PresetCollection();
 
-    inline void clear()
-    {
-        presets.clear();
-    }
+    /** Indexes a folder of presets, keeping the index in indexFile */
+    PresetCollection (const File& presetsDir, const File& indexFile);
 
-    inline void getPresetsFor (const Node& node, OwnedArray<PresetDescription>& results) const
-    {
-        SortByName sorter;
-        for (const auto* const preset : presets)
-            if (preset->identifier == node.getIdentifier().toString() && preset->format == node.getFormat().toString())
-                results.addSorted (sorter, new PresetDescription (*preset));
-    }
+    ~PresetCollection();
+
+    /** Forgets everything indexed. The next refresh reloads the index file */
+    void clear();
+
+    /** Returns presets for a node, sorted by name */
+    void getPresetsFor (const Node& node, OwnedArray<PresetDescription>& results) const;
+
+    /** Returns presets by format and identifier, sorted by name */
+    void getPresetsFor (const String& format, const String& identifier,
+                        OwnedArray<PresetDescription>& results) const;
+
+    /** Loads the presets for a plugin, sorted by name */
+    void findPresetsFor (const String& format, const String& identifier, NodeArray& nodes) const;
+
+    /** Returns the number of presets indexed */
+    int size() const;
 
     inline void addPresetFor (const Node& node, const String& name)
     {
         jassertfalse;
     }
 
-    inline void refresh()
-    {
-        clear();
-        
-        StringArray files; path.findPresetFiles (files);
-        for (const auto& filename : files)
-        {
-            const File file (filename);
-            const Node node (Node::parse (file), false);
-            if (node.isValid())
-            {
-                std::unique_ptr<PresetDescription> item;
-                item.reset (new PresetDescription());
-                item->file          = file;
-                item->name          = node.getName();
-                if (item->name.isEmpty())
-                    item->name = file.getFileNameWithoutExtension();
-                item->format        = node.getFormat();
-                item->identifier    = node.getIdentifier();
-                if (item->format.isEmpty() || item->identifier.isEmpty())
-                    continue;
-
-                presets.add (item.release());
-            }
-        }
+    /** Indexes a preset file which was just saved. Only that file is read,
+        and it can be looked up right away, even while a refresh is running */
+    void add (const File& file);
 
-        presets.minimiseStorageOverheads();
-    }
+    /** Looks for new, changed and removed presets on a background thread */
+    void refresh();
+
+    /** Looks for new, changed and removed presets, and waits until done */
+    void refreshNow();
+
+    /** Returns the default index file */
+    static File getDefaultIndexFile();
 
 private:
-    DataPath path;
-    OwnedArray<PresetDescription> presets;
+    class Indexer;
+    struct Entry
+    {
+        int64 modified = 0;
+        int64 size = 0;
+        PresetDescription preset;
+    };
+
+    struct Lookup
+    {
+        std::map<String, Array<PresetDescription>> presets;
+        int numPresets = 0;
+    };
+
+    const File presetsDir;
+    const File indexFile;
+
+    // worker state, guarded by updateLock
+    CriticalSection updateLock;
+    std::map<String, Entry> entries;
+    bool indexLoaded = false;
+
+    // published for lookups, presets added since the last update are kept
+    // here until the indexer merges them
+    CriticalSection lookupLock;
+    std::shared_ptr<const Lookup> lookup;
+    std::map<String, Entry> added;
+
+    std::unique_ptr<Indexer> indexer;
+
+    static String makeKey (const String& format, const String& identifier);
+    static Entry createEntry (const File& file, int64 modified, int64 size);
+    void update();
+    void loadIndex();
+    bool saveIndex() const;
+    void publish();
+
+    JUCE_DECLARE_NON_COPYABLE (PresetCollection)
 };
 
 }
@@ -146,6 +146,23 @@ namespace Element {
         objectData.getOrCreateChildWithName (Tags::maps, nullptr);
     }
 
+    static const char* graphPreloadSlugs[] = { "all", "next", "programs", "none" };
+
+    Session::GraphPreload Session::getGraphPreload() const
+    {
+        const auto slug = getProperty (Tags::graphPreload, graphPreloadSlugs[PreloadAll]).toString();
+        for (int i = 0; i <= (int) PreloadNone; ++i)
+            if (slug == graphPreloadSlugs[i])
+                return static_cast<GraphPreload> (i);
+        return PreloadAll;
+    }
+
+    void Session::setGraphPreload (GraphPreload policy, int count)
+    {
+        setProperty (Tags::graphPreload, graphPreloadSlugs[jlimit (0, (int) PreloadNone, (int) policy)]);
+        setProperty (Tags::graphPreloadCount, jmax (0, count));
+    }
+
     Node Session::findNodeById (const Uuid& uuid)
     {
         Node node;
@@ -74,6 +74,24 @@ namespace Element {
         inline Value getNameValue()              { return getPropertyAsValue (Slugs::name); }
         
         inline bool useExternalClock()      const { return (bool) getProperty ("externalSync", false); }
+
+        /** Which root graphs are loaded in the background, besides the active one */
+        enum GraphPreload
+        {
+            PreloadAll = 0,     ///< every graph in the session
+            PreloadNext,        ///< the next few graphs after the active one
+            PreloadPrograms,    ///< graphs which are selected by a MIDI program
+            PreloadNone         ///< graphs load when they're activated
+        };
+
+        /** Returns the session's graph preload policy */
+        GraphPreload getGraphPreload() const;
+
+        /** Returns how many graphs after the active one PreloadNext loads */
+        inline int getGraphPreloadCount() const { return jmax (0, (int) getProperty (Tags::graphPreloadCount, 2)); }
+
+        /** Changes the graph preload policy */
+        void setGraphPreload (GraphPreload policy, int count = 2);
         
         inline bool notificationsFrozen()   const { return freezeChangeNotification; }
 
@@ -0,0 +1,411 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "ElementApp.h"
+#include "session/Node.h"
+#include "session/SessionArchive.h"
+
+namespace Element {
+
+// File layout, all integers are little endian:
+//   header     magic, version, number of chunks, reserved,
+//              index offset, index size and chunk table offset
+//   chunks     node state, back to back
+//   index      the tree written by ValueTree::writeToStream with every
+//              chunked state property replaced by a chunk reference
+//   table      offset, stored size, size, kind and compression per chunk
+static const char archiveMagic[] = { 'E', 'L', 'S', 'A' };
+static constexpr int archiveVersion = 2;
+static constexpr int64 headerSize = 40;
+static constexpr int64 tableEntrySize = 32;
+
+// compressing small chunks, or ones that barely shrink, only costs time
+static constexpr int64 minSizeToCompress = 256;
+static constexpr double maxCompressedRatio = 0.9;
+
+enum ChunkKind { binaryChunk = 0, textChunk };
+enum ChunkCompression { uncompressed = 0, zlibCompressed };
+
+struct ArchiveChunk
+{
+    var value;
+    MemoryBlock data;
+    int64 offset = 0, storedSize = 0, size = 0;
+    int kind = binaryChunk;
+    int compression = uncompressed;
+};
+
+static void encodeChunk (ArchiveChunk& chunk, const bool compress, const int level)
+{
+    MemoryBlock decoded;
+    const void* raw = nullptr;
+    size_t rawSize = 0;
+
+    if (const auto* const block = chunk.value.getBinaryData())
+    {
+        raw = block->getData();
+        rawSize = block->getSize();
+    }
+    else
+    {
+        // states are normally base64 from MemoryBlock, anything else is kept as
+        // text so the property reads back exactly as it was
+        const auto text = chunk.value.toString();
+        if (! decoded.fromBase64Encoding (text) || decoded.toBase64Encoding() != text)
+        {
+            decoded.reset();
+            decoded.append (text.toRawUTF8(), text.getNumBytesAsUTF8());
+            chunk.kind = textChunk;
+        }
+
+        raw = decoded.getData();
+        rawSize = decoded.getSize();
+    }
+
+    chunk.size = (int64) rawSize;
+
+    if (compress && chunk.size >= minSizeToCompress)
+    {
+        MemoryOutputStream out;
+        {
+            GZIPCompressorOutputStream gzip (out, level);
+            gzip.write (raw, rawSize);
+        }
+
+        if ((double) out.getDataSize() < (double) chunk.size * maxCompressedRatio)
+        {
+            chunk.data = out.getMemoryBlock();
+            chunk.compression = zlibCompressed;
+        }
+    }
+
+    if (chunk.compression == uncompressed)
+        chunk.data = MemoryBlock (raw, rawSize);
+
+    chunk.storedSize = (int64) chunk.data.getSize();
+    chunk.value = var();
+}
+
+static bool readChunkData (const ArchiveChunk& chunk, const char* const base, MemoryBlock& block)
+{
+    const auto* const stored = base + chunk.offset;
+
+    if (chunk.compression == zlibCompressed)
+    {
+        MemoryInputStream in (stored, (size_t) chunk.storedSize, false);
+        GZIPDecompressorInputStream gzip (in);
+        block.setSize ((size_t) chunk.size);
+        return gzip.read (block.getData(), (int) chunk.size) == (int) chunk.size;
+    }
+
+    if (chunk.compression == uncompressed && chunk.size == chunk.storedSize)
+    {
+        block.setSize ((size_t) chunk.size);
+        block.copyFrom (stored, 0, (size_t) chunk.size);
+        return true;
+    }
+
+    return false;
+}
+
+static bool decodeChunk (ArchiveChunk& chunk, const char* const base)
+{
+    if (chunk.kind == textChunk)
+    {
+        MemoryBlock text;
+        if (! readChunkData (chunk, base, text))
+            return false;
+        chunk.value = String::fromUTF8 (static_cast<const char*> (text.getData()), (int) text.getSize());
+        return true;
+    }
+
+    // decoded in place so the state isn't copied again
+    chunk.value = var (MemoryBlock());
+    return readChunkData (chunk, base, *chunk.value.getBinaryData());
+}
+
+// every non-empty string state is chunked, so a string left in the index with
+// this prefix can only be a reference. Version 1 used plain chunk numbers,
+// which couldn't be told apart from integer state.
+static const String chunkReferencePrefix ("@chunk:");
+
+static var createChunkReference (const int chunk)
+{
+    return chunkReferencePrefix + String (chunk);
+}
+
+/** Returns the chunk a property refers to, -1 if it isn't a reference or
+    -2 if it looks like one but is malformed */
+static int getChunkReference (const var& value, const int version)
+{
+    if (version == 1)
+        return value.isInt() || value.isInt64() ? (int) value : -1;
+
+    if (! value.isString())
+        return -1;
+    const auto text = value.toString();
+    if (! text.startsWith (chunkReferencePrefix))
+        return -1;
+    const auto number = text.substring (chunkReferencePrefix.length());
+    return number.isNotEmpty() && number.containsOnly ("0123456789") ? number.getIntValue() : -2;
+}
+
+//=============================================================================
+SessionArchive::SessionArchive() { }
+SessionArchive::~SessionArchive() { }
+
+bool SessionArchive::isArchive (const File& file)
+{
+    FileInputStream in (file);
+    char magic [sizeof (archiveMagic)];
+    return in.openedOk() && in.read (magic, sizeof (magic)) == (int) sizeof (magic)
+        && memcmp (magic, archiveMagic, sizeof (magic)) == 0;
+}
+
+Result SessionArchive::load (const File& file, ValueTree& data)
+{
+    if (isArchive (file))
+        return SessionArchive().read (file, data);
+
+    if (auto xml = XmlDocument::parse (file))
+    {
+        data = ValueTree::fromXml (*xml);
+        if (data.isValid())
+            return Result::ok();
+    }
+
+    return Result::fail ("Not a valid session file");
+}
+
+void SessionArchive::setCompression (const bool shouldCompress, const int level)
+{
+    compress = shouldCompress;
+    compressionLevel = jlimit (1, 9, level);
+}
+
+void SessionArchive::setNumThreads (const int newNumThreads)
+{
+    numThreads = newNumThreads;
+}
+
+void SessionArchive::performJobs (const int numJobs, std::function<void(int)> job) const
+{
+    const int maxThreads = numThreads > 0 ? numThreads : SystemStats::getNumCpus();
+    const int numWorkers = jmin (numJobs, maxThreads) - 1;
+
+    std::atomic<int> next { 0 };
+    auto work = [&next, &job, numJobs]()
+    {
+        for (int i = next++; i < numJobs; i = next++)
+            job (i);
+    };
+
+    if (numWorkers <= 0)
+    {
+        work();
+        return;
+    }
+
+    std::atomic<int> numPending { numWorkers };
+    WaitableEvent finished;
+    std::unique_ptr<ThreadPool> pool (new ThreadPool (numWorkers)); // destroyed first
+
+    for (int i = 0; i < numWorkers; ++i)
+    {
+        pool->addJob ([&work, &numPending, &finished]()
+        {
+            work();
+            if (--numPending == 0)
+                finished.signal();
+        });
+    }
+
+    work();
+    finished.wait();
+}
+
+Result SessionArchive::write (const ValueTree& data, const File& file) const
+{
+    if (! data.isValid())
+        return Result::fail ("Nothing to write");
+
+    ValueTree index = data.createCopy();
+    Node::sanitizeProperties (index, true);
+
+    OwnedArray<ArchiveChunk> chunks;
+    Array<ValueTree> pending;
+    pending.add (index);
+
+    while (! pending.isEmpty())
+    {
+        auto tree = pending.removeAndReturn (pending.size() - 1);
+        if (tree.hasType (Tags::node))
+        {
+            for (const auto& property : { Tags::state, Tags::programState })
+            {
+                const var value = tree.getProperty (property);
+                if (! value.isBinaryData() && (! value.isString() || value.toString().isEmpty()))
+                    continue;
+
+                auto* const chunk = chunks.add (new ArchiveChunk());
+                chunk->value = value;
+                tree.setProperty (property, createChunkReference (chunks.size() - 1), nullptr);
+            }
+        }
+
+        for (int i = 0; i < tree.getNumChildren(); ++i)
+            pending.add (tree.getChild (i));
+    }
+
+    performJobs (chunks.size(), [this, &chunks] (int i) {
+        encodeChunk (*chunks.getUnchecked (i), compress, compressionLevel);
+    });
+
+    TemporaryFile tempFile (file);
+    std::unique_ptr<FileOutputStream> out (tempFile.getFile().createOutputStream());
+    if (out == nullptr || out->failedToOpen())
+        return Result::fail ("Could not write " + file.getFileName());
+
+    out->writeRepeatedByte (0, (size_t) headerSize);
+
+    for (auto* const chunk : chunks)
+    {
+        chunk->offset = out->getPosition();
+        out->write (chunk->data.getData(), chunk->data.getSize());
+        chunk->data.reset();
+    }
+
+    const auto indexOffset = out->getPosition();
+    index.writeToStream (*out);
+    const auto indexSize = out->getPosition() - indexOffset;
+
+    const auto tableOffset = out->getPosition();
+    for (const auto* const chunk : chunks)
+    {
+        out->writeInt64 (chunk->offset);
+        out->writeInt64 (chunk->storedSize);
+        out->writeInt64 (chunk->size);
+        out->writeInt (chunk->kind);
+        out->writeInt (chunk->compression);
+    }
+
+    out->setPosition (0);
+    out->write (archiveMagic, sizeof (archiveMagic));
+    out->writeInt (archiveVersion);
+    out->writeInt (chunks.size());
+    out->writeInt (0);
+    out->writeInt64 (indexOffset);
+    out->writeInt64 (indexSize);
+    out->writeInt64 (tableOffset);
+    out->flush();
+
+    const bool ok = out->getStatus().wasOk();
+    out.reset();
+
+    if (! ok || ! tempFile.overwriteTargetFileWithTemporary())
+        return Result::fail ("Could not write " + file.getFileName());
+
+    return Result::ok();
+}
+
+Result SessionArchive::read (const File& file, ValueTree& data) const
+{
+    MemoryMappedFile mapped (file, MemoryMappedFile::readOnly);
+    const auto* const base = static_cast<const char*> (mapped.getData());
+    const auto fileSize = (int64) mapped.getSize();
+
+    if (base == nullptr || fileSize < headerSize
+        || memcmp (base, archiveMagic, sizeof (archiveMagic)) != 0)
+        return Result::fail ("Not a session archive");
+
+    const auto version = (int) ByteOrder::littleEndianInt (base + 4);
+    if (version < 1 || version > archiveVersion)
+        return Result::fail ("Unsupported session archive version");
+
+    auto isInFile = [fileSize] (int64 offset, int64 size) {
+        return offset >= 0 && size >= 0 && offset <= fileSize && size <= fileSize - offset;
+    };
+
+    const auto numChunks   = (int) ByteOrder::littleEndianInt (base + 8);
+    const auto indexOffset = (int64) ByteOrder::littleEndianInt64 (base + 16);
+    const auto indexSize   = (int64) ByteOrder::littleEndianInt64 (base + 24);
+    const auto tableOffset = (int64) ByteOrder::littleEndianInt64 (base + 32);
+
+    if (numChunks < 0 || ! isInFile (indexOffset, indexSize)
+        || ! isInFile (tableOffset, (int64) numChunks * tableEntrySize))
+        return Result::fail ("Corrupt session archive");
+
+    OwnedArray<ArchiveChunk> chunks;
+    for (int i = 0; i < numChunks; ++i)
+    {
+        const auto* const entry = base + tableOffset + i * tableEntrySize;
+        auto* const chunk = chunks.add (new ArchiveChunk());
+        chunk->offset       = (int64) ByteOrder::littleEndianInt64 (entry);
+        chunk->storedSize   = (int64) ByteOrder::littleEndianInt64 (entry + 8);
+        chunk->size         = (int64) ByteOrder::littleEndianInt64 (entry + 16);
+        chunk->kind         = (int) ByteOrder::littleEndianInt (entry + 24);
+        chunk->compression  = (int) ByteOrder::littleEndianInt (entry + 28);
+
+        if (! isInFile (chunk->offset, chunk->storedSize)
+            || (chunk->kind != binaryChunk && chunk->kind != textChunk)
+            || ! isPositiveAndBelow (chunk->size, (int64) std::numeric_limits<int>::max()))
+            return Result::fail ("Corrupt session archive");
+    }
+
+    ValueTree index = ValueTree::readFromData (base + indexOffset, (size_t) indexSize);
+    if (! index.isValid())
+        return Result::fail ("Corrupt session archive");
+
+    std::atomic<bool> failed { false };
+    performJobs (chunks.size(), [&chunks, &failed, base] (int i) {
+        if (! decodeChunk (*chunks.getUnchecked (i), base))
+            failed = true;
+    });
+
+    if (failed.load())
+        return Result::fail ("Corrupt node state in session archive");
+
+    Array<ValueTree> pending;
+    pending.add (index);
+
+    while (! pending.isEmpty())
+    {
+        auto tree = pending.removeAndReturn (pending.size() - 1);
+        if (tree.hasType (Tags::node))
+        {
+            for (const auto& property : { Tags::state, Tags::programState })
+            {
+                const int chunk = getChunkReference (tree.getProperty (property), version);
+                if (chunk == -1)
+                    continue;
+                if (! isPositiveAndBelow (chunk, chunks.size()))
+                    return Result::fail ("Corrupt session archive");
+                tree.setProperty (property, chunks.getUnchecked (chunk)->value, nullptr);
+            }
+        }
+
+        for (int i = 0; i < tree.getNumChildren(); ++i)
+            pending.add (tree.getChild (i));
+    }
+
+    data = index;
+    return Result::ok();
+}
+
+}
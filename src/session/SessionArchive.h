@@ -0,0 +1,80 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+namespace Element {
+
+/** A compact binary container for sessions.
+
+    The file holds a binary ValueTree index of the session followed by the
+    plugin state of every node stored as raw, optionally zlib compressed,
+    chunks. Node state is referenced from the index by chunk number, so
+    nothing is ever base64 encoded on disk. When read back, the file is
+    memory mapped and the chunks are decoded in parallel into binary state
+    properties which Node and GraphManager restore without decoding.
+
+    Archives round trip with the XML session format: a binary state property
+    converts to the same base64 text when the session is saved as XML.
+ */
+class SessionArchive final
+{
+public:
+    SessionArchive();
+    ~SessionArchive();
+
+    /** Returns true if the file starts with the archive magic */
+    static bool isArchive (const File& file);
+
+    /** Reads a session or graph file saved either as an archive or as XML.
+        Anything which opens session files should use this so both formats
+        load everywhere.
+     */
+    static Result load (const File& file, ValueTree& data);
+
+    /** Enable or disable chunk compression. Chunks that don't shrink
+        enough are stored raw regardless.
+        @param level    zlib level 1 (fastest) to 9 (smallest)
+     */
+    void setCompression (bool shouldCompress, int level = 1);
+
+    /** Set the number of threads used to encode and decode state chunks.
+        If less than 1 the number of CPUs is used
+     */
+    void setNumThreads (int numThreads);
+
+    /** Writes a session (or graph) tree to the file */
+    Result write (const ValueTree& data, const File& file) const;
+
+    /** Reads an archive written with write() */
+    Result read (const File& file, ValueTree& data) const;
+
+private:
+    bool compress = true;
+    int compressionLevel = 1;
+    int numThreads = 0;
+
+    void performJobs (int numJobs, std::function<void(int)> job) const;
+
+    JUCE_DECLARE_NON_COPYABLE (SessionArchive)
+};
+
+}
@@ -0,0 +1,251 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "ElementApp.h"
+#include "session/Node.h"
+#include "session/SessionJournal.h"
+
+namespace Element {
+
+// File layout, all integers are little endian:
+//   header     magic and version
+//   records    size, checksum and a tree written by ValueTree::writeToStream
+static const char journalMagic[] = { 'E', 'L', 'S', 'J' };
+static constexpr int journalVersion = 1;
+static constexpr int64 headerSize = 8;
+static constexpr int64 recordHeaderSize = 8;
+
+// small journals aren't worth rewriting
+static constexpr int64 minBytesToCompact = 4 * 1024 * 1024;
+
+static uint32 checksum (const void* data, size_t size)
+{
+    // FNV-1a
+    uint32 hash = 2166136261u;
+    const auto* bytes = static_cast<const uint8*> (data);
+    for (size_t i = 0; i < size; ++i)
+        hash = (hash ^ bytes[i]) * 16777619u;
+    return hash;
+}
+
+static MemoryBlock createRecord (const ValueTree& tree)
+{
+    MemoryOutputStream data;
+    tree.writeToStream (data);
+
+    MemoryOutputStream record;
+    record.writeInt ((int) data.getDataSize());
+    record.writeInt ((int) checksum (data.getData(), data.getDataSize()));
+    record.write (data.getData(), data.getDataSize());
+    return record.getMemoryBlock();
+}
+
+static void writeHeader (OutputStream& out)
+{
+    out.write (journalMagic, sizeof (journalMagic));
+    out.writeInt (journalVersion);
+}
+
+static ValueTree findNode (const ValueTree& tree, const var& uuid)
+{
+    if (tree.hasType (Tags::node) && tree.getProperty (Tags::uuid) == uuid)
+        return tree;
+
+    for (int i = 0; i < tree.getNumChildren(); ++i)
+    {
+        const auto node = findNode (tree.getChild (i), uuid);
+        if (node.isValid())
+            return node;
+    }
+
+    return {};
+}
+
+//=============================================================================
+SessionJournal::SessionJournal() { }
+
+SessionJournal::~SessionJournal()
+{
+    waitForPendingWrites();
+}
+
+File SessionJournal::getJournalFile (const File& sessionFile)
+{
+    return sessionFile.getSiblingFile (sessionFile.getFileName() + ".autosave");
+}
+
+void SessionJournal::addJob (std::function<void()> job)
+{
+    writer.addJob (job);
+}
+
+void SessionJournal::setFile (const File& journalFile)
+{
+    if (journalFile == file)
+        return;
+
+    waitForPendingWrites();
+    file = journalFile;
+    snapshotBytes = 0;
+    appendedBytes = file.existsAsFile() ? file.getSize() : 0;
+}
+
+void SessionJournal::writeSnapshot (const ValueTree& session)
+{
+    if (file == File() || ! session.isValid())
+        return;
+
+    // node objects must be released here rather than on the writer
+    auto data = session.createCopy();
+    Node::sanitizeProperties (data, true);
+
+    const auto target = file;
+    addJob ([this, target, data]()
+    {
+        const auto record = createRecord (data);
+        TemporaryFile tempFile (target);
+
+        {
+            FileOutputStream out (tempFile.getFile());
+            if (out.failedToOpen())
+                return;
+            writeHeader (out);
+            out.write (record.getData(), record.getSize());
+            out.flush();
+            if (! out.getStatus().wasOk())
+                return;
+        }
+
+        if (tempFile.overwriteTargetFileWithTemporary())
+        {
+            snapshotBytes = (int64) record.getSize();
+            appendedBytes = 0;
+        }
+    });
+}
+
+void SessionJournal::appendNodes (const Array<ValueTree>& nodes)
+{
+    if (file == File() || nodes.isEmpty())
+        return;
+
+    Array<ValueTree> records;
+    for (const auto& node : nodes)
+    {
+        ValueTree record (Tags::node);
+        record.copyPropertiesFrom (node, nullptr);
+        Node::sanitizeProperties (record);
+        records.add (record);
+    }
+
+    const auto target = file;
+    addJob ([this, target, records]()
+    {
+        const bool isNew = ! target.existsAsFile() || target.getSize() < headerSize;
+        FileOutputStream out (target);
+        if (out.failedToOpen())
+            return;
+
+        if (isNew)
+        {
+            out.setPosition (0);
+            out.truncate();
+            writeHeader (out);
+        }
+
+        for (const auto& tree : records)
+        {
+            const auto record = createRecord (tree);
+            out.write (record.getData(), record.getSize());
+            appendedBytes += (int64) record.getSize();
+        }
+
+        out.flush();
+    });
+}
+
+bool SessionJournal::needsCompaction() const
+{
+    const auto appended = appendedBytes.load();
+    return appended >= minBytesToCompact && appended > snapshotBytes.load();
+}
+
+void SessionJournal::waitForPendingWrites()
+{
+    // there's one writer thread, so this runs after everything queued before it
+    WaitableEvent finished;
+    addJob ([&finished]() { finished.signal(); });
+    finished.wait();
+}
+
+void SessionJournal::discard()
+{
+    waitForPendingWrites();
+    if (file != File())
+        file.deleteFile();
+    snapshotBytes = 0;
+    appendedBytes = 0;
+}
+
+Result SessionJournal::replay (const File& journalFile, ValueTree& session)
+{
+    MemoryBlock data;
+    if (! journalFile.loadFileAsData (data))
+        return Result::fail ("Could not read " + journalFile.getFileName());
+
+    const auto* const base = static_cast<const char*> (data.getData());
+    const auto size = (int64) data.getSize();
+
+    if (size < headerSize || memcmp (base, journalMagic, sizeof (journalMagic)) != 0)
+        return Result::fail ("Not a session journal");
+    if ((int) ByteOrder::littleEndianInt (base + 4) != journalVersion)
+        return Result::fail ("Unsupported session journal version");
+
+    for (int64 offset = headerSize; offset + recordHeaderSize <= size;)
+    {
+        const auto recordSize = (int64) ByteOrder::littleEndianInt (base + offset);
+        const auto recordSum  = (uint32) ByteOrder::littleEndianInt (base + offset + 4);
+        const auto* const recordData = base + offset + recordHeaderSize;
+
+        // anything after a torn or damaged record can't be trusted
+        if (recordSize <= 0 || recordSize > size - offset - recordHeaderSize
+            || checksum (recordData, (size_t) recordSize) != recordSum)
+            break;
+
+        const auto record = ValueTree::readFromData (recordData, (size_t) recordSize);
+        if (record.hasType (Tags::session))
+        {
+            session = record;
+        }
+        else if (record.hasType (Tags::node) && record.hasProperty (Tags::uuid))
+        {
+            auto node = findNode (session, record.getProperty (Tags::uuid));
+            if (node.isValid())
+                for (int i = 0; i < record.getNumProperties(); ++i)
+                    node.setProperty (record.getPropertyName (i),
+                                      record.getProperty (record.getPropertyName (i)), nullptr);
+        }
+
+        offset += recordHeaderSize + recordSize;
+    }
+
+    return Result::ok();
+}
+
+}
@@ -0,0 +1,84 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+namespace Element {
+
+/** An append-only autosave journal kept next to a session file.
+
+    The journal is a sequence of checksummed binary ValueTree records. A
+    snapshot record holds the whole session and replaces everything before
+    it, so writing one compacts the journal. Node records hold the properties
+    of a single node, including its plugin state, and are applied on top of
+    the last snapshot, or of the session file if there isn't one.
+
+    Records are prepared on the calling thread and written in order on a
+    background thread. A record cut short by a crash is ignored on replay.
+ */
+class SessionJournal final
+{
+public:
+    SessionJournal();
+    ~SessionJournal();
+
+    /** Returns the journal used for a session file */
+    static File getJournalFile (const File& sessionFile);
+
+    /** Set the journal file. Writes queued for the previous file finish
+        first. Pass an empty File to stop journaling */
+    void setFile (const File& journalFile);
+
+    /** Returns the journal file */
+    File getFile() const { return file; }
+
+    /** Queues a snapshot of a session, which rewrites the journal with it */
+    void writeSnapshot (const ValueTree& session);
+
+    /** Queues a record for each node tree. Only the node's own properties are
+        written, and nodes are matched by uuid on replay */
+    void appendNodes (const Array<ValueTree>& nodes);
+
+    /** Returns true if enough node records were appended since the last
+        snapshot that writing a new one would shrink the journal */
+    bool needsCompaction() const;
+
+    /** Blocks until queued records are written */
+    void waitForPendingWrites();
+
+    /** Waits for pending writes then deletes the journal file */
+    void discard();
+
+    /** Applies a journal to session data loaded from the session file */
+    static Result replay (const File& journalFile, ValueTree& session);
+
+private:
+    File file;
+    ThreadPool writer { 1 };
+    std::atomic<int64> snapshotBytes { 0 };
+    std::atomic<int64> appendedBytes { 0 };
+
+    void addJob (std::function<void()> job);
+
+    JUCE_DECLARE_NON_COPYABLE (SessionJournal)
+};
+
+}
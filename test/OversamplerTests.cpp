@@ -8,28 +8,61 @@ BOOST_AUTO_TEST_SUITE (OversamplerTests)
 BOOST_AUTO_TEST_CASE (Basics)
 {
     Oversampler<float> os;
-    BOOST_REQUIRE (os.getNumProcessors() == 0);
-    BOOST_REQUIRE (os.getProcessor (0) == nullptr);
-    BOOST_REQUIRE (os.getLatencySamples(0) == 0);
-    BOOST_REQUIRE (os.getFactor (0) == 1);
+    BOOST_REQUIRE (os.getProcessor() == nullptr);
+    BOOST_REQUIRE (os.getLatencySamples() == 0);
+    BOOST_REQUIRE (os.getFactor() == 1);
+    BOOST_REQUIRE (os.getMemoryUsage() == 0);
+
+    // nothing is built at factor 1
     os.prepare (2, 1024);
-    BOOST_REQUIRE (os.getNumProcessors() == 3);
-    BOOST_REQUIRE_EQUAL (os.getFactor(0), 2);
-    for (int i = 0; i < os.getNumProcessors(); ++i)
+    BOOST_REQUIRE (os.getProcessor() == nullptr);
+    BOOST_REQUIRE (os.getMemoryUsage() == 0);
+
+    for (int factor = 2; factor <= 8; factor *= 2)
     {
-        BOOST_REQUIRE (nullptr != os.getProcessor (i));
-        if (auto* const proc = os.getProcessor (i))
+        os.setFactor (factor);
+        BOOST_REQUIRE_EQUAL (os.getFactor(), factor);
+        os.prepare (2, 1024);
+        BOOST_REQUIRE (nullptr != os.getProcessor());
+        if (auto* const proc = os.getProcessor())
         {
-            size_t factora = static_cast<size_t> (std::pow (2.0, (double)(i + 1)));
-            size_t factorb = proc->getOversamplingFactor();
-            BOOST_REQUIRE_EQUAL (os.getFactor(i), proc->getOversamplingFactor());
-            BOOST_REQUIRE_EQUAL (factora, factorb);
+            BOOST_REQUIRE_EQUAL ((size_t) factor, proc->getOversamplingFactor());
             BOOST_REQUIRE (proc->getLatencyInSamples() > 0.f);
-            BOOST_REQUIRE (os.getLatencySamples(i) > 0.f);
+            BOOST_REQUIRE (os.getLatencySamples() > 0.f);
         }
+        BOOST_REQUIRE (os.getMemoryUsage() >= (size_t) (2 * 1024 * factor) * sizeof (float));
     }
 
+    os.setFactor (1);
+    os.prepare (2, 1024);
+    BOOST_REQUIRE (os.getProcessor() == nullptr);
+    BOOST_REQUIRE (os.getLatencySamples() == 0);
     os.reset();
 }
 
+BOOST_AUTO_TEST_CASE (Factors)
+{
+    Oversampler<float> os;
+    os.setFactor (0);
+    BOOST_REQUIRE_EQUAL (os.getFactor(), 1);
+    os.setFactor (3);
+    BOOST_REQUIRE_EQUAL (os.getFactor(), 4);
+    os.setFactor (64);
+    BOOST_REQUIRE_EQUAL (os.getFactor(), 8);
+}
+
+BOOST_AUTO_TEST_CASE (Quality)
+{
+    Oversampler<float> os;
+    os.setFactor (2);
+    os.prepare (2, 512);
+    const float iirLatency = os.getLatencySamples();
+
+    // changes wait for prepare
+    os.setQuality (Oversampler<float>::linearPhaseFIR);
+    BOOST_REQUIRE_EQUAL (os.getLatencySamples(), iirLatency);
+    os.prepare (2, 512);
+    BOOST_REQUIRE (os.getLatencySamples() > iirLatency);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,106 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "Tests.h"
+#include "controllers/EngineController.h"
+
+namespace Element {
+
+class GraphPreloadTest : public UnitTestBase
+{
+public:
+    GraphPreloadTest() : UnitTestBase ("Graph Preload", "session", "graphPreload") { }
+    virtual ~GraphPreloadTest() { }
+
+    void initialise() override
+    {
+        initializeWorld();
+        session = getWorld().getSession();
+        engine = getAppController().findChild<EngineController>();
+    }
+
+    void shutdown() override
+    {
+        session = nullptr;
+        engine = nullptr;
+        shutdownWorld();
+    }
+
+    void runTest() override
+    {
+        testPolicy();
+        testPreload (Session::PreloadNone, 0, 1);
+        testPreload (Session::PreloadPrograms, 0, 2);
+        testPreload (Session::PreloadNext, 2, 3);
+        testPreload (Session::PreloadAll, 0, numGraphs);
+    }
+
+private:
+    static constexpr int numGraphs = 5;
+    SessionPtr session;
+    EngineController* engine = nullptr;
+
+    void testPolicy()
+    {
+        beginTest ("policy");
+        session->clear();
+        expect (session->getGraphPreload() == Session::PreloadAll);
+        session->setGraphPreload (Session::PreloadNext, 3);
+        expect (session->getGraphPreload() == Session::PreloadNext);
+        expectEquals (session->getGraphPreloadCount(), 3);
+        session->setGraphPreload (Session::PreloadPrograms);
+        expect (session->getGraphPreload() == Session::PreloadPrograms);
+    }
+
+    void testPreload (Session::GraphPreload policy, int count, int expectedResident)
+    {
+        beginTest ("preload " + String ((int) policy));
+        engine->clear();
+        session->clear();
+        for (int i = 0; i < numGraphs; ++i)
+        {
+            Node graph (Node::createDefaultGraph ("Graph " + String (i + 1)));
+            if (i == numGraphs - 1)
+                graph.setProperty (Tags::midiProgram, 4);
+            session->addGraph (graph, i == 0);
+        }
+
+        session->setGraphPreload (policy, count);
+        engine->sessionReloaded();
+
+        // only the active graph loads right away
+        expectEquals (engine->getGraphMemoryUsage().size(), 1);
+        runDispatchLoop (100 * numGraphs);
+
+        const auto resident = engine->getGraphMemoryUsage();
+        expectEquals (resident.size(), expectedResident);
+        for (const auto& usage : resident)
+        {
+            expect (usage.numNodes > 0);
+            expect (usage.renderBytes > 0);
+        }
+
+        if (policy == Session::PreloadPrograms)
+            expect (resident.getLast().graph == session->getGraph (numGraphs - 1));
+    }
+};
+
+static GraphPreloadTest sGraphPreloadTest;
+
+}
@@ -0,0 +1,145 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "session/PluginScanCache.h"
+
+namespace Element {
+
+class PluginScanCacheTest : public UnitTestBase
+{
+public:
+    PluginScanCacheTest() : UnitTestBase ("Plugin Scan Cache", "plugins", "pluginScanCache") { }
+    virtual ~PluginScanCacheTest() { }
+
+    void runTest() override
+    {
+        dir = File::createTempFile ("plugin-scan-cache");
+        dir.createDirectory();
+        testFiles();
+        testBundles();
+        testSaveAndLoad();
+        dir.deleteRecursively();
+    }
+
+private:
+    File dir;
+
+    static void addType (OwnedArray<PluginDescription>& types, const File& file, const String& name)
+    {
+        auto* type = types.add (new PluginDescription());
+        type->name = name;
+        type->pluginFormatName = "VST3";
+        type->fileOrIdentifier = file.getFullPathName();
+        type->uid = name.hashCode();
+    }
+
+    void testFiles()
+    {
+        beginTest ("files");
+        const auto file = dir.getChildFile ("Synth.vst3");
+        expect (file.replaceWithText ("binary"));
+
+        PluginScanCache cache;
+        OwnedArray<PluginDescription> types, restored;
+        addType (types, file, "Synth");
+        addType (types, file, "Synth Multi");
+        expect (! cache.restore ("VST3", file.getFullPathName(), restored));
+
+        cache.store ("VST3", file.getFullPathName(), types);
+        expect (cache.restore ("VST3", file.getFullPathName(), restored));
+        expectEquals (restored.size(), 2);
+        expectEquals (restored[1]->name, String ("Synth Multi"));
+
+        // formats are cached separately
+        restored.clear();
+        expect (! cache.restore ("VST", file.getFullPathName(), restored));
+
+        // an updated binary is scanned again
+        expect (file.replaceWithText ("a newer binary"));
+        expect (! cache.restore ("VST3", file.getFullPathName(), restored));
+
+        // files without plugins are remembered too
+        const auto notAPlugin = dir.getChildFile ("readme.vst3");
+        expect (notAPlugin.replaceWithText ("text"));
+        cache.store ("VST3", notAPlugin.getFullPathName(), OwnedArray<PluginDescription>());
+        expect (cache.restore ("VST3", notAPlugin.getFullPathName(), restored));
+        expectEquals (restored.size(), 0);
+
+        cache.remove ("VST3", notAPlugin.getFullPathName());
+        expect (! cache.restore ("VST3", notAPlugin.getFullPathName(), restored));
+
+        // identifiers that aren't files can't be checked, so aren't kept
+        cache.store ("LV2", "http://example.org/plugin", types);
+        expect (! cache.restore ("LV2", "http://example.org/plugin", restored));
+        expectEquals (cache.size(), 1);
+    }
+
+    void testBundles()
+    {
+        beginTest ("bundles");
+        const auto bundle = dir.getChildFile ("Delay.vst3");
+        const auto binary = bundle.getChildFile ("Contents/x86_64-linux/Delay.so");
+        expect (binary.getParentDirectory().createDirectory());
+        expect (binary.replaceWithText ("binary"));
+
+        PluginScanCache cache;
+        OwnedArray<PluginDescription> types, restored;
+        addType (types, bundle, "Delay");
+        cache.store ("VST3", bundle.getFullPathName(), types);
+        expect (cache.restore ("VST3", bundle.getFullPathName(), restored));
+
+        // replacing the binary inside doesn't touch the bundle folder
+        expect (binary.replaceWithText ("a larger binary"));
+        expect (! cache.restore ("VST3", bundle.getFullPathName(), restored));
+    }
+
+    void testSaveAndLoad()
+    {
+        beginTest ("save and load");
+        const auto file = dir.getChildFile ("Reverb.vst3");
+        expect (file.replaceWithText ("binary"));
+        const auto cacheFile = dir.getChildFile ("cache/PluginScanCache.xml");
+
+        {
+            PluginScanCache cache;
+            OwnedArray<PluginDescription> types;
+            addType (types, file, "Reverb");
+            cache.store ("VST3", file.getFullPathName(), types);
+            expect (cache.save (cacheFile));
+        }
+
+        PluginScanCache cache;
+        expect (cache.load (cacheFile));
+        expectEquals (cache.size(), 1);
+
+        OwnedArray<PluginDescription> restored;
+        expect (cache.restore ("VST3", file.getFullPathName(), restored));
+        expectEquals (restored.size(), 1);
+        expectEquals (restored[0]->name, String ("Reverb"));
+        expectEquals (restored[0]->uid, String ("Reverb").hashCode());
+
+        expect (cacheFile.replaceWithText ("<PLUGINSCANCACHE version=\"0\"/>"));
+        expect (! cache.load (cacheFile));
+        expectEquals (cache.size(), 0);
+    }
+};
+
+static PluginScanCacheTest sPluginScanCacheTest;
+
+}
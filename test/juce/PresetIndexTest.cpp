@@ -0,0 +1,177 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "session/Presets.h"
+
+namespace Element {
+
+class PresetIndexTest : public UnitTestBase
+{
+public:
+    PresetIndexTest() : UnitTestBase ("Preset Index", "presets", "index") { }
+    virtual ~PresetIndexTest() { }
+
+    void runTest() override
+    {
+        root = File::createTempFile ("preset-index");
+        presetsDir = root.getChildFile ("Presets");
+        indexFile = root.getChildFile ("PresetIndex.xml");
+        presetsDir.createDirectory();
+
+        testLookup();
+        testChanges();
+        testPersistence();
+        testBackgroundRefresh();
+        testAdd();
+
+        root.deleteRecursively();
+    }
+
+private:
+    File root, presetsDir, indexFile;
+
+    static bool writePreset (const File& file, const String& name, const String& format, const String& identifier)
+    {
+        ValueTree node (Tags::node);
+        node.setProperty (Tags::name, name, nullptr)
+            .setProperty (Tags::format, format, nullptr)
+            .setProperty (Tags::identifier, identifier, nullptr);
+        file.getParentDirectory().createDirectory();
+        if (auto xml = std::unique_ptr<XmlElement> (node.createXml()))
+            return xml->writeToFile (file, String());
+        return false;
+    }
+
+    StringArray getNames (PresetCollection& presets, const String& format, const String& identifier)
+    {
+        OwnedArray<PresetDescription> found;
+        presets.getPresetsFor (format, identifier, found);
+        StringArray names;
+        for (const auto* preset : found)
+            names.add (preset->name);
+        return names;
+    }
+
+    void testLookup()
+    {
+        beginTest ("lookup");
+        expect (writePreset (presetsDir.getChildFile ("b.elpreset"), "Bright", "VST3", "synth"));
+        expect (writePreset (presetsDir.getChildFile ("a.elpreset"), "Warm", "VST3", "synth"));
+        expect (writePreset (presetsDir.getChildFile ("Pads/c.elpreset"), "Airy", "VST3", "synth"));
+        expect (writePreset (presetsDir.getChildFile ("d.elpreset"), "Hall", "LV2", "reverb"));
+        expect (presetsDir.getChildFile ("broken.elpreset").replaceWithText ("not a preset"));
+        expect (presetsDir.getChildFile ("notes.txt").replaceWithText ("ignored"));
+
+        PresetCollection presets (presetsDir, indexFile);
+        expectEquals (presets.size(), 0);
+        presets.refreshNow();
+        expectEquals (presets.size(), 4);
+
+        expectEquals (getNames (presets, "VST3", "synth").joinIntoString (","), String ("Airy,Bright,Warm"));
+        expectEquals (getNames (presets, "LV2", "reverb").joinIntoString (","), String ("Hall"));
+        expectEquals (getNames (presets, "LV2", "synth").size(), 0);
+        expect (indexFile.existsAsFile());
+    }
+
+    void testChanges()
+    {
+        beginTest ("changes");
+        PresetCollection presets (presetsDir, indexFile);
+        presets.refreshNow();
+
+        expect (writePreset (presetsDir.getChildFile ("a.elpreset"), "Warm Renamed", "VST3", "synth"));
+        expect (writePreset (presetsDir.getChildFile ("e.elpreset"), "Plate", "LV2", "reverb"));
+        expect (presetsDir.getChildFile ("b.elpreset").deleteFile());
+        presets.refreshNow();
+
+        expectEquals (getNames (presets, "VST3", "synth").joinIntoString (","), String ("Airy,Warm Renamed"));
+        expectEquals (getNames (presets, "LV2", "reverb").joinIntoString (","), String ("Hall,Plate"));
+        expectEquals (presets.size(), 4);
+    }
+
+    void testPersistence()
+    {
+        beginTest ("persistence");
+        {
+            PresetCollection presets (presetsDir, indexFile);
+            presets.refreshNow();
+        }
+
+        // an index for another folder is ignored
+        const auto otherDir = root.getChildFile ("Other");
+        expect (writePreset (otherDir.getChildFile ("x.elpreset"), "Other", "VST3", "synth"));
+        PresetCollection other (otherDir, indexFile);
+        other.refreshNow();
+        expectEquals (getNames (other, "VST3", "synth").joinIntoString (","), String ("Other"));
+
+        PresetCollection presets (presetsDir, indexFile);
+        presets.refreshNow();
+        expectEquals (presets.size(), 4);
+
+        presets.clear();
+        expectEquals (presets.size(), 0);
+        presets.refreshNow();
+        expectEquals (presets.size(), 4);
+    }
+
+    void testBackgroundRefresh()
+    {
+        beginTest ("background refresh");
+        PresetCollection presets (presetsDir, indexFile);
+        presets.refresh();
+        for (int i = 0; i < 5000 && presets.size() == 0; ++i)
+            Thread::sleep (1);
+        expectEquals (presets.size(), 4);
+
+        expect (writePreset (presetsDir.getChildFile ("f.elpreset"), "Cathedral", "LV2", "reverb"));
+        presets.refresh();
+        for (int i = 0; i < 5000 && presets.size() == 4; ++i)
+            Thread::sleep (1);
+        expectEquals (getNames (presets, "LV2", "reverb").joinIntoString (","), String ("Cathedral,Hall,Plate"));
+    }
+
+    void testAdd()
+    {
+        beginTest ("add");
+        PresetCollection presets (presetsDir, indexFile);
+        presets.refreshNow();
+        const int numPresets = presets.size();
+
+        const auto file = presetsDir.getChildFile ("g.elpreset");
+        expect (writePreset (file, "Chamber", "LV2", "reverb"));
+        presets.add (file);
+        expectEquals (presets.size(), numPresets + 1);
+        expectEquals (getNames (presets, "LV2", "reverb").joinIntoString (","), String ("Cathedral,Chamber,Hall,Plate"));
+
+        // saving over it replaces the entry
+        expect (writePreset (file, "Room", "LV2", "reverb"));
+        presets.add (file);
+        expectEquals (presets.size(), numPresets + 1);
+        expectEquals (getNames (presets, "LV2", "reverb").joinIntoString (","), String ("Cathedral,Hall,Plate,Room"));
+
+        // a rescan agrees with what was added
+        presets.refreshNow();
+        expectEquals (presets.size(), numPresets + 1);
+        expectEquals (getNames (presets, "LV2", "reverb").joinIntoString (","), String ("Cathedral,Hall,Plate,Room"));
+    }
+};
+
+static PresetIndexTest sPresetIndexTest;
+
+}
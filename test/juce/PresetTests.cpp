@@ -17,6 +17,7 @@
 */
 
 #include "Tests.h"
+#include "session/Presets.h"
 
 namespace Element {
 
@@ -39,9 +40,10 @@ public:
     {
         beginTest ("scan presets");
         Node node;
-        DataPath path;
         NodeArray nodes;
-        path.findPresetsFor ("AudioUnit", "AudioUnit:Synths/aumu,samp,appl", nodes);
+        auto& presets = globals->getPresetCollection();
+        presets.refreshNow();
+        presets.findPresetsFor ("AudioUnit", "AudioUnit:Synths/aumu,samp,appl", nodes);
     }
 
 private:
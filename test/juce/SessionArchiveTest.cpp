@@ -0,0 +1,217 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "Tests.h"
+#include "session/SessionArchive.h"
+
+namespace Element {
+
+class SessionArchiveTest : public UnitTestBase
+{
+public:
+    SessionArchiveTest() : UnitTestBase ("Session Archive", "session", "sessionArchive") { }
+    virtual ~SessionArchiveTest() { }
+
+    void runTest() override
+    {
+        testRoundTrip();
+        testCorruptFiles();
+        benchmark (4, 32, 16 * 1024);
+        benchmark (8, 64, 64 * 1024);
+    }
+
+private:
+    // plugin state is usually a mix of noisy and repetitive data
+    static MemoryBlock createState (Random& random, int size)
+    {
+        MemoryBlock block ((size_t) size);
+        auto* data = static_cast<uint8*> (block.getData());
+        for (int i = 0; i < size; ++i)
+            data[i] = (i < size / 2) ? (uint8) random.nextInt (256) : (uint8) (i % 37);
+        return block;
+    }
+
+    static ValueTree createSession (int numGraphs, int numNodes, int stateSize)
+    {
+        Random random (numGraphs * numNodes);
+        ValueTree session (Tags::session);
+        session.setProperty (Tags::name, "Large Session", nullptr);
+        ValueTree graphs (Tags::graphs);
+        session.appendChild (graphs, nullptr);
+
+        for (int g = 0; g < numGraphs; ++g)
+        {
+            ValueTree graph (Tags::node);
+            graph.setProperty (Tags::name, "Graph " + String (g + 1), nullptr);
+            ValueTree nodes (Tags::nodes);
+            graph.appendChild (nodes, nullptr);
+            graphs.appendChild (graph, nullptr);
+
+            for (int n = 0; n < numNodes; ++n)
+            {
+                ValueTree node (Tags::node);
+                node.setProperty (Tags::id, n + 1, nullptr)
+                    .setProperty (Tags::name, "Node " + String (n + 1), nullptr)
+                    .setProperty (Tags::state, createState (random, stateSize).toBase64Encoding(), nullptr)
+                    .setProperty (Tags::program, 0, nullptr);
+                if (n % 4 == 0)
+                    node.setProperty (Tags::programState, createState (random, 128).toBase64Encoding(), nullptr);
+                nodes.appendChild (node, nullptr);
+            }
+        }
+
+        return session;
+    }
+
+    static String toXmlString (const ValueTree& tree)
+    {
+        auto xml = tree.createXml();
+        return xml != nullptr ? xml->toString() : String();
+    }
+
+    void testRoundTrip()
+    {
+        beginTest ("round trip");
+        auto session = createSession (2, 8, 2048);
+        auto nodes = session.getChildWithName (Tags::graphs).getChild (0).getChildWithName (Tags::nodes);
+        nodes.getChild (1).setProperty (Tags::state, "not base64 state", nullptr);
+        nodes.getChild (2).setProperty (Tags::state, var (createState (Random::getSystemRandom(), 4000)), nullptr);
+        nodes.getChild (3).setProperty (Tags::state, String(), nullptr);
+        // integer state isn't chunked, and mustn't be mistaken for a chunk reference
+        nodes.getChild (4).setProperty (Tags::state, 0, nullptr)
+                          .setProperty (Tags::programState, 1234, nullptr);
+        const auto expected = toXmlString (session);
+
+        TemporaryFile file (".els");
+        for (const bool compress : { true, false })
+        {
+            SessionArchive archive;
+            archive.setCompression (compress);
+            expect (archive.write (session, file.getFile()).wasOk());
+            expect (SessionArchive::isArchive (file.getFile()));
+
+            ValueTree loaded;
+            expect (archive.read (file.getFile(), loaded).wasOk());
+            expect (loaded.hasType (Tags::session));
+            expectEquals (toXmlString (loaded), expected);
+
+            const auto state = loaded.getChildWithName (Tags::graphs).getChild (0)
+                .getChildWithName (Tags::nodes).getChild (0).getProperty (Tags::state);
+            expect (state.isBinaryData(), "state wasn't loaded as binary");
+        }
+
+        // xml -> archive -> xml
+        auto xml = session.createXml();
+        ValueTree fromXml = ValueTree::fromXml (*xml), loaded;
+        expect (SessionArchive().write (fromXml, file.getFile()).wasOk());
+        expect (SessionArchive().read (file.getFile(), loaded).wasOk());
+        expectEquals (toXmlString (loaded), expected);
+
+        // the shared loader opens both formats
+        ValueTree fromArchive, fromXmlFile;
+        expect (SessionArchive::load (file.getFile(), fromArchive).wasOk());
+        expectEquals (toXmlString (fromArchive), expected);
+        TemporaryFile xmlFile (".els");
+        expect (xml->writeToFile (xmlFile.getFile(), String()));
+        expect (SessionArchive::load (xmlFile.getFile(), fromXmlFile).wasOk());
+        expectEquals (toXmlString (fromXmlFile), expected);
+    }
+
+    void testCorruptFiles()
+    {
+        beginTest ("corrupt files");
+        TemporaryFile file (".els");
+        expect (file.getFile().replaceWithText ("<?xml version=\"1.0\"?><session/>"));
+        expect (! SessionArchive::isArchive (file.getFile()));
+        ValueTree loaded;
+        expect (SessionArchive().read (file.getFile(), loaded).failed());
+        expect (file.getFile().replaceWithText ("not a session"));
+        expect (SessionArchive::load (file.getFile(), loaded).failed());
+
+        expect (SessionArchive().write (createSession (1, 4, 1024), file.getFile()).wasOk());
+        MemoryBlock data;
+        expect (file.getFile().loadFileAsData (data));
+        data.setSize (data.getSize() / 2);
+        expect (file.getFile().replaceWithData (data.getData(), data.getSize()));
+        expect (SessionArchive::isArchive (file.getFile()));
+        expect (SessionArchive().read (file.getFile(), loaded).failed());
+        expect (! loaded.isValid());
+    }
+
+    // loading includes decoding every state, which restoring the nodes would do
+    static size_t decodeStates (const ValueTree& tree)
+    {
+        size_t total = 0;
+        for (int i = 0; i < tree.getNumChildren(); ++i)
+            total += decodeStates (tree.getChild (i));
+
+        if (tree.hasType (Tags::node) && tree.hasProperty (Tags::state))
+        {
+            const auto& state = tree.getProperty (Tags::state);
+            if (const auto* block = state.getBinaryData())
+                return total + block->getSize();
+            MemoryBlock block;
+            block.fromBase64Encoding (state.toString());
+            total += block.getSize();
+        }
+
+        return total;
+    }
+
+    void benchmark (int numGraphs, int numNodes, int stateSize)
+    {
+        beginTest ("benchmark " + String (numGraphs * numNodes) + " nodes with "
+            + String (stateSize / 1024) + " KB state");
+
+        const auto session = createSession (numGraphs, numNodes, stateSize);
+        const auto expectedBytes = decodeStates (session);
+        TemporaryFile xmlFile (".els"), archiveFile (".els");
+        ValueTree loaded;
+
+        auto start = Time::getMillisecondCounterHiRes();
+        expect (session.createXml()->writeToFile (xmlFile.getFile(), String()));
+        const auto xmlSave = Time::getMillisecondCounterHiRes() - start;
+
+        start = Time::getMillisecondCounterHiRes();
+        if (auto xml = XmlDocument::parse (xmlFile.getFile()))
+            loaded = ValueTree::fromXml (*xml);
+        expectEquals ((int64) decodeStates (loaded), (int64) expectedBytes);
+        const auto xmlLoad = Time::getMillisecondCounterHiRes() - start;
+
+        SessionArchive archive;
+        start = Time::getMillisecondCounterHiRes();
+        expect (archive.write (session, archiveFile.getFile()).wasOk());
+        const auto archiveSave = Time::getMillisecondCounterHiRes() - start;
+
+        start = Time::getMillisecondCounterHiRes();
+        expect (archive.read (archiveFile.getFile(), loaded).wasOk());
+        expectEquals ((int64) decodeStates (loaded), (int64) expectedBytes);
+        const auto archiveLoad = Time::getMillisecondCounterHiRes() - start;
+
+        expect (archiveFile.getFile().getSize() < xmlFile.getFile().getSize());
+        logMessage ("xml: " + File::descriptionOfSizeInBytes (xmlFile.getFile().getSize())
+            + ", save " + String (xmlSave, 1) + " ms, load " + String (xmlLoad, 1) + " ms");
+        logMessage ("archive: " + File::descriptionOfSizeInBytes (archiveFile.getFile().getSize())
+            + ", save " + String (archiveSave, 1) + " ms, load " + String (archiveLoad, 1) + " ms");
+    }
+};
+
+static SessionArchiveTest sSessionArchiveTest;
+
+}
@@ -0,0 +1,170 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "session/SessionJournal.h"
+
+namespace Element {
+
+class SessionJournalTest : public UnitTestBase
+{
+public:
+    SessionJournalTest() : UnitTestBase ("Session Journal", "session", "sessionJournal") { }
+    virtual ~SessionJournalTest() { }
+
+    void runTest() override
+    {
+        testNodeRecords();
+        testSnapshots();
+        testTornRecord();
+    }
+
+private:
+    static ValueTree createSession (int numNodes)
+    {
+        ValueTree session (Tags::session);
+        ValueTree graphs (Tags::graphs);
+        ValueTree graph (Tags::node);
+        ValueTree nodes (Tags::nodes);
+        session.appendChild (graphs, nullptr);
+        graphs.appendChild (graph, nullptr);
+        graph.appendChild (nodes, nullptr);
+        graph.setProperty (Tags::uuid, Uuid().toString(), nullptr);
+
+        for (int i = 0; i < numNodes; ++i)
+        {
+            ValueTree node (Tags::node);
+            node.setProperty (Tags::uuid, Uuid().toString(), nullptr)
+                .setProperty (Tags::name, "Node " + String (i + 1), nullptr)
+                .setProperty (Tags::state, "initial", nullptr);
+            nodes.appendChild (node, nullptr);
+        }
+
+        return session;
+    }
+
+    static ValueTree getNode (const ValueTree& session, int index)
+    {
+        return session.getChildWithName (Tags::graphs).getChild (0)
+            .getChildWithName (Tags::nodes).getChild (index);
+    }
+
+    static String toXmlString (const ValueTree& tree)
+    {
+        auto xml = tree.createXml();
+        return xml != nullptr ? xml->toString() : String();
+    }
+
+    void testNodeRecords()
+    {
+        beginTest ("node records");
+        TemporaryFile file (".autosave");
+        const auto saved = createSession (4);
+        auto current = saved.createCopy();
+
+        SessionJournal journal;
+        journal.setFile (file.getFile());
+        getNode (current, 1).setProperty (Tags::state, "changed once", nullptr);
+        journal.appendNodes ({ getNode (current, 1) });
+        getNode (current, 1).setProperty (Tags::state, "changed twice", nullptr);
+        getNode (current, 3).setProperty (Tags::state, "changed", nullptr)
+                            .setProperty (Tags::program, 2, nullptr);
+        journal.appendNodes ({ getNode (current, 1), getNode (current, 3) });
+        journal.waitForPendingWrites();
+        expect (file.getFile().existsAsFile());
+
+        auto recovered = saved.createCopy();
+        expect (SessionJournal::replay (file.getFile(), recovered).wasOk());
+        expectEquals (toXmlString (recovered), toXmlString (current));
+    }
+
+    void testSnapshots()
+    {
+        beginTest ("snapshots");
+        TemporaryFile file (".autosave");
+        auto current = createSession (8);
+
+        SessionJournal journal;
+        journal.setFile (file.getFile());
+        for (int round = 0; round < 4; ++round)
+        {
+            for (int i = 0; i < 8; ++i)
+            {
+                const auto state = String (round) + String::repeatedString ("x", 1024 * (i + 1));
+                getNode (current, i).setProperty (Tags::state, state, nullptr);
+                journal.appendNodes ({ getNode (current, i) });
+            }
+        }
+
+        journal.waitForPendingWrites();
+        const auto appendedSize = file.getFile().getSize();
+
+        // a snapshot replaces the records before it
+        getNode (current, 0).getParent().removeChild (0, nullptr);
+        journal.writeSnapshot (current);
+        journal.waitForPendingWrites();
+        expect (file.getFile().getSize() < appendedSize);
+
+        getNode (current, 0).setProperty (Tags::state, "after snapshot", nullptr);
+        journal.appendNodes ({ getNode (current, 0) });
+        journal.waitForPendingWrites();
+
+        // the base is ignored once a snapshot is found
+        auto recovered = createSession (2);
+        expect (SessionJournal::replay (file.getFile(), recovered).wasOk());
+        expectEquals (toXmlString (recovered), toXmlString (current));
+
+        journal.discard();
+        expect (! file.getFile().existsAsFile());
+    }
+
+    void testTornRecord()
+    {
+        beginTest ("torn record");
+        TemporaryFile file (".autosave");
+        const auto saved = createSession (2);
+        auto current = saved.createCopy();
+
+        {
+            SessionJournal journal;
+            journal.setFile (file.getFile());
+            getNode (current, 0).setProperty (Tags::state, "kept", nullptr);
+            journal.appendNodes ({ getNode (current, 0) });
+            journal.waitForPendingWrites();
+            getNode (current, 1).setProperty (Tags::state, "lost in a crash", nullptr);
+            journal.appendNodes ({ getNode (current, 1) });
+        }
+
+        MemoryBlock data;
+        expect (file.getFile().loadFileAsData (data));
+        data.setSize (data.getSize() - 4);
+        expect (file.getFile().replaceWithData (data.getData(), data.getSize()));
+
+        auto recovered = saved.createCopy();
+        expect (SessionJournal::replay (file.getFile(), recovered).wasOk());
+        expectEquals (getNode (recovered, 0).getProperty (Tags::state).toString(), String ("kept"));
+        expectEquals (getNode (recovered, 1).getProperty (Tags::state).toString(), String ("initial"));
+
+        expect (file.getFile().replaceWithText ("not a journal"));
+        expect (SessionJournal::replay (file.getFile(), recovered).failed());
+    }
+};
+
+static SessionJournalTest sSessionJournalTest;
+
+}
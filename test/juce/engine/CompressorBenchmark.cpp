@@ -0,0 +1,202 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "engine/nodes/CompressorProcessor.h"
+
+namespace Element {
+
+class CompressorBenchmark : public UnitTestBase
+{
+public:
+    CompressorBenchmark() : UnitTestBase ("Compressor", "engine", "compressor") { }
+    virtual ~CompressorBenchmark() { }
+
+    void runTest() override
+    {
+        for (const float sideAmount : { 0.0f, 0.5f, 1.0f })
+            testMatchesReference (sideAmount);
+        // the detector that wasn't heard must still be tracking its input
+        testMatchesReference (0.0f, 1.0f);
+        testMatchesReference (1.0f, 0.5f);
+        for (const int blockSize : { 64, 256, 1024 })
+            benchmarkBlocks (blockSize);
+    }
+
+private:
+    static constexpr double sampleRate = 48000.0;
+    enum { Threshold, Ratio, Knee, Attack, Release, Makeup, SideChain };
+
+    // the per sample loop the block kernel replaced
+    struct Reference
+    {
+        LevelDetector detector, sideDetector;
+        GainComputer gainComputer;
+        SmoothedValue<float, ValueSmoothingTypes::Multiplicative> makeupGain = 1.0f;
+        float threshDB = 0.f, ratio = 1.f, kneeDB = 6.f, attackMs = 10.f,
+              releaseMs = 100.f, makeupDB = 0.f, sideChain = 0.f;
+
+        void prepare()
+        {
+            detector.reset ((float) sampleRate);
+            sideDetector.reset ((float) sampleRate);
+            gainComputer.reset();
+            makeupGain.reset (200);
+        }
+
+        void process (AudioBuffer<float>& buffer)
+        {
+            detector.setAttackMs (attackMs);
+            detector.setReleaseMs (releaseMs);
+            sideDetector.setAttackMs (attackMs);
+            sideDetector.setReleaseMs (releaseMs);
+            gainComputer.setThreshold (threshDB);
+            gainComputer.setRatio (ratio);
+            gainComputer.setKnee (kneeDB);
+            makeupGain.setTargetValue (Decibels::decibelsToGain (makeupDB));
+
+            for (int n = 0; n < buffer.getNumSamples(); ++n)
+            {
+                const float mainInput = (buffer.getSample (0, n) + buffer.getSample (1, n)) / 2.0f;
+                const float sideInput = (buffer.getSample (2, n) + buffer.getSample (3, n)) / 2.0f;
+                const float level = detector.process (mainInput) * (1.0f - sideChain)
+                                  + sideDetector.process (sideInput) * sideChain;
+                const float gain = gainComputer.process (level);
+                const float total = gain * makeupGain.getNextValue();
+                buffer.applyGain (0, n, 1, total);
+                buffer.applyGain (1, n, 1, total);
+            }
+        }
+    };
+
+    static void setParameter (CompressorProcessor& proc, int index, float value)
+    {
+        if (auto* param = dynamic_cast<AudioParameterFloat*> (proc.getParameters()[index]))
+            *param = value;
+    }
+
+    static void configure (CompressorProcessor& proc, Reference& ref, float sideAmount)
+    {
+        setParameter (proc, Threshold, ref.threshDB = -18.f);
+        setParameter (proc, Ratio, ref.ratio = 4.f);
+        setParameter (proc, Knee, ref.kneeDB = 6.f);
+        setParameter (proc, Attack, ref.attackMs = 5.f);
+        setParameter (proc, Release, ref.releaseMs = 80.f);
+        setParameter (proc, Makeup, ref.makeupDB = 3.f);
+        setParameter (proc, SideChain, ref.sideChain = sideAmount);
+    }
+
+    // a drum-like signal, loud bursts over quiet noise, with a different sidechain
+    static void fillInput (AudioBuffer<float>& buffer, int64 offset, Random& random)
+    {
+        for (int n = 0; n < buffer.getNumSamples(); ++n)
+        {
+            const auto frame = offset + n;
+            const float burst = (frame % 12000) < 3000 ? 0.9f : 0.05f;
+            const float sideBurst = (frame % 9000) < 2000 ? 0.8f : 0.02f;
+            for (int ch = 0; ch < 2; ++ch)
+            {
+                buffer.setSample (ch, n, burst * (random.nextFloat() * 2.f - 1.f));
+                buffer.setSample (ch + 2, n, sideBurst * (random.nextFloat() * 2.f - 1.f));
+            }
+        }
+    }
+
+    void testMatchesReference (float sideAmount, float switchedAmount = -1.0f)
+    {
+        beginTest ("matches per sample processing, sidechain " + String (sideAmount, 1)
+            + (switchedAmount >= 0.0f ? " then " + String (switchedAmount, 1) : String()));
+        CompressorProcessor proc (2);
+        Reference ref;
+        configure (proc, ref, sideAmount);
+        proc.prepareToPlay (sampleRate, 512);
+        ref.prepare();
+
+        Random random (99);
+        MidiBuffer midi;
+        AudioBuffer<float> input (4, 512), expected (4, 512);
+        float maxError = 0.f;
+
+        // odd sized blocks cross the smoothing ramps at different points
+        int64 offset = 0;
+        for (int block = 0; block < 200; ++block)
+        {
+            const int numSamples = 1 + ((block * 97) % 512);
+            if (block == 100 && switchedAmount >= 0.0f)
+                setParameter (proc, SideChain, ref.sideChain = switchedAmount);
+            input.setSize (4, numSamples, false, false, true);
+            expected.setSize (4, numSamples, false, false, true);
+            fillInput (input, offset, random);
+            expected.makeCopyOf (input, true);
+
+            proc.processBlock (input, midi);
+            ref.process (expected);
+
+            for (int ch = 0; ch < 2; ++ch)
+                for (int n = 0; n < numSamples; ++n)
+                    maxError = jmax (maxError, std::abs (input.getSample (ch, n) - expected.getSample (ch, n)));
+            offset += numSamples;
+        }
+
+        expect (maxError < 1.0e-5f, "max error " + String (maxError));
+        expect (proc.getInputLevelDB() > -100.f);
+        proc.releaseResources();
+    }
+
+    void benchmarkBlocks (int blockSize)
+    {
+        beginTest (String (blockSize) + " sample blocks");
+        CompressorProcessor proc (2);
+        Reference ref;
+        configure (proc, ref, 0.f);
+        proc.prepareToPlay (sampleRate, blockSize);
+        ref.prepare();
+
+        // ten seconds of audio, generated up front so only processing is timed
+        const int numBlocks = roundToInt (10.0 * sampleRate / blockSize);
+        Random random (blockSize);
+        OwnedArray<AudioBuffer<float>> blocks;
+        for (int i = 0; i < numBlocks; ++i)
+            fillInput (*blocks.add (new AudioBuffer<float> (4, blockSize)), (int64) i * blockSize, random);
+
+        OwnedArray<AudioBuffer<float>> copies;
+        for (auto* block : blocks)
+            copies.add (new AudioBuffer<float> (*block));
+
+        MidiBuffer midi;
+        auto start = Time::getMillisecondCounterHiRes();
+        for (auto* block : copies)
+            ref.process (*block);
+        const auto perSample = Time::getMillisecondCounterHiRes() - start;
+
+        start = Time::getMillisecondCounterHiRes();
+        for (auto* block : blocks)
+            proc.processBlock (*block, midi);
+        const auto blockBased = Time::getMillisecondCounterHiRes() - start;
+
+        const double numSamples = (double) numBlocks * blockSize;
+        logMessage (String (blockSize) + " samples: "
+            + String (1000000.0 * perSample / numSamples, 2) + " ns per sample looping per sample, "
+            + String (1000000.0 * blockBased / numSamples, 2) + " ns per sample in blocks");
+        proc.releaseResources();
+    }
+};
+
+static CompressorBenchmark sCompressorBenchmark;
+
+}
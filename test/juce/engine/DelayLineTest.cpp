@@ -0,0 +1,455 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "engine/DelayLine.h"
+#include "engine/RenderThreadPool.h"
+
+namespace Element {
+
+/** Delays its input by the latency it reports, like a lookahead plugin */
+class LatentProcessor : public AudioProcessor
+{
+public:
+    explicit LatentProcessor (int latency)
+        : AudioProcessor (BusesProperties()
+            .withInput  ("Main", AudioChannelSet::stereo(), true)
+            .withOutput ("Main", AudioChannelSet::stereo(), true))
+    {
+        setLatency (latency);
+    }
+
+    void setLatency (int latency)
+    {
+        for (auto& line : lines)
+        {
+            if (! line.setDelay (latency))
+            {
+                line.prepare (latency, 512);
+                line.setDelay (latency);
+            }
+        }
+
+        setLatencySamples (latency);
+        updateHostDisplay();
+    }
+
+    const String getName() const override { return "Latent"; }
+
+    void prepareToPlay (double sampleRate, int blockSize) override
+    {
+        setPlayConfigDetails (2, 2, sampleRate, blockSize);
+        for (auto& line : lines)
+        {
+            line.prepare (jmax (line.getDelay(), getLatencySamples()), blockSize);
+            line.setDelay (getLatencySamples());
+        }
+    }
+
+    void releaseResources() override { }
+
+    void processBlock (AudioBuffer<float>& buffer, MidiBuffer&) override
+    {
+        for (int ch = 0; ch < jmin (2, buffer.getNumChannels()); ++ch)
+            lines[ch].process (buffer.getReadPointer (ch), buffer.getWritePointer (ch), buffer.getNumSamples());
+    }
+
+    double getTailLengthSeconds() const override    { return 0.0; }
+    bool acceptsMidi() const override               { return false; }
+    bool producesMidi() const override              { return false; }
+    AudioProcessorEditor* createEditor() override   { return nullptr; }
+    bool hasEditor() const override                 { return false; }
+
+    int getNumPrograms() override                               { return 1; }
+    int getCurrentProgram() override                            { return 0; }
+    void setCurrentProgram (int) override                       { }
+    const String getProgramName (int) override                  { return String(); }
+    void changeProgramName (int, const String&) override        { }
+    void getStateInformation (MemoryBlock&) override            { }
+    void setStateInformation (const void*, int) override        { }
+
+private:
+    AudioDelayLine lines [2];
+};
+
+/** Passes audio through and marks each note on with a pulse on the second
+    channel, so where MIDI lands shows up in the audio */
+class NoteMarker : public LatentProcessor
+{
+public:
+    NoteMarker() : LatentProcessor (0) { }
+
+    const String getName() const override { return "Note Marker"; }
+    bool acceptsMidi() const override { return true; }
+
+    void processBlock (AudioBuffer<float>& buffer, MidiBuffer& midi) override
+    {
+        LatentProcessor::processBlock (buffer, midi);
+        MidiBuffer::Iterator iter (midi);
+        MidiMessage msg; int frame = 0;
+        while (iter.getNextEvent (msg, frame))
+            if (msg.isNoteOn() && frame < buffer.getNumSamples())
+                buffer.setSample (1, frame, 1.f);
+    }
+};
+
+class DelayLineTest : public UnitTestBase
+{
+public:
+    DelayLineTest() : UnitTestBase ("Delay Lines", "engine", "delayLine") { }
+    virtual ~DelayLineTest() { }
+
+    void runTest() override
+    {
+        testAudio();
+        testSilence();
+        testMidi();
+        testGraphLatency();
+        testSharedTaps();
+        testMidiCompensation();
+    }
+
+private:
+    void testAudio()
+    {
+        beginTest ("audio is sample accurate across blocks");
+        for (const int delay : { 0, 1, 63, 64, 100, 1000 })
+        {
+            for (const int blockSize : { 1, 37, 64, 512 })
+            {
+                AudioDelayLine line;
+                line.prepare (4096, 64);
+                expect (line.setDelay (delay));
+
+                HeapBlock<float> input ((size_t) blockSize), output ((size_t) blockSize);
+                int errors = 0;
+                for (int block = 0, time = 0; block < 8; ++block, time += blockSize)
+                {
+                    for (int i = 0; i < blockSize; ++i)
+                        input[i] = (float) (time + i + 1);
+
+                    // in place on odd blocks
+                    float* const dest = (block % 2) != 0 ? input.getData() : output.getData();
+                    line.process (input, dest, blockSize);
+
+                    for (int i = 0; i < blockSize; ++i)
+                        if (dest[i] != (time + i < delay ? 0.f : (float) (time + i - delay + 1)))
+                            ++errors;
+                }
+
+                expectEquals (errors, 0, "delay " + String (delay) + ", block " + String (blockSize));
+            }
+        }
+
+        beginTest ("audio delay changes in place");
+        AudioDelayLine line;
+        line.prepare (256, 64);
+        expect (line.setDelay (200));
+        expect (! line.setDelay (257), "delays past the prepared size don't fit");
+        expectEquals (line.getDelay(), 200);
+    }
+
+    void testSilence()
+    {
+        beginTest ("silence");
+        AudioDelayLine line;
+        line.prepare (100, 64);
+        line.setDelay (100);
+
+        float block [64] = { 0.f };
+        expect (line.process (block, block, 64, true), "a new line is silent");
+
+        block[0] = 1.f;
+        expect (! line.process (block, block, 64, false));
+
+        // the impulse comes out 100 samples later, then the line is silent again
+        zeromem (block, sizeof (block));
+        expect (! line.process (block, block, 64, true));
+        expect (block[36] == 1.f);
+
+        bool silent = false;
+        for (int i = 0; i < 4 && ! silent; ++i)
+        {
+            zeromem (block, sizeof (block));
+            silent = line.process (block, block, 64, true);
+        }
+
+        expect (silent);
+    }
+
+    void testMidi()
+    {
+        beginTest ("midi timestamps shift across blocks");
+        MidiDelayLine line;
+        line.prepare();
+        line.setDelay (150);
+
+        MidiBuffer midi;
+        midi.addEvent (MidiMessage::noteOn (1, 60, 1.f), 10);
+        midi.addEvent (MidiMessage::noteOff (1, 60), 60);
+        line.process (midi, 64);
+        expect (midi.isEmpty());
+
+        midi.clear();
+        midi.addEvent (MidiMessage::noteOn (1, 62, 1.f), 5);
+        line.process (midi, 64);
+        expect (midi.isEmpty());
+
+        // 10 + 150 = 160, which is sample 32 of the third block
+        midi.clear();
+        line.process (midi, 64);
+        expectEquals (midi.getNumEvents(), 1);
+        expectEquals (midi.getFirstEventTime(), 32);
+
+        // then the note off at 210 and the second note on at 64 + 5 + 150 = 219
+        midi.clear();
+        line.process (midi, 64);
+        expectEquals (midi.getNumEvents(), 2);
+        expectEquals (midi.getFirstEventTime(), 18);
+        expectEquals (midi.getLastEventTime(), 27);
+        expect (line.isEmpty());
+
+        beginTest ("midi passes through without a delay");
+        line.setDelay (0);
+        midi.clear();
+        midi.addEvent (MidiMessage::noteOn (1, 60, 1.f), 3);
+        line.process (midi, 64);
+        expectEquals (midi.getNumEvents(), 1);
+        expectEquals (midi.getFirstEventTime(), 3);
+    }
+
+    /** Renders an impulse through the graph and returns where the output peaks */
+    int renderImpulse (GraphProcessor& graph, float& peak)
+    {
+        AudioSampleBuffer audio (2, 64);
+        MidiBuffer midi;
+
+        // flush what's left in the delay lines
+        for (int i = 0; i < 200; ++i)
+        {
+            audio.clear();
+            graph.processBlock (audio, midi);
+        }
+
+        int position = -1;
+        peak = 0.f;
+        for (int block = 0; block < 200; ++block)
+        {
+            audio.clear();
+            if (block == 0)
+                audio.setSample (0, 10, 1.f);
+            graph.processBlock (audio, midi);
+
+            for (int i = 0; i < audio.getNumSamples(); ++i)
+            {
+                if (std::abs (audio.getSample (0, i)) > peak)
+                {
+                    peak = std::abs (audio.getSample (0, i));
+                    position = block * audio.getNumSamples() + i;
+                }
+            }
+        }
+
+        return position;
+    }
+
+    void testGraphLatency()
+    {
+        beginTest ("graph compensates latency");
+        GraphProcessor graph;
+        graph.setPlayConfigDetails (2, 2, 44100.0, 64);
+        graph.prepareToPlay (44100.0, 64);
+
+        auto* const latent = new LatentProcessor (100);
+        NodeObjectPtr input = graph.addNode (new GraphProcessor::AudioGraphIOProcessor (
+            GraphProcessor::AudioGraphIOProcessor::audioInputNode));
+        NodeObjectPtr output = graph.addNode (new GraphProcessor::AudioGraphIOProcessor (
+            GraphProcessor::AudioGraphIOProcessor::audioOutputNode));
+        NodeObjectPtr node = graph.addNode (latent);
+
+        // the dry path has to be delayed to line up with the latent one
+        input->connectAudioTo (node);
+        node->connectAudioTo (output);
+        input->connectAudioTo (output);
+        graph.handleUpdateNowIfNeeded();
+
+        float peak = 0.f;
+        expectEquals (renderImpulse (graph, peak), 110);
+        expectEquals (peak, 2.f);
+        expectEquals (graph.getLatencySamples(), 100);
+
+        beginTest ("latency changes without a rebuild");
+        latent->setLatency (300);
+        graph.refreshLatencies();
+        expect (! graph.isUpdatePending());
+        expectEquals (graph.getLatencySamples(), 300);
+        expectEquals (renderImpulse (graph, peak), 310);
+        expectEquals (peak, 2.f);
+
+        beginTest ("latency past the delay's room rebuilds");
+        latent->setLatency (10000);
+        graph.refreshLatencies();
+        expect (graph.isUpdatePending());
+        graph.handleUpdateNowIfNeeded();
+        expectEquals (graph.getLatencySamples(), 10000);
+        expectEquals (renderImpulse (graph, peak), 10010);
+        expectEquals (peak, 2.f);
+
+        graph.releaseResources();
+        graph.clear();
+    }
+
+    /** Two latent branches which each mix in the dry input, so the input is
+        read by both mixers with the same delay from one shared tap */
+    void buildSharedTapGraph (GraphProcessor& graph)
+    {
+        graph.setPlayConfigDetails (2, 2, 44100.0, 64);
+        graph.prepareToPlay (44100.0, 64);
+
+        NodeObjectPtr input = graph.addNode (new GraphProcessor::AudioGraphIOProcessor (
+            GraphProcessor::AudioGraphIOProcessor::audioInputNode));
+        NodeObjectPtr output = graph.addNode (new GraphProcessor::AudioGraphIOProcessor (
+            GraphProcessor::AudioGraphIOProcessor::audioOutputNode));
+
+        for (int i = 0; i < 2; ++i)
+        {
+            NodeObjectPtr latent = graph.addNode (new LatentProcessor (100));
+            NodeObjectPtr mixer = graph.addNode (new LatentProcessor (0));
+            input->connectAudioTo (latent);
+            latent->connectAudioTo (mixer);
+            input->connectAudioTo (mixer);
+            mixer->connectAudioTo (output);
+        }
+
+        graph.handleUpdateNowIfNeeded();
+    }
+
+    void testSharedTaps()
+    {
+        beginTest ("shared delay taps");
+        GraphProcessor serial;
+        buildSharedTapGraph (serial);
+
+        // both branches and both dry paths line up
+        float peak = 0.f;
+        expectEquals (renderImpulse (serial, peak), 110);
+        expectEquals (peak, 4.f);
+        expectEquals (serial.getLatencySamples(), 100);
+
+        beginTest ("shared delay taps in a parallel plan");
+        RenderThreadPool pool;
+        pool.start (3);
+        GraphProcessor parallel;
+        parallel.setRenderThreadPool (&pool);
+        parallel.setMultiCoreRendering (true);
+        buildSharedTapGraph (parallel);
+        expect (parallel.hasParallelPlan(), "no parallel plan was built");
+
+        // the second mixer reads the tap the first one's job writes, so
+        // they only agree if the plan waits for it
+        Random random (25);
+        AudioSampleBuffer expected (2, 64), actual (2, 64);
+        MidiBuffer midi;
+        int errors = 0;
+        for (int block = 0; block < 2000; ++block)
+        {
+            for (int ch = 0; ch < 2; ++ch)
+                for (int i = 0; i < 64; ++i)
+                    expected.setSample (ch, i, random.nextFloat() * 2.f - 1.f);
+            actual.makeCopyOf (expected, true);
+
+            midi.clear();
+            serial.processBlock (expected, midi);
+            midi.clear();
+            parallel.processBlock (actual, midi);
+
+            for (int ch = 0; ch < 2; ++ch)
+                for (int i = 0; i < 64; ++i)
+                    if (std::abs (actual.getSample (ch, i) - expected.getSample (ch, i)) > 1.0e-6f)
+                        ++errors;
+        }
+
+        expectEquals (errors, 0);
+
+        parallel.setRenderThreadPool (nullptr);
+        parallel.handleUpdateNowIfNeeded();
+        serial.releaseResources();
+        parallel.releaseResources();
+        serial.clear();
+        parallel.clear();
+        pool.stop();
+    }
+
+    void testMidiCompensation()
+    {
+        beginTest ("midi compensates latency");
+        GraphProcessor graph;
+        graph.setPlayConfigDetails (2, 2, 44100.0, 64);
+        graph.prepareToPlay (44100.0, 64);
+
+        NodeObjectPtr input = graph.addNode (new GraphProcessor::AudioGraphIOProcessor (
+            GraphProcessor::AudioGraphIOProcessor::audioInputNode));
+        NodeObjectPtr output = graph.addNode (new GraphProcessor::AudioGraphIOProcessor (
+            GraphProcessor::AudioGraphIOProcessor::audioOutputNode));
+        NodeObjectPtr midiIn = graph.addNode (new GraphProcessor::AudioGraphIOProcessor (
+            GraphProcessor::AudioGraphIOProcessor::midiInputNode));
+        NodeObjectPtr latent = graph.addNode (new LatentProcessor (100));
+        NodeObjectPtr marker = graph.addNode (new NoteMarker());
+
+        // the notes have to be delayed to line up with the latent audio
+        input->connectAudioTo (latent);
+        latent->connectAudioTo (marker);
+        marker->connectAudioTo (output);
+        expect (graph.addConnection (midiIn->nodeId, midiIn->getMidiOutputPort(),
+                                     marker->nodeId, marker->getMidiInputPort()));
+        graph.handleUpdateNowIfNeeded();
+
+        AudioSampleBuffer audio (2, 64);
+        MidiBuffer midi;
+        int audioAt = -1, noteAt = -1;
+        for (int block = 0; block < 8; ++block)
+        {
+            audio.clear();
+            midi.clear();
+            if (block == 0)
+            {
+                audio.setSample (0, 10, 1.f);
+                midi.addEvent (MidiMessage::noteOn (1, 60, 1.f), 10);
+            }
+
+            graph.processBlock (audio, midi);
+            for (int i = 0; i < 64; ++i)
+            {
+                if (audio.getSample (0, i) != 0.f && audioAt < 0)
+                    audioAt = block * 64 + i;
+                if (audio.getSample (1, i) != 0.f && noteAt < 0)
+                    noteAt = block * 64 + i;
+            }
+        }
+
+        expectEquals (audioAt, 110);
+        expectEquals (noteAt, 110);
+
+        graph.releaseResources();
+        graph.clear();
+    }
+};
+
+static DelayLineTest sDelayLineTest;
+
+}
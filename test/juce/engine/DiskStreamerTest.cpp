@@ -0,0 +1,194 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "engine/DiskStreamer.h"
+
+namespace Element {
+
+class DiskStreamerTest : public UnitTestBase
+{
+public:
+    DiskStreamerTest() : UnitTestBase ("Disk Streamer", "engine", "diskStreamer") { }
+    virtual ~DiskStreamerTest() { }
+
+    void initialise() override
+    {
+        formats.registerBasicFormats();
+    }
+
+    void runTest() override
+    {
+        testPreloaded();
+        testStreamed();
+        testLooping();
+    }
+
+private:
+    AudioFormatManager formats;
+
+    static float rampValue (int64 frame)
+    {
+        return (float) (frame % 1000) / 1000.f - 0.5f;
+    }
+
+    static bool writeRamp (const File& file, int numFrames)
+    {
+        std::unique_ptr<FileOutputStream> out (file.createOutputStream());
+        if (out == nullptr)
+            return false;
+
+        WavAudioFormat wav;
+        std::unique_ptr<AudioFormatWriter> writer (wav.createWriterFor (
+            out.get(), 44100.0, 1, 32, {}, 0));
+        if (writer == nullptr)
+            return false;
+        out.release();
+
+        AudioBuffer<float> block (1, 4096);
+        for (int frame = 0; frame < numFrames; frame += block.getNumSamples())
+        {
+            const int n = jmin (block.getNumSamples(), numFrames - frame);
+            for (int i = 0; i < n; ++i)
+                block.setSample (0, i, rampValue (frame + i));
+            if (! writer->writeFromAudioSampleBuffer (block, 0, n))
+                return false;
+        }
+
+        return true;
+    }
+
+    bool waitUntilReady (DiskStreamer::Stream& stream)
+    {
+        // an empty block lets the stream pick up a seek
+        AudioBuffer<float> buffer (2, 1);
+        const AudioSourceChannelInfo empty (&buffer, 0, 0);
+        for (int i = 0; i < 5000 && ! stream.isReady(); ++i)
+        {
+            stream.getNextAudioBlock (empty);
+            Thread::sleep (1);
+        }
+
+        return stream.isReady();
+    }
+
+    bool readMatches (DiskStreamer::Stream& stream, int64 frame, int numFrames, int64 length)
+    {
+        AudioBuffer<float> buffer (2, numFrames);
+        stream.getNextAudioBlock (AudioSourceChannelInfo (buffer));
+
+        for (int i = 0; i < numFrames; ++i)
+        {
+            const auto expected = rampValue ((frame + i) % length);
+            if (buffer.getSample (0, i) != expected || buffer.getSample (1, i) != expected)
+                return false;
+        }
+
+        return true;
+    }
+
+    void testPreloaded()
+    {
+        beginTest ("preloaded");
+        TemporaryFile file (".wav");
+        expect (writeRamp (file.getFile(), 44100));
+
+        DiskStreamer streamer;
+        auto stream = streamer.openFile (formats, file.getFile());
+        expect (stream != nullptr);
+        expect (stream->isPreloaded());
+        expect (stream->isMemoryMapped());
+        expectEquals (stream->getTotalLength(), (int64) 44100);
+        expectEquals (stream->getSampleRate(), 44100.0);
+
+        expect (waitUntilReady (*stream));
+        expect (readMatches (*stream, 0, 512, 44100));
+        expect (readMatches (*stream, 512, 512, 44100));
+
+        stream->setNextReadPosition (20000);
+        expect (waitUntilReady (*stream));
+        expectEquals (stream->getNextReadPosition(), (int64) 20000);
+        expect (readMatches (*stream, 20000, 512, 44100));
+
+        const auto stats = streamer.getStats();
+        expectEquals (stats.numStreams, 1);
+        expectEquals (stats.numPreloaded, 1);
+        expectEquals (stats.underruns, (int64) 0);
+        expect (stats.bytesRead > 0);
+
+        stream.reset();
+        expectEquals (streamer.getStats().numStreams, 0);
+    }
+
+    void testStreamed()
+    {
+        beginTest ("streamed");
+        // big enough not to be preloaded
+        const int length = 44100 * 60;
+        TemporaryFile file (".wav");
+        expect (writeRamp (file.getFile(), length));
+
+        DiskStreamer streamer;
+        auto stream = streamer.openFile (formats, file.getFile());
+        expect (stream != nullptr);
+        expect (! stream->isPreloaded());
+
+        expect (waitUntilReady (*stream));
+        for (int block = 0; block < 8; ++block)
+            expect (readMatches (*stream, block * 512, 512, length));
+        expectEquals (streamer.getStats().underruns, (int64) 0);
+
+        stream->setNextReadPosition (length / 2);
+        expectEquals (stream->getNextReadPosition(), (int64) length / 2);
+        expect (waitUntilReady (*stream));
+        expect (readMatches (*stream, length / 2, 512, length));
+        expectEquals (stream->getNextReadPosition(), (int64) length / 2 + 512);
+    }
+
+    void testLooping()
+    {
+        beginTest ("looping");
+        const int length = 44100 * 60;
+        TemporaryFile file (".wav");
+        expect (writeRamp (file.getFile(), length));
+
+        DiskStreamer streamer;
+        auto stream = streamer.openFile (formats, file.getFile());
+        expect (stream != nullptr);
+
+        stream->setLooping (true);
+        stream->setNextReadPosition (length - 300);
+        expect (waitUntilReady (*stream));
+        expect (readMatches (*stream, length - 300, 512, length));
+        expectEquals (stream->getNextReadPosition(), (int64) 212);
+
+        // a short file loops from memory
+        TemporaryFile shortFile (".wav");
+        expect (writeRamp (shortFile.getFile(), 1000));
+        auto shortStream = streamer.openFile (formats, shortFile.getFile());
+        expect (shortStream != nullptr);
+        shortStream->setLooping (true);
+        expect (waitUntilReady (*shortStream));
+        expect (readMatches (*shortStream, 0, 2048, 1000));
+        expectEquals (shortStream->getNextReadPosition(), (int64) 48);
+    }
+};
+
+static DiskStreamerTest sDiskStreamerTest;
+
+}
@@ -87,6 +87,15 @@ public:
             beginTest ("graph details");
             expect (graph.getNumConnections() == 2);
             expect (graph.getLatencySamples() == node1->getLatencySamples());
+
+            beginTest ("oversampling a prepared node");
+            const int latencyBefore = node1->getLatencySamples();
+            node1->setOversamplingQuality (Oversampler<float>::linearPhaseFIR);
+            node1->setOversamplingFactor (2);
+            expect (node1->getLatencySamples() > latencyBefore, "oversampling latency wasn't picked up");
+            graph.refreshLatencies();
+            graph.handleUpdateNowIfNeeded();
+            expect (graph.getLatencySamples() == node1->getLatencySamples());
             
             node1 = nullptr; node2 = nullptr;
             graph.releaseResources();
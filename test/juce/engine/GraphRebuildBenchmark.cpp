@@ -0,0 +1,126 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+
+namespace Element {
+
+class GraphRebuildBenchmark : public UnitTestBase
+{
+public:
+    GraphRebuildBenchmark() : UnitTestBase ("Graph Rebuild", "engine", "graphRebuild") { }
+    virtual ~GraphRebuildBenchmark() { }
+
+    void runTest() override
+    {
+        testRenderOrder();
+        for (const int size : { 25, 50, 100, 200 })
+            benchmarkRebuild (size);
+    }
+
+private:
+    void testRenderOrder()
+    {
+        beginTest ("render order follows connections");
+        GraphProcessor graph;
+        graph.prepareToPlay (44100.0, 512);
+
+        // add in reverse so every connection forces a reorder
+        ReferenceCountedArray<NodeObject> chain;
+        for (int i = 0; i < 8; ++i)
+            chain.insert (0, graph.addNode (new VolumeProcessor (-30.0, 12.0, true)));
+        for (int i = 0; i < chain.size() - 1; ++i)
+            chain[i]->connectAudioTo (chain[i + 1]);
+
+        ReferenceCountedArray<NodeObject> ordered;
+        graph.getOrderedNodes (ordered);
+        expectEquals (ordered.size(), chain.size());
+        for (int i = 0; i < chain.size(); ++i)
+            expect (ordered[i] == chain[i], "node out of order");
+
+        // a feedback connection must leave the order untouched
+        chain.getLast()->connectAudioTo (chain.getFirst());
+        ordered.clearQuick();
+        graph.getOrderedNodes (ordered);
+        for (int i = 0; i < chain.size(); ++i)
+            expect (ordered[i] == chain[i], "feedback changed order");
+
+        graph.releaseResources();
+        graph.clear();
+    }
+
+    void benchmarkRebuild (const int numNodes)
+    {
+        beginTest ("rebuild " + String (numNodes) + " nodes");
+        GraphProcessor graph;
+        graph.setPlayConfigDetails (2, 2, 44100.0, 512);
+        graph.prepareToPlay (44100.0, 512);
+
+        NodeObjectPtr input = graph.addNode (new GraphProcessor::AudioGraphIOProcessor (
+            GraphProcessor::AudioGraphIOProcessor::audioInputNode));
+        NodeObjectPtr output = graph.addNode (new GraphProcessor::AudioGraphIOProcessor (
+            GraphProcessor::AudioGraphIOProcessor::audioOutputNode));
+
+        NodeObjectPtr last = input;
+        for (int i = 0; i < numNodes; ++i)
+        {
+            NodeObjectPtr node = graph.addNode (new VolumeProcessor (-30.0, 12.0, true));
+            // mix of serial chains and parallel branches
+            if (i % 4 == 0)
+                last = input;
+            last->connectAudioTo (node);
+            last = node;
+            if (i % 4 == 3)
+                node->connectAudioTo (output);
+        }
+
+        graph.handleUpdateNowIfNeeded();
+
+        const int numRebuilds = 20;
+        const auto start = Time::getMillisecondCounterHiRes();
+        for (int i = 0; i < numRebuilds; ++i)
+        {
+            NodeObjectPtr node = graph.addNode (new VolumeProcessor (-30.0, 12.0, true));
+            input->connectAudioTo (node);
+            node->connectAudioTo (output);
+            graph.handleUpdateNowIfNeeded();
+            graph.removeNode (node->nodeId);
+            graph.handleUpdateNowIfNeeded();
+        }
+        const auto elapsed = Time::getMillisecondCounterHiRes() - start;
+
+        logMessage (String (numNodes) + " nodes: " + String (elapsed / (numRebuilds * 2), 3) + " ms per rebuild");
+        expect (graph.getNumNodes() == numNodes + 2);
+
+        AudioSampleBuffer audio (2, 512);
+        MidiBuffer midi;
+        const int numBlocks = 200;
+        const auto renderStart = Time::getMillisecondCounterHiRes();
+        for (int i = 0; i < numBlocks; ++i)
+            graph.processBlock (audio, midi);
+        const auto renderElapsed = Time::getMillisecondCounterHiRes() - renderStart;
+        logMessage (String (numNodes) + " nodes: " + String (1000.0 * renderElapsed / numBlocks, 2) + " us per block");
+
+        graph.releaseResources();
+        graph.clear();
+    }
+};
+
+static GraphRebuildBenchmark sGraphRebuildBenchmark;
+
+}
@@ -0,0 +1,228 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+
+namespace Element {
+
+class GraphSequenceTest : public UnitTestBase
+{
+public:
+    GraphSequenceTest() : UnitTestBase ("Graph Sequence Swap", "engine", "graphSequence") { }
+    virtual ~GraphSequenceTest() { }
+
+    void runTest() override
+    {
+        testSwapWhileRendering();
+        testRemoveWhileRendering();
+        testOversizedBlocks();
+        testMidiChannels();
+        testBatchConnections();
+    }
+
+private:
+    struct RenderThread : public Thread
+    {
+        RenderThread (GraphProcessor& g) : Thread ("render"), graph (g) { }
+
+        void run() override
+        {
+            AudioSampleBuffer audio (2, 512);
+            MidiBuffer midi;
+            while (! threadShouldExit())
+            {
+                audio.clear();
+                graph.processBlock (audio, midi);
+                ++numBlocks;
+            }
+        }
+
+        GraphProcessor& graph;
+        std::atomic<int> numBlocks { 0 };
+    };
+
+    void testSwapWhileRendering()
+    {
+        beginTest ("swap sequences while rendering");
+        GraphProcessor graph;
+        graph.setPlayConfigDetails (2, 2, 44100.0, 512);
+        graph.prepareToPlay (44100.0, 512);
+
+        NodeObjectPtr input = graph.addNode (new GraphProcessor::AudioGraphIOProcessor (
+            GraphProcessor::AudioGraphIOProcessor::audioInputNode));
+        NodeObjectPtr output = graph.addNode (new GraphProcessor::AudioGraphIOProcessor (
+            GraphProcessor::AudioGraphIOProcessor::audioOutputNode));
+        graph.handleUpdateNowIfNeeded();
+
+        RenderThread thread (graph);
+        thread.startThread();
+
+        for (int i = 0; i < 100; ++i)
+        {
+            NodeObjectPtr node = graph.addNode (new VolumeProcessor (-30.0, 12.0, true));
+            input->connectAudioTo (node);
+            node->connectAudioTo (output);
+            graph.handleUpdateNowIfNeeded();
+            graph.reset();
+            graph.setVelocityCurveMode (static_cast<VelocityCurve::Mode> (i % VelocityCurve::numModes));
+            graph.removeNode (node->nodeId);
+            graph.handleUpdateNowIfNeeded();
+        }
+
+        thread.stopThread (1000);
+        expect (thread.numBlocks.load() > 0);
+
+        graph.releaseResources();
+        graph.clear();
+    }
+
+    void testRemoveWhileRendering()
+    {
+        beginTest ("removed nodes stay attached until the sequence is replaced");
+        GraphProcessor graph;
+        graph.setPlayConfigDetails (2, 2, 44100.0, 512);
+        graph.prepareToPlay (44100.0, 512);
+
+        NodeObjectPtr input = graph.addNode (new GraphProcessor::AudioGraphIOProcessor (
+            GraphProcessor::AudioGraphIOProcessor::audioInputNode));
+        NodeObjectPtr output = graph.addNode (new GraphProcessor::AudioGraphIOProcessor (
+            GraphProcessor::AudioGraphIOProcessor::audioOutputNode));
+        input->connectAudioTo (output);
+        graph.handleUpdateNowIfNeeded();
+
+        AudioSampleBuffer audio (2, 512);
+        MidiBuffer midi;
+        graph.processBlock (audio, midi);
+
+        // the old sequence with the output node in it is still the active one
+        graph.removeNode (output->nodeId);
+        expect (output->getParentGraph() == &graph);
+        graph.processBlock (audio, midi);
+
+        beginTest ("stopped graphs free old sequences");
+        graph.releaseResources();
+        expect (output->getParentGraph() == nullptr);
+        expectEquals (output->getReferenceCount(), 1);
+        graph.clear();
+    }
+
+    void testOversizedBlocks()
+    {
+        beginTest ("split oversized blocks");
+        GraphProcessor graph;
+        graph.setPlayConfigDetails (2, 2, 44100.0, 64);
+        graph.prepareToPlay (44100.0, 64);
+
+        NodeObjectPtr input = graph.addNode (new GraphProcessor::AudioGraphIOProcessor (
+            GraphProcessor::AudioGraphIOProcessor::audioInputNode));
+        NodeObjectPtr output = graph.addNode (new GraphProcessor::AudioGraphIOProcessor (
+            GraphProcessor::AudioGraphIOProcessor::audioOutputNode));
+        NodeObjectPtr midiIn = graph.addNode (new GraphProcessor::AudioGraphIOProcessor (
+            GraphProcessor::AudioGraphIOProcessor::midiInputNode));
+        NodeObjectPtr midiOut = graph.addNode (new GraphProcessor::AudioGraphIOProcessor (
+            GraphProcessor::AudioGraphIOProcessor::midiOutputNode));
+        input->connectAudioTo (output);
+        graph.addConnection (midiIn->nodeId, midiIn->getPortForChannel (PortType::Midi, 0, false),
+                             midiOut->nodeId, midiOut->getPortForChannel (PortType::Midi, 0, true));
+        graph.handleUpdateNowIfNeeded();
+
+        AudioSampleBuffer audio (2, 1000);
+        for (int ch = 0; ch < 2; ++ch)
+            for (int i = 0; i < audio.getNumSamples(); ++i)
+                audio.setSample (ch, i, (float) i / 1000.f);
+
+        MidiBuffer midi;
+        midi.addEvent (MidiMessage::noteOn (1, 60, 1.f), 10);
+        midi.addEvent (MidiMessage::noteOff (1, 60), 900);
+
+        graph.processBlock (audio, midi);
+
+        for (int ch = 0; ch < 2; ++ch)
+            for (int i = 0; i < audio.getNumSamples(); ++i)
+                expectEquals (audio.getSample (ch, i), (float) i / 1000.f);
+
+        expectEquals (midi.getNumEvents(), 2);
+        expectEquals (midi.getFirstEventTime(), 10);
+        expectEquals (midi.getLastEventTime(), 900);
+
+        graph.releaseResources();
+        graph.clear();
+    }
+
+    void testMidiChannels()
+    {
+        beginTest ("midi channels");
+        GraphProcessor graph;
+        graph.setMidiChannel (3);
+        expect (graph.acceptsMidiChannel (3));
+
+        graph.setMidiChannel (0);
+        expect (graph.acceptsMidiChannel (5));
+    }
+
+    static void addAudioArcs (Array<Arc>& arcs, NodeObject* source, NodeObject* dest)
+    {
+        for (int ch = 0; ch < 2; ++ch)
+            arcs.add (Arc (source->nodeId, source->getPortForChannel (PortType::Audio, ch, false),
+                           dest->nodeId, dest->getPortForChannel (PortType::Audio, ch, true)));
+    }
+
+    void testBatchConnections()
+    {
+        beginTest ("batch connections");
+        GraphProcessor graph;
+        graph.setPlayConfigDetails (2, 2, 44100.0, 512);
+        graph.prepareToPlay (44100.0, 512);
+
+        // added backwards so every connection needs the order changed
+        NodeObjectPtr output = graph.addNode (new GraphProcessor::AudioGraphIOProcessor (
+            GraphProcessor::AudioGraphIOProcessor::audioOutputNode));
+        NodeObjectPtr second = graph.addNode (new VolumeProcessor (-30.0, 12.0, true));
+        NodeObjectPtr first = graph.addNode (new VolumeProcessor (-30.0, 12.0, true));
+        NodeObjectPtr input = graph.addNode (new GraphProcessor::AudioGraphIOProcessor (
+            GraphProcessor::AudioGraphIOProcessor::audioInputNode));
+
+        Array<Arc> arcs;
+        addAudioArcs (arcs, second, output);
+        addAudioArcs (arcs, input, first);
+        addAudioArcs (arcs, first, second);
+        addAudioArcs (arcs, second, first); // feedback, connected but ignored when ordering
+        arcs.add (Arc (input->nodeId, 0, 9999, 0));
+
+        const auto results = graph.addConnections (arcs);
+        expectEquals (results.size(), arcs.size());
+        for (int i = 0; i < arcs.size() - 1; ++i)
+            expect (results[i]);
+        expect (! results.getLast(), "connected to a missing node");
+        expectEquals (graph.getNumConnections(), 8);
+
+        ReferenceCountedArray<NodeObject> order;
+        graph.getOrderedNodes (order);
+        expect (order.indexOf (input) < order.indexOf (first));
+        expect (order.indexOf (first) < order.indexOf (second));
+        expect (order.indexOf (second) < order.indexOf (output));
+
+        graph.handleUpdateNowIfNeeded();
+        graph.releaseResources();
+        graph.clear();
+    }
+};
+
+static GraphSequenceTest sGraphSequenceTest;
+
+}
@@ -252,3 +252,94 @@ private:
 };
 
 static LuaNodeValidateTest sLuaNodeValidateTest;
+
+//=============================================================================
+static String gainScript (float gain)
+{
+    String code;
+    code << "GAIN = " << String (gain) << R"(
+function node_io_ports()
+    return { audio_ins = 1, audio_outs = 1, midi_ins = 0, midi_outs = 0 }
+end
+
+function node_params()
+    return {}
+end
+
+function node_render (a, m)
+    a:fade (GAIN, GAIN)
+end
+)";
+    return code;
+}
+
+class LuaNodeHotSwapTest : public LuaUnitTest
+{
+public:
+    LuaNodeHotSwapTest() : LuaUnitTest ("Lua Node Hot Swap", "LuaNode", "hotswap") { }
+    virtual ~LuaNodeHotSwapTest() {}
+
+    void runTest() override
+    {
+        char* oldPath = getenv ("LUA_PATH");
+        setenv ("LUA_PATH", getPath().toRawUTF8(), 1);
+
+        LuaNode::Ptr node = new LuaNode();
+        beginTest ("load");
+        auto result = node->loadScript (gainScript (0.5f));
+        expect (result.wasOk(), result.getErrorMessage());
+        node->prepareToRender (44100.0, 512);
+        renderOnes (*node);
+        expectWithinAbsoluteError (audio.getSample (0, 511), 0.5f, 0.0001f);
+
+        beginTest ("compiles in the background");
+        bool called = false;
+        node->loadScriptAsync (gainScript (1.f), [&] (Result r) { called = true; result = r; });
+        waitForCompile (*node);
+        expect (called && result.wasOk(), result.getErrorMessage());
+
+        beginTest ("crossfades to the new script");
+        renderOnes (*node);
+        expectWithinAbsoluteError (audio.getSample (0, 0), 0.5f, 0.0001f);
+        expect (audio.getSample (0, 511) > 0.5f && audio.getSample (0, 511) < 1.f);
+        renderOnes (*node);
+        expectWithinAbsoluteError (audio.getSample (0, 511), 1.f, 0.001f);
+        renderOnes (*node);
+        expectEquals (audio.getSample (0, 0), 1.f);
+
+        beginTest ("superseded loads are dropped");
+        int numCalls = 0;
+        node->loadScriptAsync (gainScript (0.25f), [&] (Result) { ++numCalls; });
+        node->loadScriptAsync (gainScript (0.75f), [&] (Result) { ++numCalls; });
+        waitForCompile (*node);
+        expectEquals (numCalls, 1);
+        for (int i = 0; i < 3; ++i)
+            renderOnes (*node);
+        expectWithinAbsoluteError (audio.getSample (0, 0), 0.75f, 0.0001f);
+
+        // retired contexts are deleted on the message thread
+        runDispatchLoop (100);
+        node->releaseResources();
+        node = nullptr;
+        setenv ("LUA_PATH", oldPath != nullptr ? oldPath : "", 1);
+    }
+
+private:
+    AudioSampleBuffer audio { 1, 512 };
+    MidiPipe midi;
+
+    void renderOnes (LuaNode& node)
+    {
+        for (int i = 0; i < audio.getNumSamples(); ++i)
+            audio.setSample (0, i, 1.f);
+        node.render (audio, midi);
+    }
+
+    void waitForCompile (LuaNode& node)
+    {
+        for (int i = 0; i < 250 && node.isCompiling(); ++i)
+            runDispatchLoop (20);
+    }
+};
+
+static LuaNodeHotSwapTest sLuaNodeHotSwapTest;
@@ -0,0 +1,97 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "Tests.h"
+#include "engine/MeterBuffer.h"
+
+namespace Element {
+
+class MeterBufferTest : public UnitTestBase
+{
+public:
+    MeterBufferTest() : UnitTestBase ("Meter Buffer", "engine", "meterBuffer") { }
+    virtual ~MeterBufferTest() { }
+
+    void runTest() override
+    {
+        testMeasure();
+        testRing();
+    }
+
+private:
+    void testMeasure()
+    {
+        beginTest ("measure");
+        HeapBlock<float> samples (103, true);
+        for (int i = 0; i < 103; ++i)
+            samples[i] = std::sin ((float) i * 0.3f) * (i % 2 == 0 ? 0.5f : -0.25f);
+        samples[57] = -0.9f;
+
+        double sum = 0.0;
+        for (int i = 0; i < 103; ++i)
+            sum += samples[i] * samples[i];
+
+        const auto level = MeterBuffer::measure (samples, 103);
+        expectWithinAbsoluteError (level.peak, 0.9f, 1.0e-6f);
+        expectWithinAbsoluteError (level.rms, (float) std::sqrt (sum / 103.0), 1.0e-5f);
+
+        const auto silent = MeterBuffer::measure (samples, 0);
+        expectEquals (silent.peak, 0.f);
+        expectEquals (silent.rms, 0.f);
+    }
+
+    void testRing()
+    {
+        beginTest ("ring");
+        MeterBuffer meter;
+        meter.prepare (2, 4);
+        expect (! meter.update());
+
+        MeterBuffer::Level level;
+        level.peak = 0.5f; level.rms = 0.3f;
+        meter.write (0, level);
+        level.peak = 0.8f; level.rms = 0.4f;
+        meter.write (1, level);
+        meter.commit();
+
+        level.peak = 0.2f; level.rms = 0.4f;
+        meter.write (0, level);
+        meter.write (1, level);
+        meter.commit();
+
+        expect (meter.update());
+        expectEquals (meter.getLevel (0).peak, 0.5f);
+        expectEquals (meter.getLevel (1).peak, 0.8f);
+        expectWithinAbsoluteError (meter.getLevel (0).rms, std::sqrt ((0.09f + 0.16f) * 0.5f), 1.0e-6f);
+        expect (! meter.update());
+
+        // frames beyond the ring capacity are dropped, not overwritten
+        for (int i = 0; i < 10; ++i)
+        {
+            meter.write (0, level);
+            meter.commit();
+        }
+        expect (meter.update());
+        expectEquals (meter.getLevel (0).peak, 0.2f);
+    }
+};
+
+static MeterBufferTest sMeterBufferTest;
+
+}
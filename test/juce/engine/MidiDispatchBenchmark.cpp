@@ -0,0 +1,162 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "Tests.h"
+#include "engine/MidiDispatchTable.h"
+
+namespace Element {
+
+class MidiDispatchBenchmark : public UnitTestBase
+{
+public:
+    MidiDispatchBenchmark() : UnitTestBase ("MIDI Dispatch", "engine", "midiDispatch") { }
+    virtual ~MidiDispatchBenchmark() { }
+
+    void runTest() override
+    {
+        testLookup();
+        for (const int size : { 128, 1024, 4096 })
+            benchmarkDispatch (size);
+    }
+
+private:
+    // stands in for a controller map handler setting a parameter
+    struct Handler
+    {
+        Handler (bool cc, int ch, int num) : isController (cc), channel (ch), number (num) { }
+        virtual ~Handler() { }
+
+        virtual bool wants (const MidiMessage& message) const
+        {
+            if (isController ? ! message.isController() : ! message.isNoteOnOrOff())
+                return false;
+            const int messageNumber = isController ? message.getControllerNumber() : message.getNoteNumber();
+            return messageNumber == number && (channel == 0 || message.getChannel() == channel);
+        }
+
+        virtual void perform (const MidiMessage& message)
+        {
+            value.store (message.isController() ? message.getControllerValue() / 127.f
+                                                 : message.getFloatVelocity());
+            ++count;
+        }
+
+        const bool isController;
+        const int channel, number;
+        std::atomic<float> value { 0.f };
+        int count = 0;
+    };
+
+    static MidiMessage randomMessage (Random& random)
+    {
+        const int channel = 1 + random.nextInt (16);
+        const int number = random.nextInt (128);
+        return random.nextBool() ? MidiMessage::controllerEvent (channel, number, random.nextInt (128))
+                                 : MidiMessage::noteOn (channel, number, (uint8) (1 + random.nextInt (127)));
+    }
+
+    static void createHandlers (OwnedArray<Handler>& handlers, int numHandlers, Random& random)
+    {
+        for (int i = 0; i < numHandlers; ++i)
+            handlers.add (new Handler (random.nextInt (4) != 0, random.nextInt (17), random.nextInt (128)));
+    }
+
+    static void buildTable (MidiDispatchTable<Handler>& table, const OwnedArray<Handler>& handlers)
+    {
+        for (auto* handler : handlers)
+            table.add (handler, handler->isController, handler->channel, handler->number);
+        table.build();
+    }
+
+    void testLookup()
+    {
+        beginTest ("lookup matches a linear scan");
+        Random random (1234);
+        OwnedArray<Handler> handlers;
+        createHandlers (handlers, 2000, random);
+        MidiDispatchTable<Handler> table;
+        buildTable (table, handlers);
+
+        for (int i = 0; i < 5000; ++i)
+        {
+            const auto message = randomMessage (random);
+            Array<Handler*> expected, actual;
+            for (auto* handler : handlers)
+                if (handler->wants (message))
+                    expected.add (handler);
+            for (auto* handler : table.lookup (message))
+                if (handler->wants (message))
+                    actual.add (handler);
+
+            expect (expected == actual, "handlers differ for " + message.getDescription());
+            expectEquals (table.lookup (message).size(), expected.size());
+        }
+
+        expectEquals (table.lookup (MidiMessage::pitchWheel (1, 1000)).size(), 0);
+
+        MidiDispatchTable<Handler> empty;
+        expectEquals (empty.lookup (MidiMessage::controllerEvent (1, 1, 1)).size(), 0);
+    }
+
+    void benchmarkDispatch (const int numHandlers)
+    {
+        beginTest ("dispatch to " + String (numHandlers) + " mappings");
+        Random random (numHandlers);
+        OwnedArray<Handler> handlers;
+        createHandlers (handlers, numHandlers, random);
+        MidiDispatchTable<Handler> table;
+        buildTable (table, handlers);
+
+        const int numMessages = 20000;
+        Array<MidiMessage> messages;
+        for (int i = 0; i < numMessages; ++i)
+            messages.add (randomMessage (random));
+
+        auto start = Time::getMillisecondCounterHiRes();
+        for (const auto& message : messages)
+            for (auto* handler : handlers)
+                if (handler->wants (message))
+                    handler->perform (message);
+        const auto scanned = Time::getMillisecondCounterHiRes() - start;
+
+        int scanCount = 0;
+        for (auto* handler : handlers)
+            scanCount += std::exchange (handler->count, 0);
+
+        start = Time::getMillisecondCounterHiRes();
+        for (const auto& message : messages)
+            for (auto* handler : table.lookup (message))
+                if (handler->wants (message))
+                    handler->perform (message);
+        const auto indexed = Time::getMillisecondCounterHiRes() - start;
+
+        int tableCount = 0;
+        for (auto* handler : handlers)
+            tableCount += handler->count;
+
+        expectEquals (tableCount, scanCount);
+        logMessage (String (numHandlers) + " mappings: "
+            + String (1000000.0 * scanned / numMessages, 1) + " ns per message scanned, "
+            + String (1000000.0 * indexed / numMessages, 1) + " ns per message indexed");
+    }
+};
+
+static MidiDispatchBenchmark sMidiDispatchBenchmark;
+
+}
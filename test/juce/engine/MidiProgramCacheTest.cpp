@@ -0,0 +1,188 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "engine/MidiProgramCache.h"
+
+namespace Element {
+
+class MidiProgramCacheTest : public UnitTestBase
+{
+public:
+    MidiProgramCacheTest() : UnitTestBase ("MIDI Program Cache", "engine", "midiProgramCache") { }
+    virtual ~MidiProgramCacheTest() { }
+
+    void runTest() override
+    {
+        dir = File::createTempFile ("midi-program-cache");
+        dir.createDirectory();
+
+        testFileNames();
+        testLoading();
+        testChanges();
+        testBackground();
+        testStats();
+
+        dir.deleteRecursively();
+    }
+
+private:
+    File dir;
+
+    bool writeProgram (const String& identifier, int program, const String& text)
+    {
+        MemoryBlock state (text.toRawUTF8(), text.getNumBytesAsUTF8());
+        ValueTree node (Tags::node);
+        node.setProperty (Tags::state, state.toBase64Encoding(), nullptr);
+        if (auto xml = std::unique_ptr<XmlElement> (node.createXml()))
+            return xml->writeToFile (MidiProgramCache::getProgramFile (dir, identifier, program), String());
+        return false;
+    }
+
+    static String toString (const std::shared_ptr<const MemoryBlock>& state)
+    {
+        return state != nullptr ? state->toString() : String();
+    }
+
+    void testFileNames()
+    {
+        beginTest ("file names");
+        expectEquals (MidiProgramCache::getProgramFile (dir, "synth", 7).getFileName(),
+                      String ("synth_007.eln"));
+        expectEquals (MidiProgramCache::getProgramFile (dir, "synth", 127).getFileName(),
+                      String ("synth_127.eln"));
+    }
+
+    void testLoading()
+    {
+        beginTest ("loading");
+        expect (writeProgram ("synth", 0, "piano"));
+        expect (writeProgram ("synth", 5, "organ"));
+        expect (writeProgram ("synth", 127, "strings"));
+        expect (writeProgram ("other", 1, "drums"));
+        expect (MidiProgramCache::getProgramFile (dir, "synth", 9).replaceWithText ("not a program"));
+
+        MidiProgramCache cache;
+        expect (cache.getState (0) == nullptr);
+        cache.setSource (dir, "synth");
+        cache.refreshNow();
+
+        expectEquals (toString (cache.getState (0)), String ("piano"));
+        expectEquals (toString (cache.getState (5)), String ("organ"));
+        expectEquals (toString (cache.getState (127)), String ("strings"));
+        expect (cache.getState (1) == nullptr);
+        expect (cache.getState (9) == nullptr);
+        expect (cache.getState (128) == nullptr);
+        expect (cache.getState (-1) == nullptr);
+        expectEquals (cache.getStats().numCached, 3);
+        expectEquals ((int) cache.getMemoryUsage(), 17);
+
+        cache.setSource (dir, "other");
+        expect (cache.getState (0) == nullptr);
+        cache.refreshNow();
+        expectEquals (toString (cache.getState (1)), String ("drums"));
+        expectEquals (cache.getStats().numCached, 1);
+    }
+
+    void testChanges()
+    {
+        beginTest ("changes");
+        MidiProgramCache cache;
+        cache.setSource (dir, "synth");
+        cache.refreshNow();
+
+        // a decoded state stays valid after its file changes
+        const auto previous = cache.getState (5);
+        expect (writeProgram ("synth", 5, "electric organ"));
+        expect (MidiProgramCache::getProgramFile (dir, "synth", 0).deleteFile());
+        expect (writeProgram ("synth", 64, "brass"));
+        cache.refreshNow();
+
+        expectEquals (toString (previous), String ("organ"));
+        expectEquals (toString (cache.getState (5)), String ("electric organ"));
+        expect (cache.getState (0) == nullptr);
+        expectEquals (toString (cache.getState (64)), String ("brass"));
+        expectEquals (cache.getStats().numCached, 3);
+    }
+
+    void testBackground()
+    {
+        beginTest ("background");
+        MidiProgramCache cache;
+        cache.setSource (dir, "synth");
+        for (int i = 0; i < 5000 && cache.getStats().numCached < 3; ++i)
+            Thread::sleep (1);
+        expectEquals (cache.getStats().numCached, 3);
+
+        expect (writeProgram ("synth", 100, "choir"));
+        cache.refresh();
+        for (int i = 0; i < 5000 && cache.getStats().numCached < 4; ++i)
+            Thread::sleep (1);
+        expectEquals (toString (cache.getState (100)), String ("choir"));
+
+        beginTest ("background with a shared folder");
+        MidiProgramCache synth, other;
+        synth.setSource (dir, "synth");
+        other.setSource (dir, "other");
+        for (int i = 0; i < 5000 && (synth.getStats().numCached < 4 || other.getStats().numCached < 1); ++i)
+            Thread::sleep (1);
+        expectEquals (toString (synth.getState (100)), String ("choir"));
+        expectEquals (toString (other.getState (1)), String ("drums"));
+    }
+
+    void testStats()
+    {
+        beginTest ("stats");
+        MidiProgramCache cache;
+        cache.setSource (dir, "synth");
+        cache.refreshNow();
+
+        cache.getState (5);
+        cache.getState (64);
+        cache.getState (2);
+        cache.addLatency (1.0);
+        cache.addLatency (3.0);
+
+        const auto stats = cache.getStats();
+        expectEquals ((int) stats.hits, 2);
+        expectEquals ((int) stats.misses, 1);
+        expectEquals ((int) stats.numChanges, 2);
+        expectWithinAbsoluteError (stats.averageLatencyMs, 2.0, 0.0001);
+        expectWithinAbsoluteError (stats.maxLatencyMs, 3.0, 0.0001);
+
+        // time to decode every program from disk versus reading them back
+        const int64 start = Time::getHighResolutionTicks();
+        {
+            MidiProgramCache cold;
+            cold.setSource (dir, "synth");
+            cold.refreshNow();
+        }
+        const double decodeMs = 1000.0 * Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start);
+
+        const int64 lookupStart = Time::getHighResolutionTicks();
+        for (int program = 0; program < 128; ++program)
+            cache.getState (program);
+        const double lookupMs = 1000.0 * Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - lookupStart);
+
+        logMessage ("decode all: " + String (decodeMs, 3) + " ms, lookup all: " + String (lookupMs, 3) + " ms");
+    }
+};
+
+static MidiProgramCacheTest sMidiProgramCacheTest;
+
+}
@@ -0,0 +1,227 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "engine/nodes/AudioFilePlayerNode.h"
+#include "engine/nodes/LuaNode.h"
+#include "engine/nodes/MediaPlayerProcessor.h"
+#include "engine/nodes/ScriptNode.h"
+
+namespace Element {
+
+/** Passes audio through and reports a tail. It can also echo a pulse every
+    few blocks after its input stops, like a delay with sparse repeats.
+ */
+class TailProcessor : public BaseProcessor
+{
+public:
+    TailProcessor (int tailBlocks, int echoInterval = 0, int numEchoes = 0)
+        : BaseProcessor (BusesProperties()
+            .withInput  ("Main", AudioChannelSet::stereo(), true)
+            .withOutput ("Main", AudioChannelSet::stereo(), true)),
+          tail (tailBlocks), interval (echoInterval), echoes (numEchoes)
+    { }
+
+    const String getName() const override { return "Tail"; }
+
+    void fillInPluginDescription (PluginDescription& desc) const override
+    {
+        desc.name               = getName();
+        desc.fileOrIdentifier   = "element.test.tail";
+        desc.numInputChannels   = 2;
+        desc.numOutputChannels  = 2;
+        desc.isInstrument       = false;
+        desc.pluginFormatName   = "Element";
+    }
+
+    void prepareToPlay (double sampleRate, int blockSize) override
+    {
+        setPlayConfigDetails (2, 2, sampleRate, blockSize);
+    }
+
+    void releaseResources() override { }
+
+    void processBlock (AudioBuffer<float>& buffer, MidiBuffer&) override
+    {
+        ++numBlocks;
+        blocksSinceInput = buffer.getMagnitude (0, buffer.getNumSamples()) > 0.f
+            ? 0 : blocksSinceInput + 1;
+
+        if (interval > 0 && blocksSinceInput > 0 && blocksSinceInput % interval == 0
+            && blocksSinceInput / interval <= echoes)
+        {
+            for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+                buffer.setSample (ch, 0, 0.5f);
+        }
+    }
+
+    double getTailLengthSeconds() const override
+    {
+        return getSampleRate() > 0.0 ? (double) (tail * getBlockSize()) / getSampleRate() : 0.0;
+    }
+
+    bool acceptsMidi() const override               { return false; }
+    bool producesMidi() const override              { return false; }
+    AudioProcessorEditor* createEditor() override   { return nullptr; }
+    bool hasEditor() const override                 { return false; }
+
+    int getNumPrograms() override                               { return 1; }
+    int getCurrentProgram() override                            { return 0; }
+    void setCurrentProgram (int) override                       { }
+    const String getProgramName (int) override                  { return String(); }
+    void changeProgramName (int, const String&) override        { }
+    void getStateInformation (MemoryBlock&) override            { }
+    void setStateInformation (const void*, int) override        { }
+
+    int numBlocks = 0;
+
+private:
+    const int tail, interval, echoes;
+    int blocksSinceInput = 0;
+};
+
+class NodeSleepTest : public UnitTestBase
+{
+public:
+    NodeSleepTest() : UnitTestBase ("Node Sleeping", "engine", "sleep") { }
+    virtual ~NodeSleepTest() { }
+
+    void runTest() override
+    {
+        graph.reset (new GraphProcessor());
+        testTail();
+        testZeroTail();
+        testEchoes();
+        testGenerators();
+        graph = nullptr;
+    }
+
+private:
+    static constexpr int blockSize = 512;
+    // blocks in a row a node's output must be quiet after its tail
+    static constexpr int quietBlocks = 8;
+
+    std::unique_ptr<GraphProcessor> graph;
+    AudioSampleBuffer audio { 2, blockSize };
+    MidiBuffer midi;
+
+    TailProcessor* buildGraph (TailProcessor* tail)
+    {
+        graph->setPlayConfigDetails (2, 2, 44100.0, blockSize);
+        graph->prepareToPlay (44100.0, blockSize);
+
+        NodeObjectPtr input = graph->addNode (new GraphProcessor::AudioGraphIOProcessor (
+            GraphProcessor::AudioGraphIOProcessor::audioInputNode));
+        NodeObjectPtr output = graph->addNode (new GraphProcessor::AudioGraphIOProcessor (
+            GraphProcessor::AudioGraphIOProcessor::audioOutputNode));
+        NodeObjectPtr node = graph->addNode (tail);
+        input->connectAudioTo (node);
+        node->connectAudioTo (output);
+        graph->handleUpdateNowIfNeeded();
+        expect (node->canSleep() == (tail->getTailLengthSeconds() > 0.0));
+        return tail;
+    }
+
+    void clearGraph()
+    {
+        graph->releaseResources();
+        graph->clear();
+    }
+
+    /** Renders a block of signal or silence, returns the output's peak */
+    float render (bool signal)
+    {
+        for (int ch = 0; ch < 2; ++ch)
+            for (int i = 0; i < blockSize; ++i)
+                audio.setSample (ch, i, signal ? std::sin ((float) i * 0.01f * (float) (ch + 1)) : 0.f);
+        midi.clear();
+        graph->processBlock (audio, midi);
+        return jmax (audio.getMagnitude (0, 0, blockSize), audio.getMagnitude (1, 0, blockSize));
+    }
+
+    void testTail()
+    {
+        beginTest ("sleeps only after its tail");
+        auto* const tail = buildGraph (new TailProcessor (4));
+        render (true);
+        expectEquals (tail->numBlocks, 1);
+
+        for (int block = 0; block < 64; ++block)
+            expectEquals (render (false), 0.f);
+        const int numAwake = tail->numBlocks - 1;
+        expect (numAwake >= 4 + quietBlocks, "slept before its tail played out");
+        expect (numAwake < 64, "never went to sleep");
+
+        render (false);
+        expectEquals (tail->numBlocks - 1, numAwake, "rendered while asleep");
+
+        beginTest ("wakes on the next non-silent input");
+        expect (render (true) > 0.f, "the first block after waking was silent");
+        expectEquals (tail->numBlocks - 1, numAwake + 1);
+        clearGraph();
+    }
+
+    void testZeroTail()
+    {
+        beginTest ("a zero tail never sleeps");
+        auto* const tail = buildGraph (new TailProcessor (0));
+        render (true);
+        for (int block = 0; block < 64; ++block)
+            render (false);
+        expectEquals (tail->numBlocks, 65);
+        clearGraph();
+    }
+
+    void testEchoes()
+    {
+        beginTest ("quiet gaps between echoes don't end the tail");
+        // the tail is one block, but the echoes keep coming for 24
+        auto* const tail = buildGraph (new TailProcessor (1, 6, 4));
+        render (true);
+
+        int numEchoes = 0;
+        for (int block = 0; block < 64; ++block)
+            if (render (false) > 0.f)
+                ++numEchoes;
+
+        expectEquals (numEchoes, 4);
+        expect (tail->numBlocks - 1 < 64, "never went to sleep after the last echo");
+        clearGraph();
+    }
+
+    void testGenerators()
+    {
+        beginTest ("players and scripts never sleep");
+        graph->setPlayConfigDetails (2, 2, 44100.0, blockSize);
+        graph->prepareToPlay (44100.0, blockSize);
+        NodeObjectPtr filePlayer = graph->addNode (new AudioFilePlayerNode());
+        NodeObjectPtr mediaPlayer = graph->addNode (new MediaPlayerProcessor());
+        expect (! filePlayer->canSleep());
+        expect (! mediaPlayer->canSleep());
+        clearGraph();
+
+        LuaNode::Ptr lua = new LuaNode();
+        expect (! lua->canSleep());
+        ScriptNode::Ptr script = new ScriptNode();
+        expect (! script->canSleep());
+    }
+};
+
+static NodeSleepTest sNodeSleepTest;
+
+}
@@ -0,0 +1,167 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "Tests.h"
+#include "engine/OfflineRenderer.h"
+
+namespace Element {
+
+class OfflineRendererTest : public UnitTestBase
+{
+public:
+    OfflineRendererTest() : UnitTestBase ("Offline Renderer", "engine", "offlineRenderer") { }
+    virtual ~OfflineRendererTest() { }
+
+    void runTest() override
+    {
+        Globals world;
+        world.setEngine (new AudioEngine (world, RunMode::Offline));
+        auto engine = world.getAudioEngine();
+
+        RootGraph graph;
+        graph.setPlayConfigDetails (2, 2, sampleRate, 512);
+        NodeObjectPtr input = graph.addNode (new IOProcessor (IOProcessor::audioInputNode));
+        NodeObjectPtr output = graph.addNode (new IOProcessor (IOProcessor::audioOutputNode));
+        input->connectAudioTo (output);
+        engine->addGraph (&graph);
+        engine->setActiveGraph (0);
+
+        const auto dir = File::createTempFile ("offline-render");
+        dir.createDirectory();
+        const auto inputFile = dir.getChildFile ("input.wav");
+        writeInput (inputFile);
+
+        testRender (*engine, inputFile, dir);
+        testErrors (*engine, inputFile, dir);
+
+        engine->removeGraph (&graph);
+        graph.clear();
+        world.setEngine (nullptr);
+        dir.deleteRecursively();
+    }
+
+private:
+    static constexpr double sampleRate = 48000.0;
+    static constexpr int numFrames = 30000;
+
+    static float getInputSample (int channel, int frame)
+    {
+        return 0.5f * std::sin ((float) frame * 0.01f * (float) (channel + 1));
+    }
+
+    void writeInput (const File& file)
+    {
+        AudioSampleBuffer audio (2, numFrames);
+        for (int ch = 0; ch < 2; ++ch)
+            for (int i = 0; i < numFrames; ++i)
+                audio.setSample (ch, i, getInputSample (ch, i));
+
+        WavAudioFormat wav;
+        std::unique_ptr<AudioFormatWriter> writer (wav.createWriterFor (
+            new FileOutputStream (file), sampleRate, 2, 32, {}, 0));
+        expect (writer != nullptr);
+        if (writer != nullptr)
+            writer->writeFromAudioSampleBuffer (audio, 0, numFrames);
+    }
+
+    void testRender (AudioEngine& engine, const File& inputFile, const File& dir)
+    {
+        beginTest ("render passes input through");
+        OfflineRenderer renderer (engine);
+        OfflineRenderer::Options options;
+        options.sampleRate = sampleRate;
+        options.blockSize = 480; // doesn't divide the input evenly
+        options.inputFiles.add (inputFile);
+        options.tailSeconds = 0.1;
+        options.bitDepth = 32;
+
+        AudioSampleBuffer renders[2];
+        for (int i = 0; i < 2; ++i)
+        {
+            options.outputFile = dir.getChildFile ("output" + String (i) + ".wav");
+            const auto result = renderer.render (options);
+            expect (result.wasOk(), result.getErrorMessage());
+
+            const int expectedFrames = numFrames + roundToInt (0.1 * sampleRate);
+            expectWithinAbsoluteError (renderer.getRenderedSeconds(), expectedFrames / sampleRate, 1.0e-9);
+            readOutput (options.outputFile, renders[i]);
+            expectEquals (renders[i].getNumSamples(), expectedFrames);
+        }
+
+        if (renders[0].getNumSamples() < numFrames || renders[1].getNumSamples() != renders[0].getNumSamples())
+            return;
+
+        bool matchesInput = true, deterministic = true;
+        for (int ch = 0; ch < 2; ++ch)
+        {
+            for (int i = 0; i < renders[0].getNumSamples(); ++i)
+            {
+                const float expected = i < numFrames ? getInputSample (ch, i) : 0.f;
+                matchesInput = matchesInput && std::abs (renders[0].getSample (ch, i) - expected) < 1.0e-6f;
+                deterministic = deterministic && renders[0].getSample (ch, i) == renders[1].getSample (ch, i);
+            }
+        }
+
+        expect (matchesInput, "output doesn't match the input");
+        expect (deterministic, "renders differ");
+        logMessage ("rendered at " + String (renderer.getRealtimeFactor(), 1) + "x realtime");
+    }
+
+    void testErrors (AudioEngine& engine, const File& inputFile, const File& dir)
+    {
+        beginTest ("invalid options fail");
+        OfflineRenderer renderer (engine);
+        OfflineRenderer::Options options;
+        options.sampleRate = sampleRate;
+        options.lengthSeconds = 0.1;
+
+        options.outputFile = dir.getChildFile ("output.xyz");
+        expect (renderer.render (options).failed(), "unknown format rendered");
+
+        options.outputFile = dir.getChildFile ("output.wav");
+        options.bitDepth = 13;
+        expect (renderer.render (options).failed(), "invalid bit depth rendered");
+
+        options.bitDepth = 16;
+        options.inputFiles.add (dir.getChildFile ("missing.wav"));
+        expect (renderer.render (options).failed(), "missing input rendered");
+
+        options.inputFiles.clearQuick();
+        options.inputFiles.add (inputFile);
+        options.sampleRate = 44100.0;
+        expect (renderer.render (options).failed(), "mismatched sample rate rendered");
+    }
+
+    void readOutput (const File& file, AudioSampleBuffer& audio)
+    {
+        AudioFormatManager formats;
+        formats.registerBasicFormats();
+        std::unique_ptr<AudioFormatReader> reader (formats.createReaderFor (file));
+        expect (reader != nullptr);
+        if (reader == nullptr)
+            return;
+
+        audio.setSize ((int) reader->numChannels, (int) reader->lengthInSamples);
+        reader->read (&audio, 0, audio.getNumSamples(), 0, true, true);
+    }
+};
+
+static OfflineRendererTest sOfflineRendererTest;
+
+}
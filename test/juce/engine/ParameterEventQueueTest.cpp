@@ -0,0 +1,142 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "Tests.h"
+#include "engine/ParameterEventQueue.h"
+
+namespace Element {
+
+class ParameterEventQueueTest : public UnitTestBase
+{
+public:
+    ParameterEventQueueTest() : UnitTestBase ("Parameter Event Queue", "engine", "parameterEventQueue") { }
+    virtual ~ParameterEventQueueTest() { }
+
+    void runTest() override
+    {
+        testOrder();
+        testProducers();
+    }
+
+private:
+    static ParameterEventQueue::Event makeEvent (int parameter, float value, int frame)
+    {
+        ParameterEventQueue::Event event;
+        event.parameter = parameter;
+        event.value = value;
+        event.frame = frame;
+        return event;
+    }
+
+    void testOrder()
+    {
+        beginTest ("order and capacity");
+        ParameterEventQueue queue (5);
+        expectEquals (queue.getCapacity(), 8);
+
+        ParameterEventQueue::Event event;
+        expect (! queue.pop (event));
+
+        for (int round = 0; round < 3; ++round)
+        {
+            for (int i = 0; i < queue.getCapacity(); ++i)
+                expect (queue.push (makeEvent (i, (float) i * 0.1f, i * 8)));
+            expect (! queue.push (makeEvent (99, 0.f, 0)), "pushed to a full queue");
+
+            for (int i = 0; i < queue.getCapacity(); ++i)
+            {
+                expect (queue.pop (event));
+                expectEquals (event.parameter, i);
+                expectEquals (event.frame, i * 8);
+                expectEquals (event.value, (float) i * 0.1f);
+            }
+
+            expect (! queue.pop (event));
+        }
+
+        queue.push (makeEvent (1, 1.f, 0));
+        queue.clear();
+        expect (! queue.pop (event));
+    }
+
+    void testProducers()
+    {
+        beginTest ("multiple producers");
+        static constexpr int numProducers = 4;
+        static constexpr int numPerProducer = 5000;
+        ParameterEventQueue queue (64);
+        std::atomic<bool> go { false };
+
+        OwnedArray<Thread> producers;
+        struct Producer : public Thread
+        {
+            Producer (ParameterEventQueue& q, std::atomic<bool>& g, int i)
+                : Thread ("producer"), queue (q), go (g), index (i) { }
+
+            void run() override
+            {
+                while (! go.load())
+                    Thread::yield();
+
+                for (int i = 0; i < numPerProducer;)
+                    if (queue.push (makeEvent (index, 0.f, i)))
+                        ++i;
+            }
+
+            ParameterEventQueue& queue;
+            std::atomic<bool>& go;
+            const int index;
+        };
+
+        for (int i = 0; i < numProducers; ++i)
+            producers.add (new Producer (queue, go, i))->startThread();
+        go.store (true);
+
+        int lastFrame[numProducers] = { -1, -1, -1, -1 };
+        int received = 0;
+        bool ordered = true;
+        ParameterEventQueue::Event event;
+
+        while (received < numProducers * numPerProducer)
+        {
+            if (! queue.pop (event))
+            {
+                Thread::yield();
+                continue;
+            }
+
+            // each producer's events arrive in the order it pushed them
+            ordered = ordered && event.frame == lastFrame[event.parameter] + 1;
+            lastFrame[event.parameter] = event.frame;
+            ++received;
+        }
+
+        for (auto* producer : producers)
+            producer->waitForThreadToExit (1000);
+
+        expect (ordered);
+        expect (! queue.pop (event));
+        for (int i = 0; i < numProducers; ++i)
+            expectEquals (lastFrame[i], numPerProducer - 1);
+    }
+};
+
+static ParameterEventQueueTest sParameterEventQueueTest;
+
+}
@@ -0,0 +1,252 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "engine/RenderThreadPool.h"
+
+namespace Element {
+
+class RenderThreadPoolTest : public UnitTestBase
+{
+public:
+    RenderThreadPoolTest() : UnitTestBase ("Render Thread Pool", "engine", "renderThreadPool") { }
+    virtual ~RenderThreadPoolTest() { }
+
+    void runTest() override
+    {
+        testWork();
+        testGraphRendering();
+        testRootGraphs();
+    }
+
+private:
+    /** Volume node which records if it ever ran on one of the pool's workers */
+    struct WorkerVolume : public VolumeProcessor
+    {
+        WorkerVolume (std::atomic<bool>& flag)
+            : VolumeProcessor (-30.0, 12.0, true), ranOnWorker (flag) { }
+
+        void processBlock (AudioBuffer<float>& buffer, MidiBuffer& midi) override
+        {
+            if (RenderThreadPool::isWorkerThread())
+                ranOnWorker.store (true);
+            VolumeProcessor::processBlock (buffer, midi);
+        }
+
+        std::atomic<bool>& ranOnWorker;
+    };
+
+    struct CountingWork : public RenderThreadPool::Work
+    {
+        CountingWork (int total) : numJobs (total) { }
+
+        bool performNextJob() noexcept override
+        {
+            if (next.fetch_add (1) >= numJobs)
+                return false;
+            ++done;
+            return true;
+        }
+
+        bool isFinished() const noexcept override { return done.load() >= numJobs; }
+
+        const int numJobs;
+        std::atomic<int> next { 0 };
+        std::atomic<int> done { 0 };
+    };
+
+    void testWork()
+    {
+        beginTest ("perform work");
+        RenderThreadPool pool;
+        CountingWork idle (10);
+        expect (! pool.perform (idle), "performed without any threads");
+
+        pool.start (3);
+        expectEquals (pool.getNumThreads(), 3);
+
+        for (int i = 0; i < 100; ++i)
+        {
+            CountingWork work (64);
+            expect (pool.perform (work));
+            expectEquals (work.done.load(), 64);
+        }
+
+        pool.stop();
+        expect (! pool.isRunning());
+    }
+
+    void renderGraph (GraphProcessor& graph, AudioSampleBuffer& audio)
+    {
+        MidiBuffer midi;
+        for (int ch = 0; ch < audio.getNumChannels(); ++ch)
+            for (int i = 0; i < audio.getNumSamples(); ++i)
+                audio.setSample (ch, i, std::sin ((float) i * 0.01f * (float) (ch + 1)));
+        graph.processBlock (audio, midi);
+    }
+
+    void buildGraph (GraphProcessor& graph)
+    {
+        graph.setPlayConfigDetails (2, 2, 44100.0, 512);
+        graph.prepareToPlay (44100.0, 512);
+
+        NodeObjectPtr input = graph.addNode (new GraphProcessor::AudioGraphIOProcessor (
+            GraphProcessor::AudioGraphIOProcessor::audioInputNode));
+        NodeObjectPtr output = graph.addNode (new GraphProcessor::AudioGraphIOProcessor (
+            GraphProcessor::AudioGraphIOProcessor::audioOutputNode));
+
+        for (int i = 0; i < 8; ++i)
+        {
+            NodeObjectPtr first = graph.addNode (new VolumeProcessor (-30.0, 12.0, true));
+            NodeObjectPtr second = graph.addNode (new VolumeProcessor (-30.0, 12.0, true));
+            input->connectAudioTo (first);
+            first->connectAudioTo (second);
+            second->connectAudioTo (output);
+        }
+
+        graph.handleUpdateNowIfNeeded();
+    }
+
+    void testGraphRendering()
+    {
+        beginTest ("multi-core graph matches serial");
+        RenderThreadPool pool;
+        pool.start (3);
+
+        GraphProcessor serial, parallel;
+        buildGraph (serial);
+        parallel.setRenderThreadPool (&pool);
+        parallel.setMultiCoreRendering (true);
+        buildGraph (parallel);
+        expect (parallel.hasParallelPlan(), "no parallel plan was built");
+        expect (! serial.hasParallelPlan());
+
+        AudioSampleBuffer expected (2, 512), actual (2, 512);
+        for (int block = 0; block < 16; ++block)
+        {
+            renderGraph (serial, expected);
+            renderGraph (parallel, actual);
+
+            for (int ch = 0; ch < 2; ++ch)
+                for (int i = 0; i < 512; ++i)
+                    expectWithinAbsoluteError (actual.getSample (ch, i), expected.getSample (ch, i), 1.0e-6f);
+        }
+
+        // workers may still be waking up for the first blocks, but with eight
+        // branches they have to pick up some jobs before long
+        for (int block = 0; block < 1000 && pool.getNumWorkerJobs() <= 0; ++block)
+            renderGraph (parallel, actual);
+        expect (pool.getNumWorkerJobs() > 0, "no jobs ran on the pool's workers");
+
+        parallel.setRenderThreadPool (nullptr);
+        parallel.handleUpdateNowIfNeeded();
+        serial.releaseResources();
+        parallel.releaseResources();
+        serial.clear();
+        parallel.clear();
+        pool.stop();
+    }
+
+    void buildRootGraph (RootGraph& graph, int numVolumes, std::atomic<bool>& ranOnWorker)
+    {
+        graph.setPlayConfigDetails (2, 2, 44100.0, 512);
+        NodeObjectPtr input = graph.addNode (new IOProcessor (IOProcessor::audioInputNode));
+        NodeObjectPtr output = graph.addNode (new IOProcessor (IOProcessor::audioOutputNode));
+        NodeObjectPtr last = input;
+        for (int i = 0; i < numVolumes; ++i)
+        {
+            NodeObjectPtr volume = graph.addNode (new WorkerVolume (ranOnWorker));
+            last->connectAudioTo (volume);
+            last = volume;
+        }
+        last->connectAudioTo (output);
+    }
+
+    void testRootGraphs()
+    {
+        beginTest ("parallel root graphs on the pool match serial");
+        Globals world;
+        world.setEngine (new AudioEngine (world, RunMode::Offline));
+        auto engine = world.getAudioEngine();
+        std::atomic<bool> ranOnWorker { false }, unused { false };
+
+        RootGraph graphA, graphB;
+        buildRootGraph (graphA, 1, ranOnWorker);
+        buildRootGraph (graphB, 2, ranOnWorker);
+        engine->addGraph (&graphA);
+        engine->addGraph (&graphB);
+        engine->setActiveGraph (0);
+        engine->prepareExternalPlayback (44100.0, 512, 2, 2);
+        expect (! graphA.isSingle() && ! graphB.isSingle(), "root graphs aren't parallel");
+
+        // the same graphs rendered one after the other on this thread
+        RootGraph serialA, serialB;
+        buildRootGraph (serialA, 1, unused);
+        buildRootGraph (serialB, 2, unused);
+        serialA.prepareToPlay (44100.0, 512);
+        serialB.prepareToPlay (44100.0, 512);
+        serialA.handleUpdateNowIfNeeded();
+        serialB.handleUpdateNowIfNeeded();
+
+        MidiBuffer midi;
+        AudioSampleBuffer actual (2, 512), expectedA (2, 512), expectedB (2, 512);
+        for (int block = 0; block < 16; ++block)
+        {
+            midi.clear();
+            renderGraph (serialA, expectedA);
+            renderGraph (serialB, expectedB);
+            for (int ch = 0; ch < 2; ++ch)
+                expectedA.addFrom (ch, 0, expectedB, ch, 0, 512);
+
+            for (int ch = 0; ch < 2; ++ch)
+                for (int i = 0; i < 512; ++i)
+                    actual.setSample (ch, i, std::sin ((float) i * 0.01f * (float) (ch + 1)));
+            engine->processExternalBuffers (actual, midi);
+
+            for (int ch = 0; ch < 2; ++ch)
+                for (int i = 0; i < 512; ++i)
+                    expectWithinAbsoluteError (actual.getSample (ch, i), expectedA.getSample (ch, i), 1.0e-6f);
+        }
+
+        // a single core machine has no workers, the engine renders serially then
+        if (SystemStats::getNumCpus() > 1)
+        {
+            for (int block = 0; block < 1000 && ! ranOnWorker.load(); ++block)
+            {
+                midi.clear();
+                engine->processExternalBuffers (actual, midi);
+            }
+            expect (ranOnWorker.load(), "no root graph was rendered on the pool's workers");
+        }
+
+        engine->releaseExternalResources();
+        engine->removeGraph (&graphA);
+        engine->removeGraph (&graphB);
+        graphA.clear();
+        graphB.clear();
+        serialA.releaseResources();
+        serialB.releaseResources();
+        serialA.clear();
+        serialB.clear();
+        world.setEngine (nullptr);
+    }
+};
+
+static RenderThreadPoolTest sRenderThreadPoolTest;
+
+}
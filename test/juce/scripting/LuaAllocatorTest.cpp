@@ -0,0 +1,161 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "sol/sol.hpp"
+#include "scripting/LuaAllocator.h"
+
+using namespace Element;
+
+static const String sGarbage = R"(
+function make_garbage()
+    local t = {}
+    for i = 1, 64 do
+        t[i] = { i, tostring (i) }
+    end
+    return #t
+end
+)";
+
+//=============================================================================
+class LuaAllocatorTest : public UnitTestBase
+{
+public:
+    LuaAllocatorTest() : UnitTestBase ("Lua Allocator", "LuaAllocator", "arena") { }
+    virtual ~LuaAllocatorTest() { }
+
+    void runTest() override
+    {
+        testArena();
+        testBoundedCollection();
+        testFallback();
+        testGrowth();
+    }
+
+private:
+    void testArena()
+    {
+        beginTest ("arena");
+        LuaAllocator allocator;
+        {
+            sol::state lua (sol::default_at_panic, LuaAllocator::allocate, &allocator);
+            LuaAllocator::attach (lua);
+            lua.open_libraries (sol::lib::base, sol::lib::string, sol::lib::table);
+            lua.script (sGarbage.toRawUTF8());
+            expectEquals ((int) lua["make_garbage"]().get<int>(), 64);
+
+            const auto stats = allocator.getStats();
+            expect (stats.arenaBytes > 0);
+            expect (stats.arenaBytes <= (size_t) EL_LUA_ARENA_CHUNK_SIZE);
+            expect (stats.usedBytes > 0);
+            expect (stats.highWaterBytes >= stats.usedBytes);
+            expect (stats.allocations > 0);
+            expectEquals ((int) stats.fallbacks, 0);
+
+            // strings which grow past the largest class go to malloc
+            lua.script ("big = string.rep ('x', 100000)");
+            expect (allocator.getStats().fallbacks > 0);
+            lua.script ("big = nil");
+        }
+
+        // closing the state returns everything
+        expectEquals ((int64) allocator.getStats().usedBytes, (int64) 0);
+    }
+
+    void testBoundedCollection()
+    {
+        beginTest ("bounded collection");
+        LuaAllocator allocator;
+        sol::state lua (sol::default_at_panic, LuaAllocator::allocate, &allocator);
+        LuaAllocator::attach (lua);
+        lua.open_libraries (sol::lib::base, sol::lib::string, sol::lib::table);
+        lua.script (sGarbage.toRawUTF8());
+        lua.collect_garbage();
+        const auto baseline = allocator.getStats().usedBytes;
+
+        // nothing is collected without a step
+        sol::function makeGarbage = lua["make_garbage"];
+        for (int i = 0; i < 50; ++i)
+            makeGarbage();
+        const auto grown = allocator.getStats().usedBytes;
+        expect (grown > baseline);
+        expectEquals ((int) allocator.getStats().gcSteps, 0);
+
+        // steps bring it back down without a full collection
+        for (int i = 0; i < 2000 && allocator.getStats().usedBytes > baseline + 4096; ++i)
+            allocator.stepGarbage (lua);
+
+        const auto stats = allocator.getStats();
+        expect (stats.usedBytes < grown);
+        expect (stats.gcSteps > 0);
+        expect (stats.gcMilliseconds >= stats.maxGcStepMilliseconds);
+        expectEquals ((int) stats.fallbacks, 0);
+
+        logMessage ("gc steps: " + String (stats.gcSteps)
+            + ", max step: " + String (stats.maxGcStepMilliseconds, 4) + " ms"
+            + ", high water: " + String ((int64) stats.highWaterBytes) + " bytes");
+    }
+
+    void testFallback()
+    {
+        beginTest ("fallback");
+        LuaAllocator allocator (64 * 1024);
+        {
+            sol::state lua (sol::default_at_panic, LuaAllocator::allocate, &allocator);
+            LuaAllocator::attach (lua);
+            lua.open_libraries (sol::lib::base, sol::lib::string, sol::lib::table);
+            lua.script (sGarbage.toRawUTF8());
+
+            // still works when the arena is too small, but it's counted
+            expectEquals ((int) lua["make_garbage"]().get<int>(), 64);
+            expect (allocator.getStats().fallbacks > 0);
+            expect (allocator.getStats().highWaterBytes <= allocator.getStats().arenaBytes);
+        }
+        expectEquals ((int64) allocator.getStats().usedBytes, (int64) 0);
+    }
+
+    void testGrowth()
+    {
+        beginTest ("growth");
+        LuaAllocator allocator;
+        const auto chunkBytes = allocator.getStats().arenaBytes;
+        {
+            sol::state lua (sol::default_at_panic, LuaAllocator::allocate, &allocator);
+            LuaAllocator::attach (lua);
+            lua.open_libraries (sol::lib::base, sol::lib::string, sol::lib::table);
+
+            // fill the arena a chunk at a time, adding chunks like the
+            // message thread would between blocks
+            lua.script ("held = {}");
+            for (int i = 0; i < 64 && allocator.getStats().arenaBytes < 4 * chunkBytes; ++i)
+            {
+                lua.script ("local t = {} for i = 1, 256 do t[i] = { i, i * 2, i * 3 } end held[#held + 1] = t");
+                allocator.reserve();
+            }
+
+            const auto stats = allocator.getStats();
+            expect (stats.arenaBytes > chunkBytes, "the arena didn't grow");
+            expect (stats.arenaBytes <= (size_t) EL_LUA_ARENA_SIZE);
+            expectEquals ((int) stats.fallbacks, 0);
+            lua.script ("held = nil");
+        }
+        expectEquals ((int64) allocator.getStats().usedBytes, (int64) 0);
+    }
+};
+
+static LuaAllocatorTest sLuaAllocatorTest;
@@ -0,0 +1,211 @@
+/*
+    This file is part of Element
+    Copyright (C) 2020  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "LuaUnitTest.h"
+#include "engine/DSPKernels.h"
+
+using namespace Element;
+
+static const String sFilters = R"(
+AudioBuffer = require ('kv.AudioBuffer')
+dsp = require ('el.dsp')
+
+-- the per sample filter scripts had to write before el.dsp
+function make_lowpass (rate, freq, q)
+    local w0 = 2 * math.pi * freq / rate
+    local cosw, alpha = math.cos (w0), math.sin (w0) / (2 * q)
+    local a0 = 1 + alpha
+    return {
+        b0 = (1 - cosw) * 0.5 / a0, b1 = (1 - cosw) / a0, b2 = (1 - cosw) * 0.5 / a0,
+        a1 = -2 * cosw / a0, a2 = (1 - alpha) / a0, z1 = 0, z2 = 0
+    }
+end
+
+function lua_filter (f, samples, n)
+    local b0, b1, b2, a1, a2 = f.b0, f.b1, f.b2, f.a1, f.a2
+    local z1, z2 = f.z1, f.z2
+    for i = 1, n do
+        local x = samples[i]
+        local y = b0 * x + z1
+        z1 = b1 * x - a1 * y + z2
+        z2 = b2 * x - a2 * y
+        samples[i] = y
+    end
+    f.z1, f.z2 = z1, z2
+end
+
+function lua_blocks (f, samples, n, count)
+    for _ = 1, count do lua_filter (f, samples, n) end
+end
+
+function kernel_blocks (lpf, buffer, count)
+    for _ = 1, count do lpf:process (buffer) end
+end
+)";
+
+//=============================================================================
+class LuaDSPBenchmark : public LuaUnitTest
+{
+public:
+    LuaDSPBenchmark() : LuaUnitTest ("Lua DSP", "LuaDSP", "kernels") { }
+    virtual ~LuaDSPBenchmark() { }
+
+    void runTest() override
+    {
+        lua.script (sFilters.toRawUTF8());
+        testKernels();
+        testBindings();
+        benchmark (512, 2000);
+        lua.collect_garbage();
+    }
+
+private:
+    static constexpr double sampleRate = 48000.0;
+
+    AudioBuffer<float>& newBuffer (const char* name, int numChannels, int numSamples)
+    {
+        lua.script ((String (name) + " = AudioBuffer (" + String (numChannels)
+                    + ", " + String (numSamples) + ")").toStdString());
+        sol::userdata data = lua [name];
+        auto& buffer = **(AudioBuffer<float>**) data.pointer();
+        buffer.clear();
+        return buffer;
+    }
+
+    static void fillNoise (AudioBuffer<float>& buffer)
+    {
+        Random random (1234);
+        for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+            for (int i = 0; i < buffer.getNumSamples(); ++i)
+                buffer.setSample (ch, i, random.nextFloat() * 2.f - 1.f);
+    }
+
+    void testKernels()
+    {
+        beginTest ("delay is sample accurate across blocks");
+        {
+            Kernels::Delay delay (2, 100);
+            AudioBuffer<float> buffer (2, 64);
+            int impulseAt = -1;
+            for (int block = 0; block < 4 && impulseAt < 0; ++block)
+            {
+                buffer.clear();
+                if (block == 0)
+                    buffer.setSample (1, 10, 1.f);
+                delay.process (buffer, 75, 0.f, 1.f);
+                for (int i = 0; i < 64; ++i)
+                    if (buffer.getSample (1, i) == 1.f)
+                        impulseAt = block * 64 + i;
+            }
+            expectEquals (impulseAt, 85);
+        }
+
+        beginTest ("svf lowpass attenuates highs");
+        {
+            Kernels::Oscillator osc;
+            Kernels::SVF svf;
+            AudioBuffer<float> buffer (1, 4096);
+            osc.setup (Kernels::Oscillator::sine, sampleRate, 12000.0);
+            osc.process (buffer);
+            svf.setup (Kernels::SVF::lowPass, sampleRate, 500.0, 0.707);
+            svf.process (buffer);
+            expect (buffer.getMagnitude (0, 2048, 2048) < 0.05f);
+        }
+
+        beginTest ("spectrum peak");
+        {
+            Kernels::Oscillator osc;
+            Kernels::Spectrum spectrum (10);
+            AudioBuffer<float> buffer (1, spectrum.getSize());
+            const int bin = 64;
+            osc.setup (Kernels::Oscillator::sine, sampleRate, bin * sampleRate / spectrum.getSize());
+            osc.process (buffer);
+            spectrum.process (buffer, 0);
+            expect (spectrum.getMagnitude (bin) > 10.f * spectrum.getMagnitude (bin / 2));
+            expect (spectrum.getMagnitude (bin) > 10.f * spectrum.getMagnitude (bin * 2));
+        }
+    }
+
+    void testBindings()
+    {
+        beginTest ("bindings");
+        auto& a = newBuffer ("a", 2, 256);
+        auto& b = newBuffer ("b", 2, 256);
+
+        lua.script ("osc = dsp.Oscillator(); osc:setup ('square', 48000, 440); osc:process (a, 0.5)");
+        expectWithinAbsoluteError (a.getMagnitude (0, 256), 0.5f, 0.1f);
+        expectEquals (a.getSample (1, 100), a.getSample (0, 100));
+
+        lua.script ("dsp.gain (a, 2)");
+        expectWithinAbsoluteError (a.getMagnitude (0, 256), 1.f, 0.2f);
+
+        lua.script ("dsp.matrix (b, a, { { 0, 0 }, { 1, 0 } })");
+        expectEquals (b.getMagnitude (0, 0, 256), 0.f);
+        expectEquals (b.getSample (1, 100), a.getSample (0, 100));
+
+        lua.script ("dsp.mix (b, a, -1)");
+        expectEquals (b.getMagnitude (1, 0, 256), 0.f);
+
+        lua.script ("f = dsp.Follower(); f:setup (48000, 1, 50); level = f:process (a)");
+        expect (lua["level"].get<double>() > 0.5);
+
+        sol::protected_function bad = lua.load ("dsp.Biquad():setup ('nope', 48000, 1000)");
+        expect (! bad().valid(), "bad filter types should raise an error");
+        sol::protected_function badBuffer = lua.load ("dsp.gain ({}, 1)");
+        expect (! badBuffer().valid(), "non buffers should raise an error");
+    }
+
+    void benchmark (int blockSize, int numBlocks)
+    {
+        beginTest ("per sample lua vs kernel, block size " + String (blockSize));
+        auto& buffer = newBuffer ("input", 1, blockSize);
+        fillNoise (buffer);
+
+        sol::table samples = lua.create_table (blockSize, 0);
+        for (int i = 0; i < blockSize; ++i)
+            samples[i + 1] = buffer.getSample (0, i);
+        lua["samples"] = samples;
+
+        lua.script ("ref = make_lowpass (48000, 1200, 0.707)\n"
+                    "lpf = dsp.Biquad(); lpf:setup ('lowpass', 48000, 1200, 0.707)\n"
+                    "lua_filter (ref, samples, " + std::to_string (blockSize) + ")\n"
+                    "lpf:process (input)");
+
+        float maxError = 0.f;
+        for (int i = 0; i < blockSize; ++i)
+            maxError = jmax (maxError, std::abs ((float) samples[i + 1].get<double>() - buffer.getSample (0, i)));
+        expectLessThan (maxError, 1.0e-4f);
+
+        sol::function luaBlocks = lua["lua_blocks"];
+        sol::function kernelBlocks = lua["kernel_blocks"];
+
+        auto start = Time::getHighResolutionTicks();
+        luaBlocks (lua["ref"], samples, blockSize, numBlocks);
+        const double luaMs = 1000.0 * Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start);
+
+        start = Time::getHighResolutionTicks();
+        kernelBlocks (lua["lpf"], lua["input"], numBlocks);
+        const double kernelMs = 1000.0 * Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start);
+
+        logMessage ("biquad, " + String (numBlocks) + " blocks of " + String (blockSize)
+            + ": lua " + String (luaMs, 2) + " ms, kernel " + String (kernelMs, 2)
+            + " ms (" + String (luaMs / jmax (kernelMs, 0.001), 1) + "x)");
+    }
+};
+
+static LuaDSPBenchmark sLuaDSPBenchmark;
@@ -0,0 +1,218 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "controllers/AppController.h"
+#include "controllers/EngineController.h"
+#include "engine/GraphProcessor.h"
+#include "engine/InternalFormat.h"
+#include "engine/OfflineRenderer.h"
+#include "session/PluginManager.h"
+#include "session/SessionArchive.h"
+#include "session/Session.h"
+#include "Globals.h"
+#include "Settings.h"
+
+#include <iostream>
+
+using namespace Element;
+
+static const char* usage =
+"Usage: element-render [options] <session.els>\n"
+"\n"
+"Renders a session to an audio file as fast as possible.\n"
+"\n"
+"Options:\n"
+"  -o, --output FILE    Output file, format from the extension (.wav .flac .aiff)\n"
+"  -i, --input FILE     Audio file fed to the inputs. Can be given more than once\n"
+"  -m, --midi FILE      MIDI file fed to the MIDI input\n"
+"  -r, --rate HZ        Sample rate (default 48000)\n"
+"  -b, --block SIZE     Block size (default 512)\n"
+"      --inputs N       Number of engine inputs (default 2)\n"
+"      --outputs N      Number of engine outputs (default 2)\n"
+"  -l, --length SECS    Render length. Defaults to the longest input plus the tail\n"
+"  -t, --tail SECS      Tail after the inputs end (default 2)\n"
+"  -d, --bits N         Output bit depth (default 24)\n"
+"  -g, --graph INDEX    Graph to render (default: the session's active graph)\n"
+"      --no-latency     Don't trim the engine's latency from the output\n"
+"  -q, --quiet          Only print errors\n"
+"  -h, --help           Show this help\n";
+
+static int fail (const String& message)
+{
+    std::cerr << "element-render: " << message << std::endl;
+    return 1;
+}
+
+static File getFile (const String& path)
+{
+    return File::getCurrentWorkingDirectory().getChildFile (path);
+}
+
+/** Returns true once every node in the session has been created and no
+    graph is still waiting to rebuild */
+static bool isSessionLoaded (const Session& session)
+{
+    bool loaded = true;
+    session.forEach ([&loaded] (const ValueTree& tree)
+    {
+        if (! loaded || ! tree.hasType (Tags::node))
+            return;
+
+        auto* const object = Node (tree, false).getGraphNode();
+        if (object == nullptr)
+            loaded = false;
+        else if (auto* const graph = dynamic_cast<GraphProcessor*> (object->getAudioProcessor()))
+            loaded = ! graph->isUpdatePending();
+    });
+
+    return loaded;
+}
+
+int main (int argc, char** argv)
+{
+    ScopedJuceInitialiser_GUI juce;
+
+    OfflineRenderer::Options options;
+    File sessionFile;
+    int graphIndex = -1;
+    bool quiet = false;
+
+    StringArray args;
+    for (int i = 1; i < argc; ++i)
+        args.add (String::fromUTF8 (argv[i]));
+
+    for (int i = 0; i < args.size(); ++i)
+    {
+        const auto& arg = args[i];
+        auto next = [&]() -> String {
+            if (i + 1 >= args.size())
+                return {};
+            return args[++i];
+        };
+
+        if (arg == "-h" || arg == "--help")
+        {
+            std::cout << usage;
+            return 0;
+        }
+        else if (arg == "-o" || arg == "--output")  options.outputFile = getFile (next());
+        else if (arg == "-i" || arg == "--input")   options.inputFiles.add (getFile (next()));
+        else if (arg == "-m" || arg == "--midi")    options.midiFile = getFile (next());
+        else if (arg == "-r" || arg == "--rate")    options.sampleRate = next().getDoubleValue();
+        else if (arg == "-b" || arg == "--block")   options.blockSize = next().getIntValue();
+        else if (arg == "--inputs")                 options.numInputs = next().getIntValue();
+        else if (arg == "--outputs")                options.numOutputs = next().getIntValue();
+        else if (arg == "-l" || arg == "--length")  options.lengthSeconds = next().getDoubleValue();
+        else if (arg == "-t" || arg == "--tail")    options.tailSeconds = next().getDoubleValue();
+        else if (arg == "-d" || arg == "--bits")    options.bitDepth = next().getIntValue();
+        else if (arg == "-g" || arg == "--graph")   graphIndex = next().getIntValue();
+        else if (arg == "--no-latency")             options.compensateLatency = false;
+        else if (arg == "-q" || arg == "--quiet")   quiet = true;
+        else if (arg.startsWith ("-"))              return fail ("unknown option " + arg);
+        else                                        sessionFile = getFile (arg);
+    }
+
+    if (! sessionFile.existsAsFile())
+        return fail ("no session file given\n\n" + String (usage));
+    if (options.outputFile == File())
+        return fail ("no output file given");
+
+    Globals world;
+    world.setEngine (new AudioEngine (world, RunMode::Offline));
+    auto engine = world.getAudioEngine();
+    auto& settings = world.getSettings();
+    auto& plugins = world.getPluginManager();
+    engine->applySettings (settings);
+
+    plugins.addDefaultFormats();
+    plugins.addFormat (new InternalFormat (*engine, world.getMidiEngine()));
+    plugins.addFormat (new ElementAudioPluginFormat (world));
+    plugins.restoreUserPlugins (settings);
+    plugins.setPlayConfig (options.sampleRate, options.blockSize);
+    engine->prepareExternalPlayback (options.sampleRate, options.blockSize,
+                                     options.numInputs, options.numOutputs);
+
+    std::unique_ptr<AppController> controller (new AppController (world, RunMode::Offline));
+    controller->activate();
+
+    String error;
+    auto session = world.getSession();
+    ValueTree data;
+    if (SessionArchive::load (sessionFile, data).wasOk())
+    {
+        if (! data.hasType (Tags::session) || ! session->loadData (data))
+            error = "could not load session " + sessionFile.getFullPathName();
+    }
+    else
+    {
+        error = "not a valid session file: " + sessionFile.getFullPathName();
+    }
+
+    OfflineRenderer renderer (*engine);
+
+    if (error.isEmpty())
+    {
+        controller->findChild<EngineController>()->sessionReloaded();
+        if (graphIndex >= 0)
+            engine->setActiveGraph (graphIndex);
+
+        // let plugins finish loading and graphs pick up their connections.
+        // The timeout is only there for a plugin which never finishes
+        const auto loadDeadline = Time::getMillisecondCounterHiRes() + 60.0 * 1000.0;
+        while (! isSessionLoaded (*session))
+        {
+            if (Time::getMillisecondCounterHiRes() > loadDeadline)
+            {
+                error = "timed out waiting for the session to load";
+                break;
+            }
+
+            MessageManager::getInstance()->runDispatchLoopUntil (10);
+        }
+    }
+
+    if (error.isEmpty())
+    {
+        if (! quiet)
+        {
+            renderer.onProgress = [] (double progress)
+            {
+                std::cout << "\rrendering " << roundToInt (progress * 100.0) << "%" << std::flush;
+            };
+        }
+
+        const auto result = renderer.render (options);
+        if (! quiet)
+            std::cout << std::endl;
+
+        if (result.failed())
+            error = result.getErrorMessage();
+        else if (! quiet)
+            std::cout << "wrote " << String (renderer.getRenderedSeconds(), 2) << " seconds to "
+                      << options.outputFile.getFullPathName() << " ("
+                      << String (renderer.getRealtimeFactor(), 1) << "x realtime)" << std::endl;
+    }
+
+    controller->deactivate();
+    session->clear();
+    controller = nullptr;
+    world.setEngine (nullptr);
+
+    return error.isEmpty() ? 0 : fail (error);
+}